@@ -20,7 +20,9 @@
 #include <android-base/logging.h>
 #include <gtest/gtest.h>
 #include <stdio.h>
+#include <chrono>
 #include <fstream>
+#include <thread>
 
 #include <codec2/hidl/client.h>
 #include <C2AllocatorIon.h>
@@ -850,6 +852,117 @@ TEST_F(Codec2VideoDecHidlTest, DecodeTestEmptyBuffersInserted) {
     }
 }
 
+// Decoding throughput of the VP9 decoder by decoder thread count and number of
+// concurrent sessions
+TEST_F(Codec2VideoDecHidlTest, DecodeThroughputTest) {
+    description("Measures decoding fps vs. thread count vs. concurrent sessions");
+    if (mDisableTest) return;
+    if (mCompName != vp9) return;
+
+    // must match C2VpxDecoderThreadsTuning of the VP9 decoder
+    typedef C2GlobalParam<C2Tuning, C2Uint32Value, C2Param::TYPE_INDEX_VENDOR_START>
+            VpxDecoderThreadsTuning;
+
+    char mURL[512], info[512];
+    std::ifstream eleInfo;
+
+    strcpy(mURL, gEnv->getRes().c_str());
+    strcpy(info, gEnv->getRes().c_str());
+    GetURLForComponent(mCompName, mURL, info);
+
+    eleInfo.open(info);
+    ASSERT_EQ(eleInfo.is_open(), true);
+    android::Vector<FrameInfo> Info;
+    int bytesCount = 0;
+    uint32_t flags = 0;
+    uint32_t timestamp = 0;
+    while (1) {
+        if (!(eleInfo >> bytesCount)) break;
+        eleInfo >> flags;
+        eleInfo >> timestamp;
+        Info.push_back({bytesCount, flags, timestamp});
+    }
+    eleInfo.close();
+
+    struct Session {
+        std::shared_ptr<android::Codec2Client::Listener> listener;
+        std::shared_ptr<android::Codec2Client::Component> component;
+        std::shared_ptr<C2BlockPool> linearPool;
+        std::mutex queueLock;
+        std::condition_variable queueCondition;
+        std::list<std::unique_ptr<C2Work>> workQueue;
+        std::list<uint64_t> flushedIndices;
+        bool eos = false;
+        uint32_t framesReceived = 0;
+    };
+
+    for (uint32_t threads : { 1u, 2u, 4u, 0u }) {
+        for (size_t sessionCount : { 1u, 2u, 4u, 8u }) {
+            std::vector<std::unique_ptr<Session>> sessions;
+            for (size_t i = 0; i < sessionCount; ++i) {
+                sessions.emplace_back(new Session);
+                Session *session = sessions.back().get();
+                session->listener.reset(new CodecListener(
+                    [session](std::list<std::unique_ptr<C2Work>>& workItems) {
+                        for (std::unique_ptr<C2Work>& work : workItems) {
+                            if (work->worklets.empty()) continue;
+                            bool csd;
+                            workDone(session->component, work, session->flushedIndices,
+                                     session->queueLock, session->queueCondition,
+                                     session->workQueue, session->eos, csd,
+                                     session->framesReceived);
+                        }
+                    }));
+                for (int j = 0; j < MAX_INPUT_BUFFERS; ++j) {
+                    session->workQueue.emplace_back(new C2Work);
+                }
+                session->linearPool = std::make_shared<C2PooledBlockPool>(
+                        mLinearAllocator, mBlockPoolId++);
+                mClient->createComponent(gEnv->getComponent().c_str(),
+                                         session->listener, &session->component);
+                ASSERT_NE(session->component, nullptr);
+
+                VpxDecoderThreadsTuning threadsTuning(threads);
+                std::vector<std::unique_ptr<C2SettingResult>> failures;
+                ASSERT_EQ(session->component->config(
+                        { &threadsTuning }, C2_DONT_BLOCK, &failures), C2_OK);
+                ASSERT_EQ(session->component->start(), C2_OK);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> decoders;
+            for (const std::unique_ptr<Session>& session : sessions) {
+                decoders.emplace_back([&Info, &mURL, session = session.get()] {
+                    std::ifstream eleStream(mURL, std::ifstream::binary);
+                    ASSERT_EQ(eleStream.is_open(), true);
+                    ASSERT_NO_FATAL_FAILURE(decodeNFrames(
+                        session->component, session->queueLock,
+                        session->queueCondition, session->workQueue,
+                        session->flushedIndices, session->linearPool, eleStream,
+                        &Info, 0, (int)Info.size()));
+                    ASSERT_NO_FATAL_FAILURE(waitOnInputConsumption(
+                        session->queueLock, session->queueCondition,
+                        session->workQueue));
+                });
+            }
+            for (std::thread& decoder : decoders) {
+                decoder.join();
+            }
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+
+            for (const std::unique_ptr<Session>& session : sessions) {
+                EXPECT_EQ(session->framesReceived, Info.size());
+                ASSERT_EQ(session->component->release(), C2_OK);
+            }
+            double fps = sessionCount * Info.size() / elapsed.count();
+            std::cout << "[   INFO   ] threads " << threads << " sessions "
+                      << sessionCount << ": " << fps << " fps total, "
+                      << fps / sessionCount << " fps per session\n";
+        }
+    }
+}
+
 }  // anonymous namespace
 
 // TODO : Video specific configuration Test
@@ -34,6 +34,8 @@
 
 #include <android-base/file.h>
 
+#include <dlfcn.h>
+
 #ifdef LOG
 #undef LOG
 #endif
@@ -351,6 +353,29 @@ std::ostream& dump(
     return out;
 }
 
+// Dump the codec thread budget shared by software components, if they are
+// loaded in this process
+std::ostream& dumpThreadBudget(std::ostream& out) {
+    constexpr const char indent[] = "  ";
+
+    void* lib = dlopen("libstagefright_soft_c2common.so",
+                       RTLD_NOW | RTLD_NOLOAD);
+    if (!lib) {
+        return out;
+    }
+    typedef size_t (*DumpFunc)(char*, size_t);
+    DumpFunc dumpFunc = (DumpFunc)dlsym(lib, "SimpleC2ThreadBudget_Dump");
+    if (dumpFunc) {
+        // allocations may change between the two calls
+        std::string dump(dumpFunc(nullptr, 0) + 1, '\0');
+        size_t length = dumpFunc(&dump[0], dump.size());
+        dump.resize(std::min(length, dump.size() - 1));
+        out << indent << dump << std::endl;
+    }
+    dlclose(lib);
+    return out;
+}
+
 } // unnamed namespace
 
 Return<void> ComponentStore::debug(
@@ -415,6 +440,8 @@ Return<void> ComponentStore::debug(
             }
         }
 
+        dumpThreadBudget(out);
+
         out << "End of dump -- C2ComponentStore: "
                 << mStore->getName() << std::endl;
     }
@@ -64,9 +64,10 @@ Return<void> CachedConfigurable::query(
             mayBlock ? C2_MAY_BLOCK : C2_DONT_BLOCK,
             &c2heapParams);
 
-    hidl_vec<uint8_t> params;
-    createParamsBlob(&params, c2heapParams);
-    _hidl_cb(static_cast<Status>(c2res), params);
+    // binder threads are long-lived, so reuse their blob storage across calls
+    thread_local ParamsBlobBuilder params;
+    params.build(c2heapParams);
+    _hidl_cb(static_cast<Status>(c2res), params.blob());
 
     return Void();
 }
@@ -100,9 +101,9 @@ Return<void> CachedConfigurable::config(
         }
         failures.resize(ix);
     }
-    hidl_vec<uint8_t> outParams;
-    createParamsBlob(&outParams, c2params);
-    _hidl_cb((Status)c2res, failures, outParams);
+    thread_local ParamsBlobBuilder outParams;
+    outParams.build(c2params);
+    _hidl_cb((Status)c2res, failures, outParams.blob());
     return Void();
 }
 
@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "Codec2-InputBufferManager"
+#include <android-base/logging.h>
+
+#include <codec2/hidl/1.0/InputBufferManager.h>
+#include <codec2/hidl/1.0/types.h>
+
+#include <C2Debug.h>
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+
+namespace hardware {
+namespace google {
+namespace media {
+namespace c2 {
+namespace V1_0 {
+namespace utils {
+
+using namespace ::android;
+
+constexpr nsecs_t InputBufferManager::kMinNotificationPeriodNs;
+constexpr nsecs_t InputBufferManager::kMaxNotificationPeriodNs;
+constexpr size_t InputBufferManager::kThrottleBatchSize;
+
+InputBufferManager::Shard::Shard(const wp<IComponentListener>& listener)
+      : listener(listener),
+        lastSentNs(systemTime() - kMaxNotificationPeriodNs),
+        periodNs(kMinNotificationPeriodNs),
+        pending(false) {
+}
+
+void InputBufferManager::registerFrameData(
+        const sp<IComponentListener>& listener,
+        const C2FrameData& input) {
+    getInstance()._registerFrameData(listener, input);
+}
+
+void InputBufferManager::unregisterFrameData(
+        const wp<IComponentListener>& listener,
+        const C2FrameData& input) {
+    getInstance()._unregisterFrameData(listener, input);
+}
+
+void InputBufferManager::unregisterFrameData(
+        const wp<IComponentListener>& listener) {
+    getInstance()._unregisterFrameData(listener);
+}
+
+std::shared_ptr<InputBufferManager::Shard> InputBufferManager::getShard(
+        const wp<IComponentListener>& listener, bool create) {
+    std::lock_guard<std::mutex> lock(mShardsMutex);
+    auto it = mShards.find(listener);
+    if (it != mShards.end()) {
+        return it->second;
+    }
+    if (!create) {
+        return nullptr;
+    }
+    std::shared_ptr<Shard> shard = std::make_shared<Shard>(listener);
+    mShards.emplace(listener, shard);
+    return shard;
+}
+
+void InputBufferManager::_registerFrameData(
+        const sp<IComponentListener>& listener,
+        const C2FrameData& input) {
+    uint64_t frameIndex = input.ordinal.frameIndex.peeku();
+    ALOGV("InputBufferManager::_registerFrameData called "
+          "(listener @ %p, frameIndex = %llu)",
+          listener.get(),
+          static_cast<long long unsigned>(frameIndex));
+    std::shared_ptr<Shard> shard = getShard(listener, true);
+    std::lock_guard<std::mutex> lock(shard->mutex);
+
+    std::vector<std::unique_ptr<TrackedBuffer>> &bufferIds =
+            shard->trackedBuffers[frameIndex];
+
+    for (size_t i = 0; i < input.buffers.size(); ++i) {
+        if (!input.buffers[i]) {
+            ALOGV("InputBufferManager::_registerFrameData: "
+                  "Input buffer at index %zu is null", i);
+            continue;
+        }
+        bufferIds.emplace_back(std::make_unique<TrackedBuffer>(
+                shard, frameIndex, i, input.buffers[i]));
+
+        c2_status_t status = input.buffers[i]->registerOnDestroyNotify(
+                onBufferDestroyed, bufferIds.back().get());
+        if (status != C2_OK) {
+            ALOGD("InputBufferManager: registerOnDestroyNotify failed "
+                  "(listener @ %p, frameIndex = %llu, bufferIndex = %zu) "
+                  "=> %s (%d)",
+                  listener.get(),
+                  static_cast<unsigned long long>(frameIndex),
+                  i,
+                  asString(status), static_cast<int>(status));
+            bufferIds.pop_back();
+        }
+    }
+    if (bufferIds.empty()) {
+        shard->trackedBuffers.erase(frameIndex);
+    }
+}
+
+void InputBufferManager::unregisterBuffers_l(
+        const std::vector<std::unique_ptr<TrackedBuffer>>& buffers) {
+    for (const std::unique_ptr<TrackedBuffer>& bufferId : buffers) {
+        std::shared_ptr<C2Buffer> buffer = bufferId->buffer.lock();
+        if (buffer) {
+            c2_status_t status = buffer->unregisterOnDestroyNotify(
+                    onBufferDestroyed, bufferId.get());
+            if (status != C2_OK) {
+                ALOGD("InputBufferManager: "
+                      "unregisterOnDestroyNotify failed "
+                      "(frameIndex = %llu, bufferIndex = %zu) "
+                      "=> %s (%d)",
+                      static_cast<unsigned long long>(bufferId->frameIndex),
+                      bufferId->bufferIndex,
+                      asString(status), static_cast<int>(status));
+            }
+        }
+    }
+}
+
+// Remove a pair (listener, frameIndex) from the listener's Shard. This implies
+// all bufferIndices and their pending notifications are removed.
+//
+// This is called from onWorkDone() and flush().
+void InputBufferManager::_unregisterFrameData(
+        const wp<IComponentListener>& listener,
+        const C2FrameData& input) {
+    uint64_t frameIndex = input.ordinal.frameIndex.peeku();
+    ALOGV("InputBufferManager::_unregisterFrameData called "
+          "(listener @ %p, frameIndex = %llu)",
+          listener.unsafe_get(),
+          static_cast<long long unsigned>(frameIndex));
+    std::shared_ptr<Shard> shard = getShard(listener, false);
+    if (!shard) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(shard->mutex);
+
+    auto findFrameIndex = shard->trackedBuffers.find(frameIndex);
+    if (findFrameIndex != shard->trackedBuffers.end()) {
+        unregisterBuffers_l(findFrameIndex->second);
+        shard->trackedBuffers.erase(findFrameIndex);
+    }
+
+    std::vector<std::pair<uint64_t, size_t>> &deathNotifications =
+            shard->deathNotifications;
+    deathNotifications.erase(
+            std::remove_if(
+                    deathNotifications.begin(), deathNotifications.end(),
+                    [frameIndex](const std::pair<uint64_t, size_t>& p) {
+                        return p.first == frameIndex;
+                    }),
+            deathNotifications.end());
+}
+
+// Remove the Shard of listener. This implies all frameIndices, bufferIndices
+// and pending notifications are removed.
+//
+// This is called when the component cleans up all input buffers, i.e., when
+// reset(), release(), stop() or ~Component() is called.
+void InputBufferManager::_unregisterFrameData(
+        const wp<IComponentListener>& listener) {
+    ALOGV("InputBufferManager::_unregisterFrameData called (listener @ %p)",
+            listener.unsafe_get());
+    std::shared_ptr<Shard> shard;
+    {
+        std::lock_guard<std::mutex> lock(mShardsMutex);
+        auto it = mShards.find(listener);
+        if (it == mShards.end()) {
+            return;
+        }
+        shard = std::move(it->second);
+        mShards.erase(it);
+    }
+
+    // A pending Shard will be dropped by the notification thread once it
+    // finds it empty.
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    for (const auto& frame : shard->trackedBuffers) {
+        unregisterBuffers_l(frame.second);
+    }
+    shard->trackedBuffers.clear();
+    shard->deathNotifications.clear();
+}
+
+// Move a buffer from the tracked buffers to the pending notifications of its
+// Shard. This is called when a registered C2Buffer object is destroyed.
+void InputBufferManager::onBufferDestroyed(const C2Buffer* buf, void* arg) {
+    getInstance()._onBufferDestroyed(buf, arg);
+}
+
+void InputBufferManager::_onBufferDestroyed(const C2Buffer* buf, void* arg) {
+    if (!buf || !arg) {
+        ALOGW("InputBufferManager::_onBufferDestroyed called "
+              "with null argument(s) (buf @ %p, arg @ %p)",
+              buf, arg);
+        return;
+    }
+    const TrackedBuffer* id = reinterpret_cast<const TrackedBuffer*>(arg);
+    std::shared_ptr<Shard> shard = id->shard.lock();
+    uint64_t frameIndex = id->frameIndex;
+    size_t bufferIndex = id->bufferIndex;
+    ALOGV("InputBufferManager::_onBufferDestroyed called "
+          "(frameIndex = %llu, bufferIndex = %zu)",
+          static_cast<unsigned long long>(frameIndex),
+          bufferIndex);
+    if (!shard) {
+        ALOGD("InputBufferManager::_onBufferDestroyed received "
+              "invalid listener "
+              "(frameIndex = %llu, bufferIndex = %zu)",
+              static_cast<unsigned long long>(frameIndex),
+              bufferIndex);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+
+        auto findFrameIndex = shard->trackedBuffers.find(frameIndex);
+        if (findFrameIndex == shard->trackedBuffers.end()) {
+            ALOGD("InputBufferManager::_onBufferDestroyed received "
+                  "invalid frame index "
+                  "(listener @ %p, frameIndex = %llu, bufferIndex = %zu)",
+                  shard->listener.unsafe_get(),
+                  static_cast<unsigned long long>(frameIndex),
+                  bufferIndex);
+            return;
+        }
+
+        std::vector<std::unique_ptr<TrackedBuffer>> &bufferIds =
+                findFrameIndex->second;
+        auto findBufferId = std::find_if(
+                bufferIds.begin(), bufferIds.end(),
+                [id](const std::unique_ptr<TrackedBuffer>& bufferId) {
+                    return bufferId.get() == id;
+                });
+        if (findBufferId == bufferIds.end()) {
+            ALOGD("InputBufferManager::_onBufferDestroyed received "
+                  "invalid buffer index: "
+                  "(listener @ %p, frameIndex = %llu, bufferIndex = %zu)",
+                  shard->listener.unsafe_get(),
+                  static_cast<unsigned long long>(frameIndex),
+                  bufferIndex);
+            return;
+        }
+
+        bufferIds.erase(findBufferId);
+        if (bufferIds.empty()) {
+            shard->trackedBuffers.erase(findFrameIndex);
+        }
+
+        shard->deathNotifications.emplace_back(frameIndex, bufferIndex);
+        // Only the first notification of a period wakes up the notification
+        // thread; later ones are sent in the same batch.
+        if (shard->pending) {
+            return;
+        }
+        shard->pending = true;
+    }
+
+    std::lock_guard<std::mutex> lock(mPendingMutex);
+    mPendingShards.emplace_back(std::move(shard));
+    mOnBufferDestroyed.notify_one();
+}
+
+// Notify the clients about buffer destructions.
+// Return false if all destructions have been notified.
+// Return true and set timeToRetry to the time point to wait for before
+// retrying if some destructions have not been notified.
+bool InputBufferManager::processNotifications(nsecs_t* timeToRetryNs) {
+
+    struct Notification {
+        sp<IComponentListener> listener;
+        hidl_vec<IComponentListener::RenderedFrame> renderedFrames;
+        Notification(const sp<IComponentListener>& l, size_t s)
+              : listener(l), renderedFrames(s) {}
+    };
+    std::list<Notification> notifications;
+
+    std::deque<std::shared_ptr<Shard>> shards;
+    {
+        std::lock_guard<std::mutex> lock(mPendingMutex);
+        shards.swap(mPendingShards);
+    }
+
+    std::vector<std::shared_ptr<Shard>> postponed;
+    *timeToRetryNs = kMaxNotificationPeriodNs;
+    nsecs_t timeNowNs = systemTime();
+    for (const std::shared_ptr<Shard>& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        sp<IComponentListener> listener = shard->listener.promote();
+        if (!listener || shard->deathNotifications.empty()) {
+            shard->deathNotifications.clear();
+            shard->pending = false;
+            continue;
+        }
+
+        nsecs_t timeSinceLastNotifiedNs = timeNowNs - shard->lastSentNs;
+        // If not enough time has passed since the last callback, leave the
+        // notifications for this listener untouched for now and retry later.
+        if (timeSinceLastNotifiedNs < shard->periodNs) {
+            *timeToRetryNs = std::min(*timeToRetryNs,
+                    shard->periodNs - timeSinceLastNotifiedNs);
+            ALOGV("InputBufferManager: Notifications for "
+                  "listener @ %p will be postponed.",
+                  listener.get());
+            postponed.push_back(shard);
+            continue;
+        }
+
+        // Create the argument for the callback.
+        size_t count = shard->deathNotifications.size();
+        notifications.emplace_back(listener, count);
+        hidl_vec<IComponentListener::RenderedFrame>& renderedFrames =
+                notifications.back().renderedFrames;
+        for (size_t i = 0; i < count; ++i) {
+            const std::pair<uint64_t, size_t> &p = shard->deathNotifications[i];
+            IComponentListener::RenderedFrame &renderedFrame = renderedFrames[i];
+            renderedFrame.slotId = ~p.second;
+            renderedFrame.bufferQueueId = p.first;
+            renderedFrame.timestampNs = timeNowNs;
+            ALOGV("InputBufferManager: "
+                  "Sending death notification (listener @ %p, "
+                  "frameIndex = %llu, bufferIndex = %zu)",
+                  listener.get(),
+                  static_cast<long long unsigned>(p.first),
+                  p.second);
+        }
+
+        // Throttle listeners that get many notifications per callback, and
+        // speed up those that get few.
+        shard->periodNs = count >= kThrottleBatchSize ?
+                std::min(shard->periodNs * 2, kMaxNotificationPeriodNs) :
+                std::max(shard->periodNs / 2, kMinNotificationPeriodNs);
+        shard->deathNotifications.clear();
+        shard->lastSentNs = timeNowNs;
+        shard->pending = false;
+    }
+
+    bool retry = !postponed.empty();
+    if (retry) {
+        std::lock_guard<std::mutex> lock(mPendingMutex);
+        mPendingShards.insert(mPendingShards.begin(),
+                              postponed.begin(), postponed.end());
+    }
+
+    // Call onFramesRendered outside the lock to avoid deadlock.
+    for (const Notification& notification : notifications) {
+        if (!notification.listener->onFramesRendered(
+                notification.renderedFrames).isOk()) {
+            // This may trigger if the client has died.
+            ALOGD("InputBufferManager: onFramesRendered transaction failed "
+                  "(listener @ %p)",
+                  notification.listener.get());
+        }
+    }
+    if (retry) {
+        ALOGV("InputBufferManager: Pending death notifications"
+              "will be sent in %lldns.",
+              static_cast<long long>(*timeToRetryNs));
+    }
+    return retry;
+}
+
+void InputBufferManager::main() {
+    ALOGV("InputBufferManager: Starting main thread");
+    nsecs_t timeToRetryNs;
+    bool retry = false;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mPendingMutex);
+            if (retry) {
+                // A Shard that gets its first notification cuts the wait
+                // short.
+                mOnBufferDestroyed.wait_for(
+                        lock, std::chrono::nanoseconds(timeToRetryNs));
+            } else {
+                ALOGV("InputBufferManager: Waiting for buffer deaths");
+                mOnBufferDestroyed.wait(
+                        lock, [this] { return !mPendingShards.empty(); });
+            }
+        }
+        ALOGV("InputBufferManager: Sending buffer death notifications");
+        retry = processNotifications(&timeToRetryNs);
+    }
+}
+
+InputBufferManager::InputBufferManager()
+      : mMainThread(&InputBufferManager::main, this) {
+}
+
+InputBufferManager& InputBufferManager::getInstance() {
+    static InputBufferManager instance{};
+    return instance;
+}
+
+}  // namespace utils
+}  // namespace V1_0
+}  // namespace c2
+}  // namespace media
+}  // namespace google
+}  // namespace hardware
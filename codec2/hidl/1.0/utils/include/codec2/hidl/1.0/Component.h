@@ -108,6 +108,15 @@ protected:
     ::hardware::google::media::c2::V1_0::utils::DefaultBufferPoolSender
             mBufferPoolSender;
 
+    // Storage recycled across queue() and onWorkDone() calls. mWorkBundle is
+    // the WorkBundle last sent to the listener; it is reused for the next one.
+    WorkArena mWorkArena;
+    std::mutex mWorkBundleMutex;
+    WorkBundle mWorkBundle;
+
+    // Linear blocks imported from the input buffers received in queue().
+    BaseBlockCache mBaseBlockCache;
+
     std::mutex mBlockPoolsMutex;
     // This map keeps C2BlockPool objects that are created by createBlockPool()
     // alive. These C2BlockPool objects can be deleted by calling
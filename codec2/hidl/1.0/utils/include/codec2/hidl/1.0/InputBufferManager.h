@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HARDWARE_GOOGLE_MEDIA_C2_V1_0_UTILS_INPUTBUFFERMANAGER_H
+#define HARDWARE_GOOGLE_MEDIA_C2_V1_0_UTILS_INPUTBUFFERMANAGER_H
+
+#include <hardware/google/media/c2/1.0/IComponentListener.h>
+#include <utils/Timers.h>
+
+#include <C2Buffer.h>
+#include <C2Work.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hardware {
+namespace google {
+namespace media {
+namespace c2 {
+namespace V1_0 {
+namespace utils {
+
+using ::android::sp;
+using ::android::wp;
+
+// InputBufferManager
+// ==================
+//
+// InputBufferManager presents a way to track and untrack input buffers in this
+// (codec) process and send a notification to a listener, possibly in a
+// different process, when a tracked buffer no longer has any references in this
+// process. (In fact, this class would work for listeners in the same process
+// too, but the optimization discussed below will not be beneficial.)
+//
+// InputBufferManager holds a collection of records representing tracked buffers
+// and their callback listeners. Conceptually, one record is a triple (listener,
+// frameIndex, bufferIndex) where
+//
+// - (frameIndex, bufferIndex) is a pair of indices used to identify the buffer.
+// - listener is of type IComponentListener. Its onFramesRendered() function
+//   will be called after the associated buffer dies. The argument of
+//   onFramesRendered() is a list of RenderedFrame objects, each of which has
+//   the following members:
+//
+//     uint64_t bufferQueueId
+//     int32_t  slotId
+//     int64_t  timestampNs
+//
+// When a tracked buffer associated to the triple (listener, frameIndex,
+// bufferIndex) goes out of scope, listener->onFramesRendered() will be called
+// with a RenderedFrame object whose members are set as follows:
+//
+//     bufferQueueId = frameIndex
+//     slotId        = ~bufferIndex
+//     timestampNs   = systemTime() at the time of notification
+//
+// The reason for the bitwise negation of bufferIndex is that onFramesRendered()
+// may be used for a different purpose when slotId is non-negative (which is a
+// more general use case).
+//
+// Sharding
+// --------
+//
+// The records of each listener are kept in a separate Shard object with its
+// own mutex, so buffers of different components never contend with each
+// other. The process-wide mutexes are only taken to look up a listener's Shard
+// when a frame is registered, and when a Shard gets its first pending
+// notification in a notification period.
+//
+// IPC Optimization
+// ----------------
+//
+// Since onFramesRendered() generally is an IPC call, InputBufferManager tries
+// not to call it too often. There is a mechanism to guarantee that any two
+// calls to the same listener are at least Shard::periodNs nanoseconds apart.
+// The period of a listener adapts to its rate of buffer destructions: it is
+// doubled when a notification carries many frames and halved when it carries
+// few, within [kMinNotificationPeriodNs, kMaxNotificationPeriodNs].
+//
+struct InputBufferManager {
+    // The bounds of the minimum time period between IPC calls to notify the
+    // same client about the destruction of input buffers.
+    static constexpr nsecs_t kMinNotificationPeriodNs = 250000;
+    static constexpr nsecs_t kMaxNotificationPeriodNs = 4000000;
+
+    // The number of frames in one notification at or above which the period of
+    // the listener is doubled. Below this, the period is halved.
+    static constexpr size_t kThrottleBatchSize = 4;
+
+    // Track all buffers in a C2FrameData object.
+    //
+    // input (C2FrameData) has the following two members that are of interest:
+    //
+    //   C2WorkOrdinal                ordinal
+    //   vector<shared_ptr<C2Buffer>> buffers
+    //
+    // Calling registerFrameData(listener, input) will register multiple
+    // triples (, frameIndex, bufferIndex) where frameIndex is equal to
+    // input.ordinal.frameIndex and bufferIndex runs through the indices of
+    // input.buffers such that input.buffers[bufferIndex] is not null.
+    //
+    // This should be called from queue().
+    static void registerFrameData(
+            const sp<IComponentListener>& listener,
+            const C2FrameData& input);
+
+    // Untrack all buffers in a C2FrameData object.
+    //
+    // Calling unregisterFrameData(listener, input) will unregister and remove
+    // pending notifications for all triples (l, fi, bufferIndex) such that
+    // l = listener and fi = input.ordinal.frameIndex.
+    //
+    // This should be called from onWorkDone() and flush().
+    static void unregisterFrameData(
+            const wp<IComponentListener>& listener,
+            const C2FrameData& input);
+
+    // Untrack all buffers associated to a given listener.
+    //
+    // Calling unregisterFrameData(listener) will unregister and remove
+    // pending notifications for all triples (l, frameIndex, bufferIndex) such
+    // that l = listener.
+    //
+    // This should be called when the component cleans up all input buffers,
+    // i.e., when reset(), release(), stop() or ~Component() is called.
+    static void unregisterFrameData(
+            const wp<IComponentListener>& listener);
+
+private:
+    struct Shard;
+
+    // Persistent data to be passed as "arg" in onBufferDestroyed().
+    // This is essentially the triple (listener, frameIndex, bufferIndex) plus a
+    // weak pointer to the C2Buffer object. The listener is represented by its
+    // Shard.
+    struct TrackedBuffer {
+        std::weak_ptr<Shard> shard;
+        uint64_t frameIndex;
+        size_t bufferIndex;
+        std::weak_ptr<C2Buffer> buffer;
+        TrackedBuffer(const std::shared_ptr<Shard>& shard,
+                      uint64_t frameIndex,
+                      size_t bufferIndex,
+                      const std::shared_ptr<C2Buffer>& buffer)
+              : shard(shard),
+                frameIndex(frameIndex),
+                bufferIndex(bufferIndex),
+                buffer(buffer) {}
+    };
+
+    // Tracked buffers and pending notifications of one listener.
+    struct Shard {
+        const wp<IComponentListener> listener;
+
+        // Mutex for all members below.
+        std::mutex mutex;
+
+        // Map: frameIndex -> tracked buffers of the frame.
+        // TrackedBuffer objects are allocated individually so that their
+        // addresses, which are registered with the C2Buffer objects, stay
+        // valid while the map grows.
+        std::unordered_map<uint64_t, std::vector<std::unique_ptr<TrackedBuffer>>>
+                trackedBuffers;
+
+        // Pending (unsent) death notifications: (frameIndex, bufferIndex).
+        std::vector<std::pair<uint64_t, size_t>> deathNotifications;
+
+        // The timestamp of the most recent callback on this listener.
+        nsecs_t lastSentNs;
+
+        // The current minimum time period between two callbacks.
+        nsecs_t periodNs;
+
+        // Whether this Shard is in mPendingShards.
+        bool pending;
+
+        explicit Shard(const wp<IComponentListener>& listener);
+    };
+
+    // Comparison operator for weak pointers.
+    struct CompareWeakComponentListener {
+        constexpr bool operator()(
+                const wp<IComponentListener>& x,
+                const wp<IComponentListener>& y) const {
+            return x.get_refs() < y.get_refs();
+        }
+    };
+
+    void _registerFrameData(
+            const sp<IComponentListener>& listener,
+            const C2FrameData& input);
+    void _unregisterFrameData(
+            const wp<IComponentListener>& listener,
+            const C2FrameData& input);
+    void _unregisterFrameData(
+            const wp<IComponentListener>& listener);
+
+    // Returns the Shard of listener, or null if there is none. If create is
+    // true, a new Shard is created instead of returning null.
+    std::shared_ptr<Shard> getShard(
+            const wp<IComponentListener>& listener, bool create);
+
+    // Unregister the destruction callbacks of buffers. shard->mutex must be
+    // held.
+    static void unregisterBuffers_l(
+            const std::vector<std::unique_ptr<TrackedBuffer>>& buffers);
+
+    // The callback function tied to C2Buffer objects.
+    //
+    // Note: This function assumes that sInstance is the only instance of this
+    //       class.
+    static void onBufferDestroyed(const C2Buffer* buf, void* arg);
+    void _onBufferDestroyed(const C2Buffer* buf, void* arg);
+
+    // Notify the clients about buffer destructions.
+    // Return false if all destructions have been notified.
+    // Return true and set timeToRetry to the duration to wait for before
+    // retrying if some destructions have not been notified.
+    bool processNotifications(nsecs_t* timeToRetryNs);
+
+    // Main function for the input buffer manager thread.
+    void main();
+
+    // Mutex for mShards.
+    std::mutex mShardsMutex;
+
+    // Map: listener -> Shard.
+    std::map<wp<IComponentListener>, std::shared_ptr<Shard>,
+             CompareWeakComponentListener> mShards;
+
+    // Mutex for mPendingShards.
+    std::mutex mPendingMutex;
+
+    // Shards that have pending notifications. A Shard is added when it gets
+    // its first pending notification, and removed when its notifications are
+    // sent.
+    std::deque<std::shared_ptr<Shard>> mPendingShards;
+
+    // Condition variable signaled when a Shard is added to mPendingShards.
+    std::condition_variable mOnBufferDestroyed;
+
+    // The thread that manages notifications.
+    //
+    // Note: This variable is declared last so its initialization will happen
+    // after all other member variables have been initialized.
+    std::thread mMainThread;
+
+    // Private constructor.
+    InputBufferManager();
+
+    // The only instance of this class.
+    static InputBufferManager& getInstance();
+
+};
+
+}  // namespace utils
+}  // namespace V1_0
+}  // namespace c2
+}  // namespace media
+}  // namespace google
+}  // namespace hardware
+
+#endif  // HARDWARE_GOOGLE_MEDIA_C2_V1_0_UTILS_INPUTBUFFERMANAGER_H
@@ -18,6 +18,11 @@
 #define HARDWARE_GOOGLE_MEDIA_C2_V1_0_UTILS_TYPES_H
 
 #include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 #include <bufferpool/ClientManager.h>
 #include <android/hardware/media/bufferpool/1.0/IClientManager.h>
@@ -218,6 +223,145 @@ c2_status_t objcpy(
         std::list<std::unique_ptr<C2Work>>* d,
         const WorkBundle& s);
 
+struct BaseBlockCache;
+
+// Storage that is recycled across calls to objcpy() between C2Work objects and
+// WorkBundle, so that marshalling work items in steady state does not
+// allocate.
+//
+// std::list<std::unique_ptr<C2Work>> -> WorkBundle: objcpy() overwrites the
+// given WorkBundle in place, and only reallocates its hidl_vecs when their
+// sizes change. The arena holds the scratch storage for the base blocks of the
+// bundle. Marshalling with the same arena (and WorkBundle) must be serialized
+// by the caller.
+//
+// WorkBundle -> std::list<std::unique_ptr<C2Work>>: objcpy() takes C2Work
+// objects, including their worklets and list nodes, from the ones given back
+// by recycle(). recycle() may be called from any thread.
+struct WorkArena {
+    WorkArena();
+
+    // Takes back C2Work objects that are no longer used. Their buffers, params
+    // and chain info are released right away. works is empty afterwards.
+    void recycle(std::list<std::unique_ptr<C2Work>>* works);
+
+    // The numbers of C2Work objects that objcpy() has allocated and reused.
+    size_t allocatedWorks() const;
+    size_t reusedWorks() const;
+
+private:
+    // The maximum number of recycled C2Work objects to keep.
+    static constexpr size_t kMaxFreeWorks = 16;
+
+    // Appends a recycled or new C2Work object to works.
+    void takeWork(std::list<std::unique_ptr<C2Work>>* works);
+
+    mutable std::mutex mMutex;
+    std::list<std::unique_ptr<C2Work>> mFreeWorks;
+    size_t mAllocatedWorks;
+    size_t mReusedWorks;
+
+    std::vector<BaseBlock> mBaseBlocks;
+    std::vector<std::pair<const void*, uint32_t>> mBaseBlockIndices;
+
+    friend Status objcpy(
+            WorkBundle* d,
+            const std::list<std::unique_ptr<C2Work>>& s,
+            BufferPoolSender* bpSender,
+            WorkArena* arena);
+    friend c2_status_t objcpy(
+            std::list<std::unique_ptr<C2Work>>* d,
+            const WorkBundle& s,
+            WorkArena* arena,
+            BaseBlockCache* baseBlockCache);
+};
+
+// Cache of the linear blocks imported from the NATIVE BaseBlocks received on
+// one connection, i.e., by one component or one client-side component.
+//
+// Receiving a NATIVE BaseBlock clones its native handle and imports it into a
+// new C2LinearAllocation, even when the sender cycles through the same few
+// buffers. The HIDL interface cannot refer to a buffer sent in an earlier
+// transaction, so the file descriptors are still transferred every time; the
+// cache only saves the clone and the import on the receiving side.
+//
+// A buffer is identified by the device and inode numbers of its file
+// descriptors together with the integers of its handle. While the cache holds
+// a buffer, no other buffer can have the same identity. This requires a kernel
+// that gives each dma-buf its own inode, i.e., Linux 5.3 or later. Older
+// kernels put all dma-bufs on the anonymous inode filesystem, where they share
+// one inode. The cache checks this on the first buffer received and does
+// nothing on such kernels: every buffer is imported as without the cache.
+//
+// A buffer is only cached when it is received a second time, and a cached
+// buffer is dropped when it has not been received in the last kMaxAge lookups.
+// A buffer that the sender no longer uses is therefore held for a bounded
+// number of frames. clear() should be called when the connection is flushed,
+// stopped or reset.
+struct BaseBlockCache {
+    BaseBlockCache();
+
+    // Returns the linear block imported from handle, from the cache if
+    // possible. Returns null if handle is not a linear block handle or cannot
+    // be imported. handle is not modified and can be closed afterwards.
+    std::shared_ptr<C2LinearBlock> importLinearBlock(
+            const native_handle_t* handle);
+
+    // Drops all cached blocks.
+    void clear();
+
+    // The numbers of importLinearBlock() calls that were served from the cache
+    // and that imported the handle.
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    // The maximum number of buffers to track, whether cached or not.
+    static constexpr size_t kMaxEntries = 32;
+
+    // The number of lookups after which an unused buffer is dropped.
+    static constexpr uint64_t kMaxAge = 64;
+
+    struct Entry {
+        std::vector<uint64_t> key;
+        uint64_t lastSeen;
+        // Null if the buffer has been received only once.
+        std::shared_ptr<C2LinearBlock> block;
+    };
+
+    // Mutex for all members below.
+    mutable std::mutex mMutex;
+    std::vector<Entry> mEntries;
+    uint64_t mLookups;
+    size_t mHits;
+    size_t mMisses;
+};
+
+// std::list<std::unique_ptr<C2Work>> -> WorkBundle, reusing the storage of d
+// and arena.
+// Note: If bufferpool will be used, bpSender must not be null.
+Status objcpy(
+        WorkBundle* d,
+        const std::list<std::unique_ptr<C2Work>>& s,
+        BufferPoolSender* bpSender,
+        WorkArena* arena);
+
+// WorkBundle -> std::list<std::unique_ptr<C2Work>>, reusing the C2Work objects
+// recycled into arena. arena may be null.
+c2_status_t objcpy(
+        std::list<std::unique_ptr<C2Work>>* d,
+        const WorkBundle& s,
+        WorkArena* arena);
+
+// WorkBundle -> std::list<std::unique_ptr<C2Work>>, reusing the C2Work objects
+// recycled into arena and the linear blocks cached in baseBlockCache. Either
+// may be null.
+c2_status_t objcpy(
+        std::list<std::unique_ptr<C2Work>>* d,
+        const WorkBundle& s,
+        WorkArena* arena,
+        BaseBlockCache* baseBlockCache);
+
 /**
  * Parses a params blob and returns C2Param pointers to its params.
  * \param[out] params target vector of C2Param pointers
@@ -250,6 +394,86 @@ Status createParamsBlob(
         hidl_vec<uint8_t> *blob,
         const std::vector<std::unique_ptr<C2Tuning>> &params);
 
+/**
+ * Read-only view of the params in a params blob.
+ *
+ * The blob is validated when the view is created, and params are read in place when the view is
+ * iterated, so neither the params nor pointers to them are copied. The blob must outlive the view
+ * and the params obtained from it.
+ */
+class ParamsBlobView {
+public:
+    class const_iterator {
+    public:
+        const C2Param *operator*() const {
+            return reinterpret_cast<const C2Param*>(mData + mOffset);
+        }
+        const_iterator &operator++();
+        bool operator==(const const_iterator &other) const { return mOffset == other.mOffset; }
+        bool operator!=(const const_iterator &other) const { return mOffset != other.mOffset; }
+
+    private:
+        friend class ParamsBlobView;
+        const_iterator(const uint8_t *data, size_t offset) : mData(data), mOffset(offset) { }
+
+        const uint8_t *mData;
+        size_t mOffset;
+    };
+
+    explicit ParamsBlobView(const hidl_vec<uint8_t> &blob);
+
+    const_iterator begin() const { return const_iterator(mData, 0); }
+    /// iteration stops at the first invalid param of the blob
+    const_iterator end() const { return const_iterator(mData, mEnd); }
+
+    /// returns the number of valid params in the blob
+    size_t size() const { return mCount; }
+
+    /**
+     * \retval C2_OK if the full blob consists of valid params
+     * \retval C2_BAD_VALUE otherwise
+     */
+    c2_status_t status() const { return mEnd == mSize ? C2_OK : C2_BAD_VALUE; }
+
+private:
+    const uint8_t *mData;
+    size_t mSize;
+    size_t mEnd;
+    size_t mCount;
+};
+
+/**
+ * Reusable builder of params blobs.
+ *
+ * The builder keeps its storage between builds, so reusing a builder for similar sets of params
+ * does not reallocate. The built blob refers to the storage of the builder, and is valid until the
+ * next build or the destruction of the builder.
+ */
+class ParamsBlobBuilder {
+public:
+    /**
+     * Concatenates a list of C2Params into the blob of this builder.
+     * \param[in] params parameters to concatenate
+     * \retval OK if the blob was successfully created
+     * \retval CORRUPTED if the blob was not successful (this only happens if the parameters were
+     *         not const)
+     */
+    Status build(const std::vector<C2Param*> &params);
+    Status build(const std::vector<std::unique_ptr<C2Param>> &params);
+    Status build(const std::vector<std::shared_ptr<const C2Info>> &params);
+    Status build(const std::vector<std::unique_ptr<C2Tuning>> &params);
+
+    /// returns the last built blob
+    const hidl_vec<uint8_t> &blob() const { return mBlob; }
+
+private:
+    template<typename T>
+    Status _build(const T &params);
+
+    std::vector<uint8_t> mStorage;
+    hidl_vec<uint8_t> mBlob; ///< refers to mStorage
+};
+
 /**
  * Parses a params blob and create a vector of C2Params whose members are copies
  * of the params in the blob.
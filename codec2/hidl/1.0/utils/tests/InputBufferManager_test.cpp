@@ -0,0 +1,219 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "InputBufferManager_test"
+
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <C2PlatformSupport.h>
+#include <codec2/hidl/1.0/InputBufferManager.h>
+
+namespace hardware {
+namespace google {
+namespace media {
+namespace c2 {
+namespace V1_0 {
+namespace utils {
+
+using ::android::hardware::hidl_vec;
+using ::android::hardware::Return;
+using ::android::hardware::Void;
+
+namespace {
+
+// Records the (frameIndex, bufferIndex) pairs it is notified about.
+struct FakeListener : public IComponentListener {
+    virtual Return<void> onWorkDone(const WorkBundle&) override {
+        return Void();
+    }
+
+    virtual Return<void> onTripped(const hidl_vec<SettingResult>&) override {
+        return Void();
+    }
+
+    virtual Return<void> onError(Status, uint32_t) override {
+        return Void();
+    }
+
+    virtual Return<void> onFramesRendered(
+            const hidl_vec<RenderedFrame>& renderedFrames) override {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ++mCallbacks;
+        for (const RenderedFrame& frame : renderedFrames) {
+            mFrames.emplace(frame.bufferQueueId, ~frame.slotId);
+        }
+        mCondition.notify_all();
+        return Void();
+    }
+
+    // Waits until count buffers have been notified, or timeout passes.
+    bool waitForFrames(size_t count, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mCondition.wait_for(lock, timeout, [this, count] {
+            return mFrames.size() >= count;
+        });
+    }
+
+    size_t callbacks() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mCallbacks;
+    }
+
+    std::set<std::pair<uint64_t, size_t>> frames() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mFrames;
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    size_t mCallbacks = 0;
+    std::set<std::pair<uint64_t, size_t>> mFrames;
+};
+
+class InputBufferManagerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::shared_ptr<C2BlockPool> pool;
+        ASSERT_EQ(C2_OK, GetCodec2BlockPool(C2BlockPool::BASIC_LINEAR, nullptr, &pool));
+        std::shared_ptr<C2LinearBlock> block;
+        ASSERT_EQ(C2_OK, pool->fetchLinearBlock(
+                kCapacity,
+                { C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE },
+                &block));
+        mBlock = std::make_unique<C2ConstLinearBlock>(block->share(0, kCapacity, C2Fence()));
+    }
+
+    // Returns input frame data that holds the only references to numBuffers
+    // new buffers.
+    C2FrameData makeInput(uint64_t frameIndex, size_t numBuffers) {
+        C2FrameData input;
+        input.ordinal.frameIndex = frameIndex;
+        for (size_t i = 0; i < numBuffers; ++i) {
+            input.buffers.push_back(C2Buffer::CreateLinearBuffer(*mBlock));
+        }
+        return input;
+    }
+
+    static constexpr size_t kCapacity = 4096;
+    static constexpr std::chrono::milliseconds kTimeout{1000};
+
+    std::unique_ptr<C2ConstLinearBlock> mBlock;
+};
+
+constexpr std::chrono::milliseconds InputBufferManagerTest::kTimeout;
+
+}  // namespace
+
+TEST_F(InputBufferManagerTest, NotifiesDestroyedBuffers) {
+    sp<FakeListener> listener = new FakeListener;
+    {
+        C2FrameData input = makeInput(5, 2);
+        InputBufferManager::registerFrameData(listener, input);
+    }
+    ASSERT_TRUE(listener->waitForFrames(2, kTimeout));
+    std::set<std::pair<uint64_t, size_t>> expected = { {5, 0}, {5, 1} };
+    EXPECT_EQ(expected, listener->frames());
+    InputBufferManager::unregisterFrameData(listener);
+}
+
+TEST_F(InputBufferManagerTest, IgnoresUnregisteredBuffers) {
+    sp<FakeListener> listener = new FakeListener;
+    {
+        C2FrameData done = makeInput(1, 1);
+        C2FrameData flushed = makeInput(2, 1);
+        C2FrameData released = makeInput(3, 1);
+        InputBufferManager::registerFrameData(listener, done);
+        InputBufferManager::registerFrameData(listener, flushed);
+        InputBufferManager::registerFrameData(listener, released);
+        InputBufferManager::unregisterFrameData(listener, done);
+        InputBufferManager::unregisterFrameData(listener, flushed);
+    }
+    ASSERT_TRUE(listener->waitForFrames(1, kTimeout));
+    InputBufferManager::unregisterFrameData(listener);
+    {
+        C2FrameData input = makeInput(4, 1);
+        InputBufferManager::registerFrameData(listener, input);
+        InputBufferManager::unregisterFrameData(listener);
+    }
+    std::this_thread::sleep_for(std::chrono::nanoseconds(
+            InputBufferManager::kMaxNotificationPeriodNs * 2));
+    std::set<std::pair<uint64_t, size_t>> expected = { {3, 0} };
+    EXPECT_EQ(expected, listener->frames());
+}
+
+// Simulates many components in one process, each of which drops its input
+// buffers from its own thread.
+TEST_F(InputBufferManagerTest, MultiComponentStress) {
+    constexpr size_t kComponents = 32;
+    constexpr size_t kFrames = 2000;
+    constexpr size_t kBuffersPerFrame = 2;
+
+    std::vector<sp<FakeListener>> listeners;
+    for (size_t i = 0; i < kComponents; ++i) {
+        listeners.push_back(new FakeListener);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kComponents; ++i) {
+        threads.emplace_back([this, &listeners, i] {
+            const sp<FakeListener> &listener = listeners[i];
+            for (uint64_t frameIndex = 0; frameIndex < kFrames; ++frameIndex) {
+                // The component consumes the input buffers right away.
+                C2FrameData input = makeInput(frameIndex, kBuffersPerFrame);
+                InputBufferManager::registerFrameData(listener, input);
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double, std::milli> queued =
+            std::chrono::steady_clock::now() - start;
+
+    size_t callbacks = 0;
+    for (const sp<FakeListener> &listener : listeners) {
+        ASSERT_TRUE(listener->waitForFrames(kFrames * kBuffersPerFrame, kTimeout));
+        callbacks += listener->callbacks();
+        InputBufferManager::unregisterFrameData(listener);
+    }
+    std::chrono::duration<double, std::milli> notified =
+            std::chrono::steady_clock::now() - start;
+    std::cout << kComponents << " components x " << kFrames << " frames: "
+              << "queued in " << queued.count() << " ms, "
+              << "notified in " << notified.count() << " ms with "
+              << callbacks << " callbacks" << std::endl;
+    EXPECT_LT(callbacks, kComponents * kFrames * kBuffersPerFrame);
+}
+
+}  // namespace utils
+}  // namespace V1_0
+}  // namespace c2
+}  // namespace media
+}  // namespace google
+}  // namespace hardware
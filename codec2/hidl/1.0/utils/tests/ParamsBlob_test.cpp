@@ -0,0 +1,214 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ParamsBlob_test"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <C2Config.h>
+#include <codec2/hidl/1.0/types.h>
+
+namespace hardware {
+namespace google {
+namespace media {
+namespace c2 {
+namespace V1_0 {
+namespace utils {
+
+namespace {
+
+template<typename T>
+std::unique_ptr<T> AllocUniqueString(const char *str) {
+    size_t len = strlen(str) + 1;
+    std::unique_ptr<T> param = T::AllocUnique(len);
+    memcpy(param->m.value, str, len);
+    return param;
+}
+
+/**
+ * Returns a set of params similar to what CCodecConfig configures for a video encoder.
+ */
+std::vector<std::unique_ptr<C2Param>> VideoEncoderParams() {
+    std::vector<std::unique_ptr<C2Param>> params;
+    params.push_back(AllocUniqueString<C2PortMediaTypeSetting::output>("video/avc"));
+    params.push_back(std::make_unique<C2StreamPictureSizeInfo::input>(0u, 1920, 1080));
+    params.push_back(std::make_unique<C2StreamFrameRateInfo::output>(0u, 30.));
+    params.push_back(std::make_unique<C2StreamBitrateInfo::output>(0u, 8000000));
+    params.push_back(std::make_unique<C2StreamBitrateModeTuning::output>(
+            0u, C2Config::BITRATE_VARIABLE));
+    params.push_back(std::make_unique<C2StreamProfileLevelInfo::output>(
+            0u, PROFILE_AVC_HIGH, LEVEL_AVC_4_1));
+    params.push_back(std::make_unique<C2StreamSyncFrameIntervalTuning::output>(0u, 1000000));
+    params.push_back(std::make_unique<C2StreamIntraRefreshTuning::output>(
+            0u, C2Config::INTRA_REFRESH_DISABLED, 0.));
+    params.push_back(std::make_unique<C2StreamColorAspectsInfo::input>(
+            0u, C2Color::RANGE_LIMITED, C2Color::PRIMARIES_BT709,
+            C2Color::TRANSFER_170M, C2Color::MATRIX_BT709));
+    params.push_back(std::make_unique<C2StreamPixelFormatInfo::input>(0u, 0x7f420888));
+    params.push_back(std::make_unique<C2StreamMaxBufferSizeInfo::output>(0u, 1 << 20));
+    params.push_back(std::make_unique<C2PortActualDelayTuning::output>(0u));
+    return params;
+}
+
+std::vector<C2Param*> Pointers(const std::vector<std::unique_ptr<C2Param>> &params) {
+    std::vector<C2Param*> pointers;
+    for (const std::unique_ptr<C2Param> &param : params) {
+        pointers.push_back(param.get());
+    }
+    return pointers;
+}
+
+}  // namespace
+
+TEST(ParamsBlobTest, ViewReadsParamsInPlace) {
+    std::vector<std::unique_ptr<C2Param>> params = VideoEncoderParams();
+    hidl_vec<uint8_t> blob;
+    ASSERT_EQ(Status::OK, createParamsBlob(&blob, params));
+
+    ParamsBlobView view(blob);
+    ASSERT_EQ(C2_OK, view.status());
+    ASSERT_EQ(params.size(), view.size());
+    size_t i = 0;
+    for (const C2Param *param : view) {
+        EXPECT_GE((const uint8_t *)param, blob.data());
+        EXPECT_LT((const uint8_t *)param, blob.data() + blob.size());
+        EXPECT_EQ(*params[i++], *param);
+    }
+    EXPECT_EQ(params.size(), i);
+}
+
+TEST(ParamsBlobTest, ViewRejectsTruncatedBlob) {
+    std::vector<std::unique_ptr<C2Param>> params = VideoEncoderParams();
+    hidl_vec<uint8_t> blob;
+    ASSERT_EQ(Status::OK, createParamsBlob(&blob, params));
+
+    hidl_vec<uint8_t> truncated;
+    // cut into the last param, not only into its padding
+    truncated.setToExternal(blob.data(), blob.size() - 8);
+    ParamsBlobView view(truncated);
+    EXPECT_EQ(C2_BAD_VALUE, view.status());
+    EXPECT_EQ(params.size() - 1, view.size());
+
+    // an empty param must not stall parsing
+    std::vector<uint8_t> zeros(64, 0);
+    hidl_vec<uint8_t> empty;
+    empty.setToExternal(zeros.data(), zeros.size());
+    EXPECT_EQ(C2_BAD_VALUE, ParamsBlobView(empty).status());
+    EXPECT_EQ(0u, ParamsBlobView(empty).size());
+}
+
+TEST(ParamsBlobTest, BuilderMatchesCreateParamsBlob) {
+    std::vector<std::unique_ptr<C2Param>> params = VideoEncoderParams();
+    hidl_vec<uint8_t> blob;
+    ASSERT_EQ(Status::OK, createParamsBlob(&blob, params));
+
+    ParamsBlobBuilder builder;
+    // build a larger set first, so that the smaller blob reuses dirty storage
+    std::vector<std::unique_ptr<C2Param>> larger = VideoEncoderParams();
+    larger.push_back(AllocUniqueString<C2PortMediaTypeSetting::input>("video/raw"));
+    ASSERT_EQ(Status::OK, builder.build(larger));
+    const uint8_t *storage = builder.blob().data();
+    ASSERT_EQ(Status::OK, builder.build(params));
+    EXPECT_EQ(storage, builder.blob().data());
+    ASSERT_EQ(blob.size(), builder.blob().size());
+    EXPECT_EQ(0, memcmp(blob.data(), builder.blob().data(), blob.size()));
+}
+
+TEST(ParamsBlobTest, UpdateParamsFromBlob) {
+    std::vector<std::unique_ptr<C2Param>> params = VideoEncoderParams();
+    hidl_vec<uint8_t> blob;
+    ASSERT_EQ(Status::OK, createParamsBlob(&blob, params));
+
+    // the target lists the params in a different order
+    std::vector<std::unique_ptr<C2Param>> target = VideoEncoderParams();
+    std::reverse(target.begin(), target.end());
+    C2StreamBitrateInfo::output *bitrate = nullptr;
+    for (const std::unique_ptr<C2Param> &param : target) {
+        if (C2StreamBitrateInfo::output::From(param.get())) {
+            bitrate = C2StreamBitrateInfo::output::From(param.get());
+        }
+    }
+    ASSERT_NE(nullptr, bitrate);
+    bitrate->value = 1;
+    ASSERT_EQ(C2_OK, updateParamsFromBlob(Pointers(target), blob));
+    EXPECT_EQ(8000000u, bitrate->value);
+}
+
+TEST(ParamsBlobTest, RoundTripThroughput) {
+    constexpr int kIterations = 20000;
+    std::vector<std::unique_ptr<C2Param>> params = VideoEncoderParams();
+    std::vector<C2Param*> pointers = Pointers(params);
+
+    // config: client blob -> service parse -> service result blob -> client update
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        hidl_vec<uint8_t> in;
+        ASSERT_EQ(Status::OK, createParamsBlob(&in, pointers));
+        hidl_vec<uint8_t> inCopy = in;
+        std::vector<C2Param*> parsed;
+        ASSERT_EQ(C2_OK, parseParamsBlob(&parsed, inCopy));
+        hidl_vec<uint8_t> out;
+        ASSERT_EQ(Status::OK, createParamsBlob(&out, parsed));
+        ASSERT_EQ(C2_OK, updateParamsFromBlob(pointers, out));
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "config round trip (new blobs): "
+              << elapsed.count() / kIterations << " us" << std::endl;
+
+    ParamsBlobBuilder inBuilder;
+    ParamsBlobBuilder outBuilder;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        ASSERT_EQ(Status::OK, inBuilder.build(pointers));
+        hidl_vec<uint8_t> inCopy = inBuilder.blob();
+        std::vector<C2Param*> parsed;
+        ASSERT_EQ(C2_OK, parseParamsBlob(&parsed, inCopy));
+        ASSERT_EQ(Status::OK, outBuilder.build(parsed));
+        ASSERT_EQ(C2_OK, updateParamsFromBlob(pointers, outBuilder.blob()));
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "config round trip (reused builders): "
+              << elapsed.count() / kIterations << " us" << std::endl;
+
+    // query: service result blob -> client copies of heap params
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        ASSERT_EQ(Status::OK, outBuilder.build(params));
+        std::vector<std::unique_ptr<C2Param>> heapParams;
+        heapParams.reserve(params.size());
+        for (const C2Param *param : ParamsBlobView(outBuilder.blob())) {
+            heapParams.emplace_back(C2Param::Copy(*param));
+        }
+        ASSERT_EQ(params.size(), heapParams.size());
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "query round trip: " << elapsed.count() / kIterations << " us" << std::endl;
+}
+
+}  // namespace utils
+}  // namespace V1_0
+}  // namespace c2
+}  // namespace media
+}  // namespace google
+}  // namespace hardware
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "WorkBundle_test"
+
+#include <linux/magic.h>
+#include <sys/vfs.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <new>
+
+#include <gtest/gtest.h>
+
+#include <C2Config.h>
+#include <C2PlatformSupport.h>
+#include <codec2/hidl/1.0/types.h>
+
+namespace {
+
+// Counts the calls to operator new made by the current thread while counting
+// is enabled. Allocations made with malloc() directly (e.g. native handles) are
+// not counted.
+std::atomic<size_t> gAllocations(0);
+thread_local bool gCountAllocations = false;
+
+struct AllocationCounter {
+    AllocationCounter() {
+        gAllocations = 0;
+        gCountAllocations = true;
+    }
+    ~AllocationCounter() {
+        gCountAllocations = false;
+    }
+    size_t count() const {
+        return gAllocations;
+    }
+};
+
+}  // namespace
+
+void* operator new(size_t size) {
+    if (gCountAllocations) {
+        ++gAllocations;
+    }
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        abort();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+namespace hardware {
+namespace google {
+namespace media {
+namespace c2 {
+namespace V1_0 {
+namespace utils {
+
+namespace {
+
+class WorkBundleTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::shared_ptr<C2BlockPool> pool;
+        ASSERT_EQ(C2_OK, GetCodec2BlockPool(C2BlockPool::BASIC_LINEAR, nullptr, &pool));
+        std::shared_ptr<C2LinearBlock> block;
+        ASSERT_EQ(C2_OK, pool->fetchLinearBlock(
+                kCapacity,
+                { C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE },
+                &block));
+        mBlock = std::make_unique<C2ConstLinearBlock>(block->share(0, kCapacity, C2Fence()));
+    }
+
+    // Returns a work item like the ones a decoder returns: one input buffer,
+    // one output buffer and a config update.
+    std::list<std::unique_ptr<C2Work>> makeWorks(uint64_t frameIndex) {
+        std::list<std::unique_ptr<C2Work>> works;
+        works.emplace_back(std::make_unique<C2Work>());
+        C2Work &work = *works.back();
+        work.input.flags = C2FrameData::FLAG_CODEC_CONFIG;
+        work.input.ordinal.frameIndex = frameIndex;
+        work.input.buffers.push_back(C2Buffer::CreateLinearBuffer(*mBlock));
+        work.worklets.emplace_back(std::make_unique<C2Worklet>());
+        C2FrameData &output = work.worklets.front()->output;
+        output.ordinal.frameIndex = frameIndex;
+        output.buffers.push_back(C2Buffer::CreateLinearBuffer(*mBlock));
+        output.configUpdate.push_back(
+                std::make_unique<C2StreamBitrateInfo::output>(0u, 64000));
+        work.workletsProcessed = 1;
+        work.result = C2_OK;
+        return works;
+    }
+
+    static constexpr size_t kCapacity = 4096;
+    static constexpr int kFrames = 1000;
+
+    std::unique_ptr<C2ConstLinearBlock> mBlock;
+};
+
+constexpr size_t WorkBundleTest::kCapacity;
+
+}  // namespace
+
+TEST_F(WorkBundleTest, ArenaRoundTripMatches) {
+    WorkArena arena;
+    WorkBundle bundle;
+    for (uint64_t frameIndex = 0; frameIndex < 3; ++frameIndex) {
+        std::list<std::unique_ptr<C2Work>> works = makeWorks(frameIndex);
+        ASSERT_EQ(Status::OK, objcpy(&bundle, works, nullptr, &arena));
+        WorkBundle reference;
+        ASSERT_EQ(Status::OK, objcpy(&reference, works, nullptr));
+        ASSERT_EQ(reference.works.size(), bundle.works.size());
+        EXPECT_EQ(reference.baseBlocks.size(), bundle.baseBlocks.size());
+        EXPECT_EQ(reference.works[0].worklet.output.configUpdate,
+                  bundle.works[0].worklet.output.configUpdate);
+        EXPECT_EQ(reference.works[0].input.buffers[0].blocks[0].meta,
+                  bundle.works[0].input.buffers[0].blocks[0].meta);
+
+        std::list<std::unique_ptr<C2Work>> received;
+        ASSERT_EQ(C2_OK, objcpy(&received, bundle, &arena));
+        ASSERT_EQ(1u, received.size());
+        const C2Work &work = *received.front();
+        EXPECT_EQ(frameIndex, work.input.ordinal.frameIndex.peeku());
+        ASSERT_EQ(1u, work.input.buffers.size());
+        EXPECT_EQ(kCapacity, work.input.buffers[0]->data().linearBlocks()[0].size());
+        ASSERT_EQ(1u, work.worklets.size());
+        EXPECT_EQ(1u, work.workletsProcessed);
+        const C2FrameData &output = work.worklets.front()->output;
+        EXPECT_EQ(frameIndex, output.ordinal.frameIndex.peeku());
+        ASSERT_EQ(1u, output.configUpdate.size());
+        EXPECT_EQ(*works.front()->worklets.front()->output.configUpdate[0],
+                  *output.configUpdate[0]);
+        arena.recycle(&received);
+        EXPECT_TRUE(received.empty());
+    }
+    EXPECT_EQ(1u, arena.allocatedWorks());
+    EXPECT_EQ(2u, arena.reusedWorks());
+}
+
+TEST_F(WorkBundleTest, AllocationsPerFrame) {
+    std::list<std::unique_ptr<C2Work>> works = makeWorks(0);
+
+    size_t marshalNew;
+    {
+        AllocationCounter counter;
+        for (int i = 0; i < kFrames; ++i) {
+            WorkBundle bundle;
+            ASSERT_EQ(Status::OK, objcpy(&bundle, works, nullptr));
+        }
+        marshalNew = counter.count();
+    }
+
+    WorkArena arena;
+    WorkBundle bundle;
+    ASSERT_EQ(Status::OK, objcpy(&bundle, works, nullptr, &arena));
+    size_t marshalArena;
+    {
+        AllocationCounter counter;
+        for (int i = 0; i < kFrames; ++i) {
+            ASSERT_EQ(Status::OK, objcpy(&bundle, works, nullptr, &arena));
+        }
+        marshalArena = counter.count();
+    }
+
+    size_t unmarshalNew;
+    {
+        AllocationCounter counter;
+        for (int i = 0; i < kFrames; ++i) {
+            std::list<std::unique_ptr<C2Work>> received;
+            ASSERT_EQ(C2_OK, objcpy(&received, bundle));
+        }
+        unmarshalNew = counter.count();
+    }
+
+    size_t unmarshalArena;
+    {
+        AllocationCounter counter;
+        for (int i = 0; i < kFrames; ++i) {
+            std::list<std::unique_ptr<C2Work>> received;
+            ASSERT_EQ(C2_OK, objcpy(&received, bundle, &arena));
+            arena.recycle(&received);
+        }
+        unmarshalArena = counter.count();
+    }
+
+    std::cout << "allocations per frame: "
+              << "marshal " << double(marshalNew) / kFrames
+              << " -> " << double(marshalArena) / kFrames << ", "
+              << "unmarshal " << double(unmarshalNew) / kFrames
+              << " -> " << double(unmarshalArena) / kFrames << std::endl;
+    EXPECT_LT(marshalArena, marshalNew);
+    EXPECT_LT(unmarshalArena, unmarshalNew);
+}
+
+TEST_F(WorkBundleTest, CachesRecurringLinearBlocks) {
+    std::list<std::unique_ptr<C2Work>> works = makeWorks(0);
+    WorkBundle bundle;
+    ASSERT_EQ(Status::OK, objcpy(&bundle, works, nullptr));
+    ASSERT_EQ(1u, bundle.baseBlocks.size());
+    ASSERT_EQ(BaseBlock::Type::NATIVE, bundle.baseBlocks[0].type);
+
+    BaseBlockCache cache;
+    for (int i = 0; i < 3; ++i) {
+        std::list<std::unique_ptr<C2Work>> received;
+        ASSERT_EQ(C2_OK, objcpy(&received, bundle, nullptr, &cache));
+        ASSERT_EQ(1u, received.size());
+        ASSERT_EQ(1u, received.front()->input.buffers.size());
+        EXPECT_EQ(kCapacity, received.front()->input.buffers[0]->
+                data().linearBlocks()[0].size());
+    }
+    // The first two receptions import the buffer; the buffer is cached on the
+    // second one, unless its inode numbers are not unique.
+    EXPECT_EQ(3u, cache.hits() + cache.misses());
+    struct statfs fs;
+    const native_handle_t* handle = bundle.baseBlocks[0].nativeBlock;
+    ASSERT_EQ(0, fstatfs(handle->data[0], &fs));
+    if (fs.f_type != ANON_INODE_FS_MAGIC) {
+        EXPECT_EQ(1u, cache.hits());
+    }
+
+    cache.clear();
+    std::list<std::unique_ptr<C2Work>> received;
+    ASSERT_EQ(C2_OK, objcpy(&received, bundle, nullptr, &cache));
+    EXPECT_EQ(4u, cache.misses() + cache.hits());
+    EXPECT_EQ(fs.f_type != ANON_INODE_FS_MAGIC ? 1u : 0u, cache.hits());
+}
+
+}  // namespace utils
+}  // namespace V1_0
+}  // namespace c2
+}  // namespace media
+}  // namespace google
+}  // namespace hardware
@@ -32,9 +32,12 @@
 #include <C2Work.h>
 #include <util/C2ParamUtils.h>
 
+#include <linux/magic.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+
 #include <algorithm>
 #include <functional>
-#include <unordered_map>
 
 #include <media/stagefright/foundation/AUtils.h>
 
@@ -561,24 +564,55 @@ c2_status_t objcpy(std::unique_ptr<C2StructDescriptor> *d, const StructDescripto
 
 namespace /* unnamed */ {
 
+template<typename T>
+Status _createParamsBlob(hidl_vec<uint8_t> *blob, const T &params);
+
+// Resizes a hidl_vec unless it already has the requested size. Unlike
+// std::vector, hidl_vec reallocates on every resize(), so this is what lets
+// marshalling into a reused object keep its storage. Elements that are kept
+// must be fully overwritten by the caller.
+template<typename T>
+void resizeIfNeeded(hidl_vec<T>* v, size_t size) {
+    if (v->size() != size) {
+        v->resize(size);
+    }
+}
+
+// BaseBlock objects of a WorkBundle under construction, and the indices of the
+// raw pointers (to native_handle_t or BufferPoolData) that identify them.
+// There are only a few base blocks in a bundle, so the indices are searched
+// linearly.
+typedef std::vector<BaseBlock> BaseBlocks;
+typedef std::vector<std::pair<const void*, uint32_t>> BaseBlockIndices;
+
+bool findBaseBlock(
+        uint32_t* index,
+        const void* key,
+        const BaseBlockIndices& baseBlockIndices) {
+    for (const std::pair<const void*, uint32_t>& entry : baseBlockIndices) {
+        if (entry.first == key) {
+            *index = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
 // Find or add a hidl BaseBlock object from a given C2Handle* to a list and an
 // associated map.
 // Note: The handle is not cloned.
 Status _addBaseBlock(
         uint32_t* index,
         const C2Handle* handle,
-        std::list<BaseBlock>* baseBlocks,
-        std::map<const void*, uint32_t>* baseBlockIndices) {
+        BaseBlocks* baseBlocks,
+        BaseBlockIndices* baseBlockIndices) {
     if (!handle) {
         ALOGE("addBaseBlock called on a null C2Handle.");
         return Status::BAD_VALUE;
     }
-    auto it = baseBlockIndices->find(handle);
-    if (it != baseBlockIndices->end()) {
-        *index = it->second;
-    } else {
+    if (!findBaseBlock(index, handle, *baseBlockIndices)) {
         *index = baseBlocks->size();
-        baseBlockIndices->emplace(handle, *index);
+        baseBlockIndices->emplace_back(handle, *index);
         baseBlocks->emplace_back();
 
         BaseBlock &dBaseBlock = baseBlocks->back();
@@ -597,18 +631,15 @@ Status _addBaseBlock(
         uint32_t* index,
         const std::shared_ptr<BufferPoolData> bpData,
         BufferPoolSender* bufferPoolSender,
-        std::list<BaseBlock>* baseBlocks,
-        std::map<const void*, uint32_t>* baseBlockIndices) {
+        BaseBlocks* baseBlocks,
+        BaseBlockIndices* baseBlockIndices) {
     if (!bpData) {
         ALOGE("addBaseBlock called on a null BufferPoolData.");
         return Status::BAD_VALUE;
     }
-    auto it = baseBlockIndices->find(bpData.get());
-    if (it != baseBlockIndices->end()) {
-        *index = it->second;
-    } else {
+    if (!findBaseBlock(index, bpData.get(), *baseBlockIndices)) {
         *index = baseBlocks->size();
-        baseBlockIndices->emplace(bpData.get(), *index);
+        baseBlockIndices->emplace_back(bpData.get(), *index);
         baseBlocks->emplace_back();
 
         BaseBlock &dBaseBlock = baseBlocks->back();
@@ -634,8 +665,8 @@ Status addBaseBlock(
         const C2Handle* handle,
         const std::shared_ptr<const _C2BlockPoolData>& blockPoolData,
         BufferPoolSender* bufferPoolSender,
-        std::list<BaseBlock>* baseBlocks,
-        std::map<const void*, uint32_t>* baseBlockIndices) {
+        BaseBlocks* baseBlocks,
+        BaseBlockIndices* baseBlockIndices) {
     if (!blockPoolData) {
         // No BufferPoolData ==> NATIVE block.
         return _addBaseBlock(
@@ -689,8 +720,8 @@ Status objcpy(hidl_handle* d, const C2Fence& s) {
 // closed before the transaction is complete.
 Status objcpy(Block* d, const C2ConstLinearBlock& s,
         BufferPoolSender* bufferPoolSender,
-        std::list<BaseBlock>* baseBlocks,
-        std::map<const void*, uint32_t>* baseBlockIndices) {
+        BaseBlocks* baseBlocks,
+        BaseBlockIndices* baseBlockIndices) {
     std::shared_ptr<const _C2BlockPoolData> bpData =
             _C2BlockFactory::GetLinearBlockPoolData(s);
     Status status = addBaseBlock(&d->index, s.handle(), bpData,
@@ -703,8 +734,8 @@ Status objcpy(Block* d, const C2ConstLinearBlock& s,
     C2Hidl_RangeInfo dRangeInfo;
     dRangeInfo.offset = static_cast<uint32_t>(s.offset());
     dRangeInfo.length = static_cast<uint32_t>(s.size());
-    status = createParamsBlob(&d->meta,
-            std::vector<C2Param*>{ &dRangeInfo });
+    C2Param* const dMeta[] = { &dRangeInfo };
+    status = _createParamsBlob(&d->meta, dMeta);
     if (status != Status::OK) {
         return Status::BAD_VALUE;
     }
@@ -718,12 +749,15 @@ Status objcpy(Block* d, const C2ConstLinearBlock& s,
 // closed before the transaction is complete.
 Status objcpy(Block* d, const C2ConstGraphicBlock& s,
         BufferPoolSender* bufferPoolSender,
-        std::list<BaseBlock>* baseBlocks,
-        std::map<const void*, uint32_t>* baseBlockIndices) {
+        BaseBlocks* baseBlocks,
+        BaseBlockIndices* baseBlockIndices) {
     std::shared_ptr<const _C2BlockPoolData> bpData =
             _C2BlockFactory::GetGraphicBlockPoolData(s);
     Status status = addBaseBlock(&d->index, s.handle(), bpData,
             bufferPoolSender, baseBlocks, baseBlockIndices);
+    if (status != Status::OK) {
+        return status;
+    }
 
     // Create the metadata.
     C2Hidl_RectInfo dRectInfo;
@@ -732,8 +766,8 @@ Status objcpy(Block* d, const C2ConstGraphicBlock& s,
     dRectInfo.top = static_cast<uint32_t>(sRect.top);
     dRectInfo.width = static_cast<uint32_t>(sRect.width);
     dRectInfo.height = static_cast<uint32_t>(sRect.height);
-    status = createParamsBlob(&d->meta,
-            std::vector<C2Param*>{ &dRectInfo });
+    C2Param* const dMeta[] = { &dRectInfo };
+    status = _createParamsBlob(&d->meta, dMeta);
     if (status != Status::OK) {
         return Status::BAD_VALUE;
     }
@@ -746,10 +780,10 @@ Status objcpy(Block* d, const C2ConstGraphicBlock& s,
 // This function only fills in d->blocks.
 Status objcpy(Buffer* d, const C2BufferData& s,
         BufferPoolSender* bufferPoolSender,
-        std::list<BaseBlock>* baseBlocks,
-        std::map<const void*, uint32_t>* baseBlockIndices) {
+        BaseBlocks* baseBlocks,
+        BaseBlockIndices* baseBlockIndices) {
     Status status;
-    d->blocks.resize(
+    resizeIfNeeded(&d->blocks,
             s.linearBlocks().size() +
             s.graphicBlocks().size());
     size_t i = 0;
@@ -777,8 +811,8 @@ Status objcpy(Buffer* d, const C2BufferData& s,
 // C2Buffer -> Buffer
 Status objcpy(Buffer* d, const C2Buffer& s,
         BufferPoolSender* bufferPoolSender,
-        std::list<BaseBlock>* baseBlocks,
-        std::map<const void*, uint32_t>* baseBlockIndices) {
+        BaseBlocks* baseBlocks,
+        BaseBlockIndices* baseBlockIndices) {
     Status status = createParamsBlob(&d->info, s.info());
     if (status != Status::OK) {
         return status;
@@ -789,8 +823,8 @@ Status objcpy(Buffer* d, const C2Buffer& s,
 // C2InfoBuffer -> InfoBuffer
 Status objcpy(InfoBuffer* d, const C2InfoBuffer& s,
         BufferPoolSender* bufferPoolSender,
-        std::list<BaseBlock>* baseBlocks,
-        std::map<const void*, uint32_t>* baseBlockIndices) {
+        BaseBlocks* baseBlocks,
+        BaseBlockIndices* baseBlockIndices) {
     // TODO: C2InfoBuffer is not implemented.
     (void)d;
     (void)s;
@@ -809,21 +843,21 @@ Status objcpy(InfoBuffer* d, const C2InfoBuffer& s,
 // C2FrameData -> FrameData
 Status objcpy(FrameData* d, const C2FrameData& s,
         BufferPoolSender* bufferPoolSender,
-        std::list<BaseBlock>* baseBlocks,
-        std::map<const void*, uint32_t>* baseBlockIndices) {
+        BaseBlocks* baseBlocks,
+        BaseBlockIndices* baseBlockIndices) {
     d->flags = static_cast<hidl_bitfield<FrameData::Flags>>(s.flags);
     objcpy(&d->ordinal, s.ordinal);
 
     Status status;
-    d->buffers.resize(s.buffers.size());
+    resizeIfNeeded(&d->buffers, s.buffers.size());
     size_t i = 0;
     for (const std::shared_ptr<C2Buffer>& sBuffer : s.buffers) {
         Buffer& dBuffer = d->buffers[i++];
         if (!sBuffer) {
             // A null (pointer to) C2Buffer corresponds to a Buffer with empty
             // info and blocks.
-            dBuffer.info.resize(0);
-            dBuffer.blocks.resize(0);
+            resizeIfNeeded(&dBuffer.info, 0);
+            resizeIfNeeded(&dBuffer.blocks, 0);
             continue;
         }
         status = objcpy(
@@ -839,7 +873,7 @@ Status objcpy(FrameData* d, const C2FrameData& s,
         return status;
     }
 
-    d->infoBuffers.resize(s.infoBuffers.size());
+    resizeIfNeeded(&d->infoBuffers, s.infoBuffers.size());
     i = 0;
     for (const std::shared_ptr<C2InfoBuffer>& sInfoBuffer : s.infoBuffers) {
         InfoBuffer& dInfoBuffer = d->infoBuffers[i++];
@@ -949,28 +983,41 @@ Status objcpy(
         WorkBundle* d,
         const std::list<std::unique_ptr<C2Work>>& s,
         BufferPoolSender* bufferPoolSender) {
+    WorkArena arena;
+    return objcpy(d, s, bufferPoolSender, &arena);
+}
+
+// std::list<std::unique_ptr<C2Work>> -> WorkBundle
+Status objcpy(
+        WorkBundle* d,
+        const std::list<std::unique_ptr<C2Work>>& s,
+        BufferPoolSender* bufferPoolSender,
+        WorkArena* arena) {
     Status status = Status::OK;
 
     // baseBlocks holds a list of BaseBlock objects that Blocks can refer to.
-    std::list<BaseBlock> baseBlocks;
+    BaseBlocks& baseBlocks = arena->mBaseBlocks;
+    baseBlocks.clear();
 
     // baseBlockIndices maps a raw pointer to native_handle_t or BufferPoolData
     // inside baseBlocks to the corresponding index into baseBlocks. The keys
     // (pointers) are used to identify blocks that have the same "base block" in
-    // s, a list of C2Work objects. Because baseBlocks will be copied into a
+    // s, a list of C2Work objects. Because baseBlocks will be moved into a
     // hidl_vec eventually, the values of baseBlockIndices are zero-based
-    // integer indices instead of list iterators.
+    // integer indices.
     //
     // Note that the pointers can be raw because baseBlockIndices has a shorter
     // lifespan than all of base blocks.
-    std::map<const void*, uint32_t> baseBlockIndices;
+    BaseBlockIndices& baseBlockIndices = arena->mBaseBlockIndices;
+    baseBlockIndices.clear();
 
-    d->works.resize(s.size());
+    resizeIfNeeded(&d->works, s.size());
     size_t i = 0;
     for (const std::unique_ptr<C2Work>& sWork : s) {
         Work &dWork = d->works[i++];
         if (!sWork) {
             ALOGW("Null C2Work encountered.");
+            dWork = Work();
             continue;
         }
         status = objcpy(&dWork.input, sWork->input,
@@ -980,6 +1027,7 @@ Status objcpy(
         }
         if (sWork->worklets.size() == 0) {
             ALOGW("Work with no worklets.");
+            dWork.worklet = Worklet();
         } else {
             if (sWork->worklets.size() > 1) {
                 ALOGW("Work with multiple worklets. "
@@ -994,19 +1042,18 @@ Status objcpy(
             const C2Worklet &sWorklet = *sWork->worklets.front();
             Worklet &dWorklet = dWork.worklet;
 
-            dWorklet.tunings.resize(sWorklet.tunings.size());
+            resizeIfNeeded(&dWorklet.tunings, sWorklet.tunings.size());
             size_t j = 0;
             for (const std::unique_ptr<C2Tuning>& sTuning : sWorklet.tunings) {
-                status = createParamsBlob(
-                        &dWorklet.tunings[j++],
-                        std::vector<C2Param*>
-                        { reinterpret_cast<C2Param*>(sTuning.get()) });
+                C2Param* const dTuning[] = {
+                        reinterpret_cast<C2Param*>(sTuning.get()) };
+                status = _createParamsBlob(&dWorklet.tunings[j++], dTuning);
                 if (status != Status::OK) {
                     return status;
                 }
             }
 
-            dWorklet.failures.resize(sWorklet.failures.size());
+            resizeIfNeeded(&dWorklet.failures, sWorklet.failures.size());
             j = 0;
             for (const std::unique_ptr<C2SettingResult>& sFailure :
                     sWorklet.failures) {
@@ -1030,14 +1077,13 @@ Status objcpy(
         dWork.result = static_cast<Status>(sWork->result);
     }
 
-    // Copy std::list<BaseBlock> to hidl_vec<BaseBlock>.
-    {
-        d->baseBlocks.resize(baseBlocks.size());
-        size_t i = 0;
-        for (const BaseBlock& baseBlock : baseBlocks) {
-            d->baseBlocks[i++] = baseBlock;
-        }
+    // Move baseBlocks to hidl_vec<BaseBlock>. Moving does not clone the
+    // native handles.
+    resizeIfNeeded(&d->baseBlocks, baseBlocks.size());
+    for (size_t i = 0; i < baseBlocks.size(); ++i) {
+        d->baseBlocks[i] = std::move(baseBlocks[i]);
     }
+    baseBlocks.clear();
 
     return Status::OK;
 }
@@ -1241,9 +1287,18 @@ c2_status_t objcpy(C2FrameData* d, const FrameData& s,
 }
 
 // BaseBlock -> C2BaseBlock
-c2_status_t objcpy(C2BaseBlock* d, const BaseBlock& s) {
+// Note: baseBlockCache may be null.
+c2_status_t objcpy(C2BaseBlock* d, const BaseBlock& s,
+        BaseBlockCache* baseBlockCache) {
     switch (s.type) {
     case BaseBlock::Type::NATIVE: {
+            if (baseBlockCache) {
+                d->linear = baseBlockCache->importLinearBlock(s.nativeBlock);
+                if (d->linear) {
+                    d->type = C2BaseBlock::LINEAR;
+                    return C2_OK;
+                }
+            }
             native_handle_t* sHandle =
                     native_handle_clone(s.nativeBlock);
             if (sHandle == nullptr) {
@@ -1320,12 +1375,29 @@ c2_status_t objcpy(C2BaseBlock* d, const BaseBlock& s) {
 
 // WorkBundle -> std::list<std::unique_ptr<C2Work>>
 c2_status_t objcpy(std::list<std::unique_ptr<C2Work>>* d, const WorkBundle& s) {
+    return objcpy(d, s, nullptr, nullptr);
+}
+
+// WorkBundle -> std::list<std::unique_ptr<C2Work>>
+c2_status_t objcpy(
+        std::list<std::unique_ptr<C2Work>>* d,
+        const WorkBundle& s,
+        WorkArena* arena) {
+    return objcpy(d, s, arena, nullptr);
+}
+
+// WorkBundle -> std::list<std::unique_ptr<C2Work>>
+c2_status_t objcpy(
+        std::list<std::unique_ptr<C2Work>>* d,
+        const WorkBundle& s,
+        WorkArena* arena,
+        BaseBlockCache* baseBlockCache) {
     c2_status_t status;
 
     // Convert BaseBlocks to C2BaseBlocks.
     std::vector<C2BaseBlock> dBaseBlocks(s.baseBlocks.size());
     for (size_t i = 0; i < s.baseBlocks.size(); ++i) {
-        status = objcpy(&dBaseBlocks[i], s.baseBlocks[i]);
+        status = objcpy(&dBaseBlocks[i], s.baseBlocks[i], baseBlockCache);
         if (status != C2_OK) {
             return status;
         }
@@ -1333,7 +1405,11 @@ c2_status_t objcpy(std::list<std::unique_ptr<C2Work>>* d, const WorkBundle& s) {
 
     d->clear();
     for (const Work& sWork : s.works) {
-        d->emplace_back(std::make_unique<C2Work>());
+        if (arena) {
+            arena->takeWork(d);
+        } else {
+            d->emplace_back(std::make_unique<C2Work>());
+        }
         C2Work& dWork = *d->back();
 
         // input
@@ -1344,13 +1420,17 @@ c2_status_t objcpy(std::list<std::unique_ptr<C2Work>>* d, const WorkBundle& s) {
         }
 
         // worklet(s)
-        dWork.worklets.clear();
         // TODO: Currently, tunneling is not supported.
+        // A recycled C2Work comes with an emptied worklet.
+        if (dWork.worklets.size() != 1 || !dWork.worklets.front()) {
+            dWork.worklets.clear();
+            dWork.worklets.emplace_back(std::make_unique<C2Worklet>());
+        }
+        C2Worklet* dWorklet = dWork.worklets.front().get();
         if (sWork.workletProcessed) {
             dWork.workletsProcessed = 1;
 
             const Worklet &sWorklet = sWork.worklet;
-            std::unique_ptr<C2Worklet> dWorklet = std::make_unique<C2Worklet>();
 
             // tunings
             dWorklet->tunings.clear();
@@ -1393,9 +1473,7 @@ c2_status_t objcpy(std::list<std::unique_ptr<C2Work>>* d, const WorkBundle& s) {
                 ALOGE("Failed to create output C2FrameData.");
                 return C2_BAD_VALUE;
             }
-            dWork.worklets.emplace_back(std::move(dWorklet));
         } else {
-            dWork.worklets.emplace_back(std::make_unique<C2Worklet>());
             dWork.workletsProcessed = 0;
         }
 
@@ -1406,44 +1484,270 @@ c2_status_t objcpy(std::list<std::unique_ptr<C2Work>>* d, const WorkBundle& s) {
     return C2_OK;
 }
 
+namespace /* unnamed */ {
+
+// Releases everything a C2FrameData refers to, keeping the storage of its
+// vectors.
+void clearFrameData(C2FrameData* d) {
+    d->flags = static_cast<C2FrameData::flags_t>(0);
+    d->ordinal = C2WorkOrdinalStruct();
+    d->buffers.clear();
+    d->configUpdate.clear();
+    d->infoBuffers.clear();
+}
+
+} // unnamed namespace
+
+// WorkArena's implementation
+
+constexpr size_t WorkArena::kMaxFreeWorks;
+
+WorkArena::WorkArena()
+    : mAllocatedWorks(0),
+      mReusedWorks(0) {
+}
+
+void WorkArena::recycle(std::list<std::unique_ptr<C2Work>>* works) {
+    for (auto it = works->begin(); it != works->end(); ) {
+        C2Work* work = it->get();
+        if (!work) {
+            it = works->erase(it);
+            continue;
+        }
+        work->chainInfo.reset();
+        clearFrameData(&work->input);
+        if (work->worklets.size() > 1) {
+            work->worklets.resize(1);
+        }
+        if (!work->worklets.empty() && work->worklets.front()) {
+            C2Worklet& worklet = *work->worklets.front();
+            worklet.component = 0;
+            worklet.tunings.clear();
+            worklet.failures.clear();
+            clearFrameData(&worklet.output);
+        }
+        ++it;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    // Splice the list nodes too, so that they are reused by takeWork().
+    while (!works->empty() && mFreeWorks.size() < kMaxFreeWorks) {
+        mFreeWorks.splice(mFreeWorks.end(), *works, works->begin());
+    }
+    works->clear();
+}
+
+void WorkArena::takeWork(std::list<std::unique_ptr<C2Work>>* works) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mFreeWorks.empty()) {
+            works->splice(works->end(), mFreeWorks, mFreeWorks.begin());
+            ++mReusedWorks;
+            return;
+        }
+        ++mAllocatedWorks;
+    }
+    works->emplace_back(std::make_unique<C2Work>());
+}
+
+size_t WorkArena::allocatedWorks() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mAllocatedWorks;
+}
+
+size_t WorkArena::reusedWorks() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mReusedWorks;
+}
+
+// BaseBlockCache's implementation
+
+constexpr size_t BaseBlockCache::kMaxEntries;
+constexpr uint64_t BaseBlockCache::kMaxAge;
+
+namespace /* unnamed */ {
+
+// Computes the identity of the buffer referred to by handle. Returns false if
+// the identity cannot be computed.
+bool getBaseBlockKey(std::vector<uint64_t>* key, const native_handle_t* handle) {
+    key->clear();
+    for (int i = 0; i < handle->numFds; ++i) {
+        struct stat st;
+        if (fstat(handle->data[i], &st) != 0) {
+            return false;
+        }
+        key->push_back(static_cast<uint64_t>(st.st_dev));
+        key->push_back(static_cast<uint64_t>(st.st_ino));
+    }
+    for (int i = 0; i < handle->numInts; ++i) {
+        key->push_back(static_cast<uint32_t>(handle->data[handle->numFds + i]));
+    }
+    return true;
+}
+
+// Returns true if the kernel gives each dma-buf its own inode, so that inode
+// numbers identify buffers. Kernels before Linux 5.3 put all dma-bufs on the
+// anonymous inode filesystem, where they share one inode. This is a property
+// of the kernel, so it is only checked on the first buffer received.
+bool dmaBufsHaveUniqueInodes(int fd) {
+    static const bool unique = [fd] {
+        struct statfs fs;
+        bool result = fstatfs(fd, &fs) == 0 && fs.f_type != ANON_INODE_FS_MAGIC;
+        ALOGI_IF(!result, "dma-bufs share one inode; received buffers are not cached");
+        return result;
+    }();
+    return unique;
+}
+
+std::shared_ptr<C2LinearBlock> createLinearBlock(
+        const native_handle_t* handle) {
+    native_handle_t* clone = native_handle_clone(handle);
+    if (clone == nullptr) {
+        return nullptr;
+    }
+    std::shared_ptr<C2LinearBlock> block = _C2BlockFactory::CreateLinearBlock(
+            reinterpret_cast<const C2Handle*>(clone));
+    if (!block) {
+        native_handle_close(clone);
+        native_handle_delete(clone);
+    }
+    return block;
+}
+
+} // unnamed namespace
+
+BaseBlockCache::BaseBlockCache()
+    : mLookups(0),
+      mHits(0),
+      mMisses(0) {
+}
+
+std::shared_ptr<C2LinearBlock> BaseBlockCache::importLinearBlock(
+        const native_handle_t* handle) {
+    if (!handle || handle->numFds <= 0 || !C2AllocatorIon::isValid(
+            reinterpret_cast<const C2Handle*>(handle))) {
+        return nullptr;
+    }
+    if (!dmaBufsHaveUniqueInodes(handle->data[0])) {
+        // Buffers cannot be identified on this kernel.
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            ++mMisses;
+        }
+        return createLinearBlock(handle);
+    }
+    std::vector<uint64_t> key;
+    if (!getBaseBlockKey(&key, handle)) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    const uint64_t lookup = ++mLookups;
+    mEntries.erase(
+            std::remove_if(mEntries.begin(), mEntries.end(),
+                    [lookup](const Entry& entry) {
+                        return entry.lastSeen + kMaxAge < lookup;
+                    }),
+            mEntries.end());
+
+    for (Entry& entry : mEntries) {
+        if (entry.key == key) {
+            entry.lastSeen = lookup;
+            if (entry.block) {
+                ++mHits;
+                return entry.block;
+            }
+            // This is the second time the buffer is received.
+            ++mMisses;
+            entry.block = createLinearBlock(handle);
+            return entry.block;
+        }
+    }
+
+    ++mMisses;
+    if (mEntries.size() >= kMaxEntries) {
+        mEntries.erase(std::min_element(
+                mEntries.begin(), mEntries.end(),
+                [](const Entry& x, const Entry& y) {
+                    return x.lastSeen < y.lastSeen;
+                }));
+    }
+    mEntries.push_back(Entry{std::move(key), lookup, nullptr});
+    return createLinearBlock(handle);
+}
+
+void BaseBlockCache::clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEntries.clear();
+}
+
+size_t BaseBlockCache::hits() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mHits;
+}
+
+size_t BaseBlockCache::misses() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMisses;
+}
+
 constexpr size_t PARAMS_ALIGNMENT = 8;  // 64-bit alignment
 static_assert(PARAMS_ALIGNMENT % alignof(C2Param) == 0, "C2Param alignment mismatch");
 static_assert(PARAMS_ALIGNMENT % alignof(C2Info) == 0, "C2Param alignment mismatch");
 static_assert(PARAMS_ALIGNMENT % alignof(C2Tuning) == 0, "C2Param alignment mismatch");
 
+namespace /* unnamed */ {
+
+/**
+ * Returns the param at |offset| in a params blob of |size| bytes, or nullptr if there is no valid
+ * param at that offset.
+ */
+const C2Param *paramAt(const uint8_t *data, size_t size, size_t offset) {
+    if (offset >= size) {
+        return nullptr;
+    }
+    const C2Param *param = C2ParamUtils::ParseFirst(data + offset, size - offset);
+    // an empty param would never advance the parsing
+    return param && param->size() >= sizeof(C2Param) ? param : nullptr;
+}
+
+} // unnamed namespace
+
+ParamsBlobView::ParamsBlobView(const hidl_vec<uint8_t> &blob)
+    : mData(blob.data()),
+      mSize(blob.size()),
+      mEnd(0),
+      mCount(0) {
+    for (const C2Param *p = paramAt(mData, mSize, mEnd); p; p = paramAt(mData, mSize, mEnd)) {
+        mEnd = align(mEnd + p->size(), PARAMS_ALIGNMENT);
+        ++mCount;
+    }
+}
+
+ParamsBlobView::const_iterator &ParamsBlobView::const_iterator::operator++() {
+    // the view has validated the params already
+    mOffset = align(mOffset + (**this)->size(), PARAMS_ALIGNMENT);
+    return *this;
+}
+
 // Params -> std::vector<C2Param*>
 c2_status_t parseParamsBlob(std::vector<C2Param*> *params, const hidl_vec<uint8_t> &blob) {
     // assuming blob is const here
-    size_t size = blob.size();
-    size_t ix = 0;
-    const uint8_t *data = blob.data();
-    C2Param *p = nullptr;
-
-    do {
-        p = C2ParamUtils::ParseFirst(data + ix, size - ix);
-        if (p) {
-            params->emplace_back(p);
-            ix += p->size();
-            ix = align(ix, PARAMS_ALIGNMENT);
-        }
-    } while (p);
-
-    return ix == size ? C2_OK : C2_BAD_VALUE;
+    ParamsBlobView view(blob);
+    params->reserve(params->size() + view.size());
+    for (const C2Param *p : view) {
+        params->emplace_back(const_cast<C2Param*>(p));
+    }
+    return view.status();
 }
 
 namespace /* unnamed */ {
 
 /**
- * Concatenates a list of C2Params into a params blob.
- * \param[out] blob target blob
- * \param[in] params parameters to concatenate
- * \retval C2_OK if the blob was successfully created
- * \retval C2_BAD_VALUE if the blob was not successful (this only happens if the parameters were
- *         not const)
+ * Returns the size of the params blob for a list of C2Params.
  */
 template<typename T>
-Status _createParamsBlob(hidl_vec<uint8_t> *blob, const T &params) {
-    // assuming the parameter values are const
+size_t paramsBlobSize(const T &params) {
     size_t size = 0;
     for (const auto &p : params) {
         if (!p) {
@@ -1452,7 +1756,15 @@ Status _createParamsBlob(hidl_vec<uint8_t> *blob, const T &params) {
         size += p->size();
         size = align(size, PARAMS_ALIGNMENT);
     }
-    blob->resize(size);
+    return size;
+}
+
+/**
+ * Concatenates a list of C2Params into |size| bytes at |data|.
+ * \return the number of bytes written. This is |size| unless the parameters were not const.
+ */
+template<typename T>
+size_t writeParamsBlob(uint8_t *data, size_t size, const T &params) {
     size_t ix = 0;
     for (const auto &p : params) {
         if (!p) {
@@ -1463,12 +1775,35 @@ Status _createParamsBlob(hidl_vec<uint8_t> *blob, const T &params) {
         std::copy(
                 reinterpret_cast<const uint8_t*>(&*p),
                 reinterpret_cast<const uint8_t*>(&*p) + paramSize,
-                &(*blob)[ix]);
-        ix += paramSize;
-        ix = align(ix, PARAMS_ALIGNMENT);
+                data + ix);
+        size_t paramEnd = ix + paramSize;
+        ix = std::min(align(paramEnd, PARAMS_ALIGNMENT), size);
+        // do not leak stale or uninitialized memory in the padding
+        std::fill(data + paramEnd, data + ix, 0);
     }
-    blob->resize(ix);
-    return ix == size ? Status::OK : Status::CORRUPTED;
+    return ix;
+}
+
+/**
+ * Concatenates a list of C2Params into a params blob.
+ * \param[out] blob target blob
+ * \param[in] params parameters to concatenate
+ * \retval C2_OK if the blob was successfully created
+ * \retval C2_BAD_VALUE if the blob was not successful (this only happens if the parameters were
+ *         not const)
+ */
+template<typename T>
+Status _createParamsBlob(hidl_vec<uint8_t> *blob, const T &params) {
+    // assuming the parameter values are const
+    size_t size = paramsBlobSize(params);
+    // every byte is overwritten, so a blob of the same size is reused as is
+    resizeIfNeeded(blob, size);
+    size_t ix = writeParamsBlob(blob->data(), size, params);
+    if (ix != size) {
+        blob->resize(ix);
+        return Status::CORRUPTED;
+    }
+    return Status::OK;
 }
 
 } // unnamed namespace
@@ -1508,24 +1843,46 @@ Status createParamsBlob(
     return _createParamsBlob(blob, params);
 }
 
+template<typename T>
+Status ParamsBlobBuilder::_build(const T &params) {
+    size_t size = paramsBlobSize(params);
+    if (mStorage.size() < size) {
+        mStorage.resize(size);
+    }
+    size_t ix = writeParamsBlob(mStorage.data(), size, params);
+    mBlob.setToExternal(mStorage.data(), ix);
+    return ix == size ? Status::OK : Status::CORRUPTED;
+}
+
+Status ParamsBlobBuilder::build(const std::vector<C2Param*> &params) {
+    return _build(params);
+}
+
+Status ParamsBlobBuilder::build(const std::vector<std::unique_ptr<C2Param>> &params) {
+    return _build(params);
+}
+
+Status ParamsBlobBuilder::build(const std::vector<std::shared_ptr<const C2Info>> &params) {
+    return _build(params);
+}
+
+Status ParamsBlobBuilder::build(const std::vector<std::unique_ptr<C2Tuning>> &params) {
+    return _build(params);
+}
+
 // Params -> std::vector<std::unique_ptr<C2Param>>
 c2_status_t copyParamsFromBlob(
         std::vector<std::unique_ptr<C2Param>>* params,
         Params blob) {
-    std::vector<C2Param*> paramPointers;
-    c2_status_t status = parseParamsBlob(&paramPointers, blob);
-    if (status != C2_OK) {
+    ParamsBlobView view(blob);
+    if (view.status() != C2_OK) {
         ALOGE("copyParamsFromBlob -- blob parsing failed.");
-        return status;
+        return view.status();
     }
-    params->resize(paramPointers.size());
+    params->resize(view.size());
     size_t i = 0;
-    for (C2Param* const& paramPointer : paramPointers) {
-        if (!paramPointer) {
-            ALOGE("copyParamsFromBlob -- corrupted params blob.");
-            return C2_BAD_VALUE;
-        }
-        (*params)[i++] = C2Param::Copy(*paramPointer);
+    for (const C2Param *p : view) {
+        (*params)[i++] = C2Param::Copy(*p);
     }
     return C2_OK;
 }
@@ -1534,41 +1891,35 @@ c2_status_t copyParamsFromBlob(
 c2_status_t updateParamsFromBlob(
         const std::vector<C2Param*>& params,
         const Params& blob) {
-    std::unordered_map<uint32_t, C2Param*> index2param;
     for (C2Param* const& param : params) {
         if (!param) {
             ALOGE("updateParamsFromBlob -- corrupted input params.");
             return C2_BAD_VALUE;
         }
-        if (index2param.find(param->index()) == index2param.end()) {
-            index2param.emplace(param->index(), param);
-        }
     }
 
-    std::vector<C2Param*> paramPointers;
-    c2_status_t status = parseParamsBlob(&paramPointers, blob);
-    if (status != C2_OK) {
+    ParamsBlobView view(blob);
+    if (view.status() != C2_OK) {
         ALOGE("updateParamsFromBlob -- blob parsing failed.");
-        return status;
+        return view.status();
     }
 
-    for (C2Param* const& paramPointer : paramPointers) {
-        if (!paramPointer) {
-            ALOGE("updateParamsFromBlob -- corrupted param in blob.");
-            return C2_BAD_VALUE;
-        }
-        decltype(index2param)::iterator i = index2param.find(
-                paramPointer->index());
-        if (i == index2param.end()) {
+    // there are only a few params in a config, so a linear search is cheaper than building an
+    // index map. The first param with a given index is updated.
+    for (const C2Param *p : view) {
+        std::vector<C2Param*>::const_iterator i = std::find_if(
+                params.begin(), params.end(),
+                [p](const C2Param *param) { return param->index() == p->index(); });
+        if (i == params.end()) {
             ALOGW("updateParamsFromBlob -- unseen param index.");
             continue;
         }
-        if (!i->second->updateFrom(*paramPointer)) {
+        if (!(*i)->updateFrom(*p)) {
             ALOGE("updateParamsFromBlob -- mismatching sizes: "
                     "%u vs %u (index = %u).",
-                    static_cast<unsigned>(params.size()),
-                    static_cast<unsigned>(paramPointer->size()),
-                    static_cast<unsigned>(i->first));
+                    static_cast<unsigned>((*i)->size()),
+                    static_cast<unsigned>(p->size()),
+                    static_cast<unsigned>(p->index()));
             return C2_BAD_VALUE;
         }
     }
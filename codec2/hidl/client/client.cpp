@@ -43,6 +43,7 @@
 
 #include <C2Debug.h>
 #include <C2BufferPriv.h>
+#include <C2ParamInternal.h>
 #include <C2PlatformSupport.h>
 
 namespace android {
@@ -100,7 +101,13 @@ Codec2ConfigurableClient::Base* Codec2ConfigurableClient::base() const {
 }
 
 Codec2ConfigurableClient::Codec2ConfigurableClient(
-        const sp<Codec2ConfigurableClient::Base>& base) : mBase(base) {
+        const sp<Codec2ConfigurableClient::Base>& base)
+      : mBase(base),
+        mCacheEnabled(::android::base::GetBoolProperty(
+                "debug.stagefright.c2.client-param-cache", true)),
+        mCacheGeneration(0),
+        mDescriptorsCached(false),
+        mCacheStats{} {
     Return<void> transStatus = base->getName(
             [this](const hidl_string& name) {
                 mName = name.c_str();
@@ -110,11 +117,148 @@ Codec2ConfigurableClient::Codec2ConfigurableClient(
     }
 }
 
+Codec2ConfigurableClient::~Codec2ConfigurableClient() {
+    CacheStats stats = getCacheStats();
+    if (stats.paramQueries > 0 || stats.valueQueries > 0) {
+        ALOGD("%s: param cache hits %zu/%zu, supported values cache hits %zu/%zu, "
+                "%zu query transactions, %zu saved",
+                mName.c_str(),
+                stats.paramHits, stats.paramQueries,
+                stats.valueHits, stats.valueQueries,
+                stats.transactions, stats.savedTransactions);
+    }
+}
+
+Codec2ConfigurableClient::CacheStats Codec2ConfigurableClient::getCacheStats() const {
+    std::lock_guard<std::mutex> lock(mCacheMutex);
+    return mCacheStats;
+}
+
+void Codec2ConfigurableClient::invalidateCache() {
+    std::lock_guard<std::mutex> lock(mCacheMutex);
+    ++mCacheGeneration;
+    for (auto it = mCachedParams.begin(); it != mCachedParams.end(); ) {
+        if ((getAttrib_l(it->first) & C2ParamDescriptor::IS_CONST)
+                == C2ParamDescriptor::IS_CONST) {
+            ++it;
+        } else {
+            it = mCachedParams.erase(it);
+        }
+    }
+    for (auto it = mCachedValues.begin(); it != mCachedValues.end(); ) {
+        if (std::get<3>(it->first) == C2FieldSupportedValuesQuery::POSSIBLE) {
+            ++it;
+        } else {
+            it = mCachedValues.erase(it);
+        }
+    }
+}
+
+uint32_t Codec2ConfigurableClient::getAttrib_l(C2Param::Index index) const {
+    auto it = mAttribs.find(index.type());
+    return it == mAttribs.end() ? 0 : it->second;
+}
+
 c2_status_t Codec2ConfigurableClient::query(
         const std::vector<C2Param*> &stackParams,
         const std::vector<C2Param::Index> &heapParamIndices,
         c2_blocking_t mayBlock,
         std::vector<std::unique_ptr<C2Param>>* const heapParams) const {
+    if (!mCacheEnabled) {
+        return queryRemote(stackParams, heapParamIndices, mayBlock, heapParams);
+    }
+
+    std::vector<C2Param*> remoteStackParams;
+    std::vector<C2Param::Index> remoteHeapParamIndices;
+    // heap params served from the cache, in the order of heapParamIndices
+    std::vector<std::unique_ptr<C2Param>> cachedHeapParams(heapParamIndices.size());
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mCacheMutex);
+        generation = mCacheGeneration;
+        for (C2Param* const& stackParam : stackParams) {
+            if (!stackParam) {
+                continue;
+            }
+            ++mCacheStats.paramQueries;
+            auto it = mCachedParams.find(stackParam->index());
+            if (it != mCachedParams.end() && stackParam->updateFrom(*it->second)) {
+                ++mCacheStats.paramHits;
+                continue;
+            }
+            remoteStackParams.push_back(stackParam);
+        }
+        for (size_t i = 0; i < heapParamIndices.size(); ++i) {
+            ++mCacheStats.paramQueries;
+            auto it = mCachedParams.find(heapParamIndices[i]);
+            if (it != mCachedParams.end() && heapParams) {
+                cachedHeapParams[i] = C2Param::Copy(*it->second);
+                if (cachedHeapParams[i]) {
+                    ++mCacheStats.paramHits;
+                    continue;
+                }
+            }
+            remoteHeapParamIndices.push_back(heapParamIndices[i]);
+        }
+        if (remoteStackParams.empty() && remoteHeapParamIndices.empty()) {
+            ++mCacheStats.savedTransactions;
+        }
+    }
+
+    c2_status_t status = C2_OK;
+    std::vector<std::unique_ptr<C2Param>> remoteHeapParams;
+    if (!remoteStackParams.empty() || !remoteHeapParamIndices.empty()) {
+        status = queryRemote(
+                remoteStackParams, remoteHeapParamIndices, mayBlock,
+                heapParams ? &remoteHeapParams : nullptr);
+
+        // cache the returned values of read-only params unless the cache was
+        // invalidated during the query
+        std::lock_guard<std::mutex> lock(mCacheMutex);
+        if (generation == mCacheGeneration) {
+            auto cache = [this](const C2Param &param) {
+                if (param && (getAttrib_l(param.index()) & C2ParamDescriptor::IS_READ_ONLY)) {
+                    std::unique_ptr<C2Param> copy = C2Param::Copy(param);
+                    if (copy) {
+                        mCachedParams[param.index()] = std::move(copy);
+                    }
+                }
+            };
+            for (C2Param* const& stackParam : remoteStackParams) {
+                cache(*stackParam);
+            }
+            for (const std::unique_ptr<C2Param>& heapParam : remoteHeapParams) {
+                if (heapParam) {
+                    cache(*heapParam);
+                }
+            }
+        }
+    }
+
+    if (heapParams) {
+        // merge cached and queried heap params in the requested order; the
+        // component omits params that it does not support
+        auto remote = remoteHeapParams.begin();
+        for (size_t i = 0; i < heapParamIndices.size(); ++i) {
+            if (cachedHeapParams[i]) {
+                heapParams->push_back(std::move(cachedHeapParams[i]));
+            } else if (remote != remoteHeapParams.end()
+                    && *remote && (*remote)->index() == heapParamIndices[i]) {
+                heapParams->push_back(std::move(*remote++));
+            }
+        }
+        for (; remote != remoteHeapParams.end(); ++remote) {
+            heapParams->push_back(std::move(*remote));
+        }
+    }
+    return status;
+}
+
+c2_status_t Codec2ConfigurableClient::queryRemote(
+        const std::vector<C2Param*> &stackParams,
+        const std::vector<C2Param::Index> &heapParamIndices,
+        c2_blocking_t mayBlock,
+        std::vector<std::unique_ptr<C2Param>>* const heapParams) const {
     hidl_vec<ParamIndex> indices(
             stackParams.size() + heapParamIndices.size());
     size_t numIndices = 0;
@@ -134,6 +278,10 @@ c2_status_t Codec2ConfigurableClient::query(
     if (heapParams) {
         heapParams->reserve(heapParams->size() + numIndices);
     }
+    {
+        std::lock_guard<std::mutex> lock(mCacheMutex);
+        ++mCacheStats.transactions;
+    }
     c2_status_t status;
     Return<void> transStatus = base()->query(
             indices,
@@ -146,24 +294,19 @@ c2_status_t Codec2ConfigurableClient::query(
                             "Error code = %d", static_cast<int>(status));
                     return;
                 }
-                std::vector<C2Param*> paramPointers;
-                c2_status_t parseStatus = parseParamsBlob(&paramPointers, p);
-                if (parseStatus != C2_OK) {
+                // read the params in place; only heap params need to be copied
+                ParamsBlobView paramPointers(p);
+                if (paramPointers.status() != C2_OK) {
                     ALOGE("query -- error while parsing params. "
                             "Error code = %d", static_cast<int>(status));
-                    status = parseStatus;
+                    status = paramPointers.status();
                     return;
                 }
                 size_t i = 0;
                 for (auto it = paramPointers.begin(); it != paramPointers.end(); ) {
-                    C2Param* paramPointer = *it;
+                    const C2Param* paramPointer = *it;
                     if (numStackIndices > 0) {
                         --numStackIndices;
-                        if (!paramPointer) {
-                            ALOGW("query -- null stack param.");
-                            ++it;
-                            continue;
-                        }
                         for (; i < stackParams.size() && !stackParams[i]; ) {
                             ++i;
                         }
@@ -183,11 +326,6 @@ c2_status_t Codec2ConfigurableClient::query(
                                     static_cast<int>(paramPointer->index()));
                         }
                     } else {
-                        if (!paramPointer) {
-                            ALOGW("query -- null heap param.");
-                            ++it;
-                            continue;
-                        }
                         if (!heapParams) {
                             ALOGW("query -- unexpected extra stack param.");
                         } else {
@@ -208,15 +346,16 @@ c2_status_t Codec2ConfigurableClient::config(
         const std::vector<C2Param*> &params,
         c2_blocking_t mayBlock,
         std::vector<std::unique_ptr<C2SettingResult>>* const failures) {
-    Params hidlParams;
-    Status hidlStatus = createParamsBlob(&hidlParams, params);
+    // reuse the blob storage of the calling thread across calls
+    thread_local ParamsBlobBuilder hidlParams;
+    Status hidlStatus = hidlParams.build(params);
     if (hidlStatus != Status::OK) {
         ALOGE("config -- bad input.");
         return C2_TRANSACTION_FAILED;
     }
     c2_status_t status;
     Return<void> transStatus = base()->config(
-            hidlParams,
+            hidlParams.blob(),
             mayBlock == C2_MAY_BLOCK,
             [&status, &params, failures](
                     Status s,
@@ -239,6 +378,9 @@ c2_status_t Codec2ConfigurableClient::config(
                 }
                 status = updateParamsFromBlob(params, o);
             });
+    // read-only params and currently supported values may depend on the
+    // configured params
+    invalidateCache();
     if (!transStatus.isOk()) {
         ALOGE("config -- transaction failed.");
         return C2_TRANSACTION_FAILED;
@@ -248,7 +390,17 @@ c2_status_t Codec2ConfigurableClient::config(
 
 c2_status_t Codec2ConfigurableClient::querySupportedParams(
         std::vector<std::shared_ptr<C2ParamDescriptor>>* const params) const {
-    // TODO: Cache and query properly!
+    // supported params never change, so they are only queried once
+    {
+        std::lock_guard<std::mutex> lock(mCacheMutex);
+        if (mCacheEnabled && mDescriptorsCached) {
+            params->insert(params->end(), mDescriptors.begin(), mDescriptors.end());
+            ++mCacheStats.savedTransactions;
+            return C2_OK;
+        }
+        ++mCacheStats.transactions;
+    }
+    size_t start = params->size();
     c2_status_t status;
     Return<void> transStatus = base()->querySupportedParams(
             std::numeric_limits<uint32_t>::min(),
@@ -278,12 +430,87 @@ c2_status_t Codec2ConfigurableClient::querySupportedParams(
         ALOGE("querySupportedParams -- transaction failed.");
         return C2_TRANSACTION_FAILED;
     }
+    if (mCacheEnabled && status == C2_OK) {
+        std::lock_guard<std::mutex> lock(mCacheMutex);
+        if (!mDescriptorsCached) {
+            mDescriptors.assign(params->begin() + start, params->end());
+            for (const std::shared_ptr<C2ParamDescriptor>& desc : mDescriptors) {
+                if (desc) {
+                    mAttribs[desc->index().type()] = _C2ParamInspector::GetAttrib(*desc);
+                }
+            }
+            mDescriptorsCached = true;
+        }
+    }
     return status;
 }
 
 c2_status_t Codec2ConfigurableClient::querySupportedValues(
         std::vector<C2FieldSupportedValuesQuery>& fields,
         c2_blocking_t mayBlock) const {
+    if (!mCacheEnabled) {
+        return querySupportedValuesRemote(fields, mayBlock);
+    }
+
+    auto key = [](const C2FieldSupportedValuesQuery& query) {
+        C2ParamField field = query.field();
+        return FieldKey(_C2ParamInspector::GetIndex(field),
+                        _C2ParamInspector::GetOffset(field),
+                        _C2ParamInspector::GetSize(field),
+                        query.type());
+    };
+
+    std::vector<C2FieldSupportedValuesQuery> remoteFields;
+    std::vector<size_t> remotePositions;
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mCacheMutex);
+        generation = mCacheGeneration;
+        for (size_t i = 0; i < fields.size(); ++i) {
+            ++mCacheStats.valueQueries;
+            auto it = mCachedValues.find(key(fields[i]));
+            if (it != mCachedValues.end()) {
+                ++mCacheStats.valueHits;
+                fields[i].status = C2_OK;
+                fields[i].values = it->second;
+                continue;
+            }
+            remoteFields.push_back(fields[i]);
+            remotePositions.push_back(i);
+        }
+        if (remoteFields.empty()) {
+            ++mCacheStats.savedTransactions;
+            return C2_OK;
+        }
+    }
+
+    c2_status_t status = querySupportedValuesRemote(remoteFields, mayBlock);
+    if (status != C2_OK && status != C2_BAD_INDEX) {
+        return status;
+    }
+    std::lock_guard<std::mutex> lock(mCacheMutex);
+    for (size_t i = 0; i < remoteFields.size(); ++i) {
+        C2FieldSupportedValuesQuery& field = fields[remotePositions[i]];
+        field.status = remoteFields[i].status;
+        field.values = remoteFields[i].values;
+        // possible values never change; current values are valid until the
+        // next invalidation
+        if (field.status == C2_OK
+                && (field.type() == C2FieldSupportedValuesQuery::POSSIBLE
+                        || generation == mCacheGeneration)) {
+            mCachedValues.emplace(key(field), field.values);
+        }
+    }
+    return status;
+}
+
+c2_status_t Codec2ConfigurableClient::querySupportedValuesRemote(
+        std::vector<C2FieldSupportedValuesQuery>& fields,
+        c2_blocking_t mayBlock) const {
+    {
+        std::lock_guard<std::mutex> lock(mCacheMutex);
+        ++mCacheStats.transactions;
+    }
     hidl_vec<FieldSupportedValuesQuery> inFields(fields.size());
     for (size_t i = 0; i < fields.size(); ++i) {
         Status hidlStatus = objcpy(&inFields[i], fields[i]);
@@ -334,8 +561,10 @@ struct Codec2Client::Component::HidlListener : public IComponentListener {
     std::weak_ptr<Listener> base;
 
     virtual Return<void> onWorkDone(const WorkBundle& workBundle) override {
+        std::shared_ptr<Codec2Client::Component> strongComponent = component.lock();
         std::list<std::unique_ptr<C2Work>> workItems;
-        c2_status_t status = objcpy(&workItems, workBundle);
+        c2_status_t status = objcpy(&workItems, workBundle, nullptr,
+                strongComponent ? &strongComponent->mBaseBlockCache : nullptr);
         if (status != C2_OK) {
             ALOGI("onWorkDone -- received corrupted WorkBundle. "
                     "status = %d.", static_cast<int>(status));
@@ -343,7 +572,6 @@ struct Codec2Client::Component::HidlListener : public IComponentListener {
         }
         // release input buffers potentially held by the component from queue
         size_t numDiscardedInputBuffers = 0;
-        std::shared_ptr<Codec2Client::Component> strongComponent = component.lock();
         if (strongComponent) {
             numDiscardedInputBuffers = strongComponent->handleOnWorkDone(workItems);
         }
@@ -847,8 +1075,14 @@ size_t Codec2Client::Component::handleOnWorkDone(
         const std::list<std::unique_ptr<C2Work>> &workItems) {
     // Input buffers' lifetime management
     std::vector<uint64_t> inputDone;
+    bool configUpdated = false;
     for (const std::unique_ptr<C2Work> &work : workItems) {
         if (work) {
+            for (const std::unique_ptr<C2Worklet> &worklet : work->worklets) {
+                if (worklet && !worklet->output.configUpdate.empty()) {
+                    configUpdated = true;
+                }
+            }
             if (work->worklets.empty()
                     || !work->worklets.back()
                     || (work->worklets.back()->output.flags & C2FrameData::FLAG_INCOMPLETE) == 0) {
@@ -857,6 +1091,10 @@ size_t Codec2Client::Component::handleOnWorkDone(
             }
         }
     }
+    if (configUpdated) {
+        // the component changed its configuration on its own
+        invalidateCache();
+    }
 
     size_t numDiscardedInputBuffers = 0;
     {
@@ -952,13 +1190,24 @@ c2_status_t Codec2Client::Component::queue(
         }
     }
 
-    WorkBundle workBundle;
-    Status hidlStatus = objcpy(&workBundle, *items, &mBufferPoolSender);
+    // Reuse the storage of the previous WorkBundle unless another thread is
+    // queueing at the same time.
+    WorkBundle localWorkBundle;
+    WorkBundle* workBundle = &localWorkBundle;
+    std::unique_lock<std::mutex> lock(mQueueMutex, std::try_to_lock);
+    Status hidlStatus;
+    if (lock) {
+        workBundle = &mQueueWorkBundle;
+        hidlStatus = objcpy(workBundle, *items, &mBufferPoolSender,
+                            &mQueueWorkArena);
+    } else {
+        hidlStatus = objcpy(workBundle, *items, &mBufferPoolSender);
+    }
     if (hidlStatus != Status::OK) {
         ALOGE("queue -- bad input.");
         return C2_TRANSACTION_FAILED;
     }
-    Return<Status> transStatus = base()->queue(workBundle);
+    Return<Status> transStatus = base()->queue(*workBundle);
     if (!transStatus.isOk()) {
         ALOGE("queue -- transaction failed.");
         return C2_TRANSACTION_FAILED;
@@ -992,6 +1241,7 @@ c2_status_t Codec2Client::Component::flush(
         ALOGE("flush -- transaction failed.");
         return C2_TRANSACTION_FAILED;
     }
+    mBaseBlockCache.clear();
 
     // Indices of flushed work items.
     std::vector<uint64_t> flushedIndices;
@@ -1082,6 +1332,7 @@ c2_status_t Codec2Client::Component::stop() {
         ALOGE("stop -- call failed. "
                 "Error code = %d", static_cast<int>(status));
     }
+    mBaseBlockCache.clear();
     mInputBuffersMutex.lock();
     mInputBuffers.clear();
     mInputBufferCount.clear();
@@ -1101,6 +1352,8 @@ c2_status_t Codec2Client::Component::reset() {
         ALOGE("reset -- call failed. "
                 "Error code = %d", static_cast<int>(status));
     }
+    invalidateCache();
+    mBaseBlockCache.clear();
     mInputBuffersMutex.lock();
     mInputBuffers.clear();
     mInputBufferCount.clear();
@@ -1120,6 +1373,8 @@ c2_status_t Codec2Client::Component::release() {
         ALOGE("release -- call failed. "
                 "Error code = %d", static_cast<int>(status));
     }
+    invalidateCache();
+    mBaseBlockCache.clear();
     mInputBuffersMutex.lock();
     mInputBuffers.clear();
     mInputBufferCount.clear();
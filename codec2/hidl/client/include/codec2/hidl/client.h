@@ -33,6 +33,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <tuple>
 
 /**
  * This file contains minimal interfaces for the framework to access Codec2.0.
@@ -142,15 +143,65 @@ struct Codec2ConfigurableClient {
             std::vector<C2FieldSupportedValuesQuery>& fields,
             c2_blocking_t mayBlock) const;
 
+    // Statistics of the client-side cache of const and read-only parameters,
+    // parameter descriptors and supported values.
+    struct CacheStats {
+        size_t paramQueries;      // params requested from query()
+        size_t paramHits;         // params served from the cache
+        size_t valueQueries;      // fields requested from querySupportedValues()
+        size_t valueHits;         // fields served from the cache
+        size_t transactions;      // query transactions made to the component
+        size_t savedTransactions; // queries served fully from the cache
+    };
+    CacheStats getCacheStats() const;
+
+    // Drops cached values that may change: non-const read-only parameters and
+    // currently supported values. This is called on configuration updates.
+    void invalidateCache();
+
     // base cannot be null.
     Codec2ConfigurableClient(const sp<Base>& base);
 
+    ~Codec2ConfigurableClient();
+
 protected:
     C2String mName;
     sp<Base> mBase;
 
     Base* base() const;
 
+    c2_status_t queryRemote(
+            const std::vector<C2Param*>& stackParams,
+            const std::vector<C2Param::Index> &heapParamIndices,
+            c2_blocking_t mayBlock,
+            std::vector<std::unique_ptr<C2Param>>* const heapParams) const;
+
+    c2_status_t querySupportedValuesRemote(
+            std::vector<C2FieldSupportedValuesQuery>& fields,
+            c2_blocking_t mayBlock) const;
+
+    // Returns the attributes of a parameter, or 0 if the descriptors have not
+    // been queried yet.
+    uint32_t getAttrib_l(C2Param::Index index) const;
+
+    // Descriptors, read-only parameters and supported values only change
+    // through config() or configuration updates reported by the component, so
+    // they are cached here to save transactions. The cache can be disabled by
+    // setting debug.stagefright.c2.client-param-cache to false.
+    typedef std::tuple<uint32_t, uint32_t, uint32_t, uint32_t> FieldKey;
+    const bool mCacheEnabled;
+    mutable std::mutex mCacheMutex;
+    mutable uint32_t mCacheGeneration;
+    mutable bool mDescriptorsCached;
+    mutable std::vector<std::shared_ptr<C2ParamDescriptor>> mDescriptors;
+    // param type -> attributes
+    mutable std::map<uint32_t, uint32_t> mAttribs;
+    // param index -> value
+    mutable std::map<uint32_t, std::unique_ptr<C2Param>> mCachedParams;
+    // (param index, field offset, field size, query type) -> supported values
+    mutable std::map<FieldKey, C2FieldSupportedValues> mCachedValues;
+    mutable CacheStats mCacheStats;
+
     friend struct Codec2Client;
 };
 
@@ -408,6 +459,15 @@ protected:
     ::hardware::google::media::c2::V1_0::utils::DefaultBufferPoolSender
             mBufferPoolSender;
 
+    // Storage recycled across queue() calls. mQueueWorkBundle is the
+    // WorkBundle last sent to the component; it is reused for the next one.
+    std::mutex mQueueMutex;
+    ::hardware::google::media::c2::V1_0::WorkBundle mQueueWorkBundle;
+    ::hardware::google::media::c2::V1_0::utils::WorkArena mQueueWorkArena;
+
+    // Linear blocks imported from the output buffers received in onWorkDone().
+    ::hardware::google::media::c2::V1_0::utils::BaseBlockCache mBaseBlockCache;
+
     std::mutex mOutputBufferQueueMutex;
     sp<IGraphicBufferProducer> mOutputIgbp;
     uint64_t mOutputBqId;
@@ -0,0 +1,260 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "Codec2ConfigurableClient_test"
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <C2Config.h>
+#include <codec2/hidl/1.0/Configurable.h>
+#include <codec2/hidl/client.h>
+
+namespace android {
+
+namespace {
+
+using ::hardware::google::media::c2::V1_0::utils::CachedConfigurable;
+using ::hardware::google::media::c2::V1_0::utils::ConfigurableC2Intf;
+
+/**
+ * A video decoder interface with a const media type, a settable input picture size and a
+ * read-only output picture size that follows the input picture size.
+ */
+class FakeIntf : public ConfigurableC2Intf {
+public:
+    FakeIntf() : ConfigurableC2Intf("c2.test.decoder") {
+        const char *mediaType = "video/avc";
+        std::unique_ptr<C2PortMediaTypeSetting::output> mediaTypeParam =
+            C2PortMediaTypeSetting::output::AllocUnique(strlen(mediaType) + 1);
+        memcpy(mediaTypeParam->m.value, mediaType, strlen(mediaType) + 1);
+        mParams[C2PortMediaTypeSetting::output::PARAM_TYPE] = std::move(mediaTypeParam);
+        mParams[C2StreamPictureSizeInfo::input::PARAM_TYPE] =
+            std::make_unique<C2StreamPictureSizeInfo::input>(0u, 176, 144);
+        mParams[C2StreamPictureSizeInfo::output::PARAM_TYPE] =
+            std::make_unique<C2StreamPictureSizeInfo::output>(0u, 176, 144);
+    }
+
+    virtual c2_status_t query(
+            const std::vector<C2Param::Index> &indices,
+            c2_blocking_t,
+            std::vector<std::unique_ptr<C2Param>>* const params) const override {
+        mLastQuery.assign(indices.begin(), indices.end());
+        c2_status_t res = C2_OK;
+        for (const C2Param::Index &index : indices) {
+            auto it = mParams.find(index);
+            if (it == mParams.end()) {
+                res = C2_BAD_INDEX;
+                continue;
+            }
+            params->push_back(C2Param::Copy(*it->second));
+        }
+        return res;
+    }
+
+    virtual c2_status_t config(
+            const std::vector<C2Param*> &params,
+            c2_blocking_t,
+            std::vector<std::unique_ptr<C2SettingResult>>* const) override {
+        c2_status_t res = C2_OK;
+        for (C2Param *param : params) {
+            if (param->index() != C2StreamPictureSizeInfo::input::PARAM_TYPE) {
+                param->invalidate();
+                res = C2_BAD_INDEX;
+                continue;
+            }
+            C2StreamPictureSizeInfo::input *size = (C2StreamPictureSizeInfo::input *)param;
+            mParams[C2StreamPictureSizeInfo::input::PARAM_TYPE]->updateFrom(*size);
+            mParams[C2StreamPictureSizeInfo::output::PARAM_TYPE] =
+                std::make_unique<C2StreamPictureSizeInfo::output>(0u, size->width, size->height);
+        }
+        return res;
+    }
+
+    virtual c2_status_t querySupportedParams(
+            std::vector<std::shared_ptr<C2ParamDescriptor>>* const params) const override {
+        params->push_back(std::make_shared<C2ParamDescriptor>(
+                C2PortMediaTypeSetting::output::PARAM_TYPE, C2ParamDescriptor::IS_CONST,
+                "output.media-type"));
+        params->push_back(std::make_shared<C2ParamDescriptor>(
+                C2StreamPictureSizeInfo::input::PARAM_TYPE, C2ParamDescriptor::IS_PERSISTENT,
+                "input.picture-size"));
+        params->push_back(std::make_shared<C2ParamDescriptor>(
+                C2StreamPictureSizeInfo::output::PARAM_TYPE, C2ParamDescriptor::IS_READ_ONLY,
+                "output.picture-size"));
+        return C2_OK;
+    }
+
+    virtual c2_status_t querySupportedValues(
+            std::vector<C2FieldSupportedValuesQuery>&, c2_blocking_t) const override {
+        return C2_OMITTED;
+    }
+
+    /** Indices of the last query that reached the component. */
+    mutable std::vector<uint32_t> mLastQuery;
+
+private:
+    std::map<uint32_t, std::unique_ptr<C2Param>> mParams;
+};
+
+/** CachedConfigurable without the component store, which only validates the params. */
+struct TestConfigurable : public CachedConfigurable {
+    TestConfigurable(std::unique_ptr<ConfigurableC2Intf>&& intf)
+        : CachedConfigurable(std::move(intf)) {
+        mIntf->querySupportedParams(&mSupportedParams);
+    }
+};
+
+}  // namespace
+
+class Codec2ConfigurableClientTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::unique_ptr<FakeIntf> intf = std::make_unique<FakeIntf>();
+        mIntf = intf.get();
+        mClient = std::make_unique<Codec2ConfigurableClient>(
+                new TestConfigurable(std::move(intf)));
+        std::vector<std::shared_ptr<C2ParamDescriptor>> params;
+        ASSERT_EQ(C2_OK, mClient->querySupportedParams(&params));
+        ASSERT_EQ(3u, params.size());
+        mStats = mClient->getCacheStats();
+    }
+
+    c2_status_t queryHeap(
+            const std::vector<C2Param::Index> &indices,
+            std::vector<std::unique_ptr<C2Param>> *params) {
+        mIntf->mLastQuery.clear();
+        return mClient->query({}, indices, C2_MAY_BLOCK, params);
+    }
+
+    // Returns the change of the cache stats since the last call.
+    Codec2ConfigurableClient::CacheStats statsDelta() {
+        Codec2ConfigurableClient::CacheStats stats = mClient->getCacheStats();
+        Codec2ConfigurableClient::CacheStats delta = {
+            stats.paramQueries - mStats.paramQueries,
+            stats.paramHits - mStats.paramHits,
+            stats.valueQueries - mStats.valueQueries,
+            stats.valueHits - mStats.valueHits,
+            stats.transactions - mStats.transactions,
+            stats.savedTransactions - mStats.savedTransactions,
+        };
+        mStats = stats;
+        return delta;
+    }
+
+    const uint32_t kMediaType = C2PortMediaTypeSetting::output::PARAM_TYPE;
+    const uint32_t kInputSize = C2StreamPictureSizeInfo::input::PARAM_TYPE;
+    const uint32_t kOutputSize = C2StreamPictureSizeInfo::output::PARAM_TYPE;
+
+    FakeIntf *mIntf;
+    std::unique_ptr<Codec2ConfigurableClient> mClient;
+    Codec2ConfigurableClient::CacheStats mStats;
+};
+
+TEST_F(Codec2ConfigurableClientTest, QueriesSupportedParamsOnce) {
+    std::vector<std::shared_ptr<C2ParamDescriptor>> params;
+    ASSERT_EQ(C2_OK, mClient->querySupportedParams(&params));
+    ASSERT_EQ(3u, params.size());
+    EXPECT_EQ(kMediaType, (uint32_t)params[0]->index());
+    EXPECT_TRUE(params[2]->isReadOnly());
+    Codec2ConfigurableClient::CacheStats delta = statsDelta();
+    EXPECT_EQ(0u, delta.transactions);
+    EXPECT_EQ(1u, delta.savedTransactions);
+}
+
+TEST_F(Codec2ConfigurableClientTest, ServesReadOnlyParamsFromCache) {
+    std::vector<std::unique_ptr<C2Param>> params;
+    ASSERT_EQ(C2_OK, queryHeap({ kMediaType, kOutputSize }, &params));
+    ASSERT_EQ(2u, params.size());
+    EXPECT_EQ(2u, mIntf->mLastQuery.size());
+    Codec2ConfigurableClient::CacheStats delta = statsDelta();
+    EXPECT_EQ(2u, delta.paramQueries);
+    EXPECT_EQ(0u, delta.paramHits);
+    EXPECT_EQ(1u, delta.transactions);
+
+    params.clear();
+    ASSERT_EQ(C2_OK, queryHeap({ kMediaType, kOutputSize }, &params));
+    ASSERT_EQ(2u, params.size());
+    EXPECT_STREQ("video/avc", ((C2PortMediaTypeSetting::output *)params[0].get())->m.value);
+    EXPECT_EQ(176u, ((C2StreamPictureSizeInfo::output *)params[1].get())->width);
+    EXPECT_TRUE(mIntf->mLastQuery.empty());
+    delta = statsDelta();
+    EXPECT_EQ(2u, delta.paramHits);
+    EXPECT_EQ(0u, delta.transactions);
+    EXPECT_EQ(1u, delta.savedTransactions);
+
+    // settable params are always queried from the component
+    C2StreamPictureSizeInfo::input inputSize;
+    ASSERT_EQ(C2_OK, mClient->query({ &inputSize }, {}, C2_MAY_BLOCK, nullptr));
+    EXPECT_EQ(144u, inputSize.height);
+    delta = statsDelta();
+    EXPECT_EQ(0u, delta.paramHits);
+    EXPECT_EQ(1u, delta.transactions);
+}
+
+TEST_F(Codec2ConfigurableClientTest, MergesPartiallyCachedQueries) {
+    std::vector<std::unique_ptr<C2Param>> params;
+    ASSERT_EQ(C2_OK, queryHeap({ kMediaType }, &params));
+    statsDelta();
+
+    // only the uncached params reach the component, and the results keep the requested order
+    // without the unsupported param
+    const uint32_t kUnsupported = C2StreamFrameRateInfo::output::PARAM_TYPE;
+    params.clear();
+    EXPECT_EQ(C2_BAD_INDEX,
+              queryHeap({ kInputSize, kMediaType, kUnsupported, kOutputSize }, &params));
+    EXPECT_EQ(std::vector<uint32_t>({ kInputSize, kUnsupported, kOutputSize }),
+              mIntf->mLastQuery);
+    ASSERT_EQ(3u, params.size());
+    EXPECT_EQ(kInputSize, params[0]->index());
+    EXPECT_EQ(kMediaType, params[1]->index());
+    EXPECT_EQ(kOutputSize, params[2]->index());
+    Codec2ConfigurableClient::CacheStats delta = statsDelta();
+    EXPECT_EQ(4u, delta.paramQueries);
+    EXPECT_EQ(1u, delta.paramHits);
+    EXPECT_EQ(1u, delta.transactions);
+    EXPECT_EQ(0u, delta.savedTransactions);
+}
+
+TEST_F(Codec2ConfigurableClientTest, ConfigInvalidatesReadOnlyParams) {
+    std::vector<std::unique_ptr<C2Param>> params;
+    ASSERT_EQ(C2_OK, queryHeap({ kMediaType, kOutputSize }, &params));
+
+    C2StreamPictureSizeInfo::input inputSize(0u, 320, 240);
+    std::vector<std::unique_ptr<C2SettingResult>> failures;
+    ASSERT_EQ(C2_OK, mClient->config({ &inputSize }, C2_MAY_BLOCK, &failures));
+    statsDelta();
+
+    // the const param stays cached, but the read-only param is queried again
+    params.clear();
+    ASSERT_EQ(C2_OK, queryHeap({ kMediaType, kOutputSize }, &params));
+    EXPECT_EQ(std::vector<uint32_t>({ kOutputSize }), mIntf->mLastQuery);
+    ASSERT_EQ(2u, params.size());
+    EXPECT_EQ(kMediaType, params[0]->index());
+    ASSERT_EQ(kOutputSize, params[1]->index());
+    EXPECT_EQ(320u, ((C2StreamPictureSizeInfo::output *)params[1].get())->width);
+    EXPECT_EQ(240u, ((C2StreamPictureSizeInfo::output *)params[1].get())->height);
+    Codec2ConfigurableClient::CacheStats delta = statsDelta();
+    EXPECT_EQ(1u, delta.paramHits);
+    EXPECT_EQ(1u, delta.transactions);
+}
+
+}  // namespace android
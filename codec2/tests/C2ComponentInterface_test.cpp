@@ -19,6 +19,11 @@
 #include <dlfcn.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include <gtest/gtest.h>
 #include <utils/Log.h>
 
@@ -26,6 +31,7 @@
 #include <C2Config.h>
 #include <util/C2InterfaceHelper.h>
 #include <C2Param.h>
+#include <C2PlatformSupport.h>
 
 #if !defined(UNUSED)
 #define UNUSED(expr)                                                           \
@@ -703,4 +709,174 @@ TEST_F(C2CompIntfTest, C2V4L2CodecIntf) {
     testMain(componentIntf, componentName);
 }
 
+TEST_F(C2CompIntfTest, AvcDecIntfThroughput) {
+    constexpr int kIterations = 20000;
+
+    std::shared_ptr<C2ComponentInterface> intf;
+    ASSERT_EQ(C2_OK, GetCodec2PlatformComponentStore()->createInterface(
+            "c2.android.avc.decoder", &intf));
+
+    C2StreamPictureSizeInfo::output size(0u, 320, 240);
+    C2StreamMaxPictureSizeTuning::output maxSize(0u);
+    C2StreamProfileLevelInfo::input profileLevel(0u);
+    C2StreamMaxBufferSizeInfo::input maxInputSize(0u);
+    C2StreamColorAspectsInfo::output colorAspects(0u);
+    std::vector<C2Param *> queried = {
+        &size, &maxSize, &profileLevel, &maxInputSize, &colorAspects };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        ASSERT_EQ(C2_OK, intf->query_vb(queried, {}, C2_MAY_BLOCK, nullptr));
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    printf("query of %zu params: %.2f us\n", queried.size(), elapsed.count() / kIterations);
+
+    // the picture size has dependent parameters, so every config also runs their setters
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        C2StreamPictureSizeInfo::output config(0u, 320 + (i & 1) * 16, 240);
+        std::vector<std::unique_ptr<C2SettingResult>> failures;
+        ASSERT_EQ(C2_OK, intf->config_vb({ &config }, C2_MAY_BLOCK, &failures));
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    printf("config of picture size: %.2f us\n", elapsed.count() / kIterations);
+}
+
+namespace {
+
+class SnapshotIntf : public C2InterfaceHelper {
+public:
+    SnapshotIntf() : C2InterfaceHelper(std::make_shared<C2ReflectorHelper>()) {
+        setDerivedInstance(this);
+
+        addParameter(
+                DefineParam(mSize, C2_PARAMKEY_PICTURE_SIZE)
+                .withDefault(new C2StreamPictureSizeInfo::output(0u, 320, 240))
+                .withFields({
+                    C2F(mSize, width).inRange(2, 4096, 2),
+                    C2F(mSize, height).inRange(2, 4096, 2),
+                })
+                .withSetter(SizeSetter)
+                .build());
+
+        addParameter(
+                DefineParam(mMaxSize, C2_PARAMKEY_MAX_PICTURE_SIZE)
+                .withDefault(new C2StreamMaxPictureSizeTuning::output(0u, 320, 240))
+                .withFields({
+                    C2F(mMaxSize, width).inRange(2, 4096, 2),
+                    C2F(mMaxSize, height).inRange(2, 4096, 2),
+                })
+                .withSetter(MaxSizeSetter, mSize)
+                .build());
+
+        addSnapshotParameters({ mSize, mMaxSize });
+    }
+
+    static C2R SizeSetter(bool mayBlock, C2P<C2StreamPictureSizeInfo::output> &me) {
+        (void)mayBlock;
+        (void)me;
+        return C2R::Ok();
+    }
+
+    static C2R MaxSizeSetter(bool mayBlock, C2P<C2StreamMaxPictureSizeTuning::output> &me,
+                             const C2P<C2StreamPictureSizeInfo::output> &size) {
+        (void)mayBlock;
+        me.set().width = std::max(me.v.width, size.v.width);
+        me.set().height = std::max(me.v.height, size.v.height);
+        return C2R::Ok();
+    }
+
+    std::shared_ptr<C2StreamPictureSizeInfo::output> mSize;
+    std::shared_ptr<C2StreamMaxPictureSizeTuning::output> mMaxSize;
+    std::shared_ptr<C2StreamColorAspectsInfo::output> mNotAdded;
+};
+
+}  // namespace
+
+TEST_F(C2CompIntfTest, SnapshotFollowsConfig) {
+    SnapshotIntf intf;
+    std::shared_ptr<const C2InterfaceHelper::Snapshot> initial = intf.snapshot();
+    ASSERT_TRUE(initial->get(intf.mSize));
+    EXPECT_EQ(320u, initial->get(intf.mSize)->width);
+    EXPECT_FALSE(initial->get(intf.mNotAdded));
+
+    C2StreamPictureSizeInfo::output size(0u, 640, 480);
+    std::vector<std::unique_ptr<C2SettingResult>> failures;
+    ASSERT_EQ(C2_OK, intf.config({ &size }, C2_MAY_BLOCK, &failures));
+
+    std::shared_ptr<const C2InterfaceHelper::Snapshot> updated = intf.snapshot();
+    EXPECT_GT(updated->version(), initial->version());
+    EXPECT_EQ(640u, updated->get(intf.mSize)->width);
+    // dependent parameters are part of the same snapshot
+    EXPECT_EQ(640u, updated->get(intf.mMaxSize)->width);
+    // older snapshots are not modified
+    EXPECT_EQ(320u, initial->get(intf.mSize)->width);
+
+    // an unchanged value does not publish a new snapshot
+    ASSERT_EQ(C2_OK, intf.config({ &size }, C2_MAY_BLOCK, &failures));
+    EXPECT_EQ(updated->version(), intf.snapshot()->version());
+}
+
+TEST_F(C2CompIntfTest, SnapshotIsConsistentUnderConfig) {
+    SnapshotIntf intf;
+    std::atomic<bool> done(false);
+    std::thread writer([&intf, &done] {
+        for (uint32_t i = 1; i <= 10000; ++i) {
+            C2StreamPictureSizeInfo::output size(0u, 2 * i, 2 * i);
+            std::vector<std::unique_ptr<C2SettingResult>> failures;
+            (void)intf.config({ &size }, C2_MAY_BLOCK, &failures);
+        }
+        done = true;
+    });
+    uint32_t lastVersion = 0;
+    while (!done) {
+        std::shared_ptr<const C2InterfaceHelper::Snapshot> snapshot = intf.snapshot();
+        ASSERT_GE(snapshot->version(), lastVersion);
+        lastVersion = snapshot->version();
+        std::shared_ptr<C2StreamPictureSizeInfo::output> size = snapshot->get(intf.mSize);
+        std::shared_ptr<C2StreamMaxPictureSizeTuning::output> maxSize =
+            snapshot->get(intf.mMaxSize);
+        ASSERT_GE(maxSize->width, size->width);
+        ASSERT_EQ(size->width, size->height);
+    }
+    writer.join();
+}
+
+namespace {
+
+class DuplicateIntf : public C2InterfaceHelper {
+public:
+    DuplicateIntf() : C2InterfaceHelper(std::make_shared<C2ReflectorHelper>()) {
+        setDerivedInstance(this);
+
+        addParameter(
+                DefineParam(mSize, C2_PARAMKEY_PICTURE_SIZE)
+                .withConstValue(new C2StreamPictureSizeInfo::output(0u, 320, 240))
+                .build());
+
+        // same index as mSize
+        addParameter(
+                DefineParam(mDuplicate, C2_PARAMKEY_PICTURE_SIZE)
+                .withConstValue(new C2StreamPictureSizeInfo::output(0u, 640, 480))
+                .build());
+    }
+
+    std::shared_ptr<C2StreamPictureSizeInfo::output> mSize;
+    std::shared_ptr<C2StreamPictureSizeInfo::output> mDuplicate;
+};
+
+}  // namespace
+
+TEST_F(C2CompIntfTest, IgnoresParamsWithDuplicateIndex) {
+    DuplicateIntf intf;
+    std::vector<std::shared_ptr<C2ParamDescriptor>> descriptors;
+    ASSERT_EQ(C2_OK, intf.querySupportedParams(&descriptors));
+    ASSERT_EQ(1u, descriptors.size());
+
+    C2StreamPictureSizeInfo::output size(0u);
+    ASSERT_EQ(C2_OK, intf.query({ &size }, {}, C2_MAY_BLOCK, nullptr));
+    EXPECT_EQ(320u, size.width);
+    EXPECT_EQ(240u, size.height);
+}
+
 } // namespace android
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <android-base/file.h>
+
+#include <C2Component.h>
+#include <C2PlatformSupport.h>
+#include <util/C2ComponentTraitsCache.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+namespace android {
+
+namespace {
+
+std::shared_ptr<C2Component::Traits> MakeTraits(const std::string &name) {
+    std::shared_ptr<C2Component::Traits> traits = std::make_shared<C2Component::Traits>();
+    traits->name = name;
+    traits->domain = C2Component::DOMAIN_VIDEO;
+    traits->kind = C2Component::KIND_DECODER;
+    traits->rank = 0x200;
+    traits->mediaType = "video/avc";
+    return traits;
+}
+
+void WriteFile(const std::string &path, const std::string &contents) {
+    std::ofstream os(path, std::ios::trunc);
+    os << contents;
+}
+
+}  // namespace
+
+class C2ComponentTraitsCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mCachePath = std::string(mDir.path) + "/traits.cache";
+        mLibPath = std::string(mDir.path) + "/libfake.so";
+        WriteFile(mLibPath, "ELF");
+    }
+
+    TemporaryDir mDir;
+    std::string mCachePath;
+    std::string mLibPath;
+};
+
+TEST_F(C2ComponentTraitsCacheTest, RoundTrip) {
+    {
+        C2ComponentTraitsCache cache(mCachePath);
+        EXPECT_FALSE(cache.load());
+        EXPECT_EQ(nullptr, cache.find("c2.fake.decoder", mLibPath));
+        cache.put("c2.fake.decoder", mLibPath, MakeTraits("c2.fake.decoder"));
+        cache.put("OMX.fake.decoder", mLibPath, MakeTraits("OMX.fake.decoder"));
+        ASSERT_TRUE(cache.save());
+    }
+
+    C2ComponentTraitsCache cache(mCachePath);
+    ASSERT_TRUE(cache.load());
+    std::shared_ptr<const C2Component::Traits> traits = cache.find("c2.fake.decoder", mLibPath);
+    ASSERT_NE(nullptr, traits);
+    EXPECT_EQ("c2.fake.decoder", traits->name);
+    EXPECT_EQ(C2Component::DOMAIN_VIDEO, traits->domain);
+    EXPECT_EQ(C2Component::KIND_DECODER, traits->kind);
+    EXPECT_EQ(0x200u, traits->rank);
+    EXPECT_EQ("video/avc", traits->mediaType);
+    ASSERT_NE(nullptr, cache.find("OMX.fake.decoder", mLibPath));
+
+    // entries are keyed by the library path
+    EXPECT_EQ(nullptr, cache.find("c2.fake.decoder", mLibPath + ".old"));
+}
+
+TEST_F(C2ComponentTraitsCacheTest, InvalidatedByLibraryChange) {
+    {
+        C2ComponentTraitsCache cache(mCachePath);
+        cache.put("c2.fake.decoder", mLibPath, MakeTraits("c2.fake.decoder"));
+        ASSERT_TRUE(cache.save());
+    }
+    WriteFile(mLibPath, "ELF, but updated");
+
+    C2ComponentTraitsCache cache(mCachePath);
+    ASSERT_TRUE(cache.load());
+    EXPECT_EQ(nullptr, cache.find("c2.fake.decoder", mLibPath));
+}
+
+TEST_F(C2ComponentTraitsCacheTest, IgnoresCorruptedFile) {
+    WriteFile(mCachePath, "C2ComponentTraitsCache 0 fingerprint\nnot\ta\tvalid\tentry\n");
+    C2ComponentTraitsCache cache(mCachePath);
+    EXPECT_FALSE(cache.load());
+    EXPECT_EQ(nullptr, cache.find("not", "a"));
+}
+
+TEST_F(C2ComponentTraitsCacheTest, ListComponentsStartup) {
+    std::shared_ptr<C2ComponentStore> store = GetCodec2PlatformComponentStore();
+    std::vector<std::shared_ptr<const C2Component::Traits>> list = store->listComponents();
+    ASSERT_FALSE(list.empty());
+
+    // Cost of deriving the traits without a cache: load each module and query its interface.
+    // Libraries stay mapped after the first load, so this underestimates a true cold start.
+    auto start = std::chrono::steady_clock::now();
+    for (const std::shared_ptr<const C2Component::Traits> &traits : list) {
+        std::shared_ptr<C2ComponentInterface> intf;
+        ASSERT_EQ(C2_OK, store->createInterface(traits->name, &intf));
+        std::vector<std::unique_ptr<C2Param>> params;
+        (void)intf->query_vb({}, { C2PortMimeConfig::input::PARAM_TYPE }, C2_MAY_BLOCK, &params);
+    }
+    std::chrono::duration<double, std::milli> loaded = std::chrono::steady_clock::now() - start;
+
+    {
+        C2ComponentTraitsCache cache(mCachePath);
+        for (const std::shared_ptr<const C2Component::Traits> &traits : list) {
+            cache.put(traits->name, "lib" + traits->name + ".so", traits);
+        }
+        ASSERT_TRUE(cache.save());
+    }
+
+    // Cost of listing from a warm cache: read the file and validate every entry.
+    start = std::chrono::steady_clock::now();
+    C2ComponentTraitsCache cache(mCachePath);
+    ASSERT_TRUE(cache.load());
+    for (const std::shared_ptr<const C2Component::Traits> &traits : list) {
+        ASSERT_NE(nullptr, cache.find(traits->name, "lib" + traits->name + ".so"));
+    }
+    std::chrono::duration<double, std::milli> cached = std::chrono::steady_clock::now() - start;
+
+    std::cout << list.size() << " components: "
+              << loaded.count() << " ms loading modules, "
+              << cached.count() << " ms from traits cache" << std::endl;
+}
+
+} // namespace android
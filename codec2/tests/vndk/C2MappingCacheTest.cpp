@@ -0,0 +1,177 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <util/C2MappingCache.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace android {
+
+namespace {
+
+// memfd stands in for an ion buffer; both are mapped through their fd.
+int CreateBuffer(size_t size) {
+    int fd = syscall(__NR_memfd_create, "C2MappingCacheTest", 0);
+    if (fd >= 0 && ftruncate(fd, size) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+}  // namespace
+
+class C2MappingCacheTest : public ::testing::Test {
+protected:
+    static constexpr size_t kCapacity = 1 << 20;
+
+    void SetUp() override {
+        C2MappingCache::SetLimit(32 << 20);
+    }
+
+    void TearDown() override {
+        mCaches.clear();
+        for (int fd : mFds) {
+            close(fd);
+        }
+        C2MappingCache::SetLimit(32 << 20);
+    }
+
+    C2MappingCache *createCache() {
+        int fd = CreateBuffer(kCapacity);
+        EXPECT_GE(fd, 0);
+        mFds.push_back(fd);
+        mCaches.emplace_back(new C2MappingCache(fd, kCapacity));
+        return mCaches.back().get();
+    }
+
+    std::vector<int> mFds;
+    std::vector<std::unique_ptr<C2MappingCache>> mCaches;
+};
+
+constexpr size_t C2MappingCacheTest::kCapacity;
+
+TEST_F(C2MappingCacheTest, PartialRangeMaps) {
+    C2MappingCache *cache = createCache();
+    void *rw;
+    ASSERT_EQ(C2_OK, cache->map(100, 10, PROT_READ | PROT_WRITE, &rw));
+    memcpy(rw, "codec2", 6);
+
+    // a read-only map of an overlapping range sees the same data
+    void *ro;
+    ASSERT_EQ(C2_OK, cache->map(102, 4, PROT_READ, &ro));
+    EXPECT_EQ(0, memcmp(ro, "dec2", 4));
+
+    // ranges must be unmapped exactly as they were mapped
+    EXPECT_EQ(C2_BAD_VALUE, cache->unmap(rw, 11));
+    EXPECT_EQ(C2_OK, cache->unmap(rw, 10));
+    EXPECT_EQ(C2_BAD_VALUE, cache->unmap(rw, 10));
+    EXPECT_EQ(C2_OK, cache->unmap(ro, 4));
+
+    void *addr;
+    EXPECT_EQ(C2_BAD_VALUE, cache->map(0, 0, PROT_READ, &addr));
+    EXPECT_EQ(C2_BAD_VALUE, cache->map(kCapacity - 1, 2, PROT_READ, &addr));
+    EXPECT_EQ(nullptr, addr);
+}
+
+TEST_F(C2MappingCacheTest, ReusesIdleMappings) {
+    C2MappingCache *cache = createCache();
+    C2MappingCache::Stats before = C2MappingCache::GetStats();
+    for (int i = 0; i < 100; ++i) {
+        void *addr;
+        ASSERT_EQ(C2_OK, cache->map(4096, 8192, PROT_READ | PROT_WRITE, &addr));
+        ASSERT_EQ(C2_OK, cache->unmap(addr, 8192));
+    }
+    C2MappingCache::Stats after = C2MappingCache::GetStats();
+    EXPECT_EQ(100u, after.maps - before.maps);
+    EXPECT_EQ(1u, after.mmaps - before.mmaps);
+    EXPECT_EQ(kCapacity, after.idleBytes - before.idleBytes);
+
+    mCaches.clear();
+    after = C2MappingCache::GetStats();
+    EXPECT_EQ(before.idleBytes, after.idleBytes);
+    EXPECT_EQ(after.mmaps - before.mmaps, after.munmaps - before.munmaps);
+}
+
+TEST_F(C2MappingCacheTest, UnmapsLeastRecentlyUsedBeyondLimit) {
+    C2MappingCache::SetLimit(2 * kCapacity);
+    std::vector<C2MappingCache *> caches;
+    for (int i = 0; i < 3; ++i) {
+        caches.push_back(createCache());
+    }
+    C2MappingCache::Stats before = C2MappingCache::GetStats();
+    for (C2MappingCache *cache : caches) {
+        void *addr;
+        ASSERT_EQ(C2_OK, cache->map(0, kCapacity, PROT_READ, &addr));
+        ASSERT_EQ(C2_OK, cache->unmap(addr, kCapacity));
+    }
+    C2MappingCache::Stats after = C2MappingCache::GetStats();
+    EXPECT_EQ(1u, after.munmaps - before.munmaps);
+    EXPECT_EQ(2 * kCapacity, after.idleBytes);
+
+    // the first mapping was evicted; the last two are still cached
+    void *addr;
+    ASSERT_EQ(C2_OK, caches[2]->map(0, kCapacity, PROT_READ, &addr));
+    ASSERT_EQ(C2_OK, caches[2]->unmap(addr, kCapacity));
+    ASSERT_EQ(C2_OK, caches[0]->map(0, kCapacity, PROT_READ, &addr));
+    ASSERT_EQ(C2_OK, caches[0]->unmap(addr, kCapacity));
+    C2MappingCache::Stats last = C2MappingCache::GetStats();
+    EXPECT_EQ(1u, last.mmaps - after.mmaps);
+
+    // a limit of 0 unmaps idle mappings right away
+    C2MappingCache::SetLimit(0);
+    EXPECT_EQ(0u, C2MappingCache::GetStats().idleBytes);
+}
+
+TEST_F(C2MappingCacheTest, MapCostPerFrame) {
+    constexpr int kFrames = 10000;
+    C2MappingCache *cache = createCache();
+    int fd = mFds.back();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kFrames; ++i) {
+        void *addr = mmap(nullptr, kCapacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ASSERT_NE(MAP_FAILED, addr);
+        ((volatile uint8_t *)addr)[i % kCapacity] = i;
+        munmap(addr, kCapacity);
+    }
+    std::chrono::duration<double, std::micro> uncached = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kFrames; ++i) {
+        void *addr;
+        ASSERT_EQ(C2_OK, cache->map(0, kCapacity, PROT_READ | PROT_WRITE, &addr));
+        ((volatile uint8_t *)addr)[i % kCapacity] = i;
+        ASSERT_EQ(C2_OK, cache->unmap(addr, kCapacity));
+    }
+    std::chrono::duration<double, std::micro> cached = std::chrono::steady_clock::now() - start;
+
+    std::cout << "map/unmap per frame: " << uncached.count() / kFrames << " us uncached, "
+              << cached.count() / kFrames << " us cached" << std::endl;
+    EXPECT_LT(cached.count(), uncached.count());
+}
+
+} // namespace android
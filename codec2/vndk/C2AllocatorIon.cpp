@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include <list>
+#include <memory>
 
 #include <ion/ion.h>
 #include <sys/mman.h>
@@ -28,6 +29,7 @@
 #include <C2Buffer.h>
 #include <C2Debug.h>
 #include <C2ErrnoUtils.h>
+#include <util/C2MappingCache.h>
 
 namespace android {
 
@@ -167,9 +169,10 @@ private:
           mHandle(bufferFd, capacity),
           mBuffer(buffer),
           mId(id),
-          mInit(c2_map_errno<ENOMEM, EACCES, EINVAL>(err)),
-          mMapFd(-1) {
-        if (mInit != C2_OK) {
+          mInit(c2_map_errno<ENOMEM, EACCES, EINVAL>(err)) {
+        if (mInit == C2_OK) {
+            mMappingCache = std::make_unique<C2MappingCache>(bufferFd, capacity);
+        } else {
             // close ionFd now on error
             if (mIonFd >= 0) {
                 close(mIonFd);
@@ -231,100 +234,43 @@ public:
     c2_status_t map(size_t offset, size_t size, C2MemoryUsage usage, C2Fence *fence, void **addr) {
         (void)fence; // TODO: wait for fence
         *addr = nullptr;
-        if (!mMappings.empty()) {
-            ALOGV("multiple map");
-            // TODO: technically we should return DUPLICATE here, but our block views don't
-            // actually unmap, so we end up remapping an ion buffer multiple times.
-            //
-            // return C2_DUPLICATE;
-        }
-        if (size == 0) {
-            return C2_BAD_VALUE;
+        if (mInit != C2_OK) {
+            return mInit;
         }
 
         int prot = PROT_NONE;
-        int flags = MAP_SHARED;
         if (usage.expected & C2MemoryUsage::CPU_READ) {
             prot |= PROT_READ;
         }
         if (usage.expected & C2MemoryUsage::CPU_WRITE) {
             prot |= PROT_WRITE;
         }
-
-        size_t alignmentBytes = offset % PAGE_SIZE;
-        size_t mapOffset = offset - alignmentBytes;
-        size_t mapSize = size + alignmentBytes;
-        Mapping map = { nullptr, alignmentBytes, mapSize };
-
-        c2_status_t err = C2_OK;
-        if (mMapFd == -1) {
-            int ret = ion_map(mIonFd, mBuffer, mapSize, prot,
-                              flags, mapOffset, (unsigned char**)&map.addr, &mMapFd);
-            ALOGV("ion_map(ionFd = %d, handle = %d, size = %zu, prot = %d, flags = %d, "
-                  "offset = %zu) returned (%d)",
-                  mIonFd, mBuffer, mapSize, prot, flags, mapOffset, ret);
-            if (ret) {
-                mMapFd = -1;
-                map.addr = *addr = nullptr;
-                err = c2_map_errno<EINVAL>(-ret);
-            } else {
-                *addr = (uint8_t *)map.addr + alignmentBytes;
-            }
-        } else {
-            map.addr = mmap(nullptr, mapSize, prot, flags, mMapFd, mapOffset);
-            ALOGV("mmap(size = %zu, prot = %d, flags = %d, mapFd = %d, offset = %zu) "
-                  "returned (%d)",
-                  mapSize, prot, flags, mMapFd, mapOffset, errno);
-            if (map.addr == MAP_FAILED) {
-                map.addr = *addr = nullptr;
-                err = c2_map_errno<EINVAL>(errno);
-            } else {
-                *addr = (uint8_t *)map.addr + alignmentBytes;
-            }
-        }
-        if (map.addr) {
-            mMappings.push_back(map);
-        }
+        // The whole buffer is mapped through the shared buffer fd, which is what ion_map() would
+        // map, and the mapping is kept for later maps of this allocation.
+        c2_status_t err = mMappingCache->map(offset, size, prot, addr);
+        ALOGV("map(buffer = %d, offset = %zu, size = %zu, prot = %d) returned (%d)",
+              mBuffer, offset, size, prot, err);
         return err;
     }
 
     c2_status_t unmap(void *addr, size_t size, C2Fence *fence) {
-        if (mMapFd < 0 || mMappings.empty()) {
+        if (mInit != C2_OK) {
             ALOGD("tried to unmap unmapped buffer");
             return C2_NOT_FOUND;
         }
-        for (auto it = mMappings.begin(); it != mMappings.end(); ++it) {
-            if (addr != (uint8_t *)it->addr + it->alignmentBytes ||
-                    size + it->alignmentBytes != it->size) {
-                continue;
-            }
-            int err = munmap(it->addr, it->size);
-            if (err != 0) {
-                ALOGD("munmap failed");
-                return c2_map_errno<EINVAL>(errno);
-            }
+        c2_status_t err = mMappingCache->unmap(addr, size);
+        if (err == C2_OK) {
             if (fence) {
                 *fence = C2Fence(); // not using fences
             }
-            (void)mMappings.erase(it);
             ALOGV("successfully unmapped: %d", mBuffer);
-            return C2_OK;
         }
-        ALOGD("unmap failed to find specified map");
-        return C2_BAD_VALUE;
+        return err;
     }
 
     ~Impl() {
-        if (!mMappings.empty()) {
-            ALOGD("Dangling mappings!");
-            for (const Mapping &map : mMappings) {
-                (void)munmap(map.addr, map.size);
-            }
-        }
-        if (mMapFd >= 0) {
-            close(mMapFd);
-            mMapFd = -1;
-        }
+        // unmap before the buffer fd is closed
+        mMappingCache.reset();
         if (mInit == C2_OK) {
             (void)ion_free(mIonFd, mBuffer);
             native_handle_close(&mHandle);
@@ -356,13 +302,7 @@ private:
     ion_user_handle_t mBuffer;
     C2Allocator::id_t mId;
     c2_status_t mInit;
-    int mMapFd; // only one for now
-    struct Mapping {
-        void *addr;
-        size_t alignmentBytes;
-        size_t size;
-    };
-    std::list<Mapping> mMappings;
+    std::unique_ptr<C2MappingCache> mMappingCache; // only if mInit is C2_OK
 };
 
 c2_status_t C2AllocationIon::map(
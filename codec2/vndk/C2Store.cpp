@@ -26,14 +26,21 @@
 #include <C2Config.h>
 #include <C2PlatformStorePluginLoader.h>
 #include <C2PlatformSupport.h>
+#include <util/C2ComponentTraitsCache.h>
 #include <util/C2InterfaceHelper.h>
 
+#include <cutils/properties.h>
 #include <dlfcn.h>
 #include <unistd.h> // getpagesize
+#include <utils/Timers.h>
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <set>
+#include <thread>
 
 namespace android {
 
@@ -479,9 +486,6 @@ private:
 
     /**
      * An object encapsulating a loaded component module.
-     *
-     * \todo provide a way to add traits to known components here to avoid loading the .so-s
-     * for listComponents
      */
     struct ComponentModule : public C2ComponentFactory,
             public std::enable_shared_from_this<ComponentModule> {
@@ -493,7 +497,8 @@ private:
                 InterfaceDeleter deleter = std::default_delete<C2ComponentInterface>()) override;
 
         /**
-         * \returns the traits of the component in this module.
+         * \returns the traits of the component in this module, named after the component
+         *          interface.
          */
         std::shared_ptr<const C2Component::Traits> getTraits();
 
@@ -502,7 +507,7 @@ private:
          *
          * \param name[in]  component name.
          *
-         * \note Only used by ComponentLoader.
+         * \note Only used by ModuleLoader.
          */
         ComponentModule()
             : mInit(C2_NO_INIT),
@@ -515,9 +520,8 @@ private:
         /**
          * Initializes a component module with a given library path. Must be called exactly once.
          *
-         * \note Only used by ComponentLoader.
+         * \note Only used by ModuleLoader.
          *
-         * \param alias[in]   module alias
          * \param libPath[in] library path
          *
          * \retval C2_OK        the component module has been successfully loaded
@@ -527,7 +531,7 @@ private:
          * \retval C2_REFUSED   permission denied to load the component module (unexpected)
          * \retval C2_TIMED_OUT could not load the module within the time limit (unexpected)
          */
-        c2_status_t init(std::string alias, std::string libPath);
+        c2_status_t init(std::string libPath);
 
         virtual ~ComponentModule() override;
 
@@ -544,11 +548,9 @@ private:
     };
 
     /**
-     * An object encapsulating a loadable component module.
-     *
-     * \todo make this also work for enumerations
+     * An object encapsulating a loadable component module. Shared by all aliases of the module.
      */
-    struct ComponentLoader {
+    struct ModuleLoader {
         /**
          * Load the component module.
          *
@@ -569,27 +571,126 @@ private:
             std::lock_guard<std::mutex> lock(mMutex);
             std::shared_ptr<ComponentModule> localModule = mModule.lock();
             if (localModule == nullptr) {
+                int64_t startNs = systemTime();
                 localModule = std::make_shared<ComponentModule>();
-                res = localModule->init(mAlias, mLibPath);
+                res = localModule->init(mLibPath);
                 if (res == C2_OK) {
                     mModule = localModule;
                 }
+                mLoadTimeUs = (systemTime() - startNs) / 1000;
+                ALOGV("loaded %s in %lld us", mLibPath.c_str(), (long long)mLoadTimeUs);
             }
             *module = localModule;
             return res;
         }
 
         /**
-         * Creates a component loader for a specific library path (or name).
+         * \return the time the last load of the module took, or 0 if it has not been loaded.
          */
-        ComponentLoader(std::string alias, std::string libPath)
-            : mAlias(alias), mLibPath(libPath) {}
+        int64_t loadTimeUs() {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mLoadTimeUs;
+        }
+
+        const std::string &libPath() const {
+            return mLibPath;
+        }
+
+        /**
+         * Creates a module loader for a specific library path (or name).
+         */
+        explicit ModuleLoader(std::string libPath)
+            : mLibPath(libPath), mLoadTimeUs(0) {}
 
     private:
         std::mutex mMutex; ///< mutex guarding the module
         std::weak_ptr<ComponentModule> mModule; ///< weak reference to the loaded module
+        const std::string mLibPath; ///< library path
+        int64_t mLoadTimeUs; ///< duration of the last load
+    };
+
+    /**
+     * An object encapsulating a component alias of a loadable component module.
+     *
+     * \todo make this also work for enumerations
+     */
+    struct ComponentLoader {
+        /**
+         * Load the component module. See ModuleLoader::fetchModule().
+         */
+        c2_status_t fetchModule(std::shared_ptr<ComponentModule> *module) {
+            return mModuleLoader->fetchModule(module);
+        }
+
+        /**
+         * Retrieves the traits of the component.
+         *
+         * The traits are taken from |cache| if they are cached there, so that listing components
+         * does not need to load the component module. Otherwise the module is loaded, and its
+         * traits are added to |cache|.
+         *
+         * \param cache[in,out] traits cache
+         * \param traits[out]   the component traits. This will be nullptr on error.
+         *
+         * \retval C2_OK        the component traits have been successfully retrieved
+         * \retval C2_NO_MEMORY not enough memory to loading the component module
+         * \retval C2_NOT_FOUND could not locate the component module
+         * \retval C2_CORRUPTED the component module could not be loaded
+         * \retval C2_REFUSED   permission denied to load the component module
+         */
+        c2_status_t fetchTraits(
+                C2ComponentTraitsCache *cache,
+                std::shared_ptr<const C2Component::Traits> *traits) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mTraits) {
+                mTraits = cache->find(mAlias, mModuleLoader->libPath());
+            }
+            if (!mTraits) {
+                std::shared_ptr<ComponentModule> module;
+                c2_status_t res = mModuleLoader->fetchModule(&module);
+                if (res != C2_OK) {
+                    traits->reset();
+                    return res;
+                }
+                std::shared_ptr<const C2Component::Traits> moduleTraits = module->getTraits();
+                if (moduleTraits) {
+                    if (mAlias != moduleTraits->name) {
+                        ALOGV("%s is alias to %s", mAlias.c_str(), moduleTraits->name.c_str());
+                    }
+                    std::shared_ptr<C2Component::Traits> aliasTraits =
+                        std::make_shared<C2Component::Traits>(*moduleTraits);
+                    aliasTraits->name = mAlias;
+                    mTraits = aliasTraits;
+                    cache->put(mAlias, mModuleLoader->libPath(), mTraits);
+                }
+            }
+            *traits = mTraits;
+            return C2_OK;
+        }
+
+        /**
+         * \return whether the traits of the component are known without loading the module.
+         */
+        bool hasTraits(const C2ComponentTraitsCache &cache) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mTraits || cache.find(mAlias, mModuleLoader->libPath());
+        }
+
+        const std::shared_ptr<ModuleLoader> &moduleLoader() const {
+            return mModuleLoader;
+        }
+
+        /**
+         * Creates a component loader for an alias of a module.
+         */
+        ComponentLoader(std::string alias, std::shared_ptr<ModuleLoader> moduleLoader)
+            : mAlias(alias), mModuleLoader(moduleLoader) {}
+
+    private:
+        std::mutex mMutex; ///< mutex guarding the traits
         std::string mAlias; ///< component alias
-        std::string mLibPath; ///< library path
+        std::shared_ptr<ModuleLoader> mModuleLoader; ///< loader of the module
+        std::shared_ptr<const C2Component::Traits> mTraits; ///< component traits, once known
     };
 
     struct Interface : public C2InterfaceHelper {
@@ -642,14 +743,26 @@ private:
      */
     c2_status_t findComponent(C2String name, ComponentLoader **loader);
 
+    /**
+     * Loads the modules of all components whose traits are not cached, once per library and
+     * concurrently on a bounded number of threads.
+     *
+     * \param modules[out] the loaded modules. These must be held while fetching the traits so
+     *                     that aliases of the same library share the loaded module.
+     */
+    void loadModules_l(std::vector<std::shared_ptr<ComponentModule>> *modules);
+
+    std::map<C2String, std::shared_ptr<ModuleLoader>> mModules; ///< map of library -> modules
     std::map<C2String, ComponentLoader> mComponents; ///< map of name -> components
     std::vector<C2String> mComponentsList; ///< list of components
     std::shared_ptr<C2ReflectorHelper> mReflector;
     Interface mInterface;
+
+    std::mutex mTraitsCacheMutex; ///< mutex guarding the traits cache
+    std::unique_ptr<C2ComponentTraitsCache> mTraitsCache; ///< traits cache, loaded on first use
 };
 
-c2_status_t C2PlatformComponentStore::ComponentModule::init(
-        std::string alias, std::string libPath) {
+c2_status_t C2PlatformComponentStore::ComponentModule::init(std::string libPath) {
     ALOGV("in %s", __func__);
     ALOGV("loading dll");
     mLibHandle = dlopen(libPath.c_str(), RTLD_NOW|RTLD_NODELETE);
@@ -684,10 +797,7 @@ c2_status_t C2PlatformComponentStore::ComponentModule::init(
 
     std::shared_ptr<C2Component::Traits> traits(new (std::nothrow) C2Component::Traits);
     if (traits) {
-        if (alias != intf->getName()) {
-            ALOGV("%s is alias to %s", alias.c_str(), intf->getName().c_str());
-        }
-        traits->name = alias;
+        traits->name = intf->getName();
         // TODO: get this from interface properly.
         bool encoder = (traits->name.find("encoder") != std::string::npos);
         uint32_t mediaTypeIndex = encoder ? C2PortMimeConfig::output::PARAM_TYPE
@@ -787,6 +897,10 @@ C2PlatformComponentStore::C2PlatformComponentStore()
       mInterface(mReflector) {
 
     auto emplace = [this](const char *alias, const char *libPath) {
+        std::shared_ptr<ModuleLoader> &moduleLoader = mModules[libPath];
+        if (!moduleLoader) {
+            moduleLoader = std::make_shared<ModuleLoader>(libPath);
+        }
         // ComponentLoader is neither copiable nor movable, so it must be
         // constructed in-place. Now ComponentLoader takes two arguments in
         // constructor, so we need to use piecewise_construct to achieve this
@@ -794,7 +908,7 @@ C2PlatformComponentStore::C2PlatformComponentStore()
         mComponents.emplace(
                 std::piecewise_construct,
                 std::forward_as_tuple(alias),
-                std::forward_as_tuple(alias, libPath));
+                std::forward_as_tuple(alias, moduleLoader));
         mComponentsList.emplace_back(alias);
     };
     // TODO: move this also into a .so so it can be updated
@@ -881,21 +995,73 @@ c2_status_t C2PlatformComponentStore::config_sm(
 
 std::vector<std::shared_ptr<const C2Component::Traits>> C2PlatformComponentStore::listComponents() {
     // This method SHALL return within 500ms.
+    std::lock_guard<std::mutex> lock(mTraitsCacheMutex);
+    if (!mTraitsCache) {
+        mTraitsCache.reset(new C2ComponentTraitsCache(C2ComponentTraitsCache::DefaultPath()));
+        (void)mTraitsCache->load();
+    }
+    std::vector<std::shared_ptr<ComponentModule>> modules;
+    loadModules_l(&modules);
     std::vector<std::shared_ptr<const C2Component::Traits>> list;
     for (const C2String &alias : mComponentsList) {
         ComponentLoader &loader = mComponents.at(alias);
-        std::shared_ptr<ComponentModule> module;
-        c2_status_t res = loader.fetchModule(&module);
-        if (res == C2_OK) {
-            std::shared_ptr<const C2Component::Traits> traits = module->getTraits();
-            if (traits) {
-                list.push_back(traits);
-            }
+        std::shared_ptr<const C2Component::Traits> traits;
+        c2_status_t res = loader.fetchTraits(mTraitsCache.get(), &traits);
+        if (res == C2_OK && traits) {
+            list.push_back(traits);
         }
     }
+    (void)mTraitsCache->save();
     return list;
 }
 
+void C2PlatformComponentStore::loadModules_l(
+        std::vector<std::shared_ptr<ComponentModule>> *modules) {
+    std::vector<std::shared_ptr<ModuleLoader>> loaders;
+    std::set<ModuleLoader *> seen;
+    for (const C2String &alias : mComponentsList) {
+        ComponentLoader &loader = mComponents.at(alias);
+        if (!loader.hasTraits(*mTraitsCache)
+                && seen.insert(loader.moduleLoader().get()).second) {
+            loaders.push_back(loader.moduleLoader());
+        }
+    }
+    if (loaders.empty()) {
+        return;
+    }
+
+    // a single thread loads the modules serially on the caller's thread
+    size_t numThreads = std::min(
+            (size_t)std::max(property_get_int32("debug.stagefright.c2.store-load-threads", 4), 1),
+            loaders.size());
+    modules->resize(loaders.size());
+    std::atomic_size_t next(0);
+    auto load = [&loaders, &next, modules] {
+        for (size_t i = next++; i < loaders.size(); i = next++) {
+            (void)loaders[i]->fetchModule(&(*modules)[i]);
+        }
+    };
+    int64_t startNs = systemTime();
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; ++i) {
+        threads.emplace_back(load);
+    }
+    load();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    ALOGD("loaded %zu component modules in %lld us on %zu threads",
+            loaders.size(), (long long)(systemTime() - startNs) / 1000, numThreads);
+    std::sort(loaders.begin(), loaders.end(),
+              [](const std::shared_ptr<ModuleLoader> &a, const std::shared_ptr<ModuleLoader> &b) {
+                  return a->loadTimeUs() > b->loadTimeUs();
+              });
+    for (const std::shared_ptr<ModuleLoader> &loader : loaders) {
+        ALOGD("  %s: %lld us", loader->libPath().c_str(), (long long)loader->loadTimeUs());
+    }
+}
+
 c2_status_t C2PlatformComponentStore::findComponent(C2String name, ComponentLoader **loader) {
     *loader = nullptr;
     auto pos = mComponents.find(name);
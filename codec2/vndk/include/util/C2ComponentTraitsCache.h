@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C2UTILS_COMPONENT_TRAITS_CACHE_H_
+#define C2UTILS_COMPONENT_TRAITS_CACHE_H_
+
+#include <C2Component.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+/**
+ * On-disk cache of component traits, so that component stores can list their components without
+ * loading the component modules.
+ *
+ * The cache file is versioned by the cache format and the build fingerprint. Each entry is keyed by
+ * the component alias and the library path of the module, and is only valid while the library file
+ * has the same modification time and size as when the traits were cached.
+ *
+ * This class is not thread-safe.
+ */
+class C2ComponentTraitsCache {
+public:
+    /**
+     * Creates an empty cache backed by the file at |path|. Use an empty path for a cache that is
+     * only held in memory.
+     */
+    explicit C2ComponentTraitsCache(std::string path);
+
+    /**
+     * \return the default cache file path, which can be overridden by the
+     *         debug.stagefright.c2.traits-cache property.
+     */
+    static std::string DefaultPath();
+
+    /**
+     * Loads the cache file. The cache is left empty if the file is missing, corrupted or was
+     * written by a different build or cache version.
+     *
+     * \return true if the cache file was loaded.
+     */
+    bool load();
+
+    /**
+     * Writes the cache file if it has been modified since it was loaded or saved. The file is
+     * replaced atomically.
+     *
+     * \return true if the cache file is up to date.
+     */
+    bool save();
+
+    /**
+     * \return the cached traits for |alias| loaded from |libPath|, or nullptr if they are not
+     *         cached or the library has changed since they were cached.
+     */
+    std::shared_ptr<const C2Component::Traits> find(
+            const std::string &alias, const std::string &libPath) const;
+
+    /**
+     * Caches |traits| for |alias| loaded from |libPath|.
+     */
+    void put(const std::string &alias, const std::string &libPath,
+             const std::shared_ptr<const C2Component::Traits> &traits);
+
+private:
+    struct LibStamp {
+        int64_t mtimeNs;
+        int64_t size;
+        bool operator==(const LibStamp &other) const {
+            return mtimeNs == other.mtimeNs && size == other.size;
+        }
+    };
+
+    struct Entry {
+        std::string libPath;
+        LibStamp stamp;
+        std::shared_ptr<const C2Component::Traits> traits;
+    };
+
+    static LibStamp GetLibStamp(const std::string &libPath);
+
+    const std::string mPath;
+    std::map<std::string, Entry> mEntries; ///< map of alias -> entry
+    bool mDirty;
+};
+
+#endif  // C2UTILS_COMPONENT_TRAITS_CACHE_H_
@@ -686,6 +686,43 @@ public:
      */
     Lock lock() const;
 
+    /**
+     * Immutable, versioned set of the values of the parameters selected with
+     * addSnapshotParameters().
+     *
+     * Parameter values are copy-on-change, so a snapshot simply holds on to the current values.
+     * A new snapshot is published by every configuration that changes any parameter value.
+     */
+    class Snapshot {
+    public:
+        /// returns the version of this snapshot. This increases with every published snapshot.
+        uint32_t version() const { return mVersion; }
+
+        /**
+         * Returns the value of a parameter in this snapshot, or nullptr if the parameter is not
+         * part of snapshots. The returned value must not be modified.
+         *
+         * \param param the parameter as referenced by the interface
+         */
+        template<typename T>
+        std::shared_ptr<T> get(const std::shared_ptr<T> &param) const {
+            return std::static_pointer_cast<T>(find(&param));
+        }
+
+    private:
+        friend class C2InterfaceHelper;
+        std::shared_ptr<C2Param> find(const void *param) const;
+
+        uint32_t mVersion;
+        std::vector<std::pair<std::shared_ptr<C2Param> *, std::shared_ptr<C2Param>>> mValues;
+    };
+
+    /**
+     * Returns the latest snapshot of the parameters selected with addSnapshotParameters(). This
+     * does not lock the interface, so it can be used on the processing path instead of lock().
+     */
+    std::shared_ptr<const Snapshot> snapshot() const;
+
 private:
     void setInterfaceAddressBounds(uintptr_t start, uintptr_t end) {
         // TODO: exclude this helper
@@ -698,6 +735,9 @@ protected:
     std::shared_ptr<C2ReflectorHelper> mReflector;
     struct FactoryImpl;
     std::shared_ptr<FactoryImpl> _mFactory;
+    std::vector<ParamRef> mSnapshotParams; ///< protected by mMutex
+    uint32_t mSnapshotVersion; ///< protected by mMutex
+    std::shared_ptr<const Snapshot> mSnapshot; ///< accessed atomically
 
     C2InterfaceHelper(std::shared_ptr<C2ReflectorHelper> reflector);
 
@@ -709,6 +749,14 @@ protected:
      */
     void addParameter(std::shared_ptr<ParamHelper> param);
 
+    /**
+     * Adds parameters to the snapshots returned by snapshot(), and publishes a new snapshot. The
+     * parameters must have been added to this interface.
+     *
+     * \param params parameters to add.
+     */
+    void addSnapshotParameters(std::vector<ParamRef> params);
+
     /**
      * Returns the dependency index for a parameter.
      *
@@ -716,6 +764,11 @@ protected:
      */
     size_t getDependencyIndex_l(C2Param::Index ix) const;
 
+    /**
+     * Publishes a new snapshot of the current values of the snapshot parameters.
+     */
+    void publishSnapshot_l();
+
     virtual ~C2InterfaceHelper() = default;
 
     /**
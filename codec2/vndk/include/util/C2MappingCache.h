@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C2UTILS_MAPPING_CACHE_H_
+#define C2UTILS_MAPPING_CACHE_H_
+
+#include <C2.h>
+
+#include <sys/mman.h>
+
+#include <list>
+
+/**
+ * Memory mappings of one fd-backed linear allocation that outlive the views that use them.
+ *
+ * Instead of mapping the requested range on every map() call, the whole allocation is mapped once
+ * and map() returns a pointer into that mapping. When the last view of a mapping is unmapped, the
+ * mapping is kept for later map() calls until the allocation is destroyed, or until it is the
+ * least recently used idle mapping of the process and the idle mappings exceed the cache limit.
+ *
+ * A read-write mapping also serves read-only maps, and a read-only mapping is only created if
+ * there is no read-write one.
+ *
+ * map() and unmap() have the same contract as C2LinearAllocation::map() and unmap(): unmap() must
+ * be called with the address and size that a map() call returned and was called with.
+ *
+ * This class is thread-safe.
+ */
+class C2MappingCache {
+public:
+    /**
+     * Creates a mapping cache for the |capacity| bytes of the allocation backed by |fd|. |fd| is
+     * not owned and must stay valid until this object is destroyed.
+     */
+    C2MappingCache(int fd, size_t capacity);
+
+    /**
+     * Unmaps all mappings of the allocation, including the ones still in use.
+     */
+    ~C2MappingCache();
+
+    /**
+     * Maps |size| bytes at |offset| of the allocation with protection |prot| (a combination of
+     * PROT_READ and PROT_WRITE).
+     */
+    c2_status_t map(size_t offset, size_t size, int prot, void **addr /* nonnull */);
+
+    /**
+     * Releases a range mapped by map().
+     */
+    c2_status_t unmap(void *addr, size_t size);
+
+    /**
+     * Sets the maximum total size of the idle mappings in the process. Idle mappings beyond this
+     * are unmapped, least recently used first. With a limit of 0, mappings are unmapped as soon as
+     * they become idle.
+     *
+     * The default limit is 32 MiB and can be overridden (in KiB) by the
+     * debug.stagefright.c2.mapping-cache-kb property.
+     */
+    static void SetLimit(size_t bytes);
+
+    struct Stats {
+        size_t maps;        ///< number of map() calls that succeeded
+        size_t mmaps;       ///< number of mmap() calls
+        size_t munmaps;     ///< number of munmap() calls
+        size_t idleBytes;   ///< current total size of the idle mappings
+    };
+
+    /**
+     * \return the counters of all mapping caches of the process.
+     */
+    static Stats GetStats();
+
+private:
+    /** A mapping of the whole allocation. */
+    struct Mapping {
+        C2MappingCache *owner;
+        void *addr;
+        size_t size;
+        int prot;
+        size_t refs;
+        bool idle;
+        std::list<Mapping *>::iterator idleIt; ///< position in the idle list when idle
+    };
+
+    /** A range returned by map(). */
+    struct View {
+        void *addr;
+        size_t size;
+        Mapping *mapping;
+    };
+
+    const int mFd;
+    const size_t mCapacity;
+
+    // these are locked by the process-wide mutex
+    std::list<Mapping> mMappings;
+    std::list<View> mViews;
+
+    friend struct C2MappingCacheRegistry;
+
+    C2_DO_NOT_COPY(C2MappingCache);
+};
+
+#endif  // C2UTILS_MAPPING_CACHE_H_
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "C2ComponentTraitsCache"
+#include <utils/Log.h>
+
+#include <cutils/properties.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <util/C2ComponentTraitsCache.h>
+
+namespace {
+
+// bump this whenever the file format or the way traits are derived changes
+constexpr int kCacheVersion = 1;
+constexpr char kCacheMagic[] = "C2ComponentTraitsCache";
+// the directory is created by the init script of the HAL service; the device sepolicy must let
+// mediacodec write to it, otherwise traits are not cached (see debug.stagefright.c2.traits-cache)
+constexpr char kDefaultPath[] = "/data/vendor/media/c2_component_traits.cache";
+constexpr char kPathProperty[] = "debug.stagefright.c2.traits-cache";
+
+// directories searched for libraries given by name only, in dynamic linker order
+const char *const kLibDirs[] = {
+#ifdef __LP64__
+    "/odm/lib64/", "/vendor/lib64/", "/system/lib64/",
+#else
+    "/odm/lib/", "/vendor/lib/", "/system/lib/",
+#endif
+};
+
+// Logs a failure to write the cache file. This is only logged once per process, as it usually
+// means that the cache directory is missing or not writable, which does not change.
+void LogWriteFailure(const char *what, const std::string &path) {
+    static std::atomic_bool sLogged(false);
+    if (!sLogged.exchange(true)) {
+        ALOGW("%s traits cache at %s (%s); component traits are not cached",
+              what, path.c_str(), strerror(errno));
+    }
+}
+
+std::string GetBuildFingerprint() {
+    char fingerprint[PROPERTY_VALUE_MAX];
+    property_get("ro.build.fingerprint", fingerprint, "");
+    return fingerprint;
+}
+
+bool ParseInt64(const std::string &s, int64_t *value) {
+    if (s.empty()) {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    long long v = strtoll(s.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0') {
+        return false;
+    }
+    *value = v;
+    return true;
+}
+
+std::vector<std::string> Split(const std::string &line, char delimiter) {
+    std::vector<std::string> fields;
+    std::string field;
+    std::istringstream is(line);
+    while (std::getline(is, field, delimiter)) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+}  // namespace
+
+C2ComponentTraitsCache::C2ComponentTraitsCache(std::string path)
+    : mPath(path), mDirty(false) {
+}
+
+// static
+std::string C2ComponentTraitsCache::DefaultPath() {
+    char path[PROPERTY_VALUE_MAX];
+    property_get(kPathProperty, path, kDefaultPath);
+    return path;
+}
+
+// static
+C2ComponentTraitsCache::LibStamp C2ComponentTraitsCache::GetLibStamp(const std::string &libPath) {
+    struct stat st;
+    bool found = false;
+    if (!libPath.empty() && libPath[0] == '/') {
+        found = stat(libPath.c_str(), &st) == 0;
+    } else {
+        for (const char *dir : kLibDirs) {
+            if (stat((dir + libPath).c_str(), &st) == 0) {
+                found = true;
+                break;
+            }
+        }
+    }
+    if (!found) {
+        // rely on the build fingerprint alone
+        return { 0, 0 };
+    }
+    return { (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec, (int64_t)st.st_size };
+}
+
+bool C2ComponentTraitsCache::load() {
+    mEntries.clear();
+    mDirty = false;
+    if (mPath.empty()) {
+        return false;
+    }
+    std::ifstream is(mPath);
+    if (!is) {
+        ALOGV("no traits cache at %s", mPath.c_str());
+        return false;
+    }
+
+    std::string line;
+    std::ostringstream header;
+    header << kCacheMagic << ' ' << kCacheVersion << ' ' << GetBuildFingerprint();
+    if (!std::getline(is, line) || line != header.str()) {
+        ALOGD("ignoring stale traits cache at %s", mPath.c_str());
+        return false;
+    }
+
+    while (std::getline(is, line)) {
+        // alias, library path, mtime, size, name, domain, kind, rank, media type
+        std::vector<std::string> fields = Split(line, '\t');
+        int64_t mtimeNs, size, domain, kind, rank;
+        if (fields.size() != 9
+                || !ParseInt64(fields[2], &mtimeNs)
+                || !ParseInt64(fields[3], &size)
+                || !ParseInt64(fields[5], &domain)
+                || !ParseInt64(fields[6], &kind)
+                || !ParseInt64(fields[7], &rank)) {
+            ALOGD("ignoring corrupted traits cache at %s", mPath.c_str());
+            mEntries.clear();
+            return false;
+        }
+        std::shared_ptr<C2Component::Traits> traits = std::make_shared<C2Component::Traits>();
+        traits->name = fields[4];
+        traits->domain = (C2Component::domain_t)domain;
+        traits->kind = (C2Component::kind_t)kind;
+        traits->rank = (C2Component::rank_t)rank;
+        traits->mediaType = fields[8];
+        mEntries[fields[0]] = Entry{ fields[1], LibStamp{ mtimeNs, size }, traits };
+    }
+    ALOGV("loaded %zu traits from %s", mEntries.size(), mPath.c_str());
+    return true;
+}
+
+bool C2ComponentTraitsCache::save() {
+    if (!mDirty) {
+        return true;
+    }
+    if (mPath.empty()) {
+        return false;
+    }
+    std::string tmpPath = mPath + ".tmp";
+    {
+        std::ofstream os(tmpPath, std::ios::trunc);
+        if (!os) {
+            LogWriteFailure("cannot write", tmpPath);
+            return false;
+        }
+        os << kCacheMagic << ' ' << kCacheVersion << ' ' << GetBuildFingerprint() << '\n';
+        for (const std::pair<const std::string, Entry> &it : mEntries) {
+            const Entry &entry = it.second;
+            os << it.first << '\t' << entry.libPath << '\t'
+               << entry.stamp.mtimeNs << '\t' << entry.stamp.size << '\t'
+               << entry.traits->name << '\t'
+               << (int64_t)entry.traits->domain << '\t'
+               << (int64_t)entry.traits->kind << '\t'
+               << (int64_t)entry.traits->rank << '\t'
+               << entry.traits->mediaType << '\n';
+        }
+        os.flush();
+        if (!os) {
+            LogWriteFailure("failed to write", tmpPath);
+            (void)remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    if (rename(tmpPath.c_str(), mPath.c_str()) != 0) {
+        LogWriteFailure("failed to replace", mPath);
+        (void)remove(tmpPath.c_str());
+        return false;
+    }
+    mDirty = false;
+    return true;
+}
+
+std::shared_ptr<const C2Component::Traits> C2ComponentTraitsCache::find(
+        const std::string &alias, const std::string &libPath) const {
+    auto it = mEntries.find(alias);
+    if (it == mEntries.end() || it->second.libPath != libPath
+            || !(it->second.stamp == GetLibStamp(libPath))) {
+        return nullptr;
+    }
+    return it->second.traits;
+}
+
+void C2ComponentTraitsCache::put(
+        const std::string &alias, const std::string &libPath,
+        const std::shared_ptr<const C2Component::Traits> &traits) {
+    if (!traits) {
+        return;
+    }
+    for (const std::string *s : { &alias, &libPath, &traits->name, &traits->mediaType }) {
+        if (s->find_first_of("\t\n") != std::string::npos) {
+            ALOGD("not caching traits of %s: unsupported characters", alias.c_str());
+            return;
+        }
+    }
+    mEntries[alias] = Entry{ libPath, GetLibStamp(libPath), traits };
+    mDirty = true;
+}
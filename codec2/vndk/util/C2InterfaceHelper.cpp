@@ -20,6 +20,8 @@
 
 #include <android-base/stringprintf.h>
 
+#include <algorithm>
+
 using ::android::base::StringPrintf;
 
 /* --------------------------------- ReflectorHelper --------------------------------- */
@@ -456,11 +458,34 @@ public:
 
     virtual ~FactoryImpl() = default;
 
-    void addParam(std::shared_ptr<ParamHelper> param) {
+    /**
+     * A parameter of the interface. Slots are numbered in the order parameters are added, which is
+     * also their dependency order, so the slot number is the dependency index of the parameter.
+     */
+    struct Slot {
+        C2Param::Index index;
+        std::shared_ptr<ParamHelper> param;
+        std::vector<size_t> downDependencies; ///< slots of the down-dependencies
+        ssize_t next; ///< next slot in the same lookup bucket, or -1
+    };
+
+    /**
+     * Adds a parameter to the interface.
+     *
+     * \retval C2_OK        the parameter was added
+     * \retval C2_BAD_VALUE a parameter with the same index has already been added; the parameter
+     *                      was not added
+     */
+    c2_status_t addParam(std::shared_ptr<ParamHelper> param) {
+        if (findSlot(param->index()) >= 0) {
+            C2_LOG(ERROR) << "Parameter " << param->name() << " has the same index as an earlier "
+                    "parameter; ignoring it";
+            return C2_BAD_VALUE;
+        }
         _mParams.insert({ param->ref(), param });
-        _mIndexToHelper.insert({param->index(), param});
 
         // add down-dependencies (and validate dependencies as a result)
+        size_t slot = _mSlots.size();
         size_t ix = 0;
         for (const ParamRef &ref : param->getDependenciesAsRefs()) {
             // dependencies must already be defined
@@ -468,28 +493,36 @@ public:
                 C2_LOG(FATAL) << "Parameter " << param->name() << " has a dependency at index "
                         << ix << " that is not yet defined";
             }
-            _mParams.find(ref)->second->addDownDependency(param->index());
+            std::shared_ptr<ParamHelper> dependency = _mParams.find(ref)->second;
+            dependency->addDownDependency(param->index());
+            ssize_t dependencySlot = findSlot(dependency->index());
+            if (dependencySlot >= 0) {
+                _mSlots[dependencySlot].downDependencies.push_back(slot);
+            }
             ++ix;
         }
 
-        _mDependencyIndex.emplace(param->index(), _mDependencyIndex.size());
+        _mSlots.push_back({ param->index(), param, {}, -1 });
+        if (_mSlots.size() * 2 > _mBuckets.size()) {
+            rehash(std::max(_mBuckets.size() * 2, (size_t)16u));
+        } else {
+            link(slot);
+        }
+        return C2_OK;
     }
 
     std::shared_ptr<ParamHelper> getParam(C2Param::Index ix) const {
         // TODO: handle streams separately
-        const auto it = _mIndexToHelper.find(ix);
-        if (it == _mIndexToHelper.end()) {
-            return nullptr;
-        }
-        return it->second;
+        ssize_t slot = findSlot(ix);
+        return slot < 0 ? nullptr : _mSlots[slot].param;
     }
 
     /**
      * TODO: this could return a copy using proper pointer cast.
      */
     std::shared_ptr<C2Param> getParamValue(C2Param::Index ix) const {
-        std::shared_ptr<ParamHelper> helper = getParam(ix);
-        return helper ? helper->value() : nullptr;
+        ssize_t slot = findSlot(ix);
+        return slot < 0 ? nullptr : _mSlots[slot].param->value();
     }
 
     c2_status_t querySupportedParams(
@@ -503,24 +536,107 @@ public:
         return C2_OK;
     }
 
-    size_t getDependencyIndex(C2Param::Index ix) {
+    size_t getDependencyIndex(C2Param::Index ix) const {
         // in this version of the helper there is only a single stream so
         // we can look up directly by index
-        auto it = _mDependencyIndex.find(ix);
-        return it == _mDependencyIndex.end() ? SIZE_MAX : it->second;
+        ssize_t slot = findSlot(ix);
+        return slot < 0 ? SIZE_MAX : (size_t)slot;
+    }
+
+    const Slot &getSlot(size_t slot) const {
+        return _mSlots[slot];
+    }
+
+    size_t numSlots() const {
+        return _mSlots.size();
     }
 
 private:
+    size_t bucketOf(C2Param::Index ix) const {
+        // parameters are mostly told apart by their type index; stream and direction variants of
+        // the same type share a bucket
+        return (uint32_t)(ix.typeIndex() * 0x9E3779B1u) >> _mBucketShift;
+    }
+
+    ssize_t findSlot(C2Param::Index ix) const {
+        if (_mBuckets.empty()) {
+            return -1;
+        }
+        for (ssize_t slot = _mBuckets[bucketOf(ix)]; slot >= 0; slot = _mSlots[slot].next) {
+            if (_mSlots[slot].index == ix) {
+                return slot;
+            }
+        }
+        return -1;
+    }
+
+    void link(size_t slot) {
+        ssize_t &head = _mBuckets[bucketOf(_mSlots[slot].index)];
+        _mSlots[slot].next = head;
+        head = slot;
+    }
+
+    void rehash(size_t numBuckets) {
+        _mBuckets.assign(numBuckets, -1);
+        _mBucketShift = 32 - __builtin_ctz(numBuckets);
+        for (size_t slot = 0; slot < _mSlots.size(); ++slot) {
+            link(slot);
+        }
+    }
+
     std::map<ParamRef, std::shared_ptr<ParamHelper>> _mParams;
-    std::map<C2Param::Index, std::shared_ptr<ParamHelper>> _mIndexToHelper;
     std::shared_ptr<C2ParamReflector> _mReflector;
-    std::map<C2Param::Index, size_t> _mDependencyIndex;
+    std::vector<Slot> _mSlots; ///< parameters in dependency order
+    std::vector<ssize_t> _mBuckets; ///< first slot of each lookup bucket, or -1
+    uint32_t _mBucketShift;
 };
 
 /* --------------------------------- Helper --------------------------------- */
 
 namespace {
 
+/**
+ * Set of parameter slots with inline storage for typical interfaces, so that tracking the
+ * dependencies to update during config does not allocate.
+ */
+class SlotSet {
+public:
+    explicit SlotSet(size_t size)
+        : mNumWords((size + 63) / 64) {
+        if (mNumWords <= kInlineWords) {
+            mWords = mInline;
+            std::fill(mInline, mInline + mNumWords, 0u);
+        } else {
+            mHeap.assign(mNumWords, 0u);
+            mWords = mHeap.data();
+        }
+    }
+
+    void set(size_t i) { mWords[i / 64] |= 1ull << (i % 64); }
+    void reset(size_t i) { mWords[i / 64] &= ~(1ull << (i % 64)); }
+    bool test(size_t i) const { return mWords[i / 64] & (1ull << (i % 64)); }
+    bool empty() const { return first() == SIZE_MAX; }
+
+    /**
+     * \return the lowest slot in the set, or SIZE_MAX if the set is empty.
+     */
+    size_t first() const {
+        for (size_t w = 0; w < mNumWords; ++w) {
+            if (mWords[w]) {
+                return w * 64 + __builtin_ctzll(mWords[w]);
+            }
+        }
+        return SIZE_MAX;
+    }
+
+private:
+    static constexpr size_t kInlineWords = 4;
+    const size_t mNumWords;
+    uint64_t *mWords;
+    uint64_t mInline[kInlineWords];
+    std::vector<uint64_t> mHeap;
+};
+
 static std::string asString(C2Param *p) {
     char addr[20];
     sprintf(addr, "%p:[", p);
@@ -537,7 +653,12 @@ static std::string asString(C2Param *p) {
 
 C2InterfaceHelper::C2InterfaceHelper(std::shared_ptr<C2ReflectorHelper> reflector)
     : mReflector(reflector),
-      _mFactory(std::make_shared<FactoryImpl>(reflector)) { }
+      _mFactory(std::make_shared<FactoryImpl>(reflector)),
+      mSnapshotVersion(0u) {
+    std::shared_ptr<Snapshot> snapshot(new Snapshot);
+    snapshot->mVersion = mSnapshotVersion;
+    mSnapshot = snapshot;
+}
 
 
 size_t C2InterfaceHelper::GetBaseOffset(const std::shared_ptr<C2ParamReflector> &reflector,
@@ -577,9 +698,7 @@ void C2InterfaceHelper::addParameter(std::shared_ptr<ParamHelper> param) {
     std::lock_guard<std::mutex> lock(mMutex);
     mReflector->addStructDescriptor(param->retrieveStructDescriptor());
     c2_status_t err = param->validate(mReflector);
-    if (err != C2_CORRUPTED) {
-        _mFactory->addParam(param);
-
+    if (err != C2_CORRUPTED && _mFactory->addParam(param) == C2_OK) {
         // run setter to ensure correct values
         bool changed = false;
         std::vector<std::unique_ptr<C2SettingResult>> failures;
@@ -604,10 +723,11 @@ c2_status_t C2InterfaceHelper::config(
     // down dependencies are marked dirty, but params set are not immediately
     // marked dirty (unless they become down dependency) so that we can
     // avoid setting them if they did not change
-
-    // TODO: there could be multiple indices for the same dependency index
-    // { depIx, paramIx } may be a suitable key
-    std::map<size_t, std::pair<C2Param::Index, bool>> dependencies;
+    //
+    // dependencies are tracked by dependency index, which is also the slot of the parameter
+    SlotSet pending(_mFactory->numSlots());
+    SlotSet dirty(_mFactory->numSlots());
+    bool anyChanged = false;
 
     // we cannot determine the last valid parameter, so add an extra
     // loop iteration after the last parameter
@@ -636,32 +756,34 @@ c2_status_t C2InterfaceHelper::config(
             // first insert - mark not dirty
             // it may have been marked dirty by a dependency update
             // this does not overrwrite(!)
-            (void)dependencies.insert({ paramDepIx, { paramIx, false /* dirty */ }});
-            auto it = dependencies.find(paramDepIx);
+            pending.set(paramDepIx);
             C2_LOG(VERBOSE) << "marking dependency for setting at #" << paramDepIx << ": "
-                    << it->second.first << ", update "
-                    << (it->second.second ? "always (dirty)" : "only if changed");
+                    << paramIx << ", update "
+                    << (dirty.test(paramDepIx) ? "always (dirty)" : "only if changed");
         } else {
             // process any remaining dependencies
-            if (dependencies.empty()) {
+            if (pending.empty()) {
                 continue;
             }
             C2_LOG(VERBOSE) << "handling dirty down dependencies after last setting";
         }
 
         // process any dirtied down-dependencies until the next param
-        while (dependencies.size() && dependencies.begin()->first <= paramDepIx) {
-            auto min = dependencies.begin();
-            C2Param::Index ix = min->second.first;
-            bool dirty = min->second.second;
-            dependencies.erase(min);
-
-            std::shared_ptr<ParamHelper> param = _mFactory->getParam(ix);
+        for (size_t depIx = pending.first();
+                depIx != SIZE_MAX && depIx <= paramDepIx;
+                depIx = pending.first()) {
+            const FactoryImpl::Slot &slot = _mFactory->getSlot(depIx);
+            C2Param::Index ix = slot.index;
+            bool wasDirty = dirty.test(depIx);
+            pending.reset(depIx);
+            dirty.reset(depIx);
+
+            const std::shared_ptr<ParamHelper> &param = slot.param;
             C2_LOG(VERBOSE) << "old value " << asString(param->value().get());
             if (!last) {
                 C2_LOG(VERBOSE) << "new value " << asString(p);
             }
-            if (!last && !dirty && ix == paramIx && *param->value() == *p) {
+            if (!last && !wasDirty && ix == paramIx && *param->value() == *p) {
                 // no change in value - and dependencies were not updated
                 // no need to update
                 C2_LOG(VERBOSE) << "ignoring setting unchanged param " << ix;
@@ -697,24 +819,22 @@ c2_status_t C2InterfaceHelper::config(
             // compare ptrs as params are copy on write
             if (changed) {
                 C2_LOG(VERBOSE) << "param " << ix << " value changed";
+                anyChanged = true;
                 // value changed update down-dependencies and mark them dirty
-                for (const C2Param::Index ix : param->getDownDependencies()) {
-                    C2_LOG(VERBOSE) << 1;
-                    auto insert_res = dependencies.insert(
-                            { getDependencyIndex_l(ix), { ix, true /* dirty */ }});
-                    if (!insert_res.second) {
-                        (*insert_res.first).second.second = true; // mark dirty
-                    }
-
-                    auto it = dependencies.find(getDependencyIndex_l(ix));
-                    C2_CHECK(it->second.second);
+                for (size_t downDepIx : slot.downDependencies) {
+                    pending.set(downDepIx);
+                    dirty.set(downDepIx);
                     C2_LOG(VERBOSE) << "marking down dependencies to update at #"
-                            << getDependencyIndex_l(ix) << ": " << it->second.first;
+                            << downDepIx << ": " << _mFactory->getSlot(downDepIx).index;
                 }
             }
         }
     }
 
+    if (anyChanged && !mSnapshotParams.empty()) {
+        publishSnapshot_l();
+    }
+
     return (paramCorrupted ? C2_CORRUPTED :
             paramBlocking ? C2_BLOCKING :
             paramTimedOut ? C2_TIMED_OUT :
@@ -727,6 +847,35 @@ size_t C2InterfaceHelper::getDependencyIndex_l(C2Param::Index ix) const {
     return _mFactory->getDependencyIndex(ix);
 }
 
+void C2InterfaceHelper::addSnapshotParameters(std::vector<ParamRef> params) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSnapshotParams.insert(mSnapshotParams.end(), params.begin(), params.end());
+    publishSnapshot_l();
+}
+
+void C2InterfaceHelper::publishSnapshot_l() {
+    std::shared_ptr<Snapshot> snapshot(new Snapshot);
+    snapshot->mVersion = ++mSnapshotVersion;
+    snapshot->mValues.reserve(mSnapshotParams.size());
+    for (const ParamRef &param : mSnapshotParams) {
+        snapshot->mValues.emplace_back(param, param.get());
+    }
+    std::atomic_store(&mSnapshot, std::shared_ptr<const Snapshot>(snapshot));
+}
+
+std::shared_ptr<const C2InterfaceHelper::Snapshot> C2InterfaceHelper::snapshot() const {
+    return std::atomic_load(&mSnapshot);
+}
+
+std::shared_ptr<C2Param> C2InterfaceHelper::Snapshot::find(const void *param) const {
+    for (const std::pair<std::shared_ptr<C2Param> *, std::shared_ptr<C2Param>> &value : mValues) {
+        if ((const void *)value.first == param) {
+            return value.second;
+        }
+    }
+    return nullptr;
+}
+
 c2_status_t C2InterfaceHelper::query(
         const std::vector<C2Param*> &stackParams,
         const std::vector<C2Param::Index> &heapParamIndices,
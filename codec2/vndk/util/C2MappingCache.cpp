@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "C2MappingCache"
+#include <utils/Log.h>
+
+#include <cutils/properties.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <C2ErrnoUtils.h>
+#include <util/C2MappingCache.h>
+
+namespace {
+
+constexpr int32_t kDefaultLimitKb = 32768;
+constexpr char kLimitProperty[] = "debug.stagefright.c2.mapping-cache-kb";
+
+typedef std::vector<std::pair<void *, size_t>> Unmapped;
+
+void Unmap(const Unmapped &unmapped) {
+    for (const std::pair<void *, size_t> &range : unmapped) {
+        if (munmap(range.first, range.second) != 0) {
+            ALOGD("munmap failed");
+        }
+    }
+}
+
+}  // namespace
+
+/**
+ * Process-wide state of the mapping caches: the idle mappings in LRU order and the cache limit.
+ */
+struct C2MappingCacheRegistry {
+    typedef C2MappingCache::Mapping Mapping;
+
+    static C2MappingCacheRegistry &Get() {
+        // never destroyed, as allocations may outlive static destruction
+        static C2MappingCacheRegistry *sRegistry = new C2MappingCacheRegistry;
+        return *sRegistry;
+    }
+
+    C2MappingCacheRegistry()
+        : limit(size_t(std::max(property_get_int32(kLimitProperty, kDefaultLimitKb), 0)) << 10),
+          stats{ 0, 0, 0, 0 } {
+    }
+
+    /**
+     * Adds a use of |mapping|, taking it off the idle list if needed. |mutex| must be held.
+     */
+    void acquire_l(Mapping *mapping) {
+        if (mapping->idle) {
+            idle.erase(mapping->idleIt);
+            stats.idleBytes -= mapping->size;
+            mapping->idle = false;
+        }
+        ++mapping->refs;
+    }
+
+    /**
+     * Removes a use of |mapping|. If the mapping becomes idle, it is cached, and the
+     * idle mappings beyond the limit are removed from their owners and appended to |unmapped|.
+     * |mutex| must be held.
+     */
+    void release_l(Mapping *mapping, Unmapped *unmapped) {
+        if (--mapping->refs > 0) {
+            return;
+        }
+        mapping->idle = true;
+        idle.push_front(mapping);
+        mapping->idleIt = idle.begin();
+        stats.idleBytes += mapping->size;
+        trim_l(unmapped);
+    }
+
+    /**
+     * Removes the least recently used idle mappings from their owners until the idle mappings fit
+     * in the limit, and appends them to |unmapped|. |mutex| must be held.
+     */
+    void trim_l(Unmapped *unmapped) {
+        while (stats.idleBytes > limit && !idle.empty()) {
+            Mapping *lru = idle.back();
+            idle.pop_back();
+            stats.idleBytes -= lru->size;
+            ++stats.munmaps;
+            unmapped->emplace_back(lru->addr, lru->size);
+            lru->owner->mMappings.remove_if(
+                    [lru](const Mapping &mapping) { return &mapping == lru; });
+        }
+    }
+
+    std::mutex mutex;
+    size_t limit;
+    std::list<Mapping *> idle; ///< idle mappings, most recently used first
+    C2MappingCache::Stats stats;
+};
+
+C2MappingCache::C2MappingCache(int fd, size_t capacity)
+    : mFd(fd),
+      mCapacity(capacity) {
+}
+
+C2MappingCache::~C2MappingCache() {
+    C2MappingCacheRegistry &registry = C2MappingCacheRegistry::Get();
+    Unmapped unmapped;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        if (!mViews.empty()) {
+            ALOGD("Dangling mappings!");
+        }
+        for (Mapping &mapping : mMappings) {
+            if (mapping.idle) {
+                registry.idle.erase(mapping.idleIt);
+                registry.stats.idleBytes -= mapping.size;
+            }
+            ++registry.stats.munmaps;
+            unmapped.emplace_back(mapping.addr, mapping.size);
+        }
+        mMappings.clear();
+        mViews.clear();
+    }
+    Unmap(unmapped);
+}
+
+c2_status_t C2MappingCache::map(size_t offset, size_t size, int prot, void **addr) {
+    *addr = nullptr;
+    if (size == 0 || offset > mCapacity || size > mCapacity - offset) {
+        return C2_BAD_VALUE;
+    }
+
+    C2MappingCacheRegistry &registry = C2MappingCacheRegistry::Get();
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (Mapping &mapping : mMappings) {
+            if ((mapping.prot & prot) == prot) {
+                registry.acquire_l(&mapping);
+                *addr = (uint8_t *)mapping.addr + offset;
+                mViews.push_back({ *addr, size, &mapping });
+                ++registry.stats.maps;
+                return C2_OK;
+            }
+        }
+    }
+
+    // map outside of the lock; concurrent misses may create redundant mappings, which is harmless
+    void *base = mmap(nullptr, mCapacity, prot, MAP_SHARED, mFd, 0);
+    ALOGV("mmap(size = %zu, prot = %d, fd = %d) returned (%d)", mCapacity, prot, mFd, errno);
+    if (base == MAP_FAILED) {
+        return c2_map_errno<EINVAL>(errno);
+    }
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    ++registry.stats.mmaps;
+    mMappings.push_back({ this, base, mCapacity, prot, 0, false, {} });
+    Mapping &mapping = mMappings.back();
+    registry.acquire_l(&mapping);
+    *addr = (uint8_t *)base + offset;
+    mViews.push_back({ *addr, size, &mapping });
+    ++registry.stats.maps;
+    return C2_OK;
+}
+
+c2_status_t C2MappingCache::unmap(void *addr, size_t size) {
+    C2MappingCacheRegistry &registry = C2MappingCacheRegistry::Get();
+    Unmapped unmapped;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = std::find_if(mViews.begin(), mViews.end(), [addr, size](const View &view) {
+            return view.addr == addr && view.size == size;
+        });
+        if (it == mViews.end()) {
+            ALOGD("unmap failed to find specified map");
+            return C2_BAD_VALUE;
+        }
+        Mapping *mapping = it->mapping;
+        mViews.erase(it);
+        registry.release_l(mapping, &unmapped);
+    }
+    Unmap(unmapped);
+    return C2_OK;
+}
+
+// static
+void C2MappingCache::SetLimit(size_t bytes) {
+    C2MappingCacheRegistry &registry = C2MappingCacheRegistry::Get();
+    Unmapped unmapped;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.limit = bytes;
+        registry.trim_l(&unmapped);
+    }
+    Unmap(unmapped);
+}
+
+// static
+C2MappingCache::Stats C2MappingCache::GetStats() {
+    C2MappingCacheRegistry &registry = C2MappingCacheRegistry::Get();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.stats;
+}
@@ -107,6 +107,9 @@ public:
                 DefineParam(mInputMaxBufSize, C2_PARAMKEY_INPUT_MAX_BUFFER_SIZE)
                 .withConstValue(new C2StreamMaxBufferSizeInfo::input(0u, 8192))
                 .build());
+
+        addParameter(SimpleInterface<void>::BaseParams::DefineOutputBatchSize(
+                mOutputBatchSize, 1u));
     }
 
 private:
@@ -118,6 +121,7 @@ private:
     std::shared_ptr<C2StreamChannelCountInfo::output> mChannelCount;
     std::shared_ptr<C2BitrateTuning::input> mBitrate;
     std::shared_ptr<C2StreamMaxBufferSizeInfo::input> mInputMaxBufSize;
+    std::shared_ptr<C2PortBatchSizeTuning::output> mOutputBatchSize;
 };
 
 C2SoftAmrDec::C2SoftAmrDec(
@@ -153,6 +153,27 @@ public:
                 .withFields({C2F(mSyncFramePeriod, value).any()})
                 .withSetter(Setter<decltype(*mSyncFramePeriod)>::StrictValueWithNoDeps)
                 .build());
+
+        addParameter(
+                DefineParam(mColorAspects, C2_PARAMKEY_COLOR_ASPECTS)
+                .withDefault(new C2StreamColorAspectsInfo::input(
+                        0u, C2Color::RANGE_UNSPECIFIED, C2Color::PRIMARIES_UNSPECIFIED,
+                        C2Color::TRANSFER_UNSPECIFIED, C2Color::MATRIX_UNSPECIFIED))
+                .withFields({
+                    C2F(mColorAspects, range).inRange(
+                                C2Color::RANGE_UNSPECIFIED,     C2Color::RANGE_OTHER),
+                    C2F(mColorAspects, primaries).inRange(
+                                C2Color::PRIMARIES_UNSPECIFIED, C2Color::PRIMARIES_OTHER),
+                    C2F(mColorAspects, transfer).inRange(
+                                C2Color::TRANSFER_UNSPECIFIED,  C2Color::TRANSFER_OTHER),
+                    C2F(mColorAspects, matrix).inRange(
+                                C2Color::MATRIX_UNSPECIFIED,    C2Color::MATRIX_OTHER)
+                })
+                .withSetter(ColorAspectsSetter)
+                .build());
+
+        // dynamic parameters are read for every frame
+        addSnapshotParameters({ mIntraRefresh, mBitrate, mRequestSync });
     }
 
     static C2R BitrateSetter(bool mayBlock, C2P<C2StreamBitrateInfo::output> &me) {
@@ -255,6 +276,23 @@ public:
         return C2R::Ok();
     }
 
+    static C2R ColorAspectsSetter(bool mayBlock, C2P<C2StreamColorAspectsInfo::input> &me) {
+        (void)mayBlock;
+        if (me.v.range > C2Color::RANGE_OTHER) {
+                me.set().range = C2Color::RANGE_OTHER;
+        }
+        if (me.v.primaries > C2Color::PRIMARIES_OTHER) {
+                me.set().primaries = C2Color::PRIMARIES_OTHER;
+        }
+        if (me.v.transfer > C2Color::TRANSFER_OTHER) {
+                me.set().transfer = C2Color::TRANSFER_OTHER;
+        }
+        if (me.v.matrix > C2Color::MATRIX_OTHER) {
+                me.set().matrix = C2Color::MATRIX_OTHER;
+        }
+        return C2R::Ok();
+    }
+
     static C2R IntraRefreshSetter(bool mayBlock, C2P<C2StreamIntraRefreshTuning::output> &me) {
         (void)mayBlock;
         C2R res = C2R::Ok();
@@ -323,6 +361,18 @@ public:
     std::shared_ptr<C2StreamFrameRateInfo::output> getFrameRate_l() const { return mFrameRate; }
     std::shared_ptr<C2StreamBitrateInfo::output> getBitrate_l() const { return mBitrate; }
     std::shared_ptr<C2StreamRequestSyncFrameTuning::output> getRequestSync_l() const { return mRequestSync; }
+    std::shared_ptr<C2StreamColorAspectsInfo::input> getColorAspects_l() const { return mColorAspects; }
+
+    // getters of dynamic parameters that do not require locking
+    std::shared_ptr<C2StreamIntraRefreshTuning::output> getIntraRefresh(const Snapshot &snapshot) const {
+        return snapshot.get(mIntraRefresh);
+    }
+    std::shared_ptr<C2StreamBitrateInfo::output> getBitrate(const Snapshot &snapshot) const {
+        return snapshot.get(mBitrate);
+    }
+    std::shared_ptr<C2StreamRequestSyncFrameTuning::output> getRequestSync(const Snapshot &snapshot) const {
+        return snapshot.get(mRequestSync);
+    }
 
 private:
     std::shared_ptr<C2StreamFormatConfig::input> mInputFormat;
@@ -337,6 +387,7 @@ private:
     std::shared_ptr<C2BitrateTuning::output> mBitrate;
     std::shared_ptr<C2StreamProfileLevelInfo::output> mProfileLevel;
     std::shared_ptr<C2StreamSyncFrameIntervalTuning::output> mSyncFramePeriod;
+    std::shared_ptr<C2StreamColorAspectsInfo::input> mColorAspects;
 };
 
 #define ive_api_function  ih264e_api_function
@@ -348,18 +399,11 @@ namespace {
 // From external/libavc/encoder/ih264e_bitstream.h
 constexpr uint32_t MIN_STREAM_SIZE = 0x800;
 
-static size_t GetCPUCoreCount() {
-    long cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    // _SC_NPROC_ONLN must be defined...
-    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-    CHECK(cpuCoreCount >= 1);
-    ALOGV("Number of CPU cores: %ld", cpuCoreCount);
-    return (size_t)cpuCoreCount;
-}
+// Expected size of key and non-key frames relative to the average frame size at the target
+// bitrate, and the headroom kept over the recent peak frame size (in 1/4 units).
+constexpr uint32_t KEY_FRAME_SIZE_RATIO = 8;
+constexpr uint32_t FRAME_SIZE_RATIO = 2;
+constexpr uint32_t PEAK_FRAME_SIZE_HEADROOM_Q2 = 5;
 
 }  // namespace
 
@@ -375,8 +419,9 @@ C2SoftAvcEnc::C2SoftAvcEnc(
       mSawOutputEOS(false),
       mSignalledError(false),
       mCodecCtx(nullptr),
-      // TODO: output buffer size
-      mOutBufferSize(524288) {
+      mOutBufferSize(0),
+      mInput(name, SimpleC2EncoderInput::FORMAT_I420,
+             SimpleC2EncoderInput::FLAG_DERIVED_CHROMA_STRIDE) {
 
     // If dump is enabled, then open create an empty file
     GENERATE_FILE_NAMES();
@@ -418,7 +463,7 @@ void  C2SoftAvcEnc::initEncParams() {
     mMemRecords = nullptr;
     mNumMemRecords = DEFAULT_MEM_REC_CNT;
     mHeaderGenerated = 0;
-    mNumCores = GetCPUCoreCount();
+    mNumCores = 1;
     mArch = DEFAULT_ARCH;
     mSliceMode = DEFAULT_SLICE_MODE;
     mSliceParam = DEFAULT_SLICE_PARAM;
@@ -565,6 +610,30 @@ c2_status_t C2SoftAvcEnc::setBitRate() {
     return C2_OK;
 }
 
+c2_status_t C2SoftAvcEnc::getOutBufferSize() {
+    ive_ctl_getbufinfo_ip_t s_buf_info_ip = {};
+    ive_ctl_getbufinfo_op_t s_buf_info_op = {};
+    IV_STATUS_T status;
+
+    s_buf_info_ip.e_cmd = IVE_CMD_VIDEO_CTL;
+    s_buf_info_ip.e_sub_cmd = IVE_CMD_CTL_GETBUFINFO;
+
+    s_buf_info_ip.u4_max_wd = mSize->width;
+    s_buf_info_ip.u4_max_ht = mSize->height;
+    s_buf_info_ip.e_inp_color_fmt = mIvVideoColorFormat;
+
+    s_buf_info_ip.u4_size = sizeof(ive_ctl_getbufinfo_ip_t);
+    s_buf_info_op.u4_size = sizeof(ive_ctl_getbufinfo_op_t);
+
+    status = ive_api_function(mCodecCtx, &s_buf_info_ip, &s_buf_info_op);
+    if (status != IV_SUCCESS) {
+        ALOGE("Unable to get buffer info = 0x%x\n", s_buf_info_op.u4_error_code);
+        return C2_CORRUPTED;
+    }
+    mOutBufferSize = s_buf_info_op.au4_min_out_buf_size[0];
+    return C2_OK;
+}
+
 c2_status_t C2SoftAvcEnc::setFrameType(IV_PICTURE_CODING_TYPE_T e_frame_type) {
     ive_ctl_set_frame_type_ip_t s_frame_type_ip;
     ive_ctl_set_frame_type_op_t s_frame_type_op;
@@ -850,14 +919,14 @@ c2_status_t C2SoftAvcEnc::initEncoder() {
         mAVCEncLevel = mIntf->getLevel_l();
         mIInterval = mIntf->getSyncFramePeriod_l();
         mIDRInterval = mIntf->getSyncFramePeriod_l();
+        mColorAspects = mIntf->getColorAspects_l();
     }
     uint32_t width = mSize->width;
     uint32_t height = mSize->height;
 
     mStride = width;
 
-    // TODO
-    mIvVideoColorFormat = IV_YUV_420P;
+    mNumCores = acquireThreads(width, height, CODEC_MAX_CORES)->threads();
 
     ALOGD("Params width %d height %d level %d colorFormat %d", width,
             height, mAVCEncLevel, mIvVideoColorFormat);
@@ -1051,6 +1120,15 @@ c2_status_t C2SoftAvcEnc::initEncoder() {
     /* Video control Set in Encode header mode */
     setEncMode(IVE_ENC_MODE_HEADER);
 
+    /* Get the worst case encoded frame size */
+    if (getOutBufferSize() != C2_OK || mOutBufferSize < MIN_STREAM_SIZE) {
+        mOutBufferSize = MAX(width * height * 3 / 2, MIN_STREAM_SIZE);
+    }
+    mOutBufferSize = ALIGN4096(mOutBufferSize);
+    mPeakFrameSize[0] = mPeakFrameSize[1] = 0;
+    mNumInputFrames = 0;
+    mOutStats = {};
+
     ALOGV("init_codec successfull");
 
     mSpsPpsHeaderReceived = false;
@@ -1069,6 +1147,12 @@ c2_status_t C2SoftAvcEnc::releaseEncoder() {
         return C2_OK;
     }
 
+    ALOGD("Output buffers: %llu frames, %llu direct, %llu mispredicted, %llu overflows",
+            (unsigned long long)mOutStats.frames, (unsigned long long)mOutStats.direct,
+            (unsigned long long)mOutStats.mispredicted, (unsigned long long)mOutStats.overflows);
+    mOutScratch = MemoryBlock();
+    mInput.reset();
+
     s_retrieve_mem_ip.u4_size = sizeof(iv_retrieve_mem_rec_ip_t);
     s_retrieve_mem_op.u4_size = sizeof(iv_retrieve_mem_rec_op_t);
     s_retrieve_mem_ip.e_cmd = IV_CMD_RETRIEVE_MEMREC;
@@ -1103,6 +1187,15 @@ c2_status_t C2SoftAvcEnc::releaseEncoder() {
     return C2_OK;
 }
 
+uint32_t C2SoftAvcEnc::predictOutputSize(bool keyFrame) const {
+    float frameRate = MAX(mFrameRate->value, 1.f);
+    uint64_t size = uint64_t(mBitrate->value / 8 / frameRate)
+            * (keyFrame ? KEY_FRAME_SIZE_RATIO : FRAME_SIZE_RATIO);
+    size = MAX(size, uint64_t(mPeakFrameSize[keyFrame]) * PEAK_FRAME_SIZE_HEADROOM_Q2 / 4);
+    size = MAX(size, uint64_t(MIN_STREAM_SIZE));
+    return MIN(ALIGN4096(size), uint64_t(mOutBufferSize));
+}
+
 c2_status_t C2SoftAvcEnc::setEncodeArgs(
         ive_video_encode_ip_t *ps_encode_ip,
         ive_video_encode_op_t *ps_encode_op,
@@ -1149,82 +1242,28 @@ c2_status_t C2SoftAvcEnc::setEncodeArgs(
         return C2_BAD_VALUE;
     }
     ALOGV("width = %d, height = %d", input->width(), input->height());
-    const C2PlanarLayout &layout = input->layout();
-    uint8_t *yPlane = const_cast<uint8_t *>(input->data()[C2PlanarLayout::PLANE_Y]);
-    uint8_t *uPlane = const_cast<uint8_t *>(input->data()[C2PlanarLayout::PLANE_U]);
-    uint8_t *vPlane = const_cast<uint8_t *>(input->data()[C2PlanarLayout::PLANE_V]);
-    int32_t yStride = layout.planes[C2PlanarLayout::PLANE_Y].rowInc;
-    int32_t uStride = layout.planes[C2PlanarLayout::PLANE_U].rowInc;
-    int32_t vStride = layout.planes[C2PlanarLayout::PLANE_V].rowInc;
-
     uint32_t width = mSize->width;
     uint32_t height = mSize->height;
     // width and height are always even (as block size is 16x16)
     CHECK_EQ((width & 1u), 0u);
     CHECK_EQ((height & 1u), 0u);
-    size_t yPlaneSize = width * height;
-
-    switch (layout.type) {
-        case C2PlanarLayout::TYPE_RGB:
-            [[fallthrough]];
-        case C2PlanarLayout::TYPE_RGBA: {
-            ALOGV("yPlaneSize = %zu", yPlaneSize);
-            MemoryBlock conversionBuffer = mConversionBuffers.fetch(yPlaneSize * 3 / 2);
-            mConversionBuffersInUse.emplace(conversionBuffer.data(), conversionBuffer);
-            yPlane = conversionBuffer.data();
-            uPlane = yPlane + yPlaneSize;
-            vPlane = uPlane + yPlaneSize / 4;
-            yStride = width;
-            uStride = vStride = yStride / 2;
-            ConvertRGBToPlanarYUV(yPlane, yStride, height, conversionBuffer.size(), *input);
-            break;
-        }
-        case C2PlanarLayout::TYPE_YUV: {
-            if (!IsYUV420(*input)) {
-                ALOGE("input is not YUV420");
-                return C2_BAD_VALUE;
-            }
-
-            if (layout.planes[layout.PLANE_Y].colInc == 1
-                    && layout.planes[layout.PLANE_U].colInc == 1
-                    && layout.planes[layout.PLANE_V].colInc == 1
-                    && uStride == vStride
-                    && yStride == 2 * vStride) {
-                // I420 compatible - already set up above
-                break;
-            }
-
-            // copy to I420
-            yStride = width;
-            uStride = vStride = yStride / 2;
-            MemoryBlock conversionBuffer = mConversionBuffers.fetch(yPlaneSize * 3 / 2);
-            mConversionBuffersInUse.emplace(conversionBuffer.data(), conversionBuffer);
-            MediaImage2 img = CreateYUV420PlanarMediaImage2(width, height, yStride, height);
-            status_t err = ImageCopy(conversionBuffer.data(), &img, *input);
-            if (err != OK) {
-                ALOGE("Buffer conversion failed: %d", err);
-                return C2_BAD_VALUE;
-            }
-            yPlane = conversionBuffer.data();
-            uPlane = yPlane + yPlaneSize;
-            vPlane = uPlane + yPlaneSize / 4;
-            break;
-
-        }
-
-        case C2PlanarLayout::TYPE_YUVA:
-            ALOGE("YUVA plane type is not supported");
-            return C2_BAD_VALUE;
 
-        default:
-            ALOGE("Unrecognized plane type: %d", layout.type);
-            return C2_BAD_VALUE;
+    SimpleC2EncoderInput::Frame frame;
+    c2_status_t err = mInput.prepare(
+            *input, width, height, mColorAspects->matrix, mColorAspects->range, &frame);
+    if (err != C2_OK) {
+        return err;
     }
+    uint8_t *yPlane = frame.planes[0];
+    uint8_t *uPlane = frame.planes[1];
+    uint8_t *vPlane = frame.planes[2];
+    int32_t yStride = frame.strides[0];
+    int32_t uStride = frame.strides[1];
+    int32_t vStride = frame.strides[2];
 
     switch (mIvVideoColorFormat) {
         case IV_YUV_420P:
         {
-            // input buffer is supposed to be const but Ittiam API wants bare pointer.
             ps_inp_raw_buf->apv_bufs[0] = yPlane;
             ps_inp_raw_buf->apv_bufs[1] = uPlane;
             ps_inp_raw_buf->apv_bufs[2] = vPlane;
@@ -1258,7 +1297,8 @@ c2_status_t C2SoftAvcEnc::setEncodeArgs(
         default:
         {
             ps_inp_raw_buf->apv_bufs[0] = yPlane;
-            ps_inp_raw_buf->apv_bufs[1] = uPlane;
+            ps_inp_raw_buf->apv_bufs[1] =
+                mIvVideoColorFormat == IV_YUV_420SP_VU ? vPlane : uPlane;
 
             ps_inp_raw_buf->au4_wd[0] = input->width();
             ps_inp_raw_buf->au4_wd[1] = input->width();
@@ -1286,8 +1326,31 @@ void C2SoftAvcEnc::process(
     WORD32 timeDelay, timeTaken;
     uint64_t timestamp = work->input.ordinal.timestamp.peekull();
 
+    std::shared_ptr<const C2GraphicView> view;
+    std::shared_ptr<C2Buffer> inputBuffer;
+    if (!work->input.buffers.empty()) {
+        inputBuffer = work->input.buffers[0];
+        view = std::make_shared<const C2GraphicView>(
+                inputBuffer->data().graphicBlocks().front().map().get());
+        if (view->error() != C2_OK) {
+            ALOGE("graphic view map err = %d", view->error());
+            return;
+        }
+    }
+
     // Initialize encoder if not already initialized
     if (mCodecCtx == nullptr) {
+        // take input in the layout of the first frame, so that frames are not converted
+        uint32_t format = view ? SimpleC2EncoderInput::GetFormat(*view) : 0;
+        if (format == SimpleC2EncoderInput::FORMAT_NV12) {
+            mIvVideoColorFormat = IV_YUV_420SP_UV;
+        } else if (format == SimpleC2EncoderInput::FORMAT_NV21) {
+            mIvVideoColorFormat = IV_YUV_420SP_VU;
+        } else {
+            format = SimpleC2EncoderInput::FORMAT_I420;
+            mIvVideoColorFormat = IV_YUV_420P;
+        }
+        mInput.setFormats(format);
         if (C2_OK != initEncoder()) {
             ALOGE("Failed to initialize encoder");
             mSignalledError = true;
@@ -1344,16 +1407,20 @@ void C2SoftAvcEnc::process(
     }
 
     // handle dynamic config parameters
+    bool syncRequested = false;
     {
-        IntfImpl::Lock lock = mIntf->lock();
-        std::shared_ptr<C2StreamIntraRefreshTuning::output> intraRefresh = mIntf->getIntraRefresh_l();
-        std::shared_ptr<C2StreamBitrateInfo::output> bitrate = mIntf->getBitrate_l();
-        std::shared_ptr<C2StreamRequestSyncFrameTuning::output> requestSync = mIntf->getRequestSync_l();
-        lock.unlock();
+        std::shared_ptr<const IntfImpl::Snapshot> snapshot = mIntf->snapshot();
+        std::shared_ptr<C2StreamIntraRefreshTuning::output> intraRefresh =
+            mIntf->getIntraRefresh(*snapshot);
+        std::shared_ptr<C2StreamBitrateInfo::output> bitrate = mIntf->getBitrate(*snapshot);
+        std::shared_ptr<C2StreamRequestSyncFrameTuning::output> requestSync =
+            mIntf->getRequestSync(*snapshot);
 
         if (bitrate != mBitrate) {
             mBitrate = bitrate;
             setBitRate();
+            // frame sizes at the old bitrate no longer predict the next ones
+            mPeakFrameSize[0] = mPeakFrameSize[1] = 0;
         }
 
         if (intraRefresh != mIntraRefresh) {
@@ -1370,6 +1437,7 @@ void C2SoftAvcEnc::process(
                 mIntf->config({ &clearSync }, C2_MAY_BLOCK, &failures);
                 ALOGV("Got sync request");
                 setFrameType(IV_IDR_FRAME);
+                syncRequested = true;
             }
             mRequestSync = requestSync;
         }
@@ -1389,38 +1457,54 @@ void C2SoftAvcEnc::process(
     //         }
     //     }
     // }
-    std::shared_ptr<const C2GraphicView> view;
-    std::shared_ptr<C2Buffer> inputBuffer;
-    if (!work->input.buffers.empty()) {
-        inputBuffer = work->input.buffers[0];
-        view = std::make_shared<const C2GraphicView>(
-                inputBuffer->data().graphicBlocks().front().map().get());
-        if (view->error() != C2_OK) {
-            ALOGE("graphic view map err = %d", view->error());
-            return;
-        }
-    }
-
+    // Predict the size of the encoded frame. Frames predicted to need the worst case size are
+    // encoded directly into an output block. Others are encoded into a worst case sized scratch
+    // buffer and copied into a block of the predicted size (or larger if the prediction was
+    // low), so that the encoder never runs out of space and has to encode a frame again.
+    bool keyFrame = view && (syncRequested || mNumInputFrames == 0
+            || (mIInterval > 0 && mNumInputFrames % mIInterval == 0));
+    uint32_t predictedSize = predictOutputSize(keyFrame);
+
+    C2MemoryUsage usage = { C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE };
     std::shared_ptr<C2LinearBlock> block;
-
-    do {
-        C2MemoryUsage usage = { C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE };
-        // TODO: error handling, proper usage, etc.
+    std::unique_ptr<C2WriteView> wView;
+    uint8_t *outBase = nullptr;
+    uint32_t outCapacity = 0;
+    if (predictedSize >= mOutBufferSize) {
         c2_status_t err = pool->fetchLinearBlock(mOutBufferSize, usage, &block);
         if (err != C2_OK) {
             ALOGE("fetch linear block err = %d", err);
             work->result = err;
             return;
         }
-        C2WriteView wView = block->map().get();
-        if (wView.error() != C2_OK) {
-            ALOGE("write view map err = %d", wView.error());
-            work->result = wView.error();
+        wView = std::make_unique<C2WriteView>(block->map().get());
+        if (wView->error() != C2_OK) {
+            ALOGE("write view map err = %d", wView->error());
+            work->result = wView->error();
             return;
         }
+        outBase = wView->base();
+        outCapacity = wView->capacity();
+        ++mOutStats.direct;
+    }
+
+    do {
+        if (!block) {
+            if (mOutScratch.size() < mOutBufferSize) {
+                mOutScratch = MemoryBlock::Allocate(mOutBufferSize);
+                if (mOutScratch.size() < mOutBufferSize) {
+                    ALOGE("Unable to allocate output scratch buffer of size %u", mOutBufferSize);
+                    mSignalledError = true;
+                    work->result = C2_NO_MEMORY;
+                    return;
+                }
+            }
+            outBase = mOutScratch.data();
+            outCapacity = mOutBufferSize;
+        }
 
         error = setEncodeArgs(
-                &s_encode_ip, &s_encode_op, view.get(), wView.base(), wView.capacity(), timestamp);
+                &s_encode_ip, &s_encode_op, view.get(), outBase, outCapacity, timestamp);
         if (error != C2_OK) {
             ALOGE("setEncodeArgs failed : %d", error);
             mSignalledError = true;
@@ -1440,8 +1524,13 @@ void C2SoftAvcEnc::process(
 
         if (IV_SUCCESS != status) {
             if ((s_encode_op.u4_error_code & 0xFF) == IH264E_BITSTREAM_BUFFER_OVERFLOW) {
-                // TODO: use IVE_CMD_CTL_GETBUFINFO for proper max input size?
+                // not expected as the buffer has the worst case size reported by the encoder
+                ALOGW("Bitstream buffer overflow at %u bytes", outCapacity);
+                ++mOutStats.overflows;
+                mInput.release(s_encode_ip.s_inp_buf.apv_bufs[0]);
                 mOutBufferSize *= 2;
+                wView.reset();
+                block.reset();
                 continue;
             }
             ALOGE("Encode Frame failed = 0x%x\n",
@@ -1452,6 +1541,38 @@ void C2SoftAvcEnc::process(
         }
     } while (IV_SUCCESS != status);
 
+    uint32_t outBytes = s_encode_op.s_out_buf.u4_bytes;
+    if (outBytes && !block) {
+        uint32_t blockSize = predictedSize;
+        if (outBytes > predictedSize) {
+            blockSize = ALIGN4096(outBytes);
+            ++mOutStats.mispredicted;
+        }
+        c2_status_t err = pool->fetchLinearBlock(blockSize, usage, &block);
+        if (err != C2_OK) {
+            ALOGE("fetch linear block err = %d", err);
+            work->result = err;
+            return;
+        }
+        C2WriteView copyView = block->map().get();
+        if (copyView.error() != C2_OK) {
+            ALOGE("write view map err = %d", copyView.error());
+            work->result = copyView.error();
+            return;
+        }
+        memcpy(copyView.base(), outBase, outBytes);
+    }
+    if (outBytes) {
+        bool encodedKeyFrame = (IV_IDR_FRAME == s_encode_op.u4_encoded_frame_type
+                || IV_I_FRAME == s_encode_op.u4_encoded_frame_type);
+        uint32_t &peak = mPeakFrameSize[encodedKeyFrame];
+        peak = MAX(outBytes, peak - peak / 8);
+        ++mOutStats.frames;
+    }
+    if (view) {
+        ++mNumInputFrames;
+    }
+
     // Hold input buffer reference
     if (inputBuffer) {
         mBuffers[s_encode_ip.s_inp_buf.apv_bufs[0]] = inputBuffer;
@@ -1472,7 +1593,7 @@ void C2SoftAvcEnc::process(
         } else {
             // Release input buffer reference
             mBuffers.erase(freed);
-            mConversionBuffersInUse.erase(freed);
+            mInput.release(freed);
         }
     }
 
@@ -1482,9 +1603,8 @@ void C2SoftAvcEnc::process(
         ((uint64_t)s_encode_op.u4_timestamp_high << 32) | s_encode_op.u4_timestamp_low;
     work->worklets.front()->output.buffers.clear();
 
-    if (s_encode_op.s_out_buf.u4_bytes) {
-        std::shared_ptr<C2Buffer> buffer =
-            createLinearBuffer(block, 0, s_encode_op.s_out_buf.u4_bytes);
+    if (outBytes) {
+        std::shared_ptr<C2Buffer> buffer = createLinearBuffer(block, 0, outBytes);
         if (IV_IDR_FRAME == s_encode_op.u4_encoded_frame_type) {
             ALOGV("IDR frame produced");
             buffer->setInfo(std::make_shared<C2StreamPictureTypeMaskInfo::output>(
@@ -22,6 +22,7 @@
 #include <utils/Vector.h>
 
 #include <SimpleC2Component.h>
+#include <SimpleC2EncoderInput.h>
 
 #include "ih264_typedefs.h"
 #include "iv2.h"
@@ -190,8 +191,18 @@ private:
     std::shared_ptr<C2StreamFrameRateInfo::output> mFrameRate;
     std::shared_ptr<C2StreamBitrateInfo::output> mBitrate;
     std::shared_ptr<C2StreamRequestSyncFrameTuning::output> mRequestSync;
-
-    uint32_t mOutBufferSize;
+    std::shared_ptr<C2StreamColorAspectsInfo::input> mColorAspects;
+
+    uint32_t mOutBufferSize;     // worst case size of an encoded frame
+    uint32_t mPeakFrameSize[2];  // decaying peak size of recent non-key [0] and key [1] frames
+    uint64_t mNumInputFrames;    // number of input frames queued to the encoder
+    MemoryBlock mOutScratch;     // worst case sized buffer for frames predicted to be small
+    struct {
+        uint64_t frames;         // frames encoded
+        uint64_t direct;         // frames encoded directly into a worst case sized block
+        uint64_t mispredicted;   // frames larger than their predicted size
+        uint64_t overflows;      // encodes retried after a bitstream buffer overflow
+    } mOutStats;
     UWORD32 mHeaderGenerated;
     UWORD32 mBframes;
     IV_ARCH_T mArch;
@@ -202,8 +213,7 @@ private:
     UWORD32 mIDRInterval;
     UWORD32 mDisableDeblkLevel;
     std::map<const void *, std::shared_ptr<C2Buffer>> mBuffers;
-    MemoryBlockPool mConversionBuffers;
-    std::map<const void *, MemoryBlock> mConversionBuffersInUse;
+    SimpleC2EncoderInput mInput;
 
     void initEncParams();
     c2_status_t initEncoder();
@@ -223,7 +233,9 @@ private:
     c2_status_t setProfileParams();
     c2_status_t setDeblockParams();
     c2_status_t setVbvParams();
+    c2_status_t getOutBufferSize();
     void logVersion();
+    uint32_t predictOutputSize(bool keyFrame) const;
     c2_status_t setEncodeArgs(
             ive_video_encode_ip_t *ps_encode_ip,
             ive_video_encode_op_t *ps_encode_op,
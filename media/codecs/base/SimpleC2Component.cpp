@@ -21,6 +21,7 @@
 #include <cutils/properties.h>
 #include <media/stagefright/foundation/AMessage.h>
 
+#include <algorithm>
 #include <inttypes.h>
 
 #include <C2Config.h>
@@ -31,29 +32,50 @@
 namespace android {
 
 std::unique_ptr<C2Work> SimpleC2Component::WorkQueue::pop_front() {
-    std::unique_ptr<C2Work> work = std::move(mQueue.front().work);
-    mQueue.pop_front();
+    std::unique_ptr<C2Work> work = std::move(mQueue[mHead].work);
+    mHead = (mHead + 1) & (mQueue.size() - 1);
+    --mSize;
     return work;
 }
 
 void SimpleC2Component::WorkQueue::push_back(std::unique_ptr<C2Work> work) {
-    mQueue.push_back({ std::move(work), NO_DRAIN });
+    emplace_back(std::move(work), NO_DRAIN);
 }
 
 bool SimpleC2Component::WorkQueue::empty() const {
-    return mQueue.empty();
+    return mSize == 0u;
 }
 
 void SimpleC2Component::WorkQueue::clear() {
-    mQueue.clear();
+    while (mSize > 0u) {
+        (void)pop_front();
+    }
+    mHead = 0u;
 }
 
 uint32_t SimpleC2Component::WorkQueue::drainMode() const {
-    return mQueue.front().drainMode;
+    return mQueue[mHead].drainMode;
 }
 
 void SimpleC2Component::WorkQueue::markDrain(uint32_t drainMode) {
-    mQueue.push_back({ nullptr, drainMode });
+    emplace_back(nullptr, drainMode);
+}
+
+void SimpleC2Component::WorkQueue::emplace_back(
+        std::unique_ptr<C2Work> work, uint32_t drainMode) {
+    if (mSize == mQueue.size()) {
+        // Grow by doubling, unrolling the ring so that the head is at 0.
+        std::vector<Entry> queue(std::max(kInitialCapacity, mQueue.size() * 2));
+        for (size_t i = 0; i < mSize; ++i) {
+            queue[i] = std::move(mQueue[(mHead + i) & (mQueue.size() - 1)]);
+        }
+        mQueue.swap(queue);
+        mHead = 0u;
+    }
+    Entry &entry = mQueue[(mHead + mSize) & (mQueue.size() - 1)];
+    entry.work = std::move(work);
+    entry.drainMode = drainMode;
+    ++mSize;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -92,7 +114,7 @@ void SimpleC2Component::WorkHandler::onMessageReceived(const sp<AMessage> &msg)
         case kWhatProcess: {
             if (mRunning) {
                 if (thiz->processQueue()) {
-                    (new AMessage(kWhatProcess, this))->post();
+                    msg->post();
                 }
             } else {
                 ALOGV("Ignore process message as we're not running");
@@ -105,22 +127,27 @@ void SimpleC2Component::WorkHandler::onMessageReceived(const sp<AMessage> &msg)
             [[fallthrough]];
         }
         case kWhatStart: {
+            thiz->reacquireThreads();
+            thiz->updateOutputBatchSize();
             mRunning = true;
             break;
         }
         case kWhatStop: {
             int32_t err = thiz->onStop();
+            thiz->releaseThreads(true /* keepRequest */);
             Reply(msg, &err);
             break;
         }
         case kWhatReset: {
             thiz->onReset();
+            thiz->releaseThreads(false /* keepRequest */);
             mRunning = false;
             Reply(msg);
             break;
         }
         case kWhatRelease: {
             thiz->onRelease();
+            thiz->releaseThreads(false /* keepRequest */);
             mRunning = false;
             Reply(msg);
             break;
@@ -147,9 +174,11 @@ SimpleC2Component::SimpleC2Component(
     : mDummyReadView(DummyReadView()),
       mIntf(intf),
       mLooper(new ALooper),
-      mHandler(new WorkHandler) {
+      mHandler(new WorkHandler),
+      mOutputBatchSize(1u) {
     mLooper->setName(intf->getName().c_str());
     (void)mLooper->registerHandler(mHandler);
+    mProcessMsg = new AMessage(WorkHandler::kWhatProcess, mHandler);
     mLooper->start(false, false, ANDROID_PRIORITY_VIDEO);
 }
 
@@ -193,7 +222,7 @@ c2_status_t SimpleC2Component::queue_nb(std::list<std::unique_ptr<C2Work>> * con
         }
     }
     if (queueWasEmpty) {
-        (new AMessage(WorkHandler::kWhatProcess, mHandler))->post();
+        mProcessMsg->post();
     }
     return C2_OK;
 }
@@ -251,7 +280,7 @@ c2_status_t SimpleC2Component::drain_nb(drain_mode_t drainMode) {
         queue->markDrain(drainMode);
     }
     if (queueWasEmpty) {
-        (new AMessage(WorkHandler::kWhatProcess, mHandler))->post();
+        mProcessMsg->post();
     }
 
     return C2_OK;
@@ -333,19 +362,80 @@ c2_status_t SimpleC2Component::release() {
     return C2_OK;
 }
 
+const std::shared_ptr<SimpleC2ThreadBudget::Allocation> &SimpleC2Component::acquireThreads(
+        uint32_t width, uint32_t height, size_t maxThreads) {
+    mThreadRequest.valid = true;
+    mThreadRequest.maxThreads = maxThreads;
+    if (!mThreadAllocation) {
+        mThreadRequest.width = width;
+        mThreadRequest.height = height;
+        mThreadAllocation = SimpleC2ThreadBudget::Get().acquire(
+                mIntf->getName().c_str(), width, height, maxThreads);
+    }
+    return mThreadAllocation;
+}
+
+void SimpleC2Component::setThreadsSize(uint32_t width, uint32_t height) {
+    mThreadRequest.width = width;
+    mThreadRequest.height = height;
+    if (mThreadAllocation) {
+        mThreadAllocation->setSize(width, height);
+    }
+}
+
+void SimpleC2Component::releaseThreads(bool keepRequest) {
+    mThreadAllocation.reset();
+    if (!keepRequest) {
+        mThreadRequest = ThreadRequest();
+    }
+}
+
+void SimpleC2Component::reacquireThreads() {
+    // the codec instance survives a stop, so its threads are accounted for again
+    if (mThreadRequest.valid && !mThreadAllocation) {
+        (void)acquireThreads(
+                mThreadRequest.width, mThreadRequest.height, mThreadRequest.maxThreads);
+    }
+}
+
 std::shared_ptr<C2ComponentInterface> SimpleC2Component::intf() {
     return mIntf;
 }
 
-namespace {
+void SimpleC2Component::updateOutputBatchSize() {
+    std::vector<std::unique_ptr<C2Param>> params;
+    c2_status_t err = intf()->query_vb(
+            {},
+            { C2PortBatchSizeTuning::output::PARAM_TYPE },
+            C2_DONT_BLOCK,
+            &params);
+    mOutputBatchSize = 1u;
+    if (err == C2_OK && params.size()) {
+        C2PortBatchSizeTuning::output *batchSize =
+            C2PortBatchSizeTuning::output::From(params[0].get());
+        if (batchSize && batchSize->flexCount() >= 1 && batchSize->m.values[0] > 1u) {
+            mOutputBatchSize = (size_t)batchSize->m.values[0];
+        }
+    }
+    ALOGV("output batch size %zu", mOutputBatchSize);
+}
 
-std::list<std::unique_ptr<C2Work>> vec(std::unique_ptr<C2Work> &work) {
-    std::list<std::unique_ptr<C2Work>> ret;
-    ret.push_back(std::move(work));
-    return ret;
+void SimpleC2Component::sendWork(std::unique_ptr<C2Work> work) {
+    mOutputBatch.push_back(std::move(work));
+    if (mOutputBatch.size() >= mOutputBatchSize) {
+        sendBatchedWork();
+    }
 }
 
-}  // namespace
+void SimpleC2Component::sendBatchedWork() {
+    if (mOutputBatch.empty()) {
+        return;
+    }
+    std::shared_ptr<C2Component::Listener> listener = mExecState.lock()->mListener;
+    std::list<std::unique_ptr<C2Work>> batch;
+    batch.swap(mOutputBatch);
+    listener->onWorkDone_nb(shared_from_this(), std::move(batch));
+}
 
 void SimpleC2Component::finish(
         uint64_t frameIndex, std::function<void(const std::unique_ptr<C2Work> &)> fillWork) {
@@ -361,8 +451,7 @@ void SimpleC2Component::finish(
     }
     if (work) {
         fillWork(work);
-        std::shared_ptr<C2Component::Listener> listener = mExecState.lock()->mListener;
-        listener->onWorkDone_nb(shared_from_this(), vec(work));
+        sendWork(std::move(work));
         ALOGV("returning pending work");
     }
 }
@@ -387,13 +476,24 @@ void SimpleC2Component::cloneAndSend(
     work->worklets.emplace_back(new C2Worklet);
     if (work) {
         fillWork(work);
-        std::shared_ptr<C2Component::Listener> listener = mExecState.lock()->mListener;
-        listener->onWorkDone_nb(shared_from_this(), vec(work));
+        sendWork(std::move(work));
         ALOGV("cloned and sending work");
     }
 }
 
 bool SimpleC2Component::processQueue() {
+    // Process up to mOutputBatchSize works in this iteration, and return all
+    // completed work to the listener in a single call.
+    bool hasQueuedWork;
+    size_t processed = 0;
+    do {
+        hasQueuedWork = processWork();
+    } while (hasQueuedWork && ++processed < mOutputBatchSize);
+    sendBatchedWork();
+    return hasQueuedWork;
+}
+
+bool SimpleC2Component::processWork() {
     std::unique_ptr<C2Work> work;
     uint64_t generation;
     int32_t drainMode;
@@ -455,6 +555,7 @@ bool SimpleC2Component::processQueue() {
             return err;
         }();
         if (err != C2_OK) {
+            sendBatchedWork();
             Mutexed<ExecState>::Locked state(mExecState);
             std::shared_ptr<C2Component::Listener> listener = state->mListener;
             state.unlock();
@@ -466,6 +567,7 @@ bool SimpleC2Component::processQueue() {
     if (!work) {
         c2_status_t err = drain(drainMode, mOutputBlockPool);
         if (err != C2_OK) {
+            sendBatchedWork();
             Mutexed<ExecState>::Locked state(mExecState);
             std::shared_ptr<C2Component::Listener> listener = state->mListener;
             state.unlock();
@@ -485,6 +587,7 @@ bool SimpleC2Component::processQueue() {
             std::vector<std::unique_ptr<C2SettingResult>> failures;
             c2_status_t err = intf()->config_vb(updates, C2_MAY_BLOCK, &failures);
             ALOGD("applied %zu configUpdates => %s (%d)", updates.size(), asString(err), err);
+            updateOutputBatchSize();
         }
     }
 
@@ -505,22 +608,14 @@ bool SimpleC2Component::processQueue() {
                     queue->generation(), generation);
             work->result = C2_NOT_FOUND;
             queue.unlock();
-            {
-                Mutexed<ExecState>::Locked state(mExecState);
-                std::shared_ptr<C2Component::Listener> listener = state->mListener;
-                state.unlock();
-                listener->onWorkDone_nb(shared_from_this(), vec(work));
-            }
+            sendWork(std::move(work));
             queue.lock();
             return hasQueuedWork;
         }
     }
     if (work->workletsProcessed != 0u) {
-        Mutexed<ExecState>::Locked state(mExecState);
         ALOGV("returning this work");
-        std::shared_ptr<C2Component::Listener> listener = state->mListener;
-        state.unlock();
-        listener->onWorkDone_nb(shared_from_this(), vec(work));
+        sendWork(std::move(work));
     } else {
         ALOGV("queue pending work");
         work->input.buffers.clear();
@@ -537,10 +632,7 @@ bool SimpleC2Component::processQueue() {
         if (unexpected) {
             ALOGD("unexpected pending work");
             unexpected->result = C2_CORRUPTED;
-            Mutexed<ExecState>::Locked state(mExecState);
-            std::shared_ptr<C2Component::Listener> listener = state->mListener;
-            state.unlock();
-            listener->onWorkDone_nb(shared_from_this(), vec(unexpected));
+            sendWork(std::move(unexpected));
         }
     }
     return hasQueuedWork;
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SimpleC2EncoderInput"
+#include <log/log.h>
+
+#include <cstring>
+#include <utility>
+
+#include <SimpleC2EncoderInput.h>
+
+namespace android {
+
+namespace {
+
+// Interleaves the planar U and V planes that follow the Y plane of a |stride| x |vstride| I420
+// image in place, so that the image becomes NV12 (or NV21 if |vFirst|).
+void InterleaveChroma(
+        uint8_t *y, uint32_t stride, uint32_t vstride, uint32_t width, uint32_t height,
+        bool vFirst, MemoryBlock *scratch) {
+    uint8_t *chroma = y + stride * vstride;
+    size_t chromaSize = stride * vstride / 2;
+    memcpy(scratch->data(), chroma, chromaSize);
+    const uint8_t *u = scratch->data();
+    const uint8_t *v = u + chromaSize / 2;
+    if (vFirst) {
+        std::swap(u, v);
+    }
+    for (uint32_t row = 0; row < height / 2; ++row) {
+        uint8_t *dst = chroma + row * stride;
+        for (uint32_t col = 0; col < width / 2; ++col) {
+            dst[2 * col] = u[col];
+            dst[2 * col + 1] = v[col];
+        }
+        u += stride / 2;
+        v += stride / 2;
+    }
+}
+
+}  // namespace
+
+SimpleC2EncoderInput::SimpleC2EncoderInput(const char *name, uint32_t formats, uint32_t flags)
+    : mName(name),
+      mFormats(formats),
+      mFlags(flags),
+      mStats{ 0, 0, 0, 0 } {
+}
+
+SimpleC2EncoderInput::~SimpleC2EncoderInput() {
+    reset();
+}
+
+// static
+uint32_t SimpleC2EncoderInput::GetFormat(const C2GraphicView &view) {
+    if (!IsYUV420(view)) {
+        return 0;
+    }
+    const C2PlanarLayout &layout = view.layout();
+    const C2PlaneInfo &yPlane = layout.planes[C2PlanarLayout::PLANE_Y];
+    const C2PlaneInfo &uPlane = layout.planes[C2PlanarLayout::PLANE_U];
+    const C2PlaneInfo &vPlane = layout.planes[C2PlanarLayout::PLANE_V];
+    if (yPlane.colInc != 1 || yPlane.rowInc <= 0 || uPlane.rowInc != vPlane.rowInc) {
+        return 0;
+    }
+    const uint8_t *u = view.data()[C2PlanarLayout::PLANE_U];
+    const uint8_t *v = view.data()[C2PlanarLayout::PLANE_V];
+    if (uPlane.colInc == 1 && vPlane.colInc == 1) {
+        return FORMAT_I420;
+    }
+    if (uPlane.colInc == 2 && vPlane.colInc == 2) {
+        if (v == u + 1) {
+            return FORMAT_NV12;
+        }
+        if (u == v + 1) {
+            return FORMAT_NV21;
+        }
+    }
+    return 0;
+}
+
+void SimpleC2EncoderInput::setFormats(uint32_t formats) {
+    mFormats = formats;
+}
+
+SimpleC2EncoderInput::format_t SimpleC2EncoderInput::preferredFormat() const {
+    if (mFormats & FORMAT_I420) {
+        return FORMAT_I420;
+    }
+    return (mFormats & FORMAT_NV21) && !(mFormats & FORMAT_NV12) ? FORMAT_NV21 : FORMAT_NV12;
+}
+
+bool SimpleC2EncoderInput::isDirect(
+        const C2GraphicView &view, uint32_t format, uint32_t stride) const {
+    if (!(format & mFormats)) {
+        return false;
+    }
+    const C2PlanarLayout &layout = view.layout();
+    int32_t yStride = layout.planes[C2PlanarLayout::PLANE_Y].rowInc;
+    int32_t uvStride = layout.planes[C2PlanarLayout::PLANE_U].rowInc;
+    if ((mFlags & FLAG_FIXED_STRIDE) && yStride != (int32_t)stride) {
+        return false;
+    }
+    if (mFlags & FLAG_DERIVED_CHROMA_STRIDE) {
+        return format == FORMAT_I420 ? yStride == 2 * uvStride : yStride == uvStride;
+    }
+    return true;
+}
+
+c2_status_t SimpleC2EncoderInput::prepare(
+        const C2GraphicView &view, uint32_t stride, uint32_t vstride,
+        C2Color::matrix_t matrix, C2Color::range_t range, Frame *frame) {
+    const C2PlanarLayout &layout = view.layout();
+    uint32_t format = 0;
+    switch (layout.type) {
+        case C2PlanarLayout::TYPE_RGB:
+            [[fallthrough]];
+        case C2PlanarLayout::TYPE_RGBA:
+            break;
+        case C2PlanarLayout::TYPE_YUV:
+            if (!IsYUV420(view)) {
+                ALOGE("input is not YUV420");
+                return C2_BAD_VALUE;
+            }
+            format = GetFormat(view);
+            break;
+        case C2PlanarLayout::TYPE_YUVA:
+            ALOGE("YUVA plane type is not supported");
+            return C2_BAD_VALUE;
+        default:
+            ALOGE("Unrecognized plane type: %d", layout.type);
+            return C2_BAD_VALUE;
+    }
+
+    ++mStats.frames;
+    if (format && isDirect(view, format, stride)) {
+        // input buffer is supposed to be const but codec APIs want bare pointers
+        frame->format = (format_t)format;
+        for (size_t i = 0; i < 3; ++i) {
+            frame->planes[i] = const_cast<uint8_t *>(view.data()[i]);
+            frame->strides[i] = layout.planes[i].rowInc;
+        }
+        frame->converted = false;
+        ++mStats.direct;
+        return C2_OK;
+    }
+
+    uint32_t width = view.width();
+    uint32_t height = view.height();
+    if (width > stride || height > vstride || (stride & 1) || (vstride & 1)) {
+        ALOGE("cannot convert %ux%u input into %ux%u", width, height, stride, vstride);
+        return C2_BAD_VALUE;
+    }
+    size_t size = (size_t)stride * vstride * 3 / 2;
+    MemoryBlock conversionBuffer = mConversionBuffers.fetch(size);
+    if (conversionBuffer.size() < size) {
+        ALOGE("Unable to allocate conversion buffer of size %zu", size);
+        return C2_NO_MEMORY;
+    }
+
+    format_t target = preferredFormat();
+    uint8_t *y = conversionBuffer.data();
+    uint8_t *chroma = y + stride * vstride;
+    if (layout.type != C2PlanarLayout::TYPE_YUV) {
+        status_t err = ConvertRGBToPlanarYUV(y, stride, vstride, size, view, matrix, range);
+        if (err != OK) {
+            ALOGE("RGB conversion failed: %d", err);
+            return C2_BAD_VALUE;
+        }
+        if (target != FORMAT_I420) {
+            MemoryBlock scratch = mConversionBuffers.fetch(size / 3);
+            if (scratch.size() < size / 3) {
+                ALOGE("Unable to allocate scratch buffer of size %zu", size / 3);
+                return C2_NO_MEMORY;
+            }
+            InterleaveChroma(y, stride, vstride, width, height, target == FORMAT_NV21, &scratch);
+        }
+        ++mStats.rgbConversions;
+    } else {
+        MediaImage2 img = target == FORMAT_I420
+                ? CreateYUV420PlanarMediaImage2(width, height, stride, vstride)
+                : CreateYUV420SemiPlanarMediaImage2(width, height, stride, vstride);
+        if (target == FORMAT_NV21) {
+            std::swap(img.mPlane[1].mOffset, img.mPlane[2].mOffset);
+        }
+        status_t err = ImageCopy(y, &img, view);
+        if (err != OK) {
+            ALOGE("Buffer conversion failed: %d", err);
+            return C2_BAD_VALUE;
+        }
+        ++mStats.yuvConversions;
+    }
+
+    frame->format = target;
+    frame->planes[0] = y;
+    frame->strides[0] = stride;
+    switch (target) {
+        case FORMAT_I420:
+            frame->planes[1] = chroma;
+            frame->planes[2] = chroma + stride * vstride / 4;
+            frame->strides[1] = frame->strides[2] = stride / 2;
+            break;
+        case FORMAT_NV12:
+            frame->planes[1] = chroma;
+            frame->planes[2] = chroma + 1;
+            frame->strides[1] = frame->strides[2] = stride;
+            break;
+        case FORMAT_NV21:
+            frame->planes[1] = chroma + 1;
+            frame->planes[2] = chroma;
+            frame->strides[1] = frame->strides[2] = stride;
+            break;
+    }
+    frame->converted = true;
+    mConversionBuffersInUse.emplace(y, std::move(conversionBuffer));
+    return C2_OK;
+}
+
+void SimpleC2EncoderInput::release(const void *yPlane) {
+    mConversionBuffersInUse.erase(yPlane);
+}
+
+void SimpleC2EncoderInput::reset() {
+    mConversionBuffersInUse.clear();
+    if (mStats.frames > 0) {
+        ALOGD("%s: %llu input frames, %llu direct, %llu YUV conversions, %llu RGB conversions",
+                mName.c_str(), (unsigned long long)mStats.frames,
+                (unsigned long long)mStats.direct, (unsigned long long)mStats.yuvConversions,
+                (unsigned long long)mStats.rgbConversions);
+    }
+    mStats = { 0, 0, 0, 0 };
+}
+
+}  // namespace android
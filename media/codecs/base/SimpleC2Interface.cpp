@@ -167,6 +167,8 @@ SimpleInterface<void>::BaseParams::BaseParams(
             .withSetter(Setter<C2PortBlockPoolsTuning::output>::NonStrictValuesWithNoDeps)
             .build());
 
+    addParameter(DefineOutputBatchSize(mOutputBatchSize, 1u));
+
     // add stateless params
     addParameter(
             DefineParam(mSubscribedParamIndices, C2_PARAMKEY_SUBSCRIBED_PARAM_INDICES)
@@ -298,6 +300,35 @@ void SimpleInterface<void>::BaseParams::noTimeStretch() {
             .build());
 }
 
+// static
+std::shared_ptr<C2InterfaceHelper::ParamHelper>
+SimpleInterface<void>::BaseParams::DefineOutputBatchSize(
+        std::shared_ptr<C2PortBatchSizeTuning::output> &param, uint64_t batchSize) {
+    uint64_t outputBatchSize[1] = { batchSize };
+    return DefineParam(param, C2_PARAMKEY_OUTPUT_BATCH_SIZE)
+            .withDefault(C2PortBatchSizeTuning::output::AllocShared(outputBatchSize))
+            .withFields({ C2F(param, m.values[0]).inRange(0, 16),
+                          C2F(param, m.values).inRange(0, 1) })
+            .withSetter(Setter<C2PortBatchSizeTuning::output>::NonStrictValuesWithNoDeps)
+            .build();
+}
+
+// static
+std::shared_ptr<C2InterfaceHelper::ParamHelper>
+SimpleInterface<void>::BaseParams::DefinePcmEncoding(
+        std::shared_ptr<C2StreamPcmEncodingInfo::output> &param, bool withPcm8) {
+    std::vector<uint32_t> encodings = { C2Config::PCM_16 };
+    if (withPcm8) {
+        encodings.push_back(C2Config::PCM_8);
+    }
+    encodings.push_back(C2Config::PCM_FLOAT);
+    return DefineParam(param, C2_PARAMKEY_PCM_ENCODING)
+            .withDefault(new C2StreamPcmEncodingInfo::output(0u, C2Config::PCM_16))
+            .withFields({ C2F(param, value).oneOf(encodings) })
+            .withSetter(Setter<C2StreamPcmEncodingInfo::output>::StrictValueWithNoDeps)
+            .build();
+}
+
 /*
     Clients need to handle the following base params due to custom dependency.
 
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SimpleC2PcmUtils"
+#include <log/log.h>
+
+#include <math.h>
+
+#include <SimpleC2PcmUtils.h>
+
+namespace android {
+
+size_t GetPcmSampleSize(C2Config::pcm_encoding_t encoding) {
+    switch (encoding) {
+        case C2Config::PCM_8:
+            return sizeof(uint8_t);
+        case C2Config::PCM_16:
+            return sizeof(int16_t);
+        case C2Config::PCM_FLOAT:
+            return sizeof(float);
+        default:
+            return 0;
+    }
+}
+
+void ConvertPcm16ToPcm32(
+        const int16_t *__restrict src, int32_t *__restrict dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+void ConvertFloatToPcm24(const float *__restrict src, int32_t *__restrict dst, size_t count) {
+    constexpr float kScale = 1 << 23;
+    constexpr float kMin = -(1 << 23);
+    constexpr float kMax = (1 << 23) - 1;
+    for (size_t i = 0; i < count; ++i) {
+        float value = src[i] * kScale;
+        // written so that NaN is clamped too
+        value = value > kMin ? value : kMin;
+        value = value < kMax ? value : kMax;
+        dst[i] = lrintf(value);
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SimpleC2ThreadBudget"
+#include <log/log.h>
+
+#include <cutils/properties.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <android-base/stringprintf.h>
+
+#include <SimpleC2ThreadBudget.h>
+
+namespace android {
+
+using ::android::base::StringAppendF;
+
+namespace {
+
+// overrides the number of threads in the budget if positive
+constexpr char kCapacityProperty[] = "debug.stagefright.c2.thread-budget";
+
+// picture area that counts as one unit of weight
+constexpr uint64_t kPixelsPerWeight = 1280 * 720;
+constexpr size_t kMaxWeight = 16;
+
+size_t GetOnlineCoreCount() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores >= 1 ? (size_t)cores : 1u;
+}
+
+size_t GetCapacity() {
+    int32_t capacity = property_get_int32(kCapacityProperty, 0);
+    return capacity > 0 ? (size_t)capacity : GetOnlineCoreCount();
+}
+
+}  // namespace
+
+SimpleC2ThreadBudget::Allocation::Allocation(
+        SimpleC2ThreadBudget *budget, const char *name, size_t maxThreads)
+    : mBudget(budget),
+      mName(name),
+      mMaxThreads(std::max(maxThreads, (size_t)1u)),
+      mWeight(1u),
+      mThreads(1u) {
+}
+
+SimpleC2ThreadBudget::Allocation::~Allocation() {
+    mBudget->release(this);
+}
+
+void SimpleC2ThreadBudget::Allocation::setSize(uint32_t width, uint32_t height) {
+    size_t weight = GetWeight(width, height);
+    std::lock_guard<std::mutex> lock(mBudget->mLock);
+    if (weight != mWeight) {
+        mWeight = weight;
+        mBudget->rebalance_l();
+    }
+}
+
+// static
+SimpleC2ThreadBudget &SimpleC2ThreadBudget::Get() {
+    static SimpleC2ThreadBudget sBudget;
+    return sBudget;
+}
+
+SimpleC2ThreadBudget::SimpleC2ThreadBudget()
+    : mCapacity(GetCapacity()) {
+    ALOGV("thread budget: %zu", mCapacity);
+}
+
+// static
+size_t SimpleC2ThreadBudget::GetWeight(uint32_t width, uint32_t height) {
+    uint64_t pixels = (uint64_t)width * height;
+    return std::min((size_t)((pixels + kPixelsPerWeight - 1) / kPixelsPerWeight), kMaxWeight)
+            ? : 1u;
+}
+
+std::shared_ptr<SimpleC2ThreadBudget::Allocation> SimpleC2ThreadBudget::acquire(
+        const char *name, uint32_t width, uint32_t height, size_t maxThreads) {
+    std::shared_ptr<Allocation> allocation(new Allocation(this, name, maxThreads));
+    std::lock_guard<std::mutex> lock(mLock);
+    allocation->mWeight = GetWeight(width, height);
+    mAllocations.push_back(allocation.get());
+    rebalance_l();
+    return allocation;
+}
+
+void SimpleC2ThreadBudget::release(Allocation *allocation) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mAllocations.remove(allocation);
+    rebalance_l();
+}
+
+void SimpleC2ThreadBudget::rebalance_l() {
+    size_t totalWeight = 0;
+    for (const Allocation *allocation : mAllocations) {
+        totalWeight += allocation->mWeight;
+    }
+    if (totalWeight == 0) {
+        return;
+    }
+
+    // Split the budget proportionally to the weights, giving every allocation at least one
+    // thread even if the budget is oversubscribed, then hand out the threads lost to rounding.
+    std::vector<size_t> shares;
+    shares.reserve(mAllocations.size());
+    size_t assigned = 0;
+    for (const Allocation *allocation : mAllocations) {
+        size_t share = mCapacity * allocation->mWeight / totalWeight;
+        share = std::max(std::min(share, allocation->mMaxThreads), (size_t)1u);
+        shares.push_back(share);
+        assigned += share;
+    }
+    for (bool grew = true; grew && assigned < mCapacity; ) {
+        grew = false;
+        size_t i = 0;
+        for (const Allocation *allocation : mAllocations) {
+            if (assigned < mCapacity && shares[i] < allocation->mMaxThreads) {
+                ++shares[i];
+                ++assigned;
+                grew = true;
+            }
+            ++i;
+        }
+    }
+
+    size_t i = 0;
+    for (Allocation *allocation : mAllocations) {
+        if (allocation->mThreads.exchange(shares[i]) != shares[i]) {
+            ALOGV("%s@%p: %zu threads", allocation->mName.c_str(), allocation, shares[i]);
+        }
+        ++i;
+    }
+}
+
+std::string SimpleC2ThreadBudget::dump() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    std::string out;
+    StringAppendF(&out, "Codec thread budget: %zu threads, %zu allocations\n",
+                  mCapacity, mAllocations.size());
+    for (const Allocation *allocation : mAllocations) {
+        StringAppendF(&out, "  %s@%p: %zu threads (weight %zu, max %zu)\n",
+                      allocation->mName.c_str(), allocation, allocation->threads(),
+                      allocation->mWeight, allocation->mMaxThreads);
+    }
+    return out;
+}
+
+}  // namespace android
+
+size_t SimpleC2ThreadBudget_Dump(char *buf, size_t size) {
+    std::string dump = ::android::SimpleC2ThreadBudget::Get().dump();
+    if (buf && size) {
+        size_t length = std::min(dump.size(), size - 1);
+        memcpy(buf, dump.c_str(), length);
+        buf[length] = '\0';
+    }
+    return dump.size();
+}
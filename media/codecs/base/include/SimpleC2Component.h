@@ -19,13 +19,17 @@
 
 #include <list>
 #include <unordered_map>
+#include <vector>
 
 #include <C2Component.h>
 
 #include <media/stagefright/foundation/AHandler.h>
 #include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/Mutexed.h>
 
+#include <SimpleC2ThreadBudget.h>
+
 namespace android {
 
 class SimpleC2Component
@@ -114,7 +118,7 @@ protected:
      * This method will retrieve the pending work according to |frameIndex| and
      * feed the work into |fillWork| function. |fillWork| must be
      * "non-blocking". Once |fillWork| returns the filled work will be returned
-     * to the client.
+     * to the client, possibly batched with other completed work.
      *
      * \param[in]   frameIndex    the index of the pending work
      * \param[in]   fillWork      the function to fill the retrieved work.
@@ -127,7 +131,7 @@ protected:
      * This method will retrieve and clone the pending or current work according
      * to |frameIndex| and feed the work into |fillWork| function. |fillWork|
      * must be "non-blocking". Once |fillWork| returns the filled work will be
-     * returned to the client.
+     * returned to the client, possibly batched with other completed work.
      *
      * \param[in]   frameIndex    the index of the work
      * \param[in]   currentWork   the current work under processing
@@ -152,6 +156,35 @@ protected:
             const std::shared_ptr<C2GraphicBlock> &block,
             const C2Rect &crop);
 
+    /**
+     * Acquire a share of the process-wide thread budget for the codec
+     * instance, unless the component already holds one.
+     *
+     * The allocation is released when the component is stopped, reset or
+     * released. If the component is started again without onInit(), the
+     * allocation is acquired again with the latest picture size.
+     *
+     * \param[in]   width       picture width
+     * \param[in]   height      picture height
+     * \param[in]   maxThreads  maximum number of threads the codec can use
+     * \return the current allocation
+     */
+    const std::shared_ptr<SimpleC2ThreadBudget::Allocation> &acquireThreads(
+            uint32_t width, uint32_t height, size_t maxThreads);
+
+    /**
+     * Return the current thread allocation, or nullptr if the component does
+     * not hold one.
+     */
+    const std::shared_ptr<SimpleC2ThreadBudget::Allocation> &threadAllocation() const {
+        return mThreadAllocation;
+    }
+
+    /**
+     * Update the picture size of the thread allocation, if any.
+     */
+    void setThreadsSize(uint32_t width, uint32_t height);
+
     static constexpr uint32_t NO_DRAIN = ~0u;
 
     C2ReadView mDummyReadView;
@@ -199,10 +232,20 @@ private:
 
     sp<ALooper> mLooper;
     sp<WorkHandler> mHandler;
+    // Reused for every kWhatProcess post to avoid allocating a message per
+    // queued work.
+    sp<AMessage> mProcessMsg;
 
+    /**
+     * FIFO of queued work and drain markers.
+     *
+     * Entries are kept in a power-of-two sized ring buffer that only grows, so
+     * queueing work does not allocate once the queue has reached its steady
+     * state depth.
+     */
     class WorkQueue {
     public:
-        inline WorkQueue() : mFlush(false), mGeneration(0ul) {}
+        inline WorkQueue() : mFlush(false), mGeneration(0ul), mHead(0u), mSize(0u) {}
 
         inline uint64_t generation() const { return mGeneration; }
         inline void incGeneration() { ++mGeneration; mFlush = true; }
@@ -225,9 +268,15 @@ private:
             uint32_t drainMode;
         };
 
+        static constexpr size_t kInitialCapacity = 16u;
+
         bool mFlush;
         uint64_t mGeneration;
-        std::list<Entry> mQueue;
+        std::vector<Entry> mQueue;
+        size_t mHead;
+        size_t mSize;
+
+        void emplace_back(std::unique_ptr<C2Work> work, uint32_t drainMode);
     };
     Mutexed<WorkQueue> mWorkQueue;
 
@@ -236,6 +285,29 @@ private:
 
     std::shared_ptr<C2BlockPool> mOutputBlockPool;
 
+    // Number of works to process per looper iteration and to return to the
+    // listener together. Accessed only on the looper thread.
+    size_t mOutputBatchSize;
+    std::list<std::unique_ptr<C2Work>> mOutputBatch;
+
+    // Thread allocation of the codec instance, and the request to acquire it
+    // again after a stop. Accessed only on the looper thread.
+    std::shared_ptr<SimpleC2ThreadBudget::Allocation> mThreadAllocation;
+    struct ThreadRequest {
+        bool valid = false;
+        uint32_t width = 0u;
+        uint32_t height = 0u;
+        size_t maxThreads = 0u;
+    } mThreadRequest;
+
+    void releaseThreads(bool keepRequest);
+    void reacquireThreads();
+
+    bool processWork();
+    void updateOutputBatchSize();
+    void sendWork(std::unique_ptr<C2Work> work);
+    void sendBatchedWork();
+
     SimpleC2Component() = delete;
 };
 
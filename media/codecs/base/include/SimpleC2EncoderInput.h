@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_C2_ENCODER_INPUT_H_
+#define SIMPLE_C2_ENCODER_INPUT_H_
+
+#include <map>
+#include <string>
+
+#include <C2Buffer.h>
+#include <C2Config.h>
+#include <Codec2BufferUtils.h>
+
+namespace android {
+
+/**
+ * Adapts input graphic views of a software video encoder to the YUV 4:2:0 layouts its codec
+ * accepts.
+ *
+ * Views whose layout is one of the accepted formats (with compatible strides) are passed to the
+ * codec as they are. Other YUV 4:2:0 and RGB views are converted into a buffer of the preferred
+ * accepted format, which is kept until it is released.
+ *
+ * The adapter counts direct and converted frames, and logs the counts when the session ends.
+ */
+class SimpleC2EncoderInput {
+public:
+    enum format_t : uint32_t {
+        FORMAT_I420 = 1 << 0,   ///< Y plane followed by separate U and V planes
+        FORMAT_NV12 = 1 << 1,   ///< Y plane followed by an interleaved UV plane
+        FORMAT_NV21 = 1 << 2,   ///< Y plane followed by an interleaved VU plane
+    };
+
+    enum flags_t : uint32_t {
+        /** direct frames must have the luma stride passed to prepare() */
+        FLAG_FIXED_STRIDE = 1 << 0,
+        /** the codec derives the chroma stride from the luma stride: half of it for I420 and
+         *  equal to it for NV12 and NV21 */
+        FLAG_DERIVED_CHROMA_STRIDE = 1 << 1,
+    };
+
+    /** A frame as passed to the codec. */
+    struct Frame {
+        format_t format;
+        uint8_t *planes[3];     ///< Y, U and V; U and V point into the same plane for NV12/NV21
+        int32_t strides[3];     ///< row increments of the Y, U and V planes
+        bool converted;         ///< true iff the frame is in a conversion buffer
+    };
+
+    struct Stats {
+        uint64_t frames;        ///< frames prepared
+        uint64_t direct;        ///< frames passed to the codec without conversion
+        uint64_t yuvConversions;
+        uint64_t rgbConversions;
+    };
+
+    /**
+     * \param name      name of the component, for logging
+     * \param formats   formats the codec accepts (a combination of format_t values)
+     * \param flags     stride requirements of the codec (a combination of flags_t values)
+     */
+    SimpleC2EncoderInput(const char *name, uint32_t formats, uint32_t flags = 0);
+    ~SimpleC2EncoderInput();
+
+    /**
+     * \return the format of |view| if it is a YUV 4:2:0 layout matching one of format_t, or 0.
+     */
+    static uint32_t GetFormat(const C2GraphicView &view);
+
+    /**
+     * Changes the formats the codec accepts, e.g. once the codec is configured with the format of
+     * the first frame.
+     */
+    void setFormats(uint32_t formats);
+
+    /**
+     * Prepares |view| for the codec.
+     *
+     * \param view      the input view
+     * \param stride    luma stride of converted frames (and of direct frames if
+     *                  FLAG_FIXED_STRIDE is set)
+     * \param vstride   number of luma rows of converted frames
+     * \param matrix    color matrix used to convert RGB views
+     * \param range     color range used to convert RGB views
+     * \param frame     the frame to pass to the codec
+     *
+     * \retval C2_OK        the frame is prepared
+     * \retval C2_BAD_VALUE the layout of the view is not supported or the view cannot be converted
+     * \retval C2_NO_MEMORY a conversion buffer could not be allocated
+     */
+    c2_status_t prepare(
+            const C2GraphicView &view, uint32_t stride, uint32_t vstride,
+            C2Color::matrix_t matrix, C2Color::range_t range, Frame *frame /* nonnull */);
+
+    /**
+     * Releases the conversion buffer of the frame whose Y plane is at |yPlane|, if any. This must
+     * be called once the codec no longer reads a converted frame.
+     */
+    void release(const void *yPlane);
+
+    /**
+     * Releases all conversion buffers, logs the counts of this session and resets them.
+     */
+    void reset();
+
+    const Stats &stats() const { return mStats; }
+
+private:
+    bool isDirect(const C2GraphicView &view, uint32_t format, uint32_t stride) const;
+    format_t preferredFormat() const;
+
+    const std::string mName;
+    uint32_t mFormats;
+    const uint32_t mFlags;
+    MemoryBlockPool mConversionBuffers;
+    std::map<const void *, MemoryBlock> mConversionBuffersInUse;
+    Stats mStats;
+};
+
+}  // namespace android
+
+#endif  // SIMPLE_C2_ENCODER_INPUT_H_
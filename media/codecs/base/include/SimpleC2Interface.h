@@ -123,6 +123,18 @@ public:
         /// must add support for C2ComponentTimeStretchTuning.
         void noTimeStretch();
 
+        /// Defines C2PortBatchSizeTuning::output with a default of |batchSize|. Up to 16 works
+        /// may be completed together (see SimpleC2Component); 0 or 1 means no batching.
+        /// Components that do not derive from BaseParams add the returned parameter themselves.
+        static std::shared_ptr<ParamHelper> DefineOutputBatchSize(
+                std::shared_ptr<C2PortBatchSizeTuning::output> &param, uint64_t batchSize);
+
+        /// Defines C2StreamPcmEncodingInfo::output for audio decoders, defaulting to PCM_16 and
+        /// also offering PCM_FLOAT, and PCM_8 if |withPcm8| is set. Only decoders whose library
+        /// produces float or wider samples should use this.
+        static std::shared_ptr<ParamHelper> DefinePcmEncoding(
+                std::shared_ptr<C2StreamPcmEncodingInfo::output> &param, bool withPcm8 = false);
+
         std::shared_ptr<C2ApiLevelSetting> mApiLevel;
         std::shared_ptr<C2ApiFeaturesSetting> mApiFeatures;
 
@@ -161,6 +173,7 @@ public:
         std::shared_ptr<C2SubscribedParamIndicesTuning> mSubscribedParamIndices;
         std::shared_ptr<C2PortSuggestedBufferCountTuning::input> mSuggestedInputBufferCount;
         std::shared_ptr<C2PortSuggestedBufferCountTuning::output> mSuggestedOutputBufferCount;
+        std::shared_ptr<C2PortBatchSizeTuning::output> mOutputBatchSize;
 
         std::shared_ptr<C2CurrentWorkTuning> mCurrentWorkOrdinal;
         std::shared_ptr<C2LastWorkQueuedTuning::input> mLastInputQueuedWorkOrdinal;
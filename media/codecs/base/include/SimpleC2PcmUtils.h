@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_C2_PCM_UTILS_H_
+#define SIMPLE_C2_PCM_UTILS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <C2Config.h>
+
+namespace android {
+
+/**
+ * \return the size in bytes of one sample of |encoding|, or 0 if the encoding is not known.
+ */
+size_t GetPcmSampleSize(C2Config::pcm_encoding_t encoding);
+
+/**
+ * Converts |count| 16-bit samples at |src| into 32-bit samples of the same value at |dst|. The
+ * buffers must not overlap, which lets the compiler vectorize the conversion.
+ */
+void ConvertPcm16ToPcm32(const int16_t *src, int32_t *dst, size_t count);
+
+/**
+ * Converts |count| float samples at |src| into 24-bit samples (in 32-bit words) at |dst|,
+ * rounding to nearest and clamping samples outside of [-1, 1). The buffers must not overlap.
+ */
+void ConvertFloatToPcm24(const float *src, int32_t *dst, size_t count);
+
+}  // namespace android
+
+#endif  // SIMPLE_C2_PCM_UTILS_H_
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMPLE_C2_THREAD_BUDGET_H_
+#define SIMPLE_C2_THREAD_BUDGET_H_
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace android {
+
+/**
+ * Process-wide budget of codec worker threads shared by software components.
+ *
+ * Each component holds an allocation while it is running (see
+ * SimpleC2Component::acquireThreads()) and configures its codec with the allocated thread count. The budget (by default the number of online CPU
+ * cores) is split among the live allocations proportionally to their weight, which grows with the
+ * picture size, and is rebalanced whenever an allocation is acquired, released or resized.
+ *
+ * Codecs usually only accept a thread count when they are (re)initialized, so components pick up
+ * a rebalanced share at the next such point, e.g. on flush or resolution change.
+ */
+class SimpleC2ThreadBudget {
+public:
+    class Allocation {
+    public:
+        ~Allocation();
+
+        /**
+         * \return the number of threads currently allocated, which is at least 1.
+         */
+        size_t threads() const { return mThreads.load(std::memory_order_relaxed); }
+
+        /**
+         * Updates the picture size handled by the component, and rebalances the budget if the
+         * weight of this allocation changes.
+         */
+        void setSize(uint32_t width, uint32_t height);
+
+    private:
+        friend class SimpleC2ThreadBudget;
+        Allocation(SimpleC2ThreadBudget *budget, const char *name, size_t maxThreads);
+
+        SimpleC2ThreadBudget *const mBudget;
+        const std::string mName;
+        const size_t mMaxThreads;
+        size_t mWeight;  // protected by mBudget->mLock
+        std::atomic<size_t> mThreads;
+    };
+
+    /**
+     * \return the process-wide budget.
+     */
+    static SimpleC2ThreadBudget &Get();
+
+    /**
+     * Acquires an allocation for a codec instance.
+     *
+     * \param name          name of the component, for dumping
+     * \param width         initial picture width
+     * \param height        initial picture height
+     * \param maxThreads    maximum number of threads the codec can use
+     */
+    std::shared_ptr<Allocation> acquire(
+            const char *name, uint32_t width, uint32_t height, size_t maxThreads);
+
+    /**
+     * \return the total number of threads in the budget.
+     */
+    size_t capacity() const { return mCapacity; }
+
+    /**
+     * \return a human readable description of the current allocations.
+     */
+    std::string dump() const;
+
+private:
+    SimpleC2ThreadBudget();
+
+    static size_t GetWeight(uint32_t width, uint32_t height);
+    void release(Allocation *allocation);
+    void rebalance_l();
+
+    const size_t mCapacity;
+    mutable std::mutex mLock;
+    std::list<Allocation *> mAllocations;
+};
+
+}  // namespace android
+
+/**
+ * Writes SimpleC2ThreadBudget::dump() into |buf| of |size| bytes, always null-terminated.
+ *
+ * This is exported so that the codec service can include the budget in its debug dump without
+ * depending on this library.
+ *
+ * \return the length of the full dump, excluding the terminating null.
+ */
+extern "C" size_t SimpleC2ThreadBudget_Dump(char *buf, size_t size);
+
+#endif  // SIMPLE_C2_THREAD_BUDGET_H_
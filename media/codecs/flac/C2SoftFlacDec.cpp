@@ -83,8 +83,12 @@ public:
                 DefineParam(mInputMaxBufSize, C2_PARAMKEY_INPUT_MAX_BUFFER_SIZE)
                 .withConstValue(new C2StreamMaxBufferSizeInfo::input(0u, 32768))
                 .build());
+
+        addParameter(SimpleInterface<void>::BaseParams::DefinePcmEncoding(mPcmEncodingInfo));
     }
 
+    C2Config::pcm_encoding_t getPcmEncoding() const { return mPcmEncodingInfo->value; }
+
 private:
     std::shared_ptr<C2StreamFormatConfig::input> mInputFormat;
     std::shared_ptr<C2StreamFormatConfig::output> mOutputFormat;
@@ -94,6 +98,7 @@ private:
     std::shared_ptr<C2StreamChannelCountInfo::output> mChannelCount;
     std::shared_ptr<C2BitrateTuning::input> mBitrate;
     std::shared_ptr<C2StreamMaxBufferSizeInfo::input> mInputMaxBufSize;
+    std::shared_ptr<C2StreamPcmEncodingInfo::output> mPcmEncodingInfo;
 };
 
 C2SoftFlacDec::C2SoftFlacDec(
@@ -142,9 +147,9 @@ status_t C2SoftFlacDec::initDecoder() {
     if (mFLACDecoder) {
         delete mFLACDecoder;
     }
-    mFLACDecoder = FLACDecoder::Create();
+    mFLACDecoder = FlacFrameDecoder::Create();
     if (!mFLACDecoder) {
-        ALOGE("initDecoder: failed to create FLACDecoder");
+        ALOGE("initDecoder: failed to create FlacFrameDecoder");
         mSignalledError = true;
         return NO_MEMORY;
     }
@@ -165,7 +170,7 @@ static void fillEmptyWork(const std::unique_ptr<C2Work> &work) {
     work->workletsProcessed = 1u;
 }
 
-// (TODO) add multiframe support, in plugin and FLACDecoder.cpp
+// (TODO) add multiframe support, in plugin and FlacFrameDecoder.cpp
 void C2SoftFlacDec::process(
         const std::unique_ptr<C2Work> &work,
         const std::shared_ptr<C2BlockPool> &pool) {
@@ -216,7 +221,7 @@ void C2SoftFlacDec::process(
     if (codecConfig) {
         status_t decoderErr = mFLACDecoder->parseMetadata(input, inSize);
         if (decoderErr != OK && decoderErr != WOULD_BLOCK) {
-            ALOGE("process: FLACDecoder parseMetaData returns error %d", decoderErr);
+            ALOGE("process: FlacFrameDecoder parseMetadata returns error %d", decoderErr);
             mSignalledError = true;
             work->result = C2_CORRUPTED;
             return;
@@ -263,11 +268,13 @@ void C2SoftFlacDec::process(
         return;
     }
 
+    bool outputFloat = mIntf->getPcmEncoding() == C2Config::PCM_FLOAT;
+    size_t sampleSize = outputFloat ? sizeof(float) : sizeof(short);
     size_t outSize;
     if (mHasStreamInfo)
-        outSize = mStreamInfo.max_blocksize * mStreamInfo.channels * sizeof(short);
+        outSize = mStreamInfo.max_blocksize * mStreamInfo.channels * sampleSize;
     else
-        outSize = kMaxBlockSize * FLACDecoder::kMaxChannels * sizeof(short);
+        outSize = kMaxBlockSize * FlacFrameDecoder::kMaxChannels * sampleSize;
 
     std::shared_ptr<C2LinearBlock> block;
     C2MemoryUsage usage = { C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE };
@@ -284,11 +291,10 @@ void C2SoftFlacDec::process(
         return;
     }
 
-    short *output = reinterpret_cast<short *>(wView.data());
     status_t decoderErr = mFLACDecoder->decodeOneFrame(
-                            input, inSize, output, &outSize);
+                            input, inSize, outputFloat, wView.data(), &outSize);
     if (decoderErr != OK) {
-        ALOGE("process: FLACDecoder decodeOneFrame returns error %d", decoderErr);
+        ALOGE("process: FlacFrameDecoder decodeOneFrame returns error %d", decoderErr);
         mSignalledError = true;
         work->result = C2_CORRUPTED;
         return;
@@ -19,7 +19,7 @@
 
 #include <SimpleC2Component.h>
 
-#include "FLACDecoder.h"
+#include "FlacFrameDecoder.h"
 
 namespace android {
 
@@ -49,7 +49,7 @@ private:
     };
 
     std::shared_ptr<IntfImpl> mIntf;
-    FLACDecoder *mFLACDecoder;
+    FlacFrameDecoder *mFLACDecoder;
     FLAC__StreamMetadata_StreamInfo mStreamInfo;
     bool mSignalledError;
     bool mSignalledOutputEos;
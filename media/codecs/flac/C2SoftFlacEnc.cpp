@@ -22,11 +22,14 @@
 
 #include <C2PlatformSupport.h>
 #include <SimpleC2Interface.h>
+#include <SimpleC2PcmUtils.h>
 
 #include "C2SoftFlacEnc.h"
 
 namespace android {
 
+constexpr size_t kMaxThreads = 16;
+
 class C2SoftFlacEnc::IntfImpl : public C2InterfaceHelper {
 public:
     explicit IntfImpl(const std::shared_ptr<C2ReflectorHelper> &helper)
@@ -72,11 +75,26 @@ public:
                 DefineParam(mInputMaxBufSize, C2_PARAMKEY_INPUT_MAX_BUFFER_SIZE)
                 .withConstValue(new C2StreamMaxBufferSizeInfo::input(0u, 4608))
                 .build());
+        addParameter(
+                DefineParam(mPcmEncoding, C2_PARAMKEY_PCM_ENCODING)
+                .withDefault(new C2StreamPcmEncodingInfo::input(0u, C2Config::PCM_16))
+                .withFields({C2F(mPcmEncoding, value).oneOf({
+                        C2Config::PCM_16, C2Config::PCM_FLOAT })})
+                .withSetter((Setter<decltype(*mPcmEncoding)>::StrictValueWithNoDeps))
+                .build());
+        addParameter(
+                DefineParam(mThreads, C2_PARAMKEY_FLAC_ENCODER_THREADS)
+                .withDefault(new C2FlacEncoderThreadsTuning(1u))
+                .withFields({ C2F(mThreads, value).inRange(0, kMaxThreads) })
+                .withSetter(Setter<decltype(*mThreads)>::StrictValueWithNoDeps)
+                .build());
     }
 
     uint32_t getSampleRate() const { return mSampleRate->value; }
     uint32_t getChannelCount() const { return mChannelCount->value; }
     uint32_t getBitrate() const { return mBitrate->value; }
+    C2Config::pcm_encoding_t getPcmEncoding() const { return mPcmEncoding->value; }
+    uint32_t getThreads() const { return mThreads->value; }
 
 private:
     std::shared_ptr<C2StreamFormatConfig::input> mInputFormat;
@@ -87,6 +105,8 @@ private:
     std::shared_ptr<C2StreamChannelCountInfo::input> mChannelCount;
     std::shared_ptr<C2BitrateTuning::output> mBitrate;
     std::shared_ptr<C2StreamMaxBufferSizeInfo::input> mInputMaxBufSize;
+    std::shared_ptr<C2StreamPcmEncodingInfo::input> mPcmEncoding;
+    std::shared_ptr<C2FlacEncoderThreadsTuning> mThreads;
 };
 constexpr char COMPONENT_NAME[] = "c2.android.flac.encoder";
 
@@ -97,7 +117,8 @@ C2SoftFlacEnc::C2SoftFlacEnc(
     : SimpleC2Component(std::make_shared<SimpleInterface<IntfImpl>>(name, id, intfImpl)),
       mIntf(intfImpl),
       mFlacStreamEncoder(nullptr),
-      mInputBufferPcm32(nullptr) {
+      mPcmEncoding(C2Config::PCM_16),
+      mBitsPerSample(16) {
 }
 
 C2SoftFlacEnc::~C2SoftFlacEnc() {
@@ -108,10 +129,6 @@ c2_status_t C2SoftFlacEnc::onInit() {
     mFlacStreamEncoder = FLAC__stream_encoder_new();
     if (!mFlacStreamEncoder) return C2_CORRUPTED;
 
-    mInputBufferPcm32 = (FLAC__int32*) malloc(
-            kInBlockSize * kMaxNumChannels * sizeof(FLAC__int32));
-    if (!mInputBufferPcm32) return C2_NO_MEMORY;
-
     mSignalledError = false;
     mSignalledOutputEos = false;
     mCompressionLevel = FLAC_COMPRESSION_LEVEL_DEFAULT;
@@ -133,10 +150,8 @@ void C2SoftFlacEnc::onRelease() {
         mFlacStreamEncoder = nullptr;
     }
 
-    if (mInputBufferPcm32) {
-        free(mInputBufferPcm32);
-        mInputBufferPcm32 = nullptr;
-    }
+    mParallelEncoder.reset();
+    mInputBufferPcm32.clear();
 }
 
 void C2SoftFlacEnc::onReset() {
@@ -228,8 +243,12 @@ void C2SoftFlacEnc::process(
     uint32_t channelCount = mIntf->getChannelCount();
     uint64_t outTimeStamp = mProcessedSamples * 1000000ll / sampleRate;
 
-    size_t outCapacity = inSize;
-    outCapacity += mBlockSize * channelCount * sizeof(int16_t);
+    size_t sampleSize = GetPcmSampleSize(mPcmEncoding);
+    size_t inSamples = inSize / (channelCount * sampleSize) * channelCount;
+
+    // the encoder holds back up to a block, and the parallel encoder also the pending samples
+    size_t outCapacity = (mInputBufferPcm32.size() + inSamples + mBlockSize * channelCount)
+            * (mBitsPerSample / 8);
 
     C2MemoryUsage usage = { C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE };
     c2_status_t err = pool->fetchLinearBlock(outCapacity, usage, &mOutputBlock);
@@ -247,29 +266,22 @@ void C2SoftFlacEnc::process(
 
     mEncoderWriteData = true;
     mEncoderReturnedNbBytes = 0;
-    size_t inPos = 0;
-    while (inPos < inSize) {
-        const uint8_t *inPtr = rView.data() + inOffset;
-        size_t processSize = MIN(kInBlockSize * channelCount * sizeof(int16_t), (inSize - inPos));
-        const unsigned nbInputFrames = processSize / (channelCount * sizeof(int16_t));
-        const unsigned nbInputSamples = processSize / sizeof(int16_t);
-        const int16_t *pcm16 = reinterpret_cast<const int16_t *>(inPtr + inPos);
-        ALOGV("about to encode %zu bytes", processSize);
-
-        for (unsigned i = 0; i < nbInputSamples; i++) {
-            mInputBufferPcm32[i] = (FLAC__int32) pcm16[i];
-        }
-
-        FLAC__bool ok = FLAC__stream_encoder_process_interleaved(
-                mFlacStreamEncoder, mInputBufferPcm32, nbInputFrames);
-        if (!ok) {
-            ALOGE("error encountered during encoding");
-            mSignalledError = true;
-            work->result = C2_CORRUPTED;
-            mOutputBlock.reset();
-            return;
-        }
-        inPos += processSize;
+    size_t inPos = mInputBufferPcm32.size();
+    mInputBufferPcm32.resize(inPos + inSamples);
+    if (mPcmEncoding == C2Config::PCM_FLOAT) {
+        ConvertFloatToPcm24(reinterpret_cast<const float *>(rView.data() + inOffset),
+                            mInputBufferPcm32.data() + inPos, inSamples);
+    } else {
+        ConvertPcm16ToPcm32(reinterpret_cast<const int16_t *>(rView.data() + inOffset),
+                            mInputBufferPcm32.data() + inPos, inSamples);
+    }
+    ALOGV("about to encode %zu bytes", inSize);
+    if (!encodeInput(eos)) {
+        ALOGE("error encountered during encoding");
+        mSignalledError = true;
+        work->result = C2_CORRUPTED;
+        mOutputBlock.reset();
+        return;
     }
     if (eos && (C2_OK != drain(DRAIN_COMPONENT_WITH_EOS, pool))) {
         ALOGE("error encountered during encoding");
@@ -295,6 +307,35 @@ void C2SoftFlacEnc::process(
     mEncoderReturnedNbBytes = 0;
 }
 
+bool C2SoftFlacEnc::encodeInput(bool eos) {
+    uint32_t channelCount = mIntf->getChannelCount();
+    if (!mParallelEncoder) {
+        FLAC__bool ok = FLAC__stream_encoder_process_interleaved(
+                mFlacStreamEncoder, mInputBufferPcm32.data(),
+                mInputBufferPcm32.size() / channelCount);
+        mInputBufferPcm32.clear();
+        return ok;
+    }
+
+    // encode whole batches of blocks so that every thread has several blocks to encode, and
+    // whatever is left at the end of the stream
+    size_t batchSize = mBlockSize * channelCount * kParallelBlocksPerThread
+            * mParallelEncoder->threads();
+    size_t size = eos ? mInputBufferPcm32.size()
+                      : mInputBufferPcm32.size() / batchSize * batchSize;
+    if (size == 0) {
+        return true;
+    }
+    bool ok = mParallelEncoder->encode(
+            mInputBufferPcm32.data(), size / channelCount,
+            [this](const FLAC__byte buffer[], size_t bytes, unsigned samples,
+                   unsigned current_frame) {
+                return onEncodedFlacAvailable(buffer, bytes, samples, current_frame);
+            });
+    mInputBufferPcm32.erase(mInputBufferPcm32.begin(), mInputBufferPcm32.begin() + size);
+    return ok;
+}
+
 FLAC__StreamEncoderWriteStatus C2SoftFlacEnc::onEncodedFlacAvailable(
         const FLAC__byte buffer[], size_t bytes, unsigned samples,
         unsigned current_frame) {
@@ -342,12 +383,23 @@ status_t C2SoftFlacEnc::configureEncoder() {
         return UNKNOWN_ERROR;
     }
 
-    FLAC__bool ok = true;
-    ok = ok && FLAC__stream_encoder_set_channels(mFlacStreamEncoder, mIntf->getChannelCount());
-    ok = ok && FLAC__stream_encoder_set_sample_rate(mFlacStreamEncoder, mIntf->getSampleRate());
-    ok = ok && FLAC__stream_encoder_set_bits_per_sample(mFlacStreamEncoder, 16);
-    ok = ok && FLAC__stream_encoder_set_compression_level(mFlacStreamEncoder, mCompressionLevel);
-    ok = ok && FLAC__stream_encoder_set_verify(mFlacStreamEncoder, false);
+    uint32_t channelCount = mIntf->getChannelCount();
+    uint32_t sampleRate = mIntf->getSampleRate();
+    // there is no 24-bit PCM encoding, so float input is encoded with 24 bits per sample
+    mPcmEncoding = mIntf->getPcmEncoding();
+    mBitsPerSample = mPcmEncoding == C2Config::PCM_FLOAT ? 24 : 16;
+    uint32_t bitsPerSample = mBitsPerSample;
+    uint32_t compressionLevel = mCompressionLevel;
+    // the STREAMINFO block is never rewritten without a seek callback, so skip the MD5 signature
+    FlacParallelEncoder::ConfigureFn configure = [=](FLAC__StreamEncoder *encoder) -> bool {
+        return FLAC__stream_encoder_set_channels(encoder, channelCount)
+                && FLAC__stream_encoder_set_sample_rate(encoder, sampleRate)
+                && FLAC__stream_encoder_set_bits_per_sample(encoder, bitsPerSample)
+                && FLAC__stream_encoder_set_compression_level(encoder, compressionLevel)
+                && FLAC__stream_encoder_set_verify(encoder, false)
+                && FLAC__stream_encoder_set_do_md5(encoder, false);
+    };
+    FLAC__bool ok = configure(mFlacStreamEncoder);
     if (!ok) {
         ALOGE("unknown error when configuring encoder");
         return UNKNOWN_ERROR;
@@ -367,6 +419,22 @@ status_t C2SoftFlacEnc::configureEncoder() {
     }
 
     mBlockSize = FLAC__stream_encoder_get_blocksize(mFlacStreamEncoder);
+    mInputBufferPcm32.clear();
+
+    // the encoder above still writes the header; the frames come from the parallel encoder
+    uint32_t threads = mIntf->getThreads();
+    if (threads == 0) {
+        threads = acquireThreads(0, 0, kMaxThreads)->threads();
+    }
+    mParallelEncoder.reset();
+    if (threads > 1) {
+        mParallelEncoder.reset(
+                new FlacParallelEncoder(threads, channelCount, mBlockSize, configure));
+        if (!mParallelEncoder->initCheck()) {
+            ALOGW("cannot create %u encoders; encoding on a single thread", threads);
+            mParallelEncoder.reset();
+        }
+    }
 
     ALOGV("encoder successfully configured");
     return OK;
@@ -406,6 +474,8 @@ c2_status_t C2SoftFlacEnc::drain(
     }
     FLAC__bool ok = FLAC__stream_encoder_finish(mFlacStreamEncoder);
     if (!ok) return C2_CORRUPTED;
+    mInputBufferPcm32.clear();
+    if (mParallelEncoder) mParallelEncoder->reset();
     mIsFirstFrame = true;
     mAnchorTimeStamp = 0ull;
     mProcessedSamples = 0u;
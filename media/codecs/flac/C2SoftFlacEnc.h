@@ -17,9 +17,13 @@
 #ifndef ANDROID_C2_SOFT_FLAC_ENC_H_
 #define ANDROID_C2_SOFT_FLAC_ENC_H_
 
+#include <memory>
+#include <vector>
+
 #include <SimpleC2Component.h>
 
 #include "FLAC/stream_encoder.h"
+#include "FlacParallelEncoder.h"
 
 #define FLAC_COMPRESSION_LEVEL_MIN     0
 #define FLAC_COMPRESSION_LEVEL_DEFAULT 5
@@ -31,6 +35,23 @@
 
 namespace android {
 
+enum : C2Param::type_index_t {
+    // kept clear of the vendor indices of the other software components
+    kParamIndexFlacEncoderThreads = C2Param::TYPE_INDEX_VENDOR_START + 0x100,
+};
+
+/**
+ * Number of threads encoding FLAC frames in parallel. 1 (the default) encodes on the component
+ * thread as frames arrive; more threads (up to 16) buffer input until each thread has several
+ * blocks to encode, which adds latency. 0 means the share of the process-wide codec thread budget
+ * (see SimpleC2ThreadBudget).
+ *
+ * This only takes effect when the component is (re)started.
+ */
+typedef C2GlobalParam<C2Tuning, C2Uint32Value, kParamIndexFlacEncoderThreads>
+        C2FlacEncoderThreadsTuning;
+constexpr char C2_PARAMKEY_FLAC_ENCODER_THREADS[] = "vendor.flac-encoder.threads";
+
 class C2SoftFlacEnc : public SimpleC2Component {
 public:
     class IntfImpl;
@@ -53,6 +74,7 @@ public:
 
 private:
     status_t configureEncoder();
+    bool encodeInput(bool eos);
     static FLAC__StreamEncoderWriteStatus flacEncoderWriteCallback(
             const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[],
             size_t bytes, unsigned samples, unsigned current_frame,
@@ -62,10 +84,13 @@ private:
             unsigned current_frame);
 
     std::shared_ptr<IntfImpl> mIntf;
-    const unsigned int kInBlockSize = 1152;
-    const unsigned int kMaxNumChannels = 2;
+    const unsigned int kParallelBlocksPerThread = 8;
     FLAC__StreamEncoder* mFlacStreamEncoder;
-    FLAC__int32* mInputBufferPcm32;
+    std::unique_ptr<FlacParallelEncoder> mParallelEncoder;
+    // interleaved input samples not passed to the encoder yet
+    std::vector<FLAC__int32> mInputBufferPcm32;
+    C2Config::pcm_encoding_t mPcmEncoding;
+    uint32_t mBitsPerSample;
     std::shared_ptr<C2LinearBlock> mOutputBlock;
     bool mSignalledError;
     bool mSignalledOutputEos;
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FlacFrameDecoder"
+#include <log/log.h>
+
+#include <math.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "FlacFrameDecoder.h"
+
+namespace android {
+
+namespace {
+
+constexpr uint8_t kMarker[] = { 'f', 'L', 'a', 'C' };
+
+/**
+ * Finds the end of the last metadata block in |data|, which starts with the "fLaC" marker.
+ *
+ * \return OK and the size of the marker and all metadata blocks in |*metadataSize|, WOULD_BLOCK
+ *         if the last metadata block is not complete yet, or BAD_VALUE if there is no marker.
+ */
+status_t GetMetadataSize(const uint8_t *data, size_t size, size_t *metadataSize) {
+    if (memcmp(data, kMarker, std::min(size, sizeof(kMarker)))) {
+        return BAD_VALUE;
+    }
+    size_t pos = sizeof(kMarker);
+    // each block header holds a last-block flag, a type and a 24-bit length
+    while (pos + 4 <= size) {
+        bool last = data[pos] & 0x80;
+        pos += 4 + (data[pos + 1] << 16 | data[pos + 2] << 8 | data[pos + 3]);
+        if (last) {
+            if (pos > size) {
+                break;
+            }
+            *metadataSize = pos;
+            return OK;
+        }
+    }
+    return WOULD_BLOCK;
+}
+
+}  // namespace
+
+// static
+FlacFrameDecoder *FlacFrameDecoder::Create() {
+    std::unique_ptr<FlacFrameDecoder> decoder(new FlacFrameDecoder);
+    if (!decoder->mDecoder) {
+        ALOGE("failed to create decoder");
+        return nullptr;
+    }
+    FLAC__StreamDecoderInitStatus status = FLAC__stream_decoder_init_stream(
+            decoder->mDecoder, ReadCallback, nullptr /* seek_callback */,
+            nullptr /* tell_callback */, nullptr /* length_callback */,
+            nullptr /* eof_callback */, WriteCallback, MetadataCallback, ErrorCallback,
+            decoder.get());
+    if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+        ALOGE("failed to initialize decoder: %s", FLAC__StreamDecoderInitStatusString[status]);
+        return nullptr;
+    }
+    return decoder.release();
+}
+
+FlacFrameDecoder::FlacFrameDecoder()
+    : mDecoder(FLAC__stream_decoder_new()),
+      mHasStreamInfo(false),
+      mInput(nullptr),
+      mInputSize(0),
+      mOutputFloat(false),
+      mOutput(nullptr),
+      mOutputCapacity(0),
+      mOutputSize(0),
+      mError(false) {
+    memset(&mStreamInfo, 0, sizeof(mStreamInfo));
+}
+
+FlacFrameDecoder::~FlacFrameDecoder() {
+    if (mDecoder) {
+        FLAC__stream_decoder_delete(mDecoder);
+    }
+}
+
+status_t FlacFrameDecoder::parseMetadata(const uint8_t *data, size_t size) {
+    mMetadata.insert(mMetadata.end(), data, data + size);
+    size_t metadataSize = 0;
+    status_t err = GetMetadataSize(mMetadata.data(), mMetadata.size(), &metadataSize);
+    if (err == WOULD_BLOCK) {
+        return err;
+    } else if (err != OK) {
+        ALOGE("codec config data does not start with a FLAC marker");
+        mMetadata.clear();
+        return err;
+    }
+    if (metadataSize < mMetadata.size()) {
+        ALOGW("ignoring %zu bytes after metadata", mMetadata.size() - metadataSize);
+    }
+
+    if (FLAC__stream_decoder_get_state(mDecoder) != FLAC__STREAM_DECODER_SEARCH_FOR_METADATA) {
+        // codec config data of a new stream
+        FLAC__stream_decoder_reset(mDecoder);
+    }
+    memset(&mStreamInfo, 0, sizeof(mStreamInfo));
+    mHasStreamInfo = false;
+    mError = false;
+    mInput = mMetadata.data();
+    mInputSize = metadataSize;
+    bool ok = FLAC__stream_decoder_process_until_end_of_metadata(mDecoder);
+    mInput = nullptr;
+    mInputSize = 0;
+    mMetadata.clear();
+
+    FLAC__StreamDecoderState state = FLAC__stream_decoder_get_state(mDecoder);
+    if (!ok || mError || !mHasStreamInfo || state != FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC) {
+        ALOGE("failed to parse metadata: %s", FLAC__StreamDecoderStateString[state]);
+        mHasStreamInfo = false;
+        FLAC__stream_decoder_reset(mDecoder);
+        return BAD_VALUE;
+    }
+    return OK;
+}
+
+status_t FlacFrameDecoder::decodeOneFrame(
+        const uint8_t *data, size_t size, bool outputFloat, void *out, size_t *outSize) {
+    if (!mHasStreamInfo) {
+        ALOGE("cannot decode a frame before the metadata");
+        return NO_INIT;
+    }
+    mError = false;
+    mInput = data;
+    mInputSize = size;
+    mOutputFloat = outputFloat;
+    mOutput = out;
+    mOutputCapacity = *outSize;
+    mOutputSize = 0;
+    bool ok = FLAC__stream_decoder_process_single(mDecoder);
+    ALOGW_IF(ok && mInputSize, "ignoring %zu bytes after frame", mInputSize);
+    mInput = nullptr;
+    mInputSize = 0;
+    mOutput = nullptr;
+
+    if (!ok || mError || mOutputSize == 0) {
+        ALOGE("failed to decode frame: %s",
+              FLAC__StreamDecoderStateString[FLAC__stream_decoder_get_state(mDecoder)]);
+        FLAC__stream_decoder_flush(mDecoder);
+        return BAD_VALUE;
+    }
+    *outSize = mOutputSize;
+    return OK;
+}
+
+void FlacFrameDecoder::flush() {
+    mMetadata.clear();
+    if (mHasStreamInfo) {
+        FLAC__stream_decoder_flush(mDecoder);
+    } else {
+        FLAC__stream_decoder_reset(mDecoder);
+    }
+}
+
+// static
+FLAC__StreamDecoderReadStatus FlacFrameDecoder::ReadCallback(
+        const FLAC__StreamDecoder *, FLAC__byte buffer[], size_t *bytes, void *client_data) {
+    FlacFrameDecoder *decoder = (FlacFrameDecoder *)client_data;
+    if (decoder->mInputSize == 0) {
+        // the frame or metadata is truncated
+        *bytes = 0;
+        return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+    }
+    size_t size = std::min(*bytes, decoder->mInputSize);
+    memcpy(buffer, decoder->mInput, size);
+    decoder->mInput += size;
+    decoder->mInputSize -= size;
+    *bytes = size;
+    return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+// static
+FLAC__StreamDecoderWriteStatus FlacFrameDecoder::WriteCallback(
+        const FLAC__StreamDecoder *, const FLAC__Frame *frame,
+        const FLAC__int32 *const buffer[], void *client_data) {
+    return ((FlacFrameDecoder *)client_data)->write(frame, buffer);
+}
+
+// static
+void FlacFrameDecoder::MetadataCallback(
+        const FLAC__StreamDecoder *, const FLAC__StreamMetadata *metadata, void *client_data) {
+    FlacFrameDecoder *decoder = (FlacFrameDecoder *)client_data;
+    if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
+        decoder->mStreamInfo = metadata->data.stream_info;
+        decoder->mHasStreamInfo = true;
+    }
+}
+
+// static
+void FlacFrameDecoder::ErrorCallback(
+        const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus status, void *client_data) {
+    ALOGE("decoder error: %s", FLAC__StreamDecoderErrorStatusString[status]);
+    ((FlacFrameDecoder *)client_data)->mError = true;
+}
+
+FLAC__StreamDecoderWriteStatus FlacFrameDecoder::write(
+        const FLAC__Frame *frame, const FLAC__int32 *const buffer[]) {
+    const unsigned channels = frame->header.channels;
+    const unsigned samples = frame->header.blocksize;
+    const unsigned bits = frame->header.bits_per_sample;
+    const size_t size =
+            (size_t)samples * channels * (mOutputFloat ? sizeof(float) : sizeof(int16_t));
+    if (!mOutput || channels > kMaxChannels || bits == 0 || bits > 32
+            || size > mOutputCapacity) {
+        ALOGE("cannot output %u samples of %u channels and %u bits into %zu bytes",
+              samples, channels, bits, mOutputCapacity);
+        return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+    }
+
+    if (mOutputFloat) {
+        // full scale of the stream's bit depth maps to [-1, 1)
+        const float scale = ldexpf(1.0f, 1 - (int)bits);
+        float *out = (float *)mOutput;
+        for (unsigned i = 0; i < samples; ++i) {
+            for (unsigned c = 0; c < channels; ++c) {
+                *out++ = buffer[c][i] * scale;
+            }
+        }
+    } else if (bits >= 16) {
+        const unsigned shift = bits - 16;
+        int16_t *out = (int16_t *)mOutput;
+        for (unsigned i = 0; i < samples; ++i) {
+            for (unsigned c = 0; c < channels; ++c) {
+                *out++ = buffer[c][i] >> shift;
+            }
+        }
+    } else {
+        const int32_t scale = 1 << (16 - bits);
+        int16_t *out = (int16_t *)mOutput;
+        for (unsigned i = 0; i < samples; ++i) {
+            for (unsigned c = 0; c < channels; ++c) {
+                *out++ = buffer[c][i] * scale;
+            }
+        }
+    }
+    mOutputSize = size;
+    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+}  // namespace android
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_FLAC_FRAME_DECODER_H_
+#define ANDROID_FLAC_FRAME_DECODER_H_
+
+#include <vector>
+
+#include <utils/Errors.h>
+
+#include "FLAC/stream_decoder.h"
+
+namespace android {
+
+/**
+ * Decodes a FLAC stream one frame at a time.
+ *
+ * libFLAC decodes into 32-bit samples of the stream's bit depth, which are interleaved and
+ * converted straight into 16-bit or float samples, so float output keeps the full precision of
+ * 24-bit streams.
+ */
+class FlacFrameDecoder {
+public:
+    enum {
+        kMaxChannels = 8,
+    };
+
+    /**
+     * \return a new decoder, or nullptr if it could not be created.
+     */
+    static FlacFrameDecoder *Create();
+    ~FlacFrameDecoder();
+
+    /**
+     * Parses codec config data, which starts with the "fLaC" marker and may be split among
+     * several calls.
+     *
+     * \return OK once all metadata blocks have been parsed, WOULD_BLOCK if more codec config data
+     *         is needed, or an error if the metadata is malformed.
+     */
+    status_t parseMetadata(const uint8_t *data, size_t size);
+
+    /**
+     * \return the STREAMINFO of the stream; only valid after parseMetadata() returned OK.
+     */
+    const FLAC__StreamMetadata_StreamInfo &getStreamInfo() const { return mStreamInfo; }
+
+    /**
+     * Decodes the frame in |data| into interleaved 16-bit or float samples at |out|, which holds
+     * |*outSize| bytes. On success, |*outSize| is set to the size of the samples.
+     */
+    status_t decodeOneFrame(
+            const uint8_t *data, size_t size, bool outputFloat, void *out, size_t *outSize);
+
+    /**
+     * Drops any partially decoded data, so that decoding resumes at the next frame.
+     */
+    void flush();
+
+private:
+    FlacFrameDecoder();
+
+    static FLAC__StreamDecoderReadStatus ReadCallback(
+            const FLAC__StreamDecoder *, FLAC__byte buffer[], size_t *bytes, void *client_data);
+    static FLAC__StreamDecoderWriteStatus WriteCallback(
+            const FLAC__StreamDecoder *, const FLAC__Frame *frame,
+            const FLAC__int32 *const buffer[], void *client_data);
+    static void MetadataCallback(
+            const FLAC__StreamDecoder *, const FLAC__StreamMetadata *metadata, void *client_data);
+    static void ErrorCallback(
+            const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus status, void *client_data);
+
+    FLAC__StreamDecoderWriteStatus write(
+            const FLAC__Frame *frame, const FLAC__int32 *const buffer[]);
+
+    FLAC__StreamDecoder *mDecoder;
+    FLAC__StreamMetadata_StreamInfo mStreamInfo;
+    bool mHasStreamInfo;
+    std::vector<uint8_t> mMetadata;     ///< codec config data received so far
+
+    // input and output of the current call
+    const uint8_t *mInput;
+    size_t mInputSize;
+    bool mOutputFloat;
+    void *mOutput;
+    size_t mOutputCapacity;
+    size_t mOutputSize;
+    bool mError;
+};
+
+}  // namespace android
+
+#endif  // ANDROID_FLAC_FRAME_DECODER_H_
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FlacParallelEncoder"
+#include <log/log.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "FlacParallelEncoder.h"
+
+namespace android {
+
+namespace {
+
+// frame numbers are coded like UTF-8 characters of up to 31 bits
+constexpr size_t kMaxFrameNumberSize = 6;
+constexpr unsigned kMaxFrameNumber = 0x7FFFFFFF;
+
+struct CrcTables {
+    CrcTables() {
+        for (unsigned i = 0; i < 256; ++i) {
+            unsigned crc8 = i;
+            unsigned crc16 = i << 8;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc8 = (crc8 & 0x80) ? (crc8 << 1) ^ 0x07 : crc8 << 1;
+                crc16 = (crc16 & 0x8000) ? (crc16 << 1) ^ 0x8005 : crc16 << 1;
+            }
+            crc8Table[i] = crc8 & 0xFF;
+            crc16Table[i] = crc16 & 0xFFFF;
+        }
+    }
+
+    uint8_t crc8Table[256];
+    uint16_t crc16Table[256];
+};
+
+const CrcTables &GetCrcTables() {
+    static const CrcTables sTables;
+    return sTables;
+}
+
+// CRC-8 of frame headers (polynomial x^8 + x^2 + x + 1)
+uint8_t Crc8(const FLAC__byte *data, size_t size) {
+    const uint8_t *table = GetCrcTables().crc8Table;
+    uint8_t crc = 0;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[crc ^ data[i]];
+    }
+    return crc;
+}
+
+// CRC-16 of whole frames (polynomial x^16 + x^15 + x^2 + 1)
+uint16_t Crc16(const FLAC__byte *data, size_t size) {
+    const uint16_t *table = GetCrcTables().crc16Table;
+    uint16_t crc = 0;
+    for (size_t i = 0; i < size; ++i) {
+        crc = (crc << 8) ^ table[(crc >> 8) ^ data[i]];
+    }
+    return crc;
+}
+
+// Returns the size of a coded frame number from its first byte, or 0 if it is invalid.
+size_t GetFrameNumberSize(FLAC__byte first) {
+    if (!(first & 0x80)) {
+        return 1;
+    }
+    // 110xxxxx, 1110xxxx, ..., 1111110x
+    for (size_t size = 2; size <= kMaxFrameNumberSize; ++size) {
+        unsigned mask = (0xFF00 >> (size + 1)) & 0xFF;
+        if ((first & mask) == ((0xFF00 >> size) & 0xFF)) {
+            return size;
+        }
+    }
+    return 0;
+}
+
+size_t WriteFrameNumber(unsigned number, FLAC__byte *out) {
+    if (number < 0x80) {
+        out[0] = number;
+        return 1;
+    }
+    size_t size = number < 0x800 ? 2 : number < 0x10000 ? 3 : number < 0x200000 ? 4
+            : number < 0x4000000 ? 5 : 6;
+    for (size_t i = size - 1; i > 0; --i) {
+        out[i] = 0x80 | (number & 0x3F);
+        number >>= 6;
+    }
+    out[0] = ((0xFF00 >> size) & 0xFF) | number;
+    return size;
+}
+
+}  // namespace
+
+struct FlacParallelEncoder::Worker {
+    struct Frame {
+        size_t offset;      ///< offset of the frame in |data|
+        size_t size;
+        unsigned samples;
+        unsigned number;
+    };
+
+    Worker() : encoder(FLAC__stream_encoder_new()), firstFrame(0), ok(false) {
+    }
+
+    ~Worker() {
+        if (encoder) {
+            FLAC__stream_encoder_delete(encoder);
+        }
+    }
+
+    /**
+     * Encodes a run of blocks as a stream of its own, and keeps its renumbered frames.
+     */
+    void run(const ConfigureFn &configure, const FLAC__int32 buffer[], unsigned samples) {
+        data.clear();
+        frames.clear();
+        ok = configure(encoder)
+                && FLAC__STREAM_ENCODER_INIT_STATUS_OK == FLAC__stream_encoder_init_stream(
+                        encoder, WriteCallback, nullptr /* seek_callback */,
+                        nullptr /* tell_callback */, nullptr /* metadata_callback */, this);
+        if (!ok) {
+            ALOGE("failed to initialize encoder");
+            return;
+        }
+        ok = FLAC__stream_encoder_process_interleaved(encoder, buffer, samples);
+        // this encodes the last block and leaves the encoder ready to be configured again
+        ok = FLAC__stream_encoder_finish(encoder) && ok;
+    }
+
+    static FLAC__StreamEncoderWriteStatus WriteCallback(
+            const FLAC__StreamEncoder *, const FLAC__byte buffer[], size_t bytes,
+            unsigned samples, unsigned current_frame, void *client_data) {
+        Worker *worker = (Worker *)client_data;
+        if (samples == 0) {
+            // metadata of the run, which is not part of the whole stream
+            return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+        }
+        size_t offset = worker->data.size();
+        unsigned number = worker->firstFrame + current_frame;
+        worker->data.resize(offset + bytes + kMaxFrameNumberSize);
+        size_t size = RenumberFrame(buffer, bytes, number, worker->data.data() + offset);
+        if (size == 0) {
+            ALOGE("cannot renumber frame %u to %u", current_frame, number);
+            return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+        }
+        worker->data.resize(offset + size);
+        worker->frames.push_back({ offset, size, samples, number });
+        return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+    }
+
+    FLAC__StreamEncoder *const encoder;
+    unsigned firstFrame;
+    std::vector<FLAC__byte> data;
+    std::vector<Frame> frames;
+    bool ok;
+};
+
+FlacParallelEncoder::FlacParallelEncoder(
+        size_t threads, unsigned channels, unsigned blockSize, const ConfigureFn &configure)
+    : mChannels(channels),
+      mBlockSize(blockSize),
+      mConfigure(configure),
+      mNextFrame(0) {
+    for (size_t i = 0; i < threads; ++i) {
+        std::unique_ptr<Worker> worker(new Worker);
+        if (!worker->encoder) {
+            ALOGE("failed to create encoder %zu", i);
+            mWorkers.clear();
+            return;
+        }
+        mWorkers.push_back(std::move(worker));
+    }
+}
+
+FlacParallelEncoder::~FlacParallelEncoder() {
+}
+
+bool FlacParallelEncoder::encode(
+        const FLAC__int32 buffer[], unsigned samples, const WriteFn &write) {
+    if (samples == 0) {
+        return true;
+    }
+    if (mWorkers.empty() || mBlockSize == 0) {
+        return false;
+    }
+
+    // split the blocks evenly among the encoders; the first run is encoded on this thread
+    unsigned blocks = (samples + mBlockSize - 1) / mBlockSize;
+    size_t runs = std::min((size_t)blocks, mWorkers.size());
+    std::vector<std::thread> threads;
+    unsigned firstRunSamples = 0;
+    unsigned block = 0;
+    for (size_t i = 0; i < runs; ++i) {
+        unsigned runBlocks = blocks / runs + (i < blocks % runs ? 1 : 0);
+        unsigned offset = block * mBlockSize;
+        unsigned runSamples = std::min(runBlocks * mBlockSize, samples - offset);
+        Worker *worker = mWorkers[i].get();
+        worker->firstFrame = mNextFrame + block;
+        if (i == 0) {
+            firstRunSamples = runSamples;
+        } else {
+            const FLAC__int32 *runBuffer = buffer + (size_t)offset * mChannels;
+            threads.emplace_back([this, worker, runBuffer, runSamples] {
+                worker->run(mConfigure, runBuffer, runSamples);
+            });
+        }
+        block += runBlocks;
+    }
+    mWorkers[0]->run(mConfigure, buffer, firstRunSamples);
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    mNextFrame += blocks;
+
+    for (size_t i = 0; i < runs; ++i) {
+        const Worker *worker = mWorkers[i].get();
+        if (!worker->ok) {
+            ALOGE("encoder %zu failed", i);
+            return false;
+        }
+        for (const Worker::Frame &frame : worker->frames) {
+            if (write(worker->data.data() + frame.offset, frame.size, frame.samples, frame.number)
+                    != FLAC__STREAM_ENCODER_WRITE_STATUS_OK) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// static
+size_t FlacParallelEncoder::RenumberFrame(
+        const FLAC__byte *frame, size_t size, unsigned number, FLAC__byte *out) {
+    // sync code, reserved bit and fixed-blocksize strategy
+    if (size < 5 || frame[0] != 0xFF || frame[1] != 0xF8 || number > kMaxFrameNumber) {
+        return 0;
+    }
+    unsigned blockSizeCode = frame[2] >> 4;
+    unsigned sampleRateCode = frame[2] & 0xF;
+    size_t numberSize = GetFrameNumberSize(frame[4]);
+    size_t extraSize = (blockSizeCode == 6 ? 1 : blockSizeCode == 7 ? 2 : 0)
+            + (sampleRateCode == 12 ? 1 : (sampleRateCode == 13 || sampleRateCode == 14) ? 2 : 0);
+    size_t headerSize = 4 + numberSize + extraSize;
+    // header, its CRC-8, and the CRC-16 of the frame
+    if (numberSize == 0 || headerSize + 1 + 2 > size) {
+        return 0;
+    }
+
+    memcpy(out, frame, 4);
+    size_t pos = 4 + WriteFrameNumber(number, out + 4);
+    memcpy(out + pos, frame + 4 + numberSize, extraSize);
+    pos += extraSize;
+    out[pos] = Crc8(out, pos);
+    ++pos;
+    size_t subframesSize = size - (headerSize + 1) - 2;
+    memcpy(out + pos, frame + headerSize + 1, subframesSize);
+    pos += subframesSize;
+    uint16_t crc = Crc16(out, pos);
+    out[pos++] = crc >> 8;
+    out[pos++] = crc & 0xFF;
+    return pos;
+}
+
+}  // namespace android
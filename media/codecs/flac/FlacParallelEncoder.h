@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_FLAC_PARALLEL_ENCODER_H_
+#define ANDROID_FLAC_PARALLEL_ENCODER_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "FLAC/stream_encoder.h"
+
+namespace android {
+
+/**
+ * Encodes a FLAC stream on several threads.
+ *
+ * FLAC frames only depend on each other through the frame number in their header. Each call to
+ * encode() splits its samples into runs of whole blocks, and each run is encoded on its own thread
+ * by a separate libFLAC encoder as a stream of its own. The frames of each run are then renumbered
+ * to their position in the whole stream, which also updates their CRCs, and are written in order.
+ *
+ * The frames are bit-identical to those of a single encoder with the same configuration, unless
+ * loose mid-side stereo (used by some compression levels) is enabled, as it adapts across frames.
+ * The stream is valid either way.
+ */
+class FlacParallelEncoder {
+public:
+    /**
+     * Configures an uninitialized encoder. All encoders must get the same fixed block size.
+     */
+    typedef std::function<bool(FLAC__StreamEncoder *)> ConfigureFn;
+
+    /**
+     * Receives an encoded frame, with the same arguments as a libFLAC write callback.
+     */
+    typedef std::function<FLAC__StreamEncoderWriteStatus(
+            const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame)>
+            WriteFn;
+
+    /**
+     * \param threads       number of encoders (and threads) to use
+     * \param channels      number of interleaved channels
+     * \param blockSize     block size of the encoders, in samples per channel
+     * \param configure     configures the encoders before each run
+     */
+    FlacParallelEncoder(
+            size_t threads, unsigned channels, unsigned blockSize, const ConfigureFn &configure);
+    ~FlacParallelEncoder();
+
+    /**
+     * \return false if the encoders could not be created.
+     */
+    bool initCheck() const { return !mWorkers.empty(); }
+
+    /**
+     * \return the number of encoders.
+     */
+    size_t threads() const { return mWorkers.size(); }
+
+    /**
+     * Encodes |samples| interleaved samples per channel of |buffer| and writes the frames in
+     * order. Every call but the last one of a stream must encode a multiple of the block size.
+     *
+     * \return true on success.
+     */
+    bool encode(const FLAC__int32 buffer[], unsigned samples, const WriteFn &write);
+
+    /**
+     * Restarts the frame numbering for a new stream.
+     */
+    void reset() { mNextFrame = 0; }
+
+    /**
+     * Copies the fixed-blocksize frame |frame| of |size| bytes into |out| with its frame number
+     * replaced by |number|, and recomputes its CRCs. |out| must hold at least |size| + 6 bytes.
+     *
+     * \return the size of the renumbered frame, or 0 if |frame| is not a fixed-blocksize frame.
+     */
+    static size_t RenumberFrame(
+            const FLAC__byte *frame, size_t size, unsigned number, FLAC__byte *out);
+
+private:
+    struct Worker;
+
+    const unsigned mChannels;
+    const unsigned mBlockSize;
+    const ConfigureFn mConfigure;
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    unsigned mNextFrame;
+};
+
+}  // namespace android
+
+#endif  // ANDROID_FLAC_PARALLEL_ENCODER_H_
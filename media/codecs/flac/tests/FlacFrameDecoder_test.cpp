@@ -0,0 +1,205 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <FlacFrameDecoder.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "FLAC/stream_encoder.h"
+
+namespace android {
+
+namespace {
+
+constexpr unsigned kChannels = 2;
+constexpr unsigned kSampleRate = 48000;
+constexpr unsigned kBlockSize = 1152;
+
+struct EncodedStream {
+    std::vector<uint8_t> metadata;
+    std::vector<std::vector<uint8_t>> frames;
+};
+
+// a random walk at full scale of |bits|
+std::vector<FLAC__int32> CreateSignal(unsigned samples, unsigned bits) {
+    const int32_t max = (1 << (bits - 1)) - 1;
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int32_t> step(-(max / 64), max / 64);
+    std::vector<FLAC__int32> signal(samples * kChannels);
+    int32_t values[kChannels] = {};
+    for (size_t i = 0; i < signal.size(); ++i) {
+        int32_t &value = values[i % kChannels];
+        value = std::max(-max - 1, std::min(max, value + step(rng)));
+        signal[i] = value;
+    }
+    return signal;
+}
+
+FLAC__StreamEncoderWriteStatus AppendToStream(
+        const FLAC__StreamEncoder *, const FLAC__byte buffer[], size_t bytes,
+        unsigned samples, unsigned, void *client_data) {
+    EncodedStream *stream = (EncodedStream *)client_data;
+    if (samples == 0) {
+        stream->metadata.insert(stream->metadata.end(), buffer, buffer + bytes);
+    } else {
+        stream->frames.emplace_back(buffer, buffer + bytes);
+    }
+    return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+EncodedStream Encode(const std::vector<FLAC__int32> &signal, unsigned bits) {
+    EncodedStream stream;
+    FLAC__StreamEncoder *encoder = FLAC__stream_encoder_new();
+    EXPECT_TRUE(FLAC__stream_encoder_set_channels(encoder, kChannels)
+            && FLAC__stream_encoder_set_sample_rate(encoder, kSampleRate)
+            && FLAC__stream_encoder_set_bits_per_sample(encoder, bits)
+            && FLAC__stream_encoder_set_compression_level(encoder, 5)
+            && FLAC__stream_encoder_set_blocksize(encoder, kBlockSize));
+    EXPECT_EQ(FLAC__STREAM_ENCODER_INIT_STATUS_OK, FLAC__stream_encoder_init_stream(
+            encoder, AppendToStream, nullptr, nullptr, nullptr, &stream));
+    EXPECT_TRUE(FLAC__stream_encoder_process_interleaved(
+            encoder, signal.data(), signal.size() / kChannels));
+    EXPECT_TRUE(FLAC__stream_encoder_finish(encoder));
+    FLAC__stream_encoder_delete(encoder);
+    return stream;
+}
+
+std::unique_ptr<FlacFrameDecoder> CreateDecoder(const EncodedStream &stream) {
+    std::unique_ptr<FlacFrameDecoder> decoder(FlacFrameDecoder::Create());
+    EXPECT_TRUE(decoder != nullptr);
+    if (decoder) {
+        EXPECT_EQ(OK, decoder->parseMetadata(stream.metadata.data(), stream.metadata.size()));
+    }
+    return decoder;
+}
+
+// Decodes all frames of |stream| and appends their samples to |out|.
+template<typename T>
+void DecodeFrames(
+        FlacFrameDecoder *decoder, const EncodedStream &stream, std::vector<T> *out) {
+    std::vector<T> frame(kBlockSize * kChannels);
+    for (const std::vector<uint8_t> &data : stream.frames) {
+        size_t size = frame.size() * sizeof(T);
+        ASSERT_EQ(OK, decoder->decodeOneFrame(
+                data.data(), data.size(), std::is_same<T, float>::value, frame.data(), &size));
+        ASSERT_EQ(0u, size % (kChannels * sizeof(T)));
+        out->insert(out->end(), frame.begin(), frame.begin() + size / sizeof(T));
+    }
+}
+
+}  // namespace
+
+TEST(FlacFrameDecoderTest, ParsesSplitMetadata) {
+    EncodedStream stream = Encode(CreateSignal(kBlockSize, 16), 16);
+    ASSERT_GT(stream.metadata.size(), 8u);
+    std::unique_ptr<FlacFrameDecoder> decoder(FlacFrameDecoder::Create());
+    ASSERT_TRUE(decoder != nullptr);
+
+    // the marker alone, then the rest of the metadata
+    EXPECT_EQ(WOULD_BLOCK, decoder->parseMetadata(stream.metadata.data(), 4));
+    EXPECT_EQ(OK, decoder->parseMetadata(
+            stream.metadata.data() + 4, stream.metadata.size() - 4));
+    const FLAC__StreamMetadata_StreamInfo &info = decoder->getStreamInfo();
+    EXPECT_EQ(kSampleRate, info.sample_rate);
+    EXPECT_EQ(kChannels, info.channels);
+    EXPECT_EQ(16u, info.bits_per_sample);
+    EXPECT_EQ(kBlockSize, info.max_blocksize);
+}
+
+TEST(FlacFrameDecoderTest, Decodes16BitStream) {
+    // a partial last block
+    std::vector<FLAC__int32> signal = CreateSignal(kBlockSize * 10 + 100, 16);
+    EncodedStream stream = Encode(signal, 16);
+
+    std::unique_ptr<FlacFrameDecoder> decoder = CreateDecoder(stream);
+    ASSERT_TRUE(decoder != nullptr);
+    std::vector<int16_t> pcm16;
+    DecodeFrames(decoder.get(), stream, &pcm16);
+    ASSERT_EQ(signal.size(), pcm16.size());
+    for (size_t i = 0; i < signal.size(); ++i) {
+        ASSERT_EQ(signal[i], pcm16[i]) << "sample " << i;
+    }
+
+    decoder = CreateDecoder(stream);
+    ASSERT_TRUE(decoder != nullptr);
+    std::vector<float> pcmFloat;
+    DecodeFrames(decoder.get(), stream, &pcmFloat);
+    ASSERT_EQ(signal.size(), pcmFloat.size());
+    for (size_t i = 0; i < signal.size(); ++i) {
+        ASSERT_EQ(signal[i] / 32768.0f, pcmFloat[i]) << "sample " << i;
+    }
+}
+
+TEST(FlacFrameDecoderTest, Decodes24BitStreamWithoutLosingPrecisionInFloat) {
+    std::vector<FLAC__int32> signal = CreateSignal(kBlockSize * 10, 24);
+    EncodedStream stream = Encode(signal, 24);
+
+    std::unique_ptr<FlacFrameDecoder> decoder = CreateDecoder(stream);
+    ASSERT_TRUE(decoder != nullptr);
+    EXPECT_EQ(24u, decoder->getStreamInfo().bits_per_sample);
+    std::vector<float> pcmFloat;
+    DecodeFrames(decoder.get(), stream, &pcmFloat);
+    ASSERT_EQ(signal.size(), pcmFloat.size());
+    for (size_t i = 0; i < signal.size(); ++i) {
+        // exact, as 24-bit samples fit the float mantissa
+        ASSERT_EQ(signal[i] / 8388608.0f, pcmFloat[i]) << "sample " << i;
+    }
+
+    decoder = CreateDecoder(stream);
+    ASSERT_TRUE(decoder != nullptr);
+    std::vector<int16_t> pcm16;
+    DecodeFrames(decoder.get(), stream, &pcm16);
+    ASSERT_EQ(signal.size(), pcm16.size());
+    for (size_t i = 0; i < signal.size(); ++i) {
+        ASSERT_EQ(signal[i] >> 8, pcm16[i]) << "sample " << i;
+    }
+}
+
+TEST(FlacFrameDecoderTest, RejectsBadInput) {
+    EncodedStream stream = Encode(CreateSignal(kBlockSize * 3, 16), 16);
+    ASSERT_EQ(3u, stream.frames.size());
+    std::unique_ptr<FlacFrameDecoder> decoder(FlacFrameDecoder::Create());
+    ASSERT_TRUE(decoder != nullptr);
+    std::vector<int16_t> out(kBlockSize * kChannels);
+    size_t size = out.size() * sizeof(int16_t);
+
+    const uint8_t notFlac[] = { 'O', 'g', 'g', 'S', 0, 0, 0, 0 };
+    EXPECT_EQ(BAD_VALUE, decoder->parseMetadata(notFlac, sizeof(notFlac)));
+    EXPECT_EQ(NO_INIT, decoder->decodeOneFrame(
+            stream.frames[0].data(), stream.frames[0].size(), false, out.data(), &size));
+    ASSERT_EQ(OK, decoder->parseMetadata(stream.metadata.data(), stream.metadata.size()));
+
+    // a truncated frame, after which the decoder resumes at the next frame
+    EXPECT_NE(OK, decoder->decodeOneFrame(
+            stream.frames[0].data(), stream.frames[0].size() / 2, false, out.data(), &size));
+    size = out.size() * sizeof(int16_t);
+    EXPECT_EQ(OK, decoder->decodeOneFrame(
+            stream.frames[1].data(), stream.frames[1].size(), false, out.data(), &size));
+    EXPECT_EQ(out.size() * sizeof(int16_t), size);
+
+    // an output buffer that is too small
+    size = out.size() * sizeof(int16_t) - 1;
+    EXPECT_NE(OK, decoder->decodeOneFrame(
+            stream.frames[2].data(), stream.frames[2].size(), false, out.data(), &size));
+}
+
+}  // namespace android
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <FlacParallelEncoder.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace android {
+
+namespace {
+
+constexpr unsigned kChannels = 2;
+constexpr unsigned kSampleRate = 44100;
+constexpr unsigned kBlockSize = 4096;
+
+// bit by bit, as in the format specification
+unsigned ReferenceCrc(const std::vector<uint8_t> &data, unsigned bits, unsigned poly) {
+    unsigned top = 1u << (bits - 1);
+    unsigned crc = 0;
+    for (uint8_t byte : data) {
+        crc ^= byte << (bits - 8);
+        for (int i = 0; i < 8; ++i) {
+            crc = (crc & top) ? (crc << 1) ^ poly : crc << 1;
+        }
+        crc &= (top << 1) - 1;
+    }
+    return crc;
+}
+
+unsigned ReferenceCrc8(const std::vector<uint8_t> &data) {
+    return ReferenceCrc(data, 8, 0x07);
+}
+
+unsigned ReferenceCrc16(const std::vector<uint8_t> &data) {
+    return ReferenceCrc(data, 16, 0x8005);
+}
+
+// Builds a fixed-blocksize frame with the given codes and the bytes that follow the frame number.
+std::vector<uint8_t> BuildFrame(
+        uint32_t number, uint8_t blockSizeCode, uint8_t sampleRateCode,
+        const std::vector<uint8_t> &extra, const std::vector<uint8_t> &subframes) {
+    std::vector<uint8_t> frame = {
+        0xFF, 0xF8, (uint8_t)(blockSizeCode << 4 | sampleRateCode), 0x18 };
+    if (number < 0x80) {
+        frame.push_back(number);
+    } else {
+        size_t size = 2;
+        while (size < 6 && number >= (1u << (5 * size + 1))) {
+            ++size;
+        }
+        frame.push_back((0xFF00 >> size) | (number >> (6 * (size - 1))));
+        for (size_t i = size - 1; i > 0; --i) {
+            frame.push_back(0x80 | ((number >> (6 * (i - 1))) & 0x3F));
+        }
+    }
+    frame.insert(frame.end(), extra.begin(), extra.end());
+    frame.push_back(ReferenceCrc8(frame));
+    frame.insert(frame.end(), subframes.begin(), subframes.end());
+    unsigned crc = ReferenceCrc16(frame);
+    frame.push_back(crc >> 8);
+    frame.push_back(crc & 0xFF);
+    return frame;
+}
+
+std::vector<uint8_t> Renumber(const std::vector<uint8_t> &frame, uint32_t number) {
+    std::vector<uint8_t> out(frame.size() + 6);
+    out.resize(FlacParallelEncoder::RenumberFrame(frame.data(), frame.size(), number, out.data()));
+    return out;
+}
+
+// a random walk, which compresses like music rather than like noise
+std::vector<FLAC__int32> CreateSignal(unsigned samples) {
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> step(-512, 512);
+    std::vector<FLAC__int32> signal(samples * kChannels);
+    int32_t values[kChannels] = {};
+    for (size_t i = 0; i < signal.size(); ++i) {
+        int32_t &value = values[i % kChannels];
+        value = std::max(-32768, std::min(32767, value + step(rng)));
+        signal[i] = value;
+    }
+    return signal;
+}
+
+bool Configure(FLAC__StreamEncoder *encoder) {
+    return FLAC__stream_encoder_set_channels(encoder, kChannels)
+            && FLAC__stream_encoder_set_sample_rate(encoder, kSampleRate)
+            && FLAC__stream_encoder_set_bits_per_sample(encoder, 16)
+            && FLAC__stream_encoder_set_compression_level(encoder, 5)
+            && FLAC__stream_encoder_set_blocksize(encoder, kBlockSize)
+            && FLAC__stream_encoder_set_verify(encoder, false)
+            && FLAC__stream_encoder_set_do_md5(encoder, false);
+}
+
+FLAC__StreamEncoderWriteStatus AppendFrame(
+        const FLAC__StreamEncoder *, const FLAC__byte buffer[], size_t bytes,
+        unsigned samples, unsigned, void *client_data) {
+    if (samples > 0) {
+        std::vector<uint8_t> *frames = (std::vector<uint8_t> *)client_data;
+        frames->insert(frames->end(), buffer, buffer + bytes);
+    }
+    return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+std::vector<uint8_t> EncodeWithSingleEncoder(const std::vector<FLAC__int32> &signal) {
+    std::vector<uint8_t> frames;
+    FLAC__StreamEncoder *encoder = FLAC__stream_encoder_new();
+    EXPECT_TRUE(Configure(encoder));
+    EXPECT_EQ(FLAC__STREAM_ENCODER_INIT_STATUS_OK, FLAC__stream_encoder_init_stream(
+            encoder, AppendFrame, nullptr, nullptr, nullptr, &frames));
+    EXPECT_TRUE(FLAC__stream_encoder_process_interleaved(
+            encoder, signal.data(), signal.size() / kChannels));
+    EXPECT_TRUE(FLAC__stream_encoder_finish(encoder));
+    FLAC__stream_encoder_delete(encoder);
+    return frames;
+}
+
+// Encodes |signal| in calls of |samplesPerCall| samples per channel.
+std::vector<uint8_t> EncodeWithParallelEncoder(
+        const std::vector<FLAC__int32> &signal, size_t threads, unsigned samplesPerCall) {
+    std::vector<uint8_t> frames;
+    unsigned nextFrame = 0;
+    FlacParallelEncoder encoder(threads, kChannels, kBlockSize, Configure);
+    EXPECT_TRUE(encoder.initCheck());
+    FlacParallelEncoder::WriteFn write = [&frames, &nextFrame](
+            const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame) {
+        EXPECT_GT(samples, 0u);
+        EXPECT_EQ(nextFrame++, current_frame);
+        frames.insert(frames.end(), buffer, buffer + bytes);
+        return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+    };
+    unsigned samples = signal.size() / kChannels;
+    for (unsigned offset = 0; offset < samples; offset += samplesPerCall) {
+        EXPECT_TRUE(encoder.encode(
+                signal.data() + offset * kChannels,
+                std::min(samplesPerCall, samples - offset), write));
+    }
+    return frames;
+}
+
+}  // namespace
+
+TEST(FlacParallelEncoderTest, ReferenceCrcsMatchCheckValues) {
+    std::vector<uint8_t> check = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    EXPECT_EQ(0xF4u, ReferenceCrc8(check));
+    EXPECT_EQ(0xFEE8u, ReferenceCrc16(check));
+}
+
+TEST(FlacParallelEncoderTest, RenumbersFrames) {
+    const std::vector<uint8_t> subframes = { 0x00, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE };
+    // frame numbers at the boundaries of each coded size
+    const std::vector<uint32_t> numbers = {
+        0, 1, 0x7F, 0x80, 0x7FF, 0x800, 0xFFFF, 0x10000, 0x1FFFFF, 0x200000,
+        0x3FFFFFF, 0x4000000, 0x7FFFFFFF };
+    // no extra header bytes, 8-bit block size and sample rate, 16-bit block size and sample rate
+    const std::vector<std::tuple<uint8_t, uint8_t, std::vector<uint8_t>>> codes = {
+        { 0xC, 0x9, {} }, { 0x6, 0xC, { 0xFF, 0x30 } }, { 0x7, 0xE, { 0x0F, 0xFF, 0xAC, 0x44 } } };
+    for (const auto &code : codes) {
+        for (uint32_t from : numbers) {
+            std::vector<uint8_t> frame = BuildFrame(
+                    from, std::get<0>(code), std::get<1>(code), std::get<2>(code), subframes);
+            for (uint32_t to : numbers) {
+                EXPECT_EQ(BuildFrame(to, std::get<0>(code), std::get<1>(code), std::get<2>(code),
+                                     subframes),
+                          Renumber(frame, to))
+                        << "from " << from << " to " << to;
+            }
+        }
+    }
+}
+
+TEST(FlacParallelEncoderTest, RejectsOtherFrames) {
+    std::vector<uint8_t> frame = BuildFrame(3, 0xC, 0x9, {}, { 0x00, 0x01 });
+    EXPECT_EQ(frame.size(), Renumber(frame, 4).size());
+    EXPECT_TRUE(Renumber(frame, 0x80000000).empty());
+
+    std::vector<uint8_t> variable = frame;
+    variable[1] = 0xF9;
+    EXPECT_TRUE(Renumber(variable, 4).empty());
+
+    std::vector<uint8_t> unsynced = frame;
+    unsynced[0] = 0xFE;
+    EXPECT_TRUE(Renumber(unsynced, 4).empty());
+
+    std::vector<uint8_t> badNumber = frame;
+    badNumber[4] = 0xFE;
+    EXPECT_TRUE(Renumber(badNumber, 4).empty());
+
+    std::vector<uint8_t> truncated(frame.begin(), frame.begin() + 7);
+    EXPECT_TRUE(Renumber(truncated, 4).empty());
+}
+
+TEST(FlacParallelEncoderTest, MatchesSingleEncoder) {
+    // a partial last block
+    std::vector<FLAC__int32> signal = CreateSignal(kBlockSize * 21 + 1000);
+    std::vector<uint8_t> expected = EncodeWithSingleEncoder(signal);
+    ASSERT_FALSE(expected.empty());
+    for (size_t threads = 1; threads <= 4; ++threads) {
+        EXPECT_EQ(expected, EncodeWithParallelEncoder(signal, threads, kBlockSize * 8))
+                << threads << " threads";
+        EXPECT_EQ(expected, EncodeWithParallelEncoder(signal, threads, kBlockSize * 100))
+                << threads << " threads in one call";
+    }
+}
+
+TEST(FlacParallelEncoderTest, Throughput) {
+    constexpr unsigned kSamples = kSampleRate * 60;
+    std::vector<FLAC__int32> signal = CreateSignal(kSamples);
+    size_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        auto start = std::chrono::steady_clock::now();
+        EncodeWithParallelEncoder(signal, threads, kBlockSize * 8 * threads);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << threads << " threads: " << kSamples / elapsed.count() / 1e6
+                  << " Msamples/s per channel, " << 60 / elapsed.count() << "x realtime"
+                  << std::endl;
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include "G711Decoder.h"
+
+namespace android {
+
+namespace {
+
+// Inputs of at least this many codewords are decoded with the vectorized implementations; below
+// this, the table lookup is faster as the vector loop does not get to run long enough. The vector
+// implementations shift each 16-bit lane by a different amount, which NEON does in one
+// instruction but SSE cannot, so elsewhere the table lookup is always used.
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+constexpr size_t kMinVectorSize = 32;
+#else
+constexpr size_t kMinVectorSize = SIZE_MAX;
+#endif
+
+/** Decoded values of all 256 codewords. */
+struct DecodeTable {
+    explicit DecodeTable(void (*decode)(int16_t *, const uint8_t *, size_t)) {
+        uint8_t codewords[256];
+        for (size_t i = 0; i < 256; ++i) {
+            codewords[i] = i;
+        }
+        decode(values, codewords, 256);
+    }
+
+    int16_t values[256];
+};
+
+const DecodeTable &ALawTable() {
+    static const DecodeTable sTable(DecodeALawReference);
+    return sTable;
+}
+
+const DecodeTable &MLawTable() {
+    static const DecodeTable sTable(DecodeMLawReference);
+    return sTable;
+}
+
+void DecodeWithTable(int16_t *out, const uint8_t *in, size_t inSize, const DecodeTable &table) {
+    const int16_t *values = table.values;
+    for (size_t i = 0; i < inSize; ++i) {
+        out[i] = values[in[i]];
+    }
+}
+
+}  // namespace
+
+void DecodeALaw(int16_t *out, const uint8_t *in, size_t inSize) {
+    if (inSize >= kMinVectorSize) {
+        DecodeALawVector(out, in, inSize);
+    } else {
+        DecodeALawTable(out, in, inSize);
+    }
+}
+
+void DecodeMLaw(int16_t *out, const uint8_t *in, size_t inSize) {
+    if (inSize >= kMinVectorSize) {
+        DecodeMLawVector(out, in, inSize);
+    } else {
+        DecodeMLawTable(out, in, inSize);
+    }
+}
+
+void DecodeALawReference(int16_t *out, const uint8_t *in, size_t inSize) {
+    while (inSize > 0) {
+        inSize--;
+        int32_t x = *in++;
+
+        int32_t ix = x ^ 0x55;
+        ix &= 0x7f;
+
+        int32_t iexp = ix >> 4;
+        int32_t mant = ix & 0x0f;
+
+        if (iexp > 0) {
+            mant += 16;
+        }
+
+        mant = (mant << 4) + 8;
+
+        if (iexp > 1) {
+            mant = mant << (iexp - 1);
+        }
+
+        *out++ = (x > 127) ? mant : -mant;
+    }
+}
+
+void DecodeMLawReference(int16_t *out, const uint8_t *in, size_t inSize) {
+    while (inSize > 0) {
+        inSize--;
+        int32_t x = *in++;
+
+        int32_t mantissa = ~x;
+        int32_t exponent = (mantissa >> 4) & 7;
+        int32_t segment = exponent + 1;
+        mantissa &= 0x0f;
+
+        int32_t step = 4 << segment;
+
+        int32_t abs = (0x80l << exponent) + step * mantissa + step / 2 - 4 * 33;
+
+        *out++ = (x < 0x80) ? -abs : abs;
+    }
+}
+
+void DecodeALawTable(int16_t *out, const uint8_t *in, size_t inSize) {
+    DecodeWithTable(out, in, inSize, ALawTable());
+}
+
+void DecodeMLawTable(int16_t *out, const uint8_t *in, size_t inSize) {
+    DecodeWithTable(out, in, inSize, MLawTable());
+}
+
+// The vector implementations compute in 16 bits, which hold all decoded magnitudes, so that the
+// compiler packs as many codewords as possible into each vector.
+
+void DecodeALawVector(int16_t *__restrict out, const uint8_t *__restrict in, size_t inSize) {
+    for (size_t i = 0; i < inSize; ++i) {
+        uint16_t x = in[i];
+        uint16_t ix = (x ^ 0x55) & 0x7f;
+        uint16_t iexp = ix >> 4;
+        // same as the reference, with the branches turned into selects
+        uint16_t mant = ((ix & 0x0f) << 4) + 8 + (iexp > 0 ? 16 << 4 : 0);
+        uint16_t shift = iexp > 1 ? iexp - 1 : 0;
+        mant = (uint16_t)(mant << shift);
+        out[i] = (x & 0x80) ? (int16_t)mant : (int16_t)-mant;
+    }
+}
+
+void DecodeMLawVector(int16_t *__restrict out, const uint8_t *__restrict in, size_t inSize) {
+    for (size_t i = 0; i < inSize; ++i) {
+        uint16_t x = in[i];
+        uint16_t exponent = ((x >> 4) & 7) ^ 7;
+        uint16_t mantissa = (x & 0x0f) ^ 0x0f;
+        // (0x80 << e) + (8 << e) * m + (4 << e) - 4 * 33 from the reference, factored
+        uint16_t abs = (uint16_t)((uint16_t)((mantissa << 3) + 0x84) << exponent) - 0x84;
+        out[i] = (x & 0x80) ? (int16_t)abs : (int16_t)-abs;
+    }
+}
+
+}  // namespace android
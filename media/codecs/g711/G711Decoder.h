@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_G711_DECODER_H_
+#define ANDROID_G711_DECODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+/**
+ * G.711 A-law and mu-law decoders. Each decodes |inSize| 8-bit codewords at |in| into 16-bit
+ * linear samples at |out|.
+ *
+ * DecodeALaw() and DecodeMLaw() are the ones to use. They pick the faster of the implementations
+ * below for the size of the input, which all produce identical output.
+ */
+void DecodeALaw(int16_t *out, const uint8_t *in, size_t inSize);
+void DecodeMLaw(int16_t *out, const uint8_t *in, size_t inSize);
+
+/** Reference implementations, which decode one codeword at a time with branches. */
+void DecodeALawReference(int16_t *out, const uint8_t *in, size_t inSize);
+void DecodeMLawReference(int16_t *out, const uint8_t *in, size_t inSize);
+
+/** Look up each codeword in a 256-entry table built from the reference implementation. */
+void DecodeALawTable(int16_t *out, const uint8_t *in, size_t inSize);
+void DecodeMLawTable(int16_t *out, const uint8_t *in, size_t inSize);
+
+/**
+ * Branchless implementations, which the compiler vectorizes on targets with per-lane shifts (such
+ * as NEON), decoding several codewords per instruction. These pay off for larger inputs.
+ */
+void DecodeALawVector(int16_t *out, const uint8_t *in, size_t inSize);
+void DecodeMLawVector(int16_t *out, const uint8_t *in, size_t inSize);
+
+}  // namespace android
+
+#endif  // ANDROID_G711_DECODER_H_
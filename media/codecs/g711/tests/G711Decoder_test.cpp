@@ -0,0 +1,119 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <G711Decoder.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace android {
+
+namespace {
+
+typedef void (*DecodeFn)(int16_t *out, const uint8_t *in, size_t inSize);
+
+struct Law {
+    const char *name;
+    DecodeFn reference;
+    std::vector<std::pair<const char *, DecodeFn>> decoders;
+};
+
+const std::vector<Law> &Laws() {
+    static const std::vector<Law> sLaws = {
+        { "A-law", DecodeALawReference, {
+            { "table", DecodeALawTable },
+            { "vector", DecodeALawVector },
+            { "default", DecodeALaw } } },
+        { "mu-law", DecodeMLawReference, {
+            { "table", DecodeMLawTable },
+            { "vector", DecodeMLawVector },
+            { "default", DecodeMLaw } } },
+    };
+    return sLaws;
+}
+
+}  // namespace
+
+TEST(G711DecoderTest, AllCodewordsMatchReference) {
+    uint8_t codewords[256];
+    for (size_t i = 0; i < 256; ++i) {
+        codewords[i] = i;
+    }
+    for (const Law &law : Laws()) {
+        int16_t expected[256];
+        law.reference(expected, codewords, 256);
+        for (const auto &decoder : law.decoders) {
+            int16_t actual[256];
+            decoder.second(actual, codewords, 256);
+            for (size_t i = 0; i < 256; ++i) {
+                ASSERT_EQ(expected[i], actual[i])
+                        << law.name << " " << decoder.first << " codeword " << i;
+            }
+        }
+    }
+}
+
+TEST(G711DecoderTest, BuffersMatchReference) {
+    std::mt19937 random(0);
+    std::vector<uint8_t> in(1024 + 1);
+    for (uint8_t &codeword : in) {
+        codeword = random();
+    }
+    for (const Law &law : Laws()) {
+        for (const auto &decoder : law.decoders) {
+            // cover the sizes around the vector width and unaligned buffers
+            for (size_t size = 0; size <= 1024; size += (size < 160 ? 1 : 37)) {
+                std::vector<int16_t> expected(size + 1, 0x5a5a);
+                std::vector<int16_t> actual(size + 1, 0x5a5a);
+                law.reference(&expected[1], &in[1], size);
+                decoder.second(&actual[1], &in[1], size);
+                ASSERT_EQ(expected, actual) << law.name << " " << decoder.first << " size " << size;
+            }
+        }
+    }
+}
+
+TEST(G711DecoderTest, Throughput) {
+    // 20 ms packets at 8 kHz, which is what telephony streams use
+    constexpr size_t kPacketSize = 160;
+    constexpr size_t kPackets = 200000;
+    std::mt19937 random(0);
+    std::vector<uint8_t> in(kPacketSize);
+    for (uint8_t &codeword : in) {
+        codeword = random();
+    }
+    std::vector<int16_t> out(kPacketSize);
+    for (const Law &law : Laws()) {
+        std::vector<std::pair<const char *, DecodeFn>> decoders = law.decoders;
+        decoders.emplace(decoders.begin(), "reference", law.reference);
+        for (const auto &decoder : decoders) {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < kPackets; ++i) {
+                decoder.second(out.data(), in.data(), kPacketSize);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << law.name << " " << decoder.first << ": "
+                      << kPacketSize * kPackets / elapsed.count() / 1e6
+                      << " Msamples/s per core" << std::endl;
+        }
+    }
+}
+
+} // namespace android
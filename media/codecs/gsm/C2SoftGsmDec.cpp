@@ -82,6 +82,9 @@ class C2SoftGsmDec::IntfImpl : public C2InterfaceHelper {
                 DefineParam(mInputMaxBufSize, C2_PARAMKEY_INPUT_MAX_BUFFER_SIZE)
                 .withConstValue(new C2StreamMaxBufferSizeInfo::input(0u, 1024 / MSGSM_IN_FRM_SZ * MSGSM_IN_FRM_SZ))
                 .build());
+
+        addParameter(SimpleInterface<void>::BaseParams::DefineOutputBatchSize(
+                mOutputBatchSize, 1u));
     }
 
    private:
@@ -93,6 +96,7 @@ class C2SoftGsmDec::IntfImpl : public C2InterfaceHelper {
     std::shared_ptr<C2StreamChannelCountInfo::output> mChannelCount;
     std::shared_ptr<C2BitrateTuning::input> mBitrate;
     std::shared_ptr<C2StreamMaxBufferSizeInfo::input> mInputMaxBufSize;
+    std::shared_ptr<C2PortBatchSizeTuning::output> mOutputBatchSize;
 };
 
 C2SoftGsmDec::C2SoftGsmDec(const char *name, c2_node_id_t id,
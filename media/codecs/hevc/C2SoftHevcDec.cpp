@@ -185,6 +185,9 @@ public:
                 .withConstValue(new C2StreamPixelFormatInfo::output(
                                      0u, HAL_PIXEL_FORMAT_YCBCR_420_888))
                 .build());
+
+        // color aspects are attached to every output buffer
+        addSnapshotParameters({ mColorAspects });
     }
 
     static C2R SizeSetter(bool mayBlock, const C2P<C2StreamPictureSizeInfo::output> &oldMe,
@@ -275,8 +278,8 @@ public:
         return C2R::Ok();
     }
 
-    std::shared_ptr<C2StreamColorAspectsInfo::output> getColorAspects_l() {
-        return mColorAspects;
+    std::shared_ptr<C2StreamColorAspectsInfo::output> getColorAspects() {
+        return snapshot()->get(mColorAspects);
     }
 
 private:
@@ -291,19 +294,6 @@ private:
     std::shared_ptr<C2StreamPixelFormatInfo::output> mPixelFormat;
 };
 
-static size_t getCpuCoreCount() {
-    long cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    // _SC_NPROC_ONLN must be defined...
-    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-    CHECK(cpuCoreCount >= 1);
-    ALOGV("Number of CPU cores: %ld", cpuCoreCount);
-    return (size_t)cpuCoreCount;
-}
-
 static void *ivd_aligned_malloc(void *ctxt, WORD32 alignment, WORD32 size) {
     (void) ctxt;
     return memalign(alignment, size);
@@ -418,6 +408,10 @@ status_t C2SoftHevcDec::createDecoder() {
 }
 
 status_t C2SoftHevcDec::setNumCores() {
+    // pick up the current share of the thread budget
+    if (threadAllocation()) {
+        mNumCores = threadAllocation()->threads();
+    }
     ivdext_ctl_set_num_cores_ip_t s_set_num_cores_ip;
     ivdext_ctl_set_num_cores_op_t s_set_num_cores_op;
 
@@ -487,7 +481,7 @@ status_t C2SoftHevcDec::getVersion() {
 
 status_t C2SoftHevcDec::initDecoder() {
     if (OK != createDecoder()) return UNKNOWN_ERROR;
-    mNumCores = MIN(getCpuCoreCount(), MAX_NUM_CORES);
+    acquireThreads(mWidth, mHeight, MAX_NUM_CORES);
     mStride = ALIGN64(mWidth);
     mSignalledError = false;
     resetPlugin();
@@ -679,10 +673,7 @@ void C2SoftHevcDec::finishWork(uint64_t index, const std::unique_ptr<C2Work> &wo
     std::shared_ptr<C2Buffer> buffer = createGraphicBuffer(std::move(mOutBlock),
                                                            C2Rect(mWidth, mHeight));
     mOutBlock = nullptr;
-    {
-        IntfImpl::Lock lock = mIntf->lock();
-        buffer->setInfo(mIntf->getColorAspects_l());
-    }
+    buffer->setInfo(mIntf->getColorAspects());
 
     auto fillWork = [buffer](const std::unique_ptr<C2Work> &work) {
         work->worklets.front()->output.flags = (C2FrameData::flags_t)0;
@@ -833,6 +824,7 @@ void C2SoftHevcDec::process(
             if (s_decode_op.u4_pic_wd != mWidth ||  s_decode_op.u4_pic_ht != mHeight) {
                 mWidth = s_decode_op.u4_pic_wd;
                 mHeight = s_decode_op.u4_pic_ht;
+                setThreadsSize(mWidth, mHeight);
                 CHECK_EQ(0u, s_decode_op.u4_output_present);
 
                 C2VideoSizeStreamInfo::output size(0u, mWidth, mHeight);
@@ -21,6 +21,7 @@
 
 #include <Codec2BufferUtils.h>
 #include <SimpleC2Component.h>
+#include <SimpleC2EncoderInput.h>
 
 #include "mp4enc_api.h"
 
@@ -69,8 +70,7 @@ private:
     int64_t  mNumInputFrames;
     MP4EncodingMode mEncodeMode;
 
-    MemoryBlockPool mConversionBuffers;
-    std::map<void *, MemoryBlock> mConversionBuffersInUse;
+    SimpleC2EncoderInput mInput;
 
     c2_status_t initEncParams();
     c2_status_t initEncoder();
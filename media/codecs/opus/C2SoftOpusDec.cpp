@@ -87,8 +87,15 @@ class C2SoftOpusDec::IntfImpl : public C2InterfaceHelper {
                 DefineParam(mInputMaxBufSize, C2_PARAMKEY_INPUT_MAX_BUFFER_SIZE)
                 .withConstValue(new C2StreamMaxBufferSizeInfo::input(0u, 960 * 6))
                 .build());
+
+        addParameter(SimpleInterface<void>::BaseParams::DefineOutputBatchSize(
+                mOutputBatchSize, 1u));
+
+        addParameter(SimpleInterface<void>::BaseParams::DefinePcmEncoding(mPcmEncodingInfo));
     }
 
+    C2Config::pcm_encoding_t getPcmEncoding() const { return mPcmEncodingInfo->value; }
+
    private:
     std::shared_ptr<C2StreamFormatConfig::input> mInputFormat;
     std::shared_ptr<C2StreamFormatConfig::output> mOutputFormat;
@@ -98,6 +105,8 @@ class C2SoftOpusDec::IntfImpl : public C2InterfaceHelper {
     std::shared_ptr<C2StreamChannelCountInfo::output> mChannelCount;
     std::shared_ptr<C2BitrateTuning::input> mBitrate;
     std::shared_ptr<C2StreamMaxBufferSizeInfo::input> mInputMaxBufSize;
+    std::shared_ptr<C2PortBatchSizeTuning::output> mOutputBatchSize;
+    std::shared_ptr<C2StreamPcmEncodingInfo::output> mPcmEncodingInfo;
 };
 
 C2SoftOpusDec::C2SoftOpusDec(const char *name, c2_node_id_t id,
@@ -434,10 +443,13 @@ void C2SoftOpusDec::process(
     // other timestamp).
     if (work->input.ordinal.timestamp.peeku() == 0) mSamplesToDiscard = mCodecDelay;
 
+    // libopus synthesizes float samples internally, so float output is decoded directly
+    bool outputFloat = mIntf->getPcmEncoding() == C2Config::PCM_FLOAT;
+    size_t sampleSize = outputFloat ? sizeof(float) : sizeof(int16_t);
     std::shared_ptr<C2LinearBlock> block;
     C2MemoryUsage usage = { C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE };
     c2_status_t err = pool->fetchLinearBlock(
-                          kMaxNumSamplesPerBuffer * kMaxChannels * sizeof(int16_t),
+                          kMaxNumSamplesPerBuffer * kMaxChannels * sampleSize,
                           usage, &block);
     if (err != C2_OK) {
         ALOGE("fetchLinearBlock for Output failed with status %d", err);
@@ -451,12 +463,22 @@ void C2SoftOpusDec::process(
         return;
     }
 
-    int numSamples = opus_multistream_decode(mDecoder,
+    int numSamples;
+    if (outputFloat) {
+        numSamples = opus_multistream_decode_float(mDecoder,
+                                                   data,
+                                                   inSize,
+                                                   reinterpret_cast<float *> (wView.data()),
+                                                   kMaxOpusOutputPacketSizeSamples,
+                                                   0);
+    } else {
+        numSamples = opus_multistream_decode(mDecoder,
                                              data,
                                              inSize,
                                              reinterpret_cast<int16_t *> (wView.data()),
                                              kMaxOpusOutputPacketSizeSamples,
                                              0);
+    }
     if (numSamples < 0) {
         ALOGE("opus_multistream_decode returned numSamples %d", numSamples);
         numSamples = 0;
@@ -472,13 +494,13 @@ void C2SoftOpusDec::process(
             numSamples = 0;
         } else {
             numSamples -= mSamplesToDiscard;
-            outOffset = mSamplesToDiscard * sizeof(int16_t) * mHeader.channels;
+            outOffset = mSamplesToDiscard * sampleSize * mHeader.channels;
             mSamplesToDiscard = 0;
         }
     }
 
     if (numSamples) {
-        int outSize = numSamples * sizeof(int16_t) * mHeader.channels;
+        int outSize = numSamples * sampleSize * mHeader.channels;
         ALOGV("out buffer attr. offset %d size %d ", outOffset, outSize);
 
         work->worklets.front()->output.flags = work->input.flags;
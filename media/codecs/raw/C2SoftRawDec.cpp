@@ -84,16 +84,8 @@ public:
                 .withConstValue(new C2StreamMaxBufferSizeInfo::input(0u, 64 * 1024))
                 .build());
 
-        addParameter(
-                DefineParam(mPcmEncodingInfo, C2_PARAMKEY_PCM_ENCODING)
-                .withDefault(new C2StreamPcmEncodingInfo::output(0u, C2Config::PCM_16))
-                .withFields({C2F(mPcmEncodingInfo, value).oneOf({
-                     C2Config::PCM_16,
-                     C2Config::PCM_8,
-                     C2Config::PCM_FLOAT})
-                })
-                .withSetter((Setter<decltype(*mPcmEncodingInfo)>::StrictValueWithNoDeps))
-                .build());
+        addParameter(SimpleInterface<void>::BaseParams::DefinePcmEncoding(
+                mPcmEncodingInfo, true /* withPcm8 */));
 
     }
 
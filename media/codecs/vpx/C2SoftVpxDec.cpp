@@ -57,6 +57,22 @@ public:
 
         // TODO: output latency and reordering
 
+        addParameter(
+                DefineParam(mThreads, C2_PARAMKEY_VPX_DECODER_THREADS)
+                .withDefault(new C2VpxDecoderThreadsTuning(0u))
+                .withFields({ C2F(mThreads, value).inRange(0, 64) })
+                .withSetter(Setter<decltype(*mThreads)>::StrictValueWithNoDeps)
+                .build());
+
+#ifdef VP9
+        addParameter(
+                DefineParam(mRowMt, C2_PARAMKEY_VPX_DECODER_ROW_MT)
+                .withDefault(new C2VpxDecoderRowMtTuning(C2_TRUE))
+                .withFields({ C2F(mRowMt, value).oneOf({ C2_FALSE, C2_TRUE }) })
+                .withSetter(Setter<decltype(*mRowMt)>::StrictValueWithNoDeps)
+                .build());
+#endif
+
         addParameter(
                 DefineParam(mAttrib, C2_PARAMKEY_COMPONENT_ATTRIBUTES)
                 .withConstValue(new C2ComponentAttributesSetting(C2Component::ATTRIB_IS_TEMPORAL))
@@ -249,7 +265,18 @@ public:
         return C2R::Ok();
     }
 
+    uint32_t getThreads_l() const { return mThreads->value; }
+#ifdef VP9
+    bool getRowMt_l() const { return mRowMt->value; }
+#else
+    bool getRowMt_l() const { return false; }
+#endif
+
 private:
+    std::shared_ptr<C2VpxDecoderThreadsTuning> mThreads;
+#ifdef VP9
+    std::shared_ptr<C2VpxDecoderRowMtTuning> mRowMt;
+#endif
     std::shared_ptr<C2StreamProfileLevelInfo::input> mProfileLevel;
     std::shared_ptr<C2StreamPictureSizeInfo::output> mSize;
     std::shared_ptr<C2StreamMaxPictureSizeTuning::output> mMaxSize;
@@ -325,18 +352,8 @@ c2_status_t C2SoftVpxDec::onFlush_sm() {
     return C2_OK;
 }
 
-static int GetCPUCoreCount() {
-    int cpuCoreCount = 1;
-#if defined(_SC_NPROCESSORS_ONLN)
-    cpuCoreCount = sysconf(_SC_NPROCESSORS_ONLN);
-#else
-    // _SC_NPROC_ONLN must be defined...
-    cpuCoreCount = sysconf(_SC_NPROC_ONLN);
-#endif
-    CHECK(cpuCoreCount >= 1);
-    ALOGV("Number of CPU cores: %d", cpuCoreCount);
-    return cpuCoreCount;
-}
+// upper bound of decoder threads taken from the thread budget
+constexpr size_t kMaxThreads = 16;
 
 status_t C2SoftVpxDec::initDecoder() {
 #ifdef VP9
@@ -359,9 +376,20 @@ status_t C2SoftVpxDec::initDecoder() {
         return NO_MEMORY;
     }
 
+    uint32_t threads;
+    bool rowMt;
+    {
+        IntfImpl::Lock lock = mIntf->lock();
+        threads = mIntf->getThreads_l();
+        rowMt = mIntf->getRowMt_l();
+    }
+
+    const std::shared_ptr<SimpleC2ThreadBudget::Allocation> &allocation =
+        acquireThreads(mWidth, mHeight, kMaxThreads);
+
     vpx_codec_dec_cfg_t cfg;
     memset(&cfg, 0, sizeof(vpx_codec_dec_cfg_t));
-    cfg.threads = GetCPUCoreCount();
+    cfg.threads = threads ? threads : allocation->threads();
 
     vpx_codec_flags_t flags;
     memset(&flags, 0, sizeof(vpx_codec_flags_t));
@@ -375,6 +403,21 @@ status_t C2SoftVpxDec::initDecoder() {
         return UNKNOWN_ERROR;
     }
 
+#ifdef VPX_CTRL_VP9D_SET_ROW_MT
+    if (mMode == MODE_VP9 && rowMt && cfg.threads > 1) {
+        // row based multithreading also threads the loop filter row by row; the loop filter
+        // optimization skips filtering of blocks that libvpx can tell are unaffected.
+        if ((vpx_err = vpx_codec_control(mCodecCtx, VP9D_SET_ROW_MT, 1))) {
+            ALOGW("failed to enable row based multithreading. (%d)", vpx_err);
+        } else if ((vpx_err = vpx_codec_control(mCodecCtx, VP9D_SET_LOOP_FILTER_OPT, 1))) {
+            ALOGW("failed to enable loop filter optimization. (%d)", vpx_err);
+        }
+    }
+#else
+    (void)rowMt;
+#endif
+    ALOGV("decoding with %u threads, row-mt %d", cfg.threads, rowMt);
+
     return OK;
 }
 
@@ -564,6 +607,8 @@ bool C2SoftVpxDec::outputBuffer(
     if (img->d_w != mWidth || img->d_h != mHeight) {
         mWidth = img->d_w;
         mHeight = img->d_h;
+        // libvpx only takes a thread count at init; this affects the shares of others
+        setThreadsSize(mWidth, mHeight);
 
         C2VideoSizeStreamInfo::output size(0u, mWidth, mHeight);
         std::vector<std::unique_ptr<C2SettingResult>> failures;
@@ -19,12 +19,39 @@
 
 #include <SimpleC2Component.h>
 
+#include <C2Config.h>
+
 
 #include "vpx/vpx_decoder.h"
 #include "vpx/vp8dx.h"
 
 namespace android {
 
+enum : C2Param::type_index_t {
+    kParamIndexVpxDecoderThreads = C2Param::TYPE_INDEX_VENDOR_START,
+    kParamIndexVpxDecoderRowMt,
+};
+
+/**
+ * Number of threads used by the decoder. 0 means the share of the process-wide codec thread
+ * budget (see SimpleC2ThreadBudget).
+ *
+ * This only takes effect when the component is (re)started.
+ */
+typedef C2GlobalParam<C2Tuning, C2Uint32Value, kParamIndexVpxDecoderThreads>
+        C2VpxDecoderThreadsTuning;
+constexpr char C2_PARAMKEY_VPX_DECODER_THREADS[] = "vendor.vpx-decoder.threads";
+
+/**
+ * Whether VP9 frames are decoded and loop filtered row by row on multiple threads, as opposed to
+ * tile by tile. This allows using more than one thread for streams with a single tile column.
+ *
+ * This only takes effect when the component is (re)started.
+ */
+typedef C2GlobalParam<C2Tuning, C2EasyBoolValue, kParamIndexVpxDecoderRowMt>
+        C2VpxDecoderRowMtTuning;
+constexpr char C2_PARAMKEY_VPX_DECODER_ROW_MT[] = "vendor.vpx-decoder.row-mt";
+
 struct C2SoftVpxDec : public SimpleC2Component {
     class IntfImpl;
 
@@ -65,6 +65,7 @@ C2SoftVpxEnc::C2SoftVpxEnc(const char* name, c2_node_id_t id,
       mTemporalPatternLength(0),
       mTemporalPatternIdx(0),
       mLastTimestamp(0x7FFFFFFFFFFFFFFFull),
+      mInput(name, SimpleC2EncoderInput::FORMAT_I420),
       mSignalledOutputEos(false),
       mSignalledError(false) {
     memset(mTemporalLayerBitrateRatio, 0, sizeof(mTemporalLayerBitrateRatio));
@@ -94,6 +95,8 @@ void C2SoftVpxEnc::onRelease() {
 
     // this one is not allocated by us
     mCodecInterface = nullptr;
+
+    mInput.reset();
 }
 
 c2_status_t C2SoftVpxEnc::onStop() {
@@ -317,15 +320,8 @@ status_t C2SoftVpxEnc::initEncoder() {
             ((uint64_t)INT32_MAX / 3)) {
             ALOGE("b/25812794, Buffer size is too big, width=%u, height=%u.", width, height);
         } else {
-            uint32_t stride = (width + mStrideAlign - 1) & ~(mStrideAlign - 1);
-            uint32_t vstride = (height + mStrideAlign - 1) & ~(mStrideAlign - 1);
-            mConversionBuffer = MemoryBlock::Allocate(stride * vstride * 3 / 2);
-            if (!mConversionBuffer.size()) {
-                ALOGE("Allocating conversion buffer failed.");
-            } else {
-                mNumInputFrames = -1;
-                return OK;
-            }
+            mNumInputFrames = -1;
+            return OK;
         }
     }
 
@@ -466,7 +462,6 @@ void C2SoftVpxEnc::process(
     }
     bool eos = ((work->input.flags & C2FrameData::FLAG_END_OF_STREAM) != 0);
     vpx_image_t raw_frame;
-    const C2PlanarLayout &layout = rView->layout();
     uint32_t width = rView->width();
     uint32_t height = rView->height();
     if (width > 0x8000 || height > 0x8000) {
@@ -476,69 +471,28 @@ void C2SoftVpxEnc::process(
     }
     uint32_t stride = (width + mStrideAlign - 1) & ~(mStrideAlign - 1);
     uint32_t vstride = (height + mStrideAlign - 1) & ~(mStrideAlign - 1);
-    switch (layout.type) {
-        case C2PlanarLayout::TYPE_RGB:
-        case C2PlanarLayout::TYPE_RGBA: {
-            ConvertRGBToPlanarYUV(mConversionBuffer.data(), stride, vstride,
-                                  mConversionBuffer.size(), *rView.get());
-            vpx_img_wrap(&raw_frame, VPX_IMG_FMT_I420, width, height,
-                         mStrideAlign, mConversionBuffer.data());
-            break;
-        }
-        case C2PlanarLayout::TYPE_YUV: {
-            if (!IsYUV420(*rView)) {
-                ALOGE("input is not YUV420");
-                work->result = C2_BAD_VALUE;
-                return;
-            }
-
-            if (layout.planes[layout.PLANE_Y].colInc == 1
-                    && layout.planes[layout.PLANE_U].colInc == 1
-                    && layout.planes[layout.PLANE_V].colInc == 1) {
-                // I420 compatible - though with custom offset and stride
-                vpx_img_wrap(&raw_frame, VPX_IMG_FMT_I420, width, height,
-                             mStrideAlign, (uint8_t*)rView->data()[0]);
-                raw_frame.planes[1] = (uint8_t*)rView->data()[1];
-                raw_frame.planes[2] = (uint8_t*)rView->data()[2];
-                raw_frame.stride[0] = layout.planes[layout.PLANE_Y].rowInc;
-                raw_frame.stride[1] = layout.planes[layout.PLANE_U].rowInc;
-                raw_frame.stride[2] = layout.planes[layout.PLANE_V].rowInc;
-            } else {
-                // copy to I420
-                MediaImage2 img = CreateYUV420PlanarMediaImage2(width, height, stride, vstride);
-                if (mConversionBuffer.size() >= stride * vstride * 3 / 2) {
-                    status_t err = ImageCopy(mConversionBuffer.data(), &img, *rView);
-                    if (err != OK) {
-                        ALOGE("Buffer conversion failed: %d", err);
-                        work->result = C2_BAD_VALUE;
-                        return;
-                    }
-                    vpx_img_wrap(&raw_frame, VPX_IMG_FMT_I420, stride, vstride,
-                                 mStrideAlign, (uint8_t*)rView->data()[0]);
-                    vpx_img_set_rect(&raw_frame, 0, 0, width, height);
-                } else {
-                    ALOGE("Conversion buffer is too small: %u x %u for %zu",
-                            stride, vstride, mConversionBuffer.size());
-                    work->result = C2_BAD_VALUE;
-                    return;
-                }
-            }
-            break;
-        }
-        default:
-            ALOGE("Unrecognized plane type: %d", layout.type);
-            work->result = C2_BAD_VALUE;
-            return;
+    SimpleC2EncoderInput::Frame frame;
+    c2_status_t err = mInput.prepare(*rView, stride, vstride,
+                                     C2Color::MATRIX_BT601, C2Color::RANGE_LIMITED, &frame);
+    if (err != C2_OK) {
+        work->result = err;
+        return;
+    }
+    vpx_img_wrap(&raw_frame, VPX_IMG_FMT_I420, width, height, mStrideAlign, frame.planes[0]);
+    for (size_t i = 0; i < 3; ++i) {
+        raw_frame.planes[i] = frame.planes[i];
+        raw_frame.stride[i] = frame.strides[i];
     }
 
     vpx_enc_frame_flags_t flags = getEncodeFlags();
     // handle dynamic config parameters
     {
-        IntfImpl::Lock lock = mIntf->lock();
-        std::shared_ptr<C2StreamIntraRefreshTuning::output> intraRefresh = mIntf->getIntraRefresh_l();
-        std::shared_ptr<C2StreamBitrateInfo::output> bitrate = mIntf->getBitrate_l();
-        std::shared_ptr<C2StreamRequestSyncFrameTuning::output> requestSync = mIntf->getRequestSync_l();
-        lock.unlock();
+        std::shared_ptr<const IntfImpl::Snapshot> snapshot = mIntf->snapshot();
+        std::shared_ptr<C2StreamIntraRefreshTuning::output> intraRefresh =
+            mIntf->getIntraRefresh(*snapshot);
+        std::shared_ptr<C2StreamBitrateInfo::output> bitrate = mIntf->getBitrate(*snapshot);
+        std::shared_ptr<C2StreamRequestSyncFrameTuning::output> requestSync =
+            mIntf->getRequestSync(*snapshot);
 
         if (intraRefresh != mIntraRefresh) {
             mIntraRefresh = intraRefresh;
@@ -592,6 +546,8 @@ void C2SoftVpxEnc::process(
                                                     inputTimeStamp,
                                                     frameDuration, flags,
                                                     VPX_DL_REALTIME);
+    // the encoder has copied the frame
+    mInput.release(frame.planes[0]);
     if (codec_return != VPX_CODEC_OK) {
         ALOGE("vpx encoder failed to encode frame");
         mSignalledError = true;
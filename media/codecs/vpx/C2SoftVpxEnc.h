@@ -22,6 +22,7 @@
 #include <C2PlatformSupport.h>
 #include <Codec2BufferUtils.h>
 #include <SimpleC2Component.h>
+#include <SimpleC2EncoderInput.h>
 #include <SimpleC2Interface.h>
 #include <util/C2InterfaceHelper.h>
 
@@ -200,9 +201,8 @@ struct C2SoftVpxEnc : public SimpleC2Component {
      // Number of input frames
      int64_t mNumInputFrames;
 
-     // Conversion buffer is needed to input to
-     // yuv420 planar format.
-     MemoryBlock mConversionBuffer;
+     // Adapts input that is not yuv420 planar
+     SimpleC2EncoderInput mInput;
 
      // Signalled EOS
      bool mSignalledOutputEos;
@@ -344,6 +344,9 @@ class C2SoftVpxEnc::IntfImpl : public C2InterfaceHelper {
                 .withFields({C2F(mRequestSync, value).oneOf({ C2_FALSE, C2_TRUE }) })
                 .withSetter(Setter<decltype(*mRequestSync)>::NonStrictValueWithNoDeps)
                 .build());
+
+        // dynamic parameters are read for every frame
+        addSnapshotParameters({ mIntraRefresh, mBitrate, mRequestSync });
     }
 
     static C2R BitrateSetter(bool mayBlock, C2P<C2StreamBitrateInfo::output> &me) {
@@ -407,6 +410,17 @@ class C2SoftVpxEnc::IntfImpl : public C2InterfaceHelper {
     std::shared_ptr<C2StreamBitrateModeTuning::output> getBitrateMode_l() const { return mBitrateMode; }
     std::shared_ptr<C2StreamRequestSyncFrameTuning::output> getRequestSync_l() const { return mRequestSync; }
     std::shared_ptr<C2StreamTemporalLayeringTuning::output> getTemporalLayers_l() const { return mLayering; }
+
+    // getters of dynamic parameters that do not require locking
+    std::shared_ptr<C2StreamIntraRefreshTuning::output> getIntraRefresh(const Snapshot &snapshot) const {
+        return snapshot.get(mIntraRefresh);
+    }
+    std::shared_ptr<C2StreamBitrateInfo::output> getBitrate(const Snapshot &snapshot) const {
+        return snapshot.get(mBitrate);
+    }
+    std::shared_ptr<C2StreamRequestSyncFrameTuning::output> getRequestSync(const Snapshot &snapshot) const {
+        return snapshot.get(mRequestSync);
+    }
     uint32_t getSyncFramePeriod() const {
         if (mSyncFramePeriod->value < 0 || mSyncFramePeriod->value == INT64_MAX) {
             return 0;
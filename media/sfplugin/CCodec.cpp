@@ -703,6 +703,15 @@ void CCodec::configure(const sp<AMessage> &msg) {
             mChannel->setMetaMode(CCodecBufferChannel::MODE_ANW);
         }
 
+        int32_t adaptivePipeline =
+            property_get_bool("debug.stagefright.ccodec_adaptive_pipeline", false);
+        int32_t minPipelineDepth = 1;
+        int32_t maxPipelineDepth = 0;
+        (void)msg->findInt32("pipeline-adaptive", &adaptivePipeline);
+        (void)msg->findInt32("pipeline-min-depth", &minPipelineDepth);
+        (void)msg->findInt32("pipeline-max-depth", &maxPipelineDepth);
+        mChannel->setAdaptivePipeline(adaptivePipeline, minPipelineDepth, maxPipelineDepth);
+
         sp<RefBase> obj;
         sp<Surface> surface;
         if (msg->findObject("native-window", &obj)) {
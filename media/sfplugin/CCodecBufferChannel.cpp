@@ -16,7 +16,9 @@
 
 //#define LOG_NDEBUG 0
 #define LOG_TAG "CCodecBufferChannel"
+#define ATRACE_TAG ATRACE_TAG_VIDEO
 #include <utils/Log.h>
+#include <utils/Trace.h>
 
 #include <numeric>
 
@@ -43,6 +45,7 @@
 
 #include "CCodecBufferChannel.h"
 #include "Codec2Buffer.h"
+#include "LocalBufferPool.h"
 #include "SkipCutBuffer.h"
 
 namespace android {
@@ -94,6 +97,12 @@ public:
      */
     virtual void getArray(Vector<sp<MediaCodecBuffer>> *) const {}
 
+    /**
+     * Returns a summary of the local buffer pool usage, or an empty string if
+     * these buffers are not backed by a local buffer pool.
+     */
+    virtual std::string dumpLocalBufferPool() const { return std::string(); }
+
 protected:
     std::string mComponentName; ///< name of component for debugging
     std::string mChannelName; ///< name of channel for debugging
@@ -207,21 +216,23 @@ public:
     virtual std::unique_ptr<OutputBuffers> toArrayMode(size_t size) = 0;
 
     /**
-     * Initialize SkipCutBuffer object.
+     * Initialize SkipCutBuffer object. |sampleSize| is the size in bytes of
+     * one sample of a channel.
      */
     void initSkipCutBuffer(
-            int32_t delay, int32_t padding, int32_t sampleRate, int32_t channelCount) {
+            int32_t delay, int32_t padding, int32_t sampleRate, int32_t channelCount,
+            size_t sampleSize) {
         CHECK(mSkipCutBuffer == nullptr);
         mDelay = delay;
         mPadding = padding;
         mSampleRate = sampleRate;
-        setSkipCutBuffer(delay, padding, channelCount);
+        setSkipCutBuffer(delay, padding, channelCount, sampleSize);
     }
 
     /**
      * Update the SkipCutBuffer object. No-op if it's never initialized.
      */
-    void updateSkipCutBuffer(int32_t sampleRate, int32_t channelCount) {
+    void updateSkipCutBuffer(int32_t sampleRate, int32_t channelCount, size_t sampleSize) {
         if (mSkipCutBuffer == nullptr) {
             return;
         }
@@ -231,7 +242,7 @@ public:
             delay = ((int64_t)delay * sampleRate) / mSampleRate;
             padding = ((int64_t)padding * sampleRate) / mSampleRate;
         }
-        setSkipCutBuffer(delay, padding, channelCount);
+        setSkipCutBuffer(delay, padding, channelCount, sampleSize);
     }
 
     /**
@@ -258,14 +269,14 @@ private:
     int32_t mPadding;
     int32_t mSampleRate;
 
-    void setSkipCutBuffer(int32_t skip, int32_t cut, int32_t channelCount) {
+    void setSkipCutBuffer(int32_t skip, int32_t cut, int32_t channelCount, size_t sampleSize) {
         if (mSkipCutBuffer != nullptr) {
             size_t prevSize = mSkipCutBuffer->size();
             if (prevSize != 0u) {
                 ALOGD("[%s] Replacing SkipCutBuffer holding %zu bytes", mName, prevSize);
             }
         }
-        mSkipCutBuffer = new SkipCutBuffer(skip, cut, channelCount);
+        mSkipCutBuffer = new SkipCutBuffer(skip, cut, channelCount, sampleSize);
     }
 
     DISALLOW_EVIL_CONSTRUCTORS(OutputBuffers);
@@ -276,6 +287,31 @@ namespace {
 // TODO: get this info from component
 const static size_t kMinInputBufferArraySize = 4;
 const static size_t kMaxPipelineCapacity = 18;
+// Number of work items in flight whose queue time is tracked for adaptive
+// pipeline depth. Must be larger than the maximum depth.
+const static size_t kMaxTrackedWork = 64;
+// Number of work items kept in flight in adaptive mode on top of the number
+// needed to cover the component latency, to absorb jitter.
+const static int kAdaptiveDepthHeadroom = 1;
+
+// Returns the size in bytes of one sample of a channel of raw audio in |format|.
+size_t GetPcmSampleSize(const sp<AMessage> &format) {
+    int32_t encoding = kAudioEncodingPcm16bit;
+    (void)format->findInt32(KEY_PCM_ENCODING, &encoding);
+    switch (encoding) {
+        case kAudioEncodingPcm8bit:
+            return 1;
+        case kAudioEncodingPcmFloat:
+            return 4;
+        default:
+            return 2;
+    }
+}
+
+// Exponential moving average with a weight of 1/8 for the new sample.
+void UpdateAverage(nsecs_t *average, nsecs_t sample) {
+    *average = *average ? *average + (sample - *average) / 8 : sample;
+}
 const static size_t kChannelOutputDelay = 0;
 const static size_t kMinOutputBufferArraySize = kMaxPipelineCapacity +
                                                 kChannelOutputDelay;
@@ -283,115 +319,6 @@ const static size_t kLinearBufferSize = 1048576;
 // This can fit 4K RGBA frame, and most likely client won't need more than this.
 const static size_t kMaxLinearBufferSize = 3840 * 2160 * 4;
 
-/**
- * Simple local buffer pool backed by std::vector.
- */
-class LocalBufferPool : public std::enable_shared_from_this<LocalBufferPool> {
-public:
-    /**
-     * Create a new LocalBufferPool object.
-     *
-     * \param poolCapacity  max total size of buffers managed by this pool.
-     *
-     * \return  a newly created pool object.
-     */
-    static std::shared_ptr<LocalBufferPool> Create(size_t poolCapacity) {
-        return std::shared_ptr<LocalBufferPool>(new LocalBufferPool(poolCapacity));
-    }
-
-    /**
-     * Return an ABuffer object whose size is at least |capacity|.
-     *
-     * \param   capacity  requested capacity
-     * \return  nullptr if the pool capacity is reached
-     *          an ABuffer object otherwise.
-     */
-    sp<ABuffer> newBuffer(size_t capacity) {
-        Mutex::Autolock lock(mMutex);
-        auto it = std::find_if(
-                mPool.begin(), mPool.end(),
-                [capacity](const std::vector<uint8_t> &vec) {
-                    return vec.capacity() >= capacity;
-                });
-        if (it != mPool.end()) {
-            sp<ABuffer> buffer = new VectorBuffer(std::move(*it), shared_from_this());
-            mPool.erase(it);
-            return buffer;
-        }
-        if (mUsedSize + capacity > mPoolCapacity) {
-            while (!mPool.empty()) {
-                mUsedSize -= mPool.back().capacity();
-                mPool.pop_back();
-            }
-            if (mUsedSize + capacity > mPoolCapacity) {
-                ALOGD("mUsedSize = %zu, capacity = %zu, mPoolCapacity = %zu",
-                        mUsedSize, capacity, mPoolCapacity);
-                return nullptr;
-            }
-        }
-        std::vector<uint8_t> vec(capacity);
-        mUsedSize += vec.capacity();
-        return new VectorBuffer(std::move(vec), shared_from_this());
-    }
-
-private:
-    /**
-     * ABuffer backed by std::vector.
-     */
-    class VectorBuffer : public ::android::ABuffer {
-    public:
-        /**
-         * Construct a VectorBuffer by taking the ownership of supplied vector.
-         *
-         * \param vec   backing vector of the buffer. this object takes
-         *              ownership at construction.
-         * \param pool  a LocalBufferPool object to return the vector at
-         *              destruction.
-         */
-        VectorBuffer(std::vector<uint8_t> &&vec, const std::shared_ptr<LocalBufferPool> &pool)
-            : ABuffer(vec.data(), vec.capacity()),
-              mVec(std::move(vec)),
-              mPool(pool) {
-        }
-
-        ~VectorBuffer() override {
-            std::shared_ptr<LocalBufferPool> pool = mPool.lock();
-            if (pool) {
-                // If pool is alive, return the vector back to the pool so that
-                // it can be recycled.
-                pool->returnVector(std::move(mVec));
-            }
-        }
-
-    private:
-        std::vector<uint8_t> mVec;
-        std::weak_ptr<LocalBufferPool> mPool;
-    };
-
-    Mutex mMutex;
-    size_t mPoolCapacity;
-    size_t mUsedSize;
-    std::list<std::vector<uint8_t>> mPool;
-
-    /**
-     * Private constructor to prevent constructing non-managed LocalBufferPool.
-     */
-    explicit LocalBufferPool(size_t poolCapacity)
-        : mPoolCapacity(poolCapacity), mUsedSize(0) {
-    }
-
-    /**
-     * Take back the ownership of vec from the destructed VectorBuffer and put
-     * it in front of the pool.
-     */
-    void returnVector(std::vector<uint8_t> &&vec) {
-        Mutex::Autolock lock(mMutex);
-        mPool.push_front(std::move(vec));
-    }
-
-    DISALLOW_EVIL_CONSTRUCTORS(LocalBufferPool);
-};
-
 sp<GraphicBlockBuffer> AllocateGraphicBuffer(
         const std::shared_ptr<C2BlockPool> &pool,
         const sp<AMessage> &format,
@@ -1031,6 +958,10 @@ public:
         return std::move(array);
     }
 
+    std::string dumpLocalBufferPool() const override {
+        return mLocalBufferPool->dump();
+    }
+
 private:
     FlexBuffersImpl mImpl;
     std::shared_ptr<LocalBufferPool> mLocalBufferPool;
@@ -1354,6 +1285,10 @@ public:
                 });
     }
 
+    std::string dumpLocalBufferPool() const override {
+        return mLocalBufferPool->dump();
+    }
+
 private:
     std::shared_ptr<LocalBufferPool> mLocalBufferPool;
 };
@@ -1416,7 +1351,20 @@ void CCodecBufferChannel::QueueSync::stop() {
 
 CCodecBufferChannel::PipelineCapacity::PipelineCapacity()
       : input(0), component(0),
-        mName("<UNKNOWN COMPONENT>") {
+        mName("<UNKNOWN COMPONENT>"),
+        mAdaptive(false),
+        mMinDepth(1),
+        mMaxDepth(kMaxPipelineCapacity),
+        mDepth(0),
+        mQueuedWork(kMaxTrackedWork, QueuedWork{ 0, 0 }),
+        mLatencyNs(0),
+        mWorkIntervalNs(0),
+        mDrainIntervalNs(0),
+        mLastWorkDoneNs(0),
+        mLastDrainedNs(0),
+        mGrown(0),
+        mShrunk(0),
+        mComponentStalls(0) {
 }
 
 void CCodecBufferChannel::PipelineCapacity::initialize(
@@ -1424,6 +1372,21 @@ void CCodecBufferChannel::PipelineCapacity::initialize(
         int newComponent,
         const char* newName,
         const char* callerTag) {
+    {
+        std::lock_guard<std::mutex> lock(mAdaptiveLock);
+        if (mAdaptive) {
+            newComponent = std::min(std::max(newComponent, mMinDepth), mMaxDepth);
+        }
+        mDepth = newComponent;
+        std::fill(mQueuedWork.begin(), mQueuedWork.end(), QueuedWork{ 0, 0 });
+        mLatencyNs = 0;
+        mWorkIntervalNs = 0;
+        mDrainIntervalNs = 0;
+        mLastWorkDoneNs = 0;
+        mLastDrainedNs = 0;
+        mDepthCounterName = std::string(newName) + " pipeline depth";
+        mLatencyCounterName = std::string(newName) + " pipeline latency us";
+    }
     input.store(newInput, std::memory_order_relaxed);
     component.store(newComponent, std::memory_order_relaxed);
     mName = newName;
@@ -1448,6 +1411,9 @@ bool CCodecBufferChannel::PipelineCapacity::allocate(const char* callerTag) {
     }
     input.fetch_add(1, std::memory_order_relaxed);
     component.fetch_add(1, std::memory_order_relaxed);
+    if (prevInput > 0) {
+        mComponentStalls.fetch_add(1, std::memory_order_relaxed);
+    }
     ALOGV("[%s] %s -- PipelineCapacity::allocate() returns false: "
           "pipeline availability unchanged ==> "
           "input = %d, component = %d",
@@ -1496,77 +1462,99 @@ int CCodecBufferChannel::PipelineCapacity::freeComponentSlot(
     return prevComponent + 1;
 }
 
-// CCodecBufferChannel::ReorderStash
-
-CCodecBufferChannel::ReorderStash::ReorderStash() {
-    clear();
+void CCodecBufferChannel::PipelineCapacity::setAdaptive(
+        bool adaptive, int minDepth, int maxDepth) {
+    std::lock_guard<std::mutex> lock(mAdaptiveLock);
+    mAdaptive = adaptive;
+    mMaxDepth = std::min(std::max(maxDepth, 1), (int)kMaxTrackedWork - 1);
+    mMinDepth = std::min(std::max(minDepth, 1), mMaxDepth);
 }
 
-void CCodecBufferChannel::ReorderStash::clear() {
-    mPending.clear();
-    mStash.clear();
-    mDepth = 0;
-    mKey = C2Config::ORDINAL;
-}
-
-void CCodecBufferChannel::ReorderStash::setDepth(uint32_t depth) {
-    mPending.splice(mPending.end(), mStash);
-    mDepth = depth;
-}
-void CCodecBufferChannel::ReorderStash::setKey(C2Config::ordinal_key_t key) {
-    mPending.splice(mPending.end(), mStash);
-    mKey = key;
-}
-
-bool CCodecBufferChannel::ReorderStash::pop(Entry *entry) {
-    if (mPending.empty()) {
-        return false;
+void CCodecBufferChannel::PipelineCapacity::onWorkQueued(uint64_t frameIndex) {
+    std::lock_guard<std::mutex> lock(mAdaptiveLock);
+    if (mAdaptive) {
+        mQueuedWork[frameIndex % kMaxTrackedWork] = { frameIndex, systemTime() };
     }
-    entry->buffer     = mPending.front().buffer;
-    entry->timestamp  = mPending.front().timestamp;
-    entry->flags      = mPending.front().flags;
-    entry->ordinal    = mPending.front().ordinal;
-    mPending.pop_front();
-    return true;
 }
 
-void CCodecBufferChannel::ReorderStash::emplace(
-        const std::shared_ptr<C2Buffer> &buffer,
-        int64_t timestamp,
-        int32_t flags,
-        const C2WorkOrdinalStruct &ordinal) {
-    for (auto it = mStash.begin(); it != mStash.end(); ++it) {
-        if (less(ordinal, it->ordinal)) {
-            mStash.emplace(it, buffer, timestamp, flags, ordinal);
-            return;
-        }
+void CCodecBufferChannel::PipelineCapacity::onWorkDone(uint64_t frameIndex) {
+    nsecs_t now = systemTime();
+    std::lock_guard<std::mutex> lock(mAdaptiveLock);
+    if (!mAdaptive) {
+        return;
+    }
+    QueuedWork &work = mQueuedWork[frameIndex % kMaxTrackedWork];
+    if (work.frameIndex == frameIndex && work.queuedNs != 0) {
+        UpdateAverage(&mLatencyNs, now - work.queuedNs);
+        work.queuedNs = 0;
     }
-    mStash.emplace_back(buffer, timestamp, flags, ordinal);
-    while (!mStash.empty() && mStash.size() > mDepth) {
-        mPending.push_back(mStash.front());
-        mStash.pop_front();
+    if (mLastWorkDoneNs != 0) {
+        UpdateAverage(&mWorkIntervalNs, now - mLastWorkDoneNs);
     }
+    mLastWorkDoneNs = now;
+    updateDepth_l();
 }
 
-void CCodecBufferChannel::ReorderStash::defer(
-        const CCodecBufferChannel::ReorderStash::Entry &entry) {
-    mPending.push_front(entry);
+void CCodecBufferChannel::PipelineCapacity::onOutputDrained() {
+    nsecs_t now = systemTime();
+    std::lock_guard<std::mutex> lock(mAdaptiveLock);
+    if (!mAdaptive) {
+        return;
+    }
+    if (mLastDrainedNs != 0) {
+        UpdateAverage(&mDrainIntervalNs, now - mLastDrainedNs);
+    }
+    mLastDrainedNs = now;
 }
 
-bool CCodecBufferChannel::ReorderStash::hasPending() const {
-    return !mPending.empty();
+void CCodecBufferChannel::PipelineCapacity::updateDepth_l() {
+    if (mLatencyNs <= 0 || mWorkIntervalNs <= 0) {
+        return;
+    }
+    // Little's law: the number of work items in flight needed to sustain the
+    // throughput of the slower of the component and the client.
+    nsecs_t interval = std::max(mWorkIntervalNs, mDrainIntervalNs);
+    int target = (int)std::min((mLatencyNs + interval - 1) / interval, (nsecs_t)mMaxDepth)
+            + kAdaptiveDepthHeadroom;
+    target = std::min(std::max(target, mMinDepth), mMaxDepth);
+
+    int newDepth = mDepth;
+    if (target > mDepth) {
+        newDepth = target;
+        ++mGrown;
+    } else if (target < mDepth) {
+        newDepth = mDepth - 1;
+        ++mShrunk;
+    }
+    if (newDepth != mDepth) {
+        component.fetch_add(newDepth - mDepth, std::memory_order_relaxed);
+        ALOGV("[%s] PipelineCapacity: depth %d => %d "
+              "(latency = %lld us, work interval = %lld us, drain interval = %lld us)",
+                mName, mDepth, newDepth,
+                (long long)mLatencyNs / 1000,
+                (long long)mWorkIntervalNs / 1000,
+                (long long)mDrainIntervalNs / 1000);
+        mDepth = newDepth;
+    }
+    ATRACE_INT(mDepthCounterName.c_str(), mDepth);
+    ATRACE_INT(mLatencyCounterName.c_str(), (int32_t)(mLatencyNs / 1000));
 }
 
-bool CCodecBufferChannel::ReorderStash::less(
-        const C2WorkOrdinalStruct &o1, const C2WorkOrdinalStruct &o2) {
-    switch (mKey) {
-        case C2Config::ORDINAL:   return o1.frameIndex < o2.frameIndex;
-        case C2Config::TIMESTAMP: return o1.timestamp < o2.timestamp;
-        case C2Config::CUSTOM:    return o1.customOrdinal < o2.customOrdinal;
-        default:
-            ALOGD("Unrecognized key; default to timestamp");
-            return o1.frameIndex < o2.frameIndex;
-    }
+CCodecBufferChannel::PipelineCapacity::Stats
+CCodecBufferChannel::PipelineCapacity::getStats() const {
+    std::lock_guard<std::mutex> lock(mAdaptiveLock);
+    return Stats{
+        mAdaptive,
+        mDepth,
+        mMinDepth,
+        mMaxDepth,
+        mLatencyNs / 1000,
+        mWorkIntervalNs / 1000,
+        mDrainIntervalNs / 1000,
+        mGrown,
+        mShrunk,
+        mComponentStalls.load(std::memory_order_relaxed),
+    };
 }
 
 // CCodecBufferChannel
@@ -1635,6 +1623,7 @@ status_t CCodecBufferChannel::queueInputBufferInternal(const sp<MediaCodecBuffer
     std::unique_ptr<C2Work> work(new C2Work);
     work->input.ordinal.timestamp = timeUs;
     work->input.ordinal.frameIndex = mFrameIndex++;
+    mAvailablePipelineCapacity.onWorkQueued(work->input.ordinal.frameIndex.peeku());
     // WORKAROUND: until codecs support handling work after EOS and max output sizing, use timestamp
     // manipulation to achieve image encoding via video codec, and to constrain encoded output.
     // Keep client timestamp in customOrdinal
@@ -1855,6 +1844,9 @@ status_t CCodecBufferChannel::renderOutputBuffer(
             released = (*buffers)->releaseBuffer(buffer, &c2Buffer);
         }
     }
+    if (released) {
+        mAvailablePipelineCapacity.onOutputDrained();
+    }
     // NOTE: some apps try to releaseOutputBuffer() with timestamp and/or render
     //       set to true.
     sendOutputBuffers();
@@ -2024,6 +2016,7 @@ status_t CCodecBufferChannel::discardBuffer(const sp<MediaCodecBuffer> &buffer)
         if (*buffers && (*buffers)->releaseBuffer(buffer, nullptr)) {
             buffers.unlock();
             released = true;
+            mAvailablePipelineCapacity.onOutputDrained();
         }
     }
     if (released) {
@@ -2364,7 +2357,9 @@ status_t CCodecBufferChannel::start(
                 if (delay || padding) {
                     // We need write access to the buffers, and we're already in
                     // array mode.
-                    (*buffers)->initSkipCutBuffer(delay, padding, sampleRate, channelCount);
+                    (*buffers)->initSkipCutBuffer(
+                            delay, padding, sampleRate, channelCount,
+                            GetPcmSampleSize(outputFormat));
                 }
             }
         }
@@ -2478,6 +2473,31 @@ status_t CCodecBufferChannel::requestInitialInputBuffers() {
 
 void CCodecBufferChannel::stop() {
     mSync.stop();
+    PipelineCapacity::Stats stats = mAvailablePipelineCapacity.getStats();
+    if (stats.adaptive) {
+        ALOGD("[%s] adaptive pipeline: depth = %d [%d, %d], latency = %lld us, "
+              "work interval = %lld us, drain interval = %lld us, "
+              "grown = %u, shrunk = %u, component stalls = %u",
+                mName, stats.depth, stats.minDepth, stats.maxDepth,
+                (long long)stats.latencyUs,
+                (long long)stats.workIntervalUs,
+                (long long)stats.drainIntervalUs,
+                stats.grown, stats.shrunk, stats.componentStalls);
+    }
+    {
+        Mutexed<std::unique_ptr<InputBuffers>>::Locked buffers(mInputBuffers);
+        std::string pool = *buffers ? (*buffers)->dumpLocalBufferPool() : std::string();
+        if (!pool.empty()) {
+            ALOGD("[%s] input local buffer pool: %s", mName, pool.c_str());
+        }
+    }
+    {
+        Mutexed<std::unique_ptr<OutputBuffers>>::Locked buffers(mOutputBuffers);
+        std::string pool = *buffers ? (*buffers)->dumpLocalBufferPool() : std::string();
+        if (!pool.empty()) {
+            ALOGD("[%s] output local buffer pool: %s", mName, pool.c_str());
+        }
+    }
     mFirstValidFrameIndex = mFrameIndex.load(std::memory_order_relaxed);
     if (mInputSurface != nullptr) {
         mInputSurface.reset();
@@ -2557,6 +2577,7 @@ bool CCodecBufferChannel::handleWork(
             || !work->worklets.front()
             || !(work->worklets.front()->output.flags & C2FrameData::FLAG_INCOMPLETE)) {
         mAvailablePipelineCapacity.freeComponentSlot("handleWork");
+        mAvailablePipelineCapacity.onWorkDone(work->input.ordinal.frameIndex.peeku());
     }
 
     if (work->result == C2_NOT_FOUND) {
@@ -2641,7 +2662,8 @@ bool CCodecBufferChannel::handleWork(
             int32_t sampleRate;
             if (outputFormat->findInt32(KEY_CHANNEL_COUNT, &channelCount)
                     && outputFormat->findInt32(KEY_SAMPLE_RATE, &sampleRate)) {
-                (*buffers)->updateSkipCutBuffer(sampleRate, channelCount);
+                (*buffers)->updateSkipCutBuffer(
+                        sampleRate, channelCount, GetPcmSampleSize(outputFormat));
             }
         }
     }
@@ -2713,7 +2735,7 @@ bool CCodecBufferChannel::handleWork(
 
     {
         Mutexed<ReorderStash>::Locked reorder(mReorderStash);
-        reorder->emplace(buffer, timestamp.peek(), flags, worklet->output.ordinal);
+        reorder->emplace(std::move(buffer), timestamp.peek(), flags, worklet->output.ordinal);
         if (flags & MediaCodec::BUFFER_FLAG_EOS) {
             // Flush reorder stash
             reorder->setDepth(0);
@@ -2748,7 +2770,7 @@ void CCodecBufferChannel::sendOutputBuffers() {
             }
             buffers.unlock();
             ALOGV("[%s] sendOutputBuffers: unable to register output buffer", mName);
-            mReorderStash.lock()->defer(entry);
+            mReorderStash.lock()->defer(std::move(entry));
             return;
         }
         buffers.unlock();
@@ -2809,6 +2831,11 @@ void CCodecBufferChannel::setMetaMode(MetaMode mode) {
     mMetaMode = mode;
 }
 
+void CCodecBufferChannel::setAdaptivePipeline(bool adaptive, int minDepth, int maxDepth) {
+    mAvailablePipelineCapacity.setAdaptive(
+            adaptive, minDepth, maxDepth > 0 ? maxDepth : (int)kMaxPipelineCapacity);
+}
+
 status_t toStatusT(c2_status_t c2s, c2_operation_t c2op) {
     // C2_OK is always translated to OK.
     if (c2s == C2_OK) {
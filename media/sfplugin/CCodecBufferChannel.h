@@ -20,6 +20,8 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include <C2Buffer.h>
@@ -33,6 +35,7 @@
 #include <media/stagefright/CodecBase.h>
 
 #include "InputSurfaceWrapper.h"
+#include "ReorderStash.h"
 
 namespace android {
 
@@ -149,6 +152,17 @@ public:
 
     void setMetaMode(MetaMode mode);
 
+    /**
+     * Enables or disables adaptive pipeline depth. See PipelineCapacity.
+     *
+     * \param adaptive whether the number of work items in flight adapts to
+     *                 the observed component latency and output drain rate
+     * \param minDepth lower bound of the number of work items in flight
+     * \param maxDepth upper bound of the number of work items in flight; 0
+     *                 for the default
+     */
+    void setAdaptivePipeline(bool adaptive, int minDepth, int maxDepth);
+
     // Internal classes
     class Buffers;
     class InputBuffers;
@@ -328,50 +342,77 @@ private:
         // onWorkDone() is called.
         int freeComponentSlot(const char* callerTag = nullptr);
 
-    private:
-        // Component name. Used for logging.
-        const char* mName;
-    };
-    PipelineCapacity mAvailablePipelineCapacity;
-
-    class ReorderStash {
-    public:
-        struct Entry {
-            inline Entry() : buffer(nullptr), timestamp(0), flags(0), ordinal({0, 0, 0}) {}
-            inline Entry(
-                    const std::shared_ptr<C2Buffer> &b,
-                    int64_t t,
-                    int32_t f,
-                    const C2WorkOrdinalStruct &o)
-                : buffer(b), timestamp(t), flags(f), ordinal(o) {}
-            std::shared_ptr<C2Buffer> buffer;
-            int64_t timestamp;
-            int32_t flags;
-            C2WorkOrdinalStruct ordinal;
+        // Adaptive depth control.
+        //
+        // In adaptive mode the component capacity given to initialize() is
+        // only the starting depth. The depth is then kept within
+        // [minDepth, maxDepth] at the number of work items needed to keep
+        // the pipeline busy, which is the average component latency of a
+        // work item divided by the average interval at which the slower of
+        // the component and the client completes one. The depth grows to the
+        // target immediately to avoid starving the component, and shrinks by
+        // one per completed work item to avoid oscillating on bursty input.
+        struct Stats {
+            bool adaptive;
+            int depth;
+            int minDepth;
+            int maxDepth;
+            // averages of the decision inputs; 0 until measured
+            int64_t latencyUs;
+            int64_t workIntervalUs;
+            int64_t drainIntervalUs;
+            // number of depth changes
+            uint32_t grown;
+            uint32_t shrunk;
+            // number of times allocate() failed on component capacity alone
+            uint32_t componentStalls;
         };
 
-        ReorderStash();
+        // Configure adaptive mode. Takes effect at the next initialize().
+        void setAdaptive(bool adaptive, int minDepth, int maxDepth);
+
+        // Called when work with @p frameIndex is queued to the component.
+        void onWorkQueued(uint64_t frameIndex);
+
+        // Called when work with @p frameIndex is returned by the component.
+        void onWorkDone(uint64_t frameIndex);
 
-        void clear();
-        void setDepth(uint32_t depth);
-        void setKey(C2Config::ordinal_key_t key);
-        bool pop(Entry *entry);
-        void emplace(
-                const std::shared_ptr<C2Buffer> &buffer,
-                int64_t timestamp,
-                int32_t flags,
-                const C2WorkOrdinalStruct &ordinal);
-        void defer(const Entry &entry);
-        bool hasPending() const;
+        // Called when the client releases an output buffer.
+        void onOutputDrained();
+
+        Stats getStats() const;
 
     private:
-        std::list<Entry> mPending;
-        std::list<Entry> mStash;
-        uint32_t mDepth;
-        C2Config::ordinal_key_t mKey;
+        // Component name. Used for logging.
+        const char* mName;
+
+        struct QueuedWork {
+            uint64_t frameIndex;
+            nsecs_t queuedNs;
+        };
 
-        bool less(const C2WorkOrdinalStruct &o1, const C2WorkOrdinalStruct &o2);
+        void updateDepth_l();
+
+        mutable std::mutex mAdaptiveLock;
+        bool mAdaptive;
+        int mMinDepth;
+        int mMaxDepth;
+        int mDepth;
+        // queue times of work in flight, indexed by frame index
+        std::vector<QueuedWork> mQueuedWork;
+        nsecs_t mLatencyNs;
+        nsecs_t mWorkIntervalNs;
+        nsecs_t mDrainIntervalNs;
+        nsecs_t mLastWorkDoneNs;
+        nsecs_t mLastDrainedNs;
+        uint32_t mGrown;
+        uint32_t mShrunk;
+        std::atomic_uint32_t mComponentStalls;
+        std::string mDepthCounterName;
+        std::string mLatencyCounterName;
     };
+    PipelineCapacity mAvailablePipelineCapacity;
+
     Mutexed<ReorderStash> mReorderStash;
 
     std::atomic_bool mInputMetEos;
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2018, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "LocalBufferPool"
+#include <utils/Log.h>
+
+#include <iterator>
+
+#include <android-base/stringprintf.h>
+
+#include "LocalBufferPool.h"
+
+namespace android {
+
+using android::base::StringPrintf;
+
+/**
+ * ABuffer backed by std::vector.
+ */
+class LocalBufferPool::VectorBuffer : public ::android::ABuffer {
+public:
+    /**
+     * Construct a VectorBuffer by taking the ownership of supplied vector.
+     *
+     * \param vec   backing vector of the buffer. this object takes
+     *              ownership at construction.
+     * \param pool  a LocalBufferPool object to return the vector at
+     *              destruction.
+     */
+    VectorBuffer(std::vector<uint8_t> &&vec, const std::shared_ptr<LocalBufferPool> &pool)
+        : ABuffer(vec.data(), vec.capacity()),
+          mVec(std::move(vec)),
+          mPool(pool) {
+    }
+
+    ~VectorBuffer() override {
+        std::shared_ptr<LocalBufferPool> pool = mPool.lock();
+        if (pool) {
+            // If pool is alive, return the vector back to the pool so that
+            // it can be recycled.
+            pool->returnVector(std::move(mVec));
+        }
+    }
+
+private:
+    std::vector<uint8_t> mVec;
+    std::weak_ptr<LocalBufferPool> mPool;
+};
+
+// static
+std::shared_ptr<LocalBufferPool> LocalBufferPool::Create(size_t poolCapacity) {
+    return std::shared_ptr<LocalBufferPool>(new LocalBufferPool(poolCapacity));
+}
+
+LocalBufferPool::LocalBufferPool(size_t poolCapacity)
+    : mPoolCapacity(poolCapacity) {
+}
+
+LocalBufferPool::~LocalBufferPool() {
+    ALOGV("destroying pool: %s", dump().c_str());
+}
+
+sp<ABuffer> LocalBufferPool::newBuffer(size_t capacity) {
+    Mutex::Autolock lock(mMutex);
+    size_t classSize;
+    size_t index = GetSizeClass(capacity, &classSize);
+    // Buffers are filed under the largest class not exceeding their size,
+    // so any buffer of the requested class fits, buffers of the next
+    // class up are at most 25% larger, and the class below may still
+    // hold a buffer large enough. (There is no class below class 0.)
+    const size_t candidates[] = { index, index + 1, index > 0 ? index - 1 : 0 };
+    const size_t numCandidates = index > 0 ? 3 : 2;
+    for (size_t c = 0; c < numCandidates; ++c) {
+        size_t i = candidates[c];
+        if (i >= mFreeLists.size()) {
+            continue;
+        }
+        std::deque<LruIterator> &freeList = mFreeLists[i];
+        for (auto it = freeList.rbegin(); it != freeList.rend(); ++it) {
+            LruIterator entry = *it;
+            if (entry->capacity() < capacity) {
+                continue;
+            }
+            freeList.erase(std::next(it).base());
+            sp<ABuffer> buffer = new VectorBuffer(std::move(*entry), shared_from_this());
+            mStats.freeSize -= buffer->capacity();
+            mLru.erase(entry);
+            ++mStats.hits;
+            return buffer;
+        }
+    }
+    ++mStats.misses;
+    while (mStats.usedSize + capacity > mPoolCapacity && !mLru.empty()) {
+        evictOldest_l();
+    }
+    if (mStats.usedSize + capacity > mPoolCapacity) {
+        ALOGD("usedSize = %zu, capacity = %zu, mPoolCapacity = %zu",
+                mStats.usedSize, capacity, mPoolCapacity);
+        ++mStats.failures;
+        return nullptr;
+    }
+    std::vector<uint8_t> vec(capacity);
+    mStats.usedSize += vec.capacity();
+    return new VectorBuffer(std::move(vec), shared_from_this());
+}
+
+LocalBufferPool::Stats LocalBufferPool::getStats() const {
+    Mutex::Autolock lock(mMutex);
+    return mStats;
+}
+
+std::string LocalBufferPool::dump() const {
+    Stats stats = getStats();
+    return StringPrintf(
+            "used=%zu free=%zu capacity=%zu hits=%llu misses=%llu "
+            "evictions=%llu failures=%llu",
+            stats.usedSize, stats.freeSize, mPoolCapacity,
+            (unsigned long long)stats.hits,
+            (unsigned long long)stats.misses,
+            (unsigned long long)stats.evictions,
+            (unsigned long long)stats.failures);
+}
+
+// static
+size_t LocalBufferPool::GetSizeClass(size_t capacity, size_t *classSize) {
+    if (capacity <= kMinSizeClass) {
+        *classSize = kMinSizeClass;
+        return 0;
+    }
+    // base < capacity <= 2 * base
+    size_t shift = (sizeof(unsigned long long) * 8 - 1)
+            - __builtin_clzll((unsigned long long)(capacity - 1));
+    size_t base = size_t(1) << shift;
+    size_t step = base >> 2;
+    size_t quarter = (capacity - base + step - 1) / step;  // 1..4
+    *classSize = base + quarter * step;
+    return (shift - kMinSizeClassShift) * 4 + quarter;
+}
+
+// static
+size_t LocalBufferPool::GetFloorSizeClass(size_t size) {
+    size_t classSize;
+    size_t index = GetSizeClass(size, &classSize);
+    return (classSize == size || index == 0) ? index : index - 1;
+}
+
+void LocalBufferPool::returnVector(std::vector<uint8_t> &&vec) {
+    Mutex::Autolock lock(mMutex);
+    size_t index = GetFloorSizeClass(vec.capacity());
+    if (index >= mFreeLists.size()) {
+        mFreeLists.resize(index + 1);
+    }
+    std::deque<LruIterator> &freeList = mFreeLists[index];
+    if (freeList.size() >= kMaxFreeBuffersPerClass) {
+        LruIterator oldest = freeList.front();
+        freeList.pop_front();
+        release_l(oldest);
+    }
+    mStats.freeSize += vec.capacity();
+    mLru.push_front(std::move(vec));
+    freeList.push_back(mLru.begin());
+}
+
+void LocalBufferPool::evictOldest_l() {
+    LruIterator oldest = std::prev(mLru.end());
+    // The globally oldest buffer is also the oldest of its class.
+    mFreeLists[GetFloorSizeClass(oldest->capacity())].pop_front();
+    release_l(oldest);
+}
+
+void LocalBufferPool::release_l(LruIterator it) {
+    mStats.usedSize -= it->capacity();
+    mStats.freeSize -= it->capacity();
+    mLru.erase(it);
+    ++mStats.evictions;
+}
+
+}  // namespace android
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2018, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOCAL_BUFFER_POOL_H_
+#define LOCAL_BUFFER_POOL_H_
+
+#include <deque>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <utils/Mutex.h>
+
+namespace android {
+
+/**
+ * Simple local buffer pool backed by std::vector.
+ *
+ * Cached buffers are bucketed into size classes (four classes per power of
+ * two) and recycled through per-class free lists of bounded length. Lookup of
+ * a cached buffer is therefore O(1). When the pool capacity is reached, cached
+ * buffers are trimmed in least-recently-returned order until the new
+ * allocation fits.
+ */
+class LocalBufferPool : public std::enable_shared_from_this<LocalBufferPool> {
+public:
+    /**
+     * Create a new LocalBufferPool object.
+     *
+     * \param poolCapacity  max total size of buffers managed by this pool.
+     *
+     * \return  a newly created pool object.
+     */
+    static std::shared_ptr<LocalBufferPool> Create(size_t poolCapacity);
+
+    ~LocalBufferPool();
+
+    /**
+     * Return an ABuffer object whose size is at least |capacity|.
+     *
+     * \param   capacity  requested capacity
+     * \return  nullptr if the pool capacity is reached
+     *          an ABuffer object otherwise.
+     */
+    sp<ABuffer> newBuffer(size_t capacity);
+
+    struct Stats {
+        size_t usedSize = 0;  // bytes of all buffers, including cached ones.
+        size_t freeSize = 0;  // bytes of cached buffers.
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t failures = 0;
+    };
+
+    /**
+     * Return the pool usage and counters.
+     */
+    Stats getStats() const;
+
+    /**
+     * Return a human-readable summary of the pool usage and counters.
+     */
+    std::string dump() const;
+
+private:
+    class VectorBuffer;
+
+    // Smallest size class is 4 KiB.
+    static constexpr size_t kMinSizeClassShift = 12;
+    static constexpr size_t kMinSizeClass = 1u << kMinSizeClassShift;
+    // Max number of cached buffers per size class.
+    static constexpr size_t kMaxFreeBuffersPerClass = 8;
+
+    /**
+     * Compute the size class of |capacity|.
+     *
+     * \param capacity   requested capacity
+     * \param classSize  the size of the returned class, which is at least
+     *                   |capacity|.
+     * \return the index of the size class.
+     */
+    static size_t GetSizeClass(size_t capacity, size_t *classSize);
+
+    /**
+     * Compute the index of the largest size class not exceeding |size|.
+     * Sizes below the smallest class map to the smallest class.
+     */
+    static size_t GetFloorSizeClass(size_t size);
+
+    typedef std::list<std::vector<uint8_t>>::iterator LruIterator;
+
+    mutable Mutex mMutex;
+    size_t mPoolCapacity;
+    // Cached buffers; most recently returned at the front.
+    std::list<std::vector<uint8_t>> mLru;
+    // Per-class cached buffers; most recently returned at the back.
+    std::vector<std::deque<LruIterator>> mFreeLists;
+    Stats mStats;
+
+    /**
+     * Private constructor to prevent constructing non-managed LocalBufferPool.
+     */
+    explicit LocalBufferPool(size_t poolCapacity);
+
+    /**
+     * Take back the ownership of vec from the destructed VectorBuffer and put
+     * it in the free list of its size class.
+     */
+    void returnVector(std::vector<uint8_t> &&vec);
+
+    /**
+     * Release the least recently returned cached buffer.
+     */
+    void evictOldest_l();
+
+    /**
+     * Free a cached buffer that has already been removed from its free list.
+     */
+    void release_l(LruIterator it);
+
+    DISALLOW_EVIL_CONSTRUCTORS(LocalBufferPool);
+};
+
+}  // namespace android
+
+#endif  // LOCAL_BUFFER_POOL_H_
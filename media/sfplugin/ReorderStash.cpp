@@ -0,0 +1,149 @@
+/*
+ * Copyright 2018, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ReorderStash"
+#include <utils/Log.h>
+
+#include <algorithm>
+
+#include "ReorderStash.h"
+
+namespace android {
+
+namespace {
+
+// initial number of slots in the pending ring
+constexpr size_t kMinPendingCapacity = 8;
+
+}  // namespace
+
+ReorderStash::ReorderStash()
+    : mPendingHead(0),
+      mPendingSize(0),
+      mStashSeq(0) {
+    clear();
+}
+
+void ReorderStash::clear() {
+    for (size_t i = 0; i < mPendingSize; ++i) {
+        mPending[(mPendingHead + i) % mPending.size()] = Entry();
+    }
+    mPendingHead = 0;
+    mPendingSize = 0;
+    mStash.clear();
+    mStashSeq = 0;
+    mDepth = 0;
+    mKey = C2Config::ORDINAL;
+}
+
+void ReorderStash::setDepth(uint32_t depth) {
+    flushStash();
+    mDepth = depth;
+    // the stash momentarily holds one entry above the depth in emplace()
+    mStash.reserve(depth + 1);
+}
+
+void ReorderStash::setKey(C2Config::ordinal_key_t key) {
+    flushStash();
+    mKey = key;
+}
+
+bool ReorderStash::pop(Entry *entry) {
+    if (mPendingSize == 0) {
+        return false;
+    }
+    *entry = std::move(mPending[mPendingHead]);
+    mPendingHead = (mPendingHead + 1) % mPending.size();
+    --mPendingSize;
+    return true;
+}
+
+void ReorderStash::emplace(
+        std::shared_ptr<C2Buffer> buffer,
+        int64_t timestamp,
+        int32_t flags,
+        const C2WorkOrdinalStruct &ordinal) {
+    mStash.push_back({ Entry(nullptr, timestamp, flags, ordinal), mStashSeq++ });
+    mStash.back().entry.buffer = std::move(buffer);
+    auto after = [this](const StashedEntry &a, const StashedEntry &b) { return leavesAfter(a, b); };
+    std::push_heap(mStash.begin(), mStash.end(), after);
+    while (!mStash.empty() && mStash.size() > mDepth) {
+        popStash();
+    }
+}
+
+void ReorderStash::defer(Entry &&entry) {
+    if (mPendingSize == mPending.size()) {
+        growPending();
+    }
+    mPendingHead = (mPendingHead + mPending.size() - 1) % mPending.size();
+    mPending[mPendingHead] = std::move(entry);
+    ++mPendingSize;
+}
+
+bool ReorderStash::hasPending() const {
+    return mPendingSize != 0;
+}
+
+bool ReorderStash::less(
+        const C2WorkOrdinalStruct &o1, const C2WorkOrdinalStruct &o2) const {
+    switch (mKey) {
+        case C2Config::ORDINAL:   return o1.frameIndex < o2.frameIndex;
+        case C2Config::TIMESTAMP: return o1.timestamp < o2.timestamp;
+        case C2Config::CUSTOM:    return o1.customOrdinal < o2.customOrdinal;
+        default:
+            ALOGD("Unrecognized key; default to timestamp");
+            return o1.frameIndex < o2.frameIndex;
+    }
+}
+
+bool ReorderStash::leavesAfter(const StashedEntry &a, const StashedEntry &b) const {
+    return less(b.entry.ordinal, a.entry.ordinal)
+            || (!less(a.entry.ordinal, b.entry.ordinal) && a.seq > b.seq);
+}
+
+void ReorderStash::growPending() {
+    std::vector<Entry> pending(std::max(mPending.size() * 2, kMinPendingCapacity));
+    for (size_t i = 0; i < mPendingSize; ++i) {
+        pending[i] = std::move(mPending[(mPendingHead + i) % mPending.size()]);
+    }
+    mPending.swap(pending);
+    mPendingHead = 0;
+}
+
+void ReorderStash::pushPending(Entry &&entry) {
+    if (mPendingSize == mPending.size()) {
+        growPending();
+    }
+    mPending[(mPendingHead + mPendingSize) % mPending.size()] = std::move(entry);
+    ++mPendingSize;
+}
+
+void ReorderStash::popStash() {
+    auto after = [this](const StashedEntry &a, const StashedEntry &b) { return leavesAfter(a, b); };
+    std::pop_heap(mStash.begin(), mStash.end(), after);
+    pushPending(std::move(mStash.back().entry));
+    mStash.pop_back();
+}
+
+void ReorderStash::flushStash() {
+    while (!mStash.empty()) {
+        popStash();
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2018, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REORDER_STASH_H_
+#define REORDER_STASH_H_
+
+#include <memory>
+#include <vector>
+
+#include <C2Buffer.h>
+#include <C2Config.h>
+#include <C2Work.h>
+
+namespace android {
+
+/**
+ * Reorders output buffers by their work ordinal before they are sent to the client.
+ *
+ * Up to |depth| buffers are held back in the stash, a binary heap ordered by the configured
+ * ordinal key. Once the stash holds more buffers than its depth, the least buffer is moved to the
+ * pending queue, a ring buffer from which buffers are popped in output order. Both containers
+ * keep their storage across buffers, so steady state operation does not allocate.
+ */
+class ReorderStash {
+public:
+    struct Entry {
+        inline Entry() : buffer(nullptr), timestamp(0), flags(0), ordinal({0, 0, 0}) {}
+        inline Entry(
+                const std::shared_ptr<C2Buffer> &b,
+                int64_t t,
+                int32_t f,
+                const C2WorkOrdinalStruct &o)
+            : buffer(b), timestamp(t), flags(f), ordinal(o) {}
+        std::shared_ptr<C2Buffer> buffer;
+        int64_t timestamp;
+        int32_t flags;
+        C2WorkOrdinalStruct ordinal;
+    };
+
+    ReorderStash();
+
+    void clear();
+    void setDepth(uint32_t depth);
+    void setKey(C2Config::ordinal_key_t key);
+
+    /**
+     * Moves the next pending entry into |entry|.
+     *
+     * \return false if there is no pending entry.
+     */
+    bool pop(Entry *entry);
+
+    void emplace(
+            std::shared_ptr<C2Buffer> buffer,
+            int64_t timestamp,
+            int32_t flags,
+            const C2WorkOrdinalStruct &ordinal);
+
+    /**
+     * Returns a popped entry to the front of the pending queue.
+     */
+    void defer(Entry &&entry);
+    bool hasPending() const;
+
+private:
+    struct StashedEntry {
+        Entry entry;
+        // insertion order, so that entries with equal keys leave the stash in FIFO order
+        uint64_t seq;
+    };
+
+    // pending entries; a ring of mPending.size() slots starting at mPendingHead
+    std::vector<Entry> mPending;
+    size_t mPendingHead;
+    size_t mPendingSize;
+
+    // stashed entries; a heap with the least entry at the front
+    std::vector<StashedEntry> mStash;
+    uint64_t mStashSeq;
+
+    uint32_t mDepth;
+    C2Config::ordinal_key_t mKey;
+
+    bool less(const C2WorkOrdinalStruct &o1, const C2WorkOrdinalStruct &o2) const;
+    // whether |a| leaves the stash after |b|; used as the heap comparator
+    bool leavesAfter(const StashedEntry &a, const StashedEntry &b) const;
+    void growPending();
+    void pushPending(Entry &&entry);
+    void popStash();
+    void flushStash();
+};
+
+}  // namespace android
+
+#endif  // REORDER_STASH_H_
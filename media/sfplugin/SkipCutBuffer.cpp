@@ -24,18 +24,22 @@
 
 namespace android {
 
-SkipCutBuffer::SkipCutBuffer(size_t skip, size_t cut, size_t num16BitChannels) {
+SkipCutBuffer::SkipCutBuffer(size_t skip, size_t cut, size_t numChannels, size_t sampleSize) {
 
     mWriteHead = 0;
     mReadHead = 0;
     mCapacity = 0;
     mCutBuffer = nullptr;
 
-    if (num16BitChannels == 0 || num16BitChannels > INT32_MAX / 2) {
-        ALOGW("# channels out of range: %zu, using passthrough instead", num16BitChannels);
+    if (sampleSize == 0 || sampleSize > 8) {
+        ALOGW("sample size out of range: %zu, using passthrough instead", sampleSize);
         return;
     }
-    size_t frameSize = num16BitChannels * 2;
+    if (numChannels == 0 || numChannels > INT32_MAX / sampleSize) {
+        ALOGW("# channels out of range: %zu, using passthrough instead", numChannels);
+        return;
+    }
+    size_t frameSize = numChannels * sampleSize;
     if (skip > INT32_MAX / frameSize || cut > INT32_MAX / frameSize
             || cut * frameSize > INT32_MAX - 4096) {
         ALOGW("out of range skip/cut: %zu/%zu, using passthrough instead",
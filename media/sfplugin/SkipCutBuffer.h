@@ -32,8 +32,9 @@ class SkipCutBuffer: public RefBase {
  public:
     // 'skip' is the number of frames to skip from the beginning
     // 'cut' is the number of frames to cut from the end
-    // 'num16BitChannels' is the number of channels, which are assumed to be 16 bit wide each
-    SkipCutBuffer(size_t skip, size_t cut, size_t num16Channels);
+    // 'numChannels' is the number of channels
+    // 'sampleSize' is the size in bytes of one sample of a channel (2 for 16-bit PCM)
+    SkipCutBuffer(size_t skip, size_t cut, size_t numChannels, size_t sampleSize = 2);
 
     // Submit one MediaBuffer for skipping and cutting. This may consume all or
     // some of the data in the buffer, or it may add data to it.
@@ -0,0 +1,250 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "Codec2BufferUtils_test"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <C2Config.h>
+#include <C2PlatformSupport.h>
+#include <Codec2BufferUtils.h>
+#include <system/graphics.h>
+
+namespace android {
+
+namespace {
+
+struct YUV {
+    int y;
+    int u;
+    int v;
+};
+
+/**
+ * Floating point reference for the RGB to YUV conversion.
+ */
+YUV ReferenceRGBToYUV(double r, double g, double b, bool bt709, bool fullRange) {
+    const double kr = bt709 ? 0.2126 : 0.299;
+    const double kb = bt709 ? 0.0722 : 0.114;
+    const double y = kr * r + (1 - kr - kb) * g + kb * b;
+    const double u = (b - y) / (2 * (1 - kb));
+    const double v = (r - y) / (2 * (1 - kr));
+    const double yScale = fullRange ? 1. : 219. / 255.;
+    const double uvScale = fullRange ? 1. : 224. / 255.;
+    auto clip = [](double x) { return (int)std::min(255., std::max(0., std::round(x))); };
+    return { clip((fullRange ? 0 : 16) + y * yScale),
+             clip(128 + u * uvScale),
+             clip(128 + v * uvScale) };
+}
+
+}  // namespace
+
+class Codec2BufferUtilsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(C2_OK, GetCodec2BlockPool(C2BlockPool::BASIC_GRAPHIC, nullptr, &mPool));
+    }
+
+    std::shared_ptr<C2GraphicBlock> fetchRGBABlock(uint32_t width, uint32_t height) {
+        std::shared_ptr<C2GraphicBlock> block;
+        EXPECT_EQ(C2_OK, mPool->fetchGraphicBlock(
+                width, height, HAL_PIXEL_FORMAT_RGBA_8888,
+                { C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE }, &block));
+        return block;
+    }
+
+    std::shared_ptr<C2GraphicBlock> fetchYUVBlock(uint32_t width, uint32_t height) {
+        std::shared_ptr<C2GraphicBlock> block;
+        EXPECT_EQ(C2_OK, mPool->fetchGraphicBlock(
+                width, height, HAL_PIXEL_FORMAT_YCBCR_420_888,
+                { C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE }, &block));
+        return block;
+    }
+
+    std::shared_ptr<C2BlockPool> mPool;
+};
+
+namespace {
+
+/**
+ * Describes an 8-bit 4:2:0 image with interleaved (semi-planar) chroma.
+ */
+MediaImage2 SemiPlanarImage(uint32_t width, uint32_t height, uint32_t stride, bool vFirst) {
+    MediaImage2 img;
+    img.mType = MediaImage2::MEDIA_IMAGE_TYPE_YUV;
+    img.mNumPlanes = 3;
+    img.mWidth = width;
+    img.mHeight = height;
+    img.mBitDepth = 8;
+    img.mBitDepthAllocated = 8;
+    img.mPlane[img.Y] = { 0, 1, (int32_t)stride, 1, 1 };
+    const uint32_t uvOffset = stride * height;
+    img.mPlane[img.U] = { uvOffset + (vFirst ? 1 : 0), 2, (int32_t)stride, 2, 2 };
+    img.mPlane[img.V] = { uvOffset + (vFirst ? 0 : 1), 2, (int32_t)stride, 2, 2 };
+    return img;
+}
+
+}  // namespace
+
+TEST_F(Codec2BufferUtilsTest, ConvertRGBToPlanarYUV) {
+    constexpr uint32_t kWidth = 64;
+    constexpr uint32_t kHeight = 48;
+
+    std::shared_ptr<C2GraphicBlock> block = fetchRGBABlock(kWidth, kHeight);
+    ASSERT_TRUE(block);
+    C2GraphicView view = block->map().get();
+    ASSERT_EQ(C2_OK, view.error());
+    const C2PlanarLayout &layout = view.layout();
+    ASSERT_EQ(C2PlanarLayout::TYPE_RGBA, layout.type);
+
+    // Fill the image with 2x2 blocks of a uniform color, so that chroma
+    // subsampling does not affect the expected values.
+    std::vector<uint8_t> colors(kWidth / 2 * kHeight / 2 * 3);
+    srand(0);
+    for (uint8_t &c : colors) {
+        c = rand() & 0xFF;
+    }
+    for (uint32_t y = 0; y < kHeight; ++y) {
+        for (uint32_t x = 0; x < kWidth; ++x) {
+            const uint8_t *color = &colors[((y / 2) * (kWidth / 2) + x / 2) * 3];
+            for (uint32_t p : { C2PlanarLayout::PLANE_R,
+                                C2PlanarLayout::PLANE_G,
+                                C2PlanarLayout::PLANE_B }) {
+                const C2PlaneInfo &plane = layout.planes[p];
+                view.data()[p][x * plane.colInc + y * plane.rowInc] = color[p];
+            }
+        }
+    }
+
+    std::vector<uint8_t> yuv(kWidth * kHeight * 3 / 2);
+    for (C2Color::matrix_t matrix : { C2Color::MATRIX_BT601, C2Color::MATRIX_BT709 }) {
+        for (C2Color::range_t range : { C2Color::RANGE_LIMITED, C2Color::RANGE_FULL }) {
+            SCOPED_TRACE(testing::Message() << "matrix " << (int)matrix << " range " << (int)range);
+            ASSERT_EQ(OK, ConvertRGBToPlanarYUV(
+                    yuv.data(), kWidth, kHeight, yuv.size(), view, matrix, range));
+            const uint8_t *dstY = yuv.data();
+            const uint8_t *dstU = dstY + kWidth * kHeight;
+            const uint8_t *dstV = dstU + kWidth * kHeight / 4;
+            for (uint32_t y = 0; y < kHeight; ++y) {
+                for (uint32_t x = 0; x < kWidth; ++x) {
+                    const uint8_t *color = &colors[((y / 2) * (kWidth / 2) + x / 2) * 3];
+                    YUV expected = ReferenceRGBToYUV(
+                            color[0], color[1], color[2],
+                            matrix == C2Color::MATRIX_BT709, range == C2Color::RANGE_FULL);
+                    ASSERT_NEAR(expected.y, dstY[y * kWidth + x], 2) << "at " << x << "," << y;
+                    if ((x & 1) == 0 && (y & 1) == 0) {
+                        size_t i = (y / 2) * (kWidth / 2) + x / 2;
+                        ASSERT_NEAR(expected.u, dstU[i], 3) << "at " << x << "," << y;
+                        ASSERT_NEAR(expected.v, dstV[i], 3) << "at " << x << "," << y;
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_F(Codec2BufferUtilsTest, ConvertRGBToPlanarYUVThroughput) {
+    constexpr uint32_t kWidth = 1920;
+    constexpr uint32_t kHeight = 1080;
+    constexpr int kIterations = 30;
+
+    std::shared_ptr<C2GraphicBlock> block = fetchRGBABlock(kWidth, kHeight);
+    ASSERT_TRUE(block);
+    C2GraphicView view = block->map().get();
+    ASSERT_EQ(C2_OK, view.error());
+
+    std::vector<uint8_t> yuv(kWidth * kHeight * 3 / 2);
+    for (C2Color::matrix_t matrix : { C2Color::MATRIX_BT601, C2Color::MATRIX_BT709 }) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kIterations; ++i) {
+            ASSERT_EQ(OK, ConvertRGBToPlanarYUV(
+                    yuv.data(), kWidth, kHeight, yuv.size(), view, matrix));
+        }
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::cout << "matrix " << (int)matrix << ": "
+                  << elapsed.count() / kIterations << " ms per 1080p frame" << std::endl;
+    }
+}
+
+TEST_F(Codec2BufferUtilsTest, ImageCopySemiPlanarRoundTrip) {
+    constexpr uint32_t kWidth = 64;
+    constexpr uint32_t kHeight = 48;
+    constexpr uint32_t kStride = 80;
+
+    std::shared_ptr<C2GraphicBlock> block = fetchYUVBlock(kWidth, kHeight);
+    ASSERT_TRUE(block);
+    C2GraphicView view = block->map().get();
+    ASSERT_EQ(C2_OK, view.error());
+
+    for (bool vFirst : { false, true }) {
+        SCOPED_TRACE(vFirst ? "NV21" : "NV12");
+        MediaImage2 img = SemiPlanarImage(kWidth, kHeight, kStride, vFirst);
+        std::vector<uint8_t> src(kStride * kHeight * 3 / 2);
+        srand(0);
+        for (uint8_t &c : src) {
+            c = rand() & 0xFF;
+        }
+        std::vector<uint8_t> dst(src.size(), 0);
+        ASSERT_EQ(OK, ImageCopy(view, src.data(), &img));
+        ASSERT_EQ(OK, ImageCopy(dst.data(), &img, view));
+        for (uint32_t i = 0; i < img.mNumPlanes; ++i) {
+            const MediaImage2::PlaneInfo &plane = img.mPlane[i];
+            for (uint32_t y = 0; y < kHeight / plane.mVertSubsampling; ++y) {
+                for (uint32_t x = 0; x < kWidth / plane.mHorizSubsampling; ++x) {
+                    size_t offset = plane.mOffset + y * plane.mRowInc + x * plane.mColInc;
+                    ASSERT_EQ(src[offset], dst[offset])
+                            << "plane " << i << " at " << x << "," << y;
+                }
+            }
+        }
+    }
+}
+
+TEST_F(Codec2BufferUtilsTest, ImageCopyThroughput) {
+    constexpr uint32_t kWidth = 1920;
+    constexpr uint32_t kHeight = 1080;
+    constexpr int kIterations = 30;
+
+    std::shared_ptr<C2GraphicBlock> block = fetchYUVBlock(kWidth, kHeight);
+    ASSERT_TRUE(block);
+    C2GraphicView view = block->map().get();
+    ASSERT_EQ(C2_OK, view.error());
+
+    for (bool vFirst : { false, true }) {
+        MediaImage2 img = SemiPlanarImage(kWidth, kHeight, kWidth, vFirst);
+        std::vector<uint8_t> buffer(kWidth * kHeight * 3 / 2);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kIterations; ++i) {
+            ASSERT_EQ(OK, ImageCopy(buffer.data(), &img, view));
+            ASSERT_EQ(OK, ImageCopy(view, buffer.data(), &img));
+        }
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::cout << (vFirst ? "NV21" : "NV12") << ": "
+                  << elapsed.count() / kIterations / 2 << " ms per 1080p copy" << std::endl;
+    }
+}
+
+} // namespace android
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "LocalBufferPool_test"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <LocalBufferPool.h>
+
+namespace android {
+
+TEST(LocalBufferPoolTest, RecyclesReturnedBuffers) {
+    std::shared_ptr<LocalBufferPool> pool = LocalBufferPool::Create(1000000);
+    sp<ABuffer> buffer = pool->newBuffer(10000);
+    ASSERT_NE(nullptr, buffer.get());
+    EXPECT_GE(buffer->capacity(), 10000u);
+    const uint8_t *data = buffer->base();
+    buffer.clear();
+
+    LocalBufferPool::Stats stats = pool->getStats();
+    EXPECT_EQ(0u, stats.hits);
+    EXPECT_EQ(1u, stats.misses);
+    EXPECT_EQ(10000u, stats.usedSize);
+    EXPECT_EQ(10000u, stats.freeSize);
+
+    // a slightly smaller request of the same size class gets the cached buffer
+    buffer = pool->newBuffer(9000);
+    ASSERT_NE(nullptr, buffer.get());
+    EXPECT_EQ(data, buffer->base());
+    stats = pool->getStats();
+    EXPECT_EQ(1u, stats.hits);
+    EXPECT_EQ(0u, stats.freeSize);
+
+    // a larger request does not fit the only buffer, which is in use anyway
+    sp<ABuffer> larger = pool->newBuffer(20000);
+    ASSERT_NE(nullptr, larger.get());
+    EXPECT_NE(data, larger->base());
+    stats = pool->getStats();
+    EXPECT_EQ(2u, stats.misses);
+    EXPECT_EQ(30000u, stats.usedSize);
+}
+
+TEST(LocalBufferPoolTest, DoesNotReturnTooSmallBuffers) {
+    std::shared_ptr<LocalBufferPool> pool = LocalBufferPool::Create(1000000);
+    pool->newBuffer(10000).clear();
+    sp<ABuffer> buffer = pool->newBuffer(10001);
+    ASSERT_NE(nullptr, buffer.get());
+    EXPECT_GE(buffer->capacity(), 10001u);
+    LocalBufferPool::Stats stats = pool->getStats();
+    EXPECT_EQ(0u, stats.hits);
+    EXPECT_EQ(2u, stats.misses);
+}
+
+TEST(LocalBufferPoolTest, EvictsCachedBuffersToStayWithinCapacity) {
+    std::shared_ptr<LocalBufferPool> pool = LocalBufferPool::Create(100000);
+    pool->newBuffer(90000).clear();
+
+    // the cached buffer is in another size class and must be freed to make room
+    sp<ABuffer> buffer = pool->newBuffer(20000);
+    ASSERT_NE(nullptr, buffer.get());
+    LocalBufferPool::Stats stats = pool->getStats();
+    EXPECT_EQ(1u, stats.evictions);
+    EXPECT_EQ(20000u, stats.usedSize);
+    EXPECT_EQ(0u, stats.freeSize);
+
+    // buffers in use are never evicted
+    EXPECT_EQ(nullptr, pool->newBuffer(90000).get());
+    stats = pool->getStats();
+    EXPECT_EQ(1u, stats.failures);
+    EXPECT_EQ(20000u, stats.usedSize);
+}
+
+TEST(LocalBufferPoolTest, LimitsCachedBuffersPerSizeClass) {
+    std::shared_ptr<LocalBufferPool> pool = LocalBufferPool::Create(1000000);
+    std::vector<sp<ABuffer>> buffers;
+    for (size_t i = 0; i < 10; ++i) {
+        buffers.push_back(pool->newBuffer(10000));
+        ASSERT_NE(nullptr, buffers.back().get());
+    }
+    buffers.clear();
+
+    LocalBufferPool::Stats stats = pool->getStats();
+    EXPECT_EQ(2u, stats.evictions);
+    EXPECT_EQ(80000u, stats.usedSize);
+    EXPECT_EQ(80000u, stats.freeSize);
+
+    for (size_t i = 0; i < 10; ++i) {
+        buffers.push_back(pool->newBuffer(10000));
+    }
+    stats = pool->getStats();
+    EXPECT_EQ(8u, stats.hits);
+    EXPECT_EQ(12u, stats.misses);
+    EXPECT_EQ(0u, stats.freeSize);
+}
+
+TEST(LocalBufferPoolTest, BuffersOutliveThePool) {
+    std::shared_ptr<LocalBufferPool> pool = LocalBufferPool::Create(100000);
+    sp<ABuffer> buffer = pool->newBuffer(10000);
+    ASSERT_NE(nullptr, buffer.get());
+    pool.reset();
+    memset(buffer->base(), 0xA5, buffer->capacity());
+    buffer.clear();
+}
+
+}  // namespace android
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ReorderStash_test"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <list>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <C2PlatformSupport.h>
+#include <ReorderStash.h>
+
+namespace android {
+
+namespace {
+
+/**
+ * Straightforward list based reorder stash used as the reference.
+ */
+class ReferenceStash {
+public:
+    ReferenceStash() : mDepth(0), mKey(C2Config::ORDINAL) {}
+
+    void setDepth(uint32_t depth) {
+        mPending.splice(mPending.end(), mStash);
+        mDepth = depth;
+    }
+
+    void setKey(C2Config::ordinal_key_t key) {
+        mPending.splice(mPending.end(), mStash);
+        mKey = key;
+    }
+
+    bool pop(ReorderStash::Entry *entry) {
+        if (mPending.empty()) {
+            return false;
+        }
+        *entry = mPending.front();
+        mPending.pop_front();
+        return true;
+    }
+
+    void emplace(int64_t timestamp, int32_t flags, const C2WorkOrdinalStruct &ordinal) {
+        auto it = std::find_if(mStash.begin(), mStash.end(),
+                               [this, &ordinal](const ReorderStash::Entry &e) {
+                                   return less(ordinal, e.ordinal);
+                               });
+        mStash.emplace(it, nullptr, timestamp, flags, ordinal);
+        while (!mStash.empty() && mStash.size() > mDepth) {
+            mPending.push_back(mStash.front());
+            mStash.pop_front();
+        }
+    }
+
+    void defer(const ReorderStash::Entry &entry) {
+        mPending.push_front(entry);
+    }
+
+private:
+    std::list<ReorderStash::Entry> mPending;
+    std::list<ReorderStash::Entry> mStash;
+    uint32_t mDepth;
+    C2Config::ordinal_key_t mKey;
+
+    bool less(const C2WorkOrdinalStruct &o1, const C2WorkOrdinalStruct &o2) const {
+        switch (mKey) {
+            case C2Config::TIMESTAMP: return o1.timestamp < o2.timestamp;
+            case C2Config::CUSTOM:    return o1.customOrdinal < o2.customOrdinal;
+            default:                  return o1.frameIndex < o2.frameIndex;
+        }
+    }
+};
+
+/**
+ * Returns |count| ordinals in decode order of a stream whose presentation order is shuffled
+ * within windows of |window| frames. Timestamps follow the frame index and custom ordinals run
+ * backwards, and a few frames share their timestamp with their neighbour.
+ */
+std::vector<C2WorkOrdinalStruct> MakeOrdinals(size_t count, size_t window, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint64_t> indices(count);
+    for (size_t i = 0; i < count; ++i) {
+        indices[i] = i;
+    }
+    for (size_t i = 0; i < count; i += std::max(window, (size_t)1u)) {
+        std::shuffle(indices.begin() + i,
+                     indices.begin() + std::min(i + std::max(window, (size_t)1u), count), rng);
+    }
+    std::vector<C2WorkOrdinalStruct> ordinals;
+    ordinals.reserve(count);
+    for (uint64_t index : indices) {
+        uint64_t timestamp = (index & ~(uint64_t)(rng() % 8 == 0)) * 33333;
+        ordinals.push_back({ timestamp, index, count - index });
+    }
+    return ordinals;
+}
+
+}  // namespace
+
+TEST(ReorderStashTest, MatchesReference) {
+    constexpr size_t kCount = 1000;
+    for (C2Config::ordinal_key_t key :
+            { C2Config::ORDINAL, C2Config::TIMESTAMP, C2Config::CUSTOM }) {
+        for (uint32_t depth : { 0u, 1u, 4u, 16u, 32u }) {
+            SCOPED_TRACE(testing::Message() << "key " << (int)key << " depth " << depth);
+            std::vector<C2WorkOrdinalStruct> ordinals = MakeOrdinals(kCount, depth + 1, depth);
+            ReorderStash stash;
+            ReferenceStash reference;
+            stash.setKey(key);
+            reference.setKey(key);
+            stash.setDepth(depth);
+            reference.setDepth(depth);
+
+            std::mt19937 rng(depth);
+            ReorderStash::Entry entry;
+            ReorderStash::Entry expected;
+            for (size_t i = 0; i < kCount; ++i) {
+                int32_t flags = (int32_t)i;
+                stash.emplace(nullptr, (int64_t)i, flags, ordinals[i]);
+                reference.emplace((int64_t)i, flags, ordinals[i]);
+                if (i == kCount / 2) {
+                    // reconfiguring the depth flushes the stash
+                    stash.setDepth(depth);
+                    reference.setDepth(depth);
+                }
+                // drain a random number of entries, occasionally deferring one back
+                for (size_t n = rng() % 3; n > 0; --n) {
+                    bool popped = reference.pop(&expected);
+                    ASSERT_EQ(popped, stash.pop(&entry));
+                    if (!popped) {
+                        break;
+                    }
+                    ASSERT_EQ(expected.flags, entry.flags);
+                    if (rng() % 4 == 0) {
+                        reference.defer(expected);
+                        stash.defer(std::move(entry));
+                        break;
+                    }
+                }
+            }
+            stash.setDepth(0);
+            reference.setDepth(0);
+            while (reference.pop(&expected)) {
+                ASSERT_TRUE(stash.hasPending());
+                ASSERT_TRUE(stash.pop(&entry));
+                ASSERT_EQ(expected.flags, entry.flags);
+            }
+            ASSERT_FALSE(stash.hasPending());
+            ASSERT_FALSE(stash.pop(&entry));
+        }
+    }
+}
+
+TEST(ReorderStashTest, PopMovesBufferOut) {
+    std::shared_ptr<C2BlockPool> pool;
+    ASSERT_EQ(C2_OK, GetCodec2BlockPool(C2BlockPool::BASIC_LINEAR, nullptr, &pool));
+    std::shared_ptr<C2LinearBlock> block;
+    ASSERT_EQ(C2_OK, pool->fetchLinearBlock(
+            1024, { C2MemoryUsage::CPU_READ, C2MemoryUsage::CPU_WRITE }, &block));
+    std::shared_ptr<C2Buffer> buffer =
+        C2Buffer::CreateLinearBuffer(block->share(0, 0, C2Fence()));
+    ReorderStash stash;
+    stash.emplace(buffer, 0, 0, { 0, 0, 0 });
+    EXPECT_EQ(2, buffer.use_count());
+
+    ReorderStash::Entry entry;
+    ASSERT_TRUE(stash.pop(&entry));
+    EXPECT_EQ(buffer, entry.buffer);
+    EXPECT_EQ(2, buffer.use_count());
+
+    stash.defer(std::move(entry));
+    EXPECT_EQ(2, buffer.use_count());
+    stash.clear();
+    EXPECT_EQ(1, buffer.use_count());
+}
+
+TEST(ReorderStashTest, Throughput) {
+    constexpr size_t kCount = 100000;
+    for (uint32_t depth : { 0u, 1u, 4u, 16u, 32u }) {
+        std::vector<C2WorkOrdinalStruct> ordinals = MakeOrdinals(kCount, depth + 1, depth);
+        ReorderStash stash;
+        stash.setDepth(depth);
+        ReorderStash::Entry entry;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kCount; ++i) {
+            stash.emplace(nullptr, (int64_t)i, 0, ordinals[i]);
+            while (stash.pop(&entry)) {
+            }
+        }
+        std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::cout << "depth " << depth << ": "
+                  << elapsed.count() / kCount << " ns per buffer" << std::endl;
+    }
+}
+
+} // namespace android
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SkipCutBuffer_test"
+
+#include <gtest/gtest.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+
+#include <SkipCutBuffer.h>
+
+namespace android {
+
+namespace {
+
+constexpr size_t kChannels = 2;
+constexpr size_t kFrames = 100;
+
+// Fills a buffer with |kFrames| frames of |T| samples, where each sample holds its frame index.
+template <typename T>
+sp<ABuffer> CreateFrames() {
+    sp<ABuffer> buffer = new ABuffer(kFrames * kChannels * sizeof(T));
+    T *samples = reinterpret_cast<T *>(buffer->data());
+    for (size_t i = 0; i < kFrames * kChannels; ++i) {
+        samples[i] = T(i / kChannels);
+    }
+    return buffer;
+}
+
+template <typename T>
+void ExpectSkipAndCut(size_t skip, size_t cut) {
+    sp<SkipCutBuffer> scb = new SkipCutBuffer(skip, cut, kChannels, sizeof(T));
+    sp<ABuffer> buffer = CreateFrames<T>();
+    scb->submit(buffer);
+
+    // |skip| frames are dropped and the last |cut| frames are held back
+    ASSERT_EQ((kFrames - skip - cut) * kChannels * sizeof(T), buffer->size());
+    const T *samples = reinterpret_cast<const T *>(buffer->data());
+    EXPECT_EQ(T(skip), samples[0]);
+    EXPECT_EQ(T(skip), samples[kChannels - 1]);
+    EXPECT_EQ(T(kFrames - cut - 1), samples[buffer->size() / sizeof(T) - 1]);
+    EXPECT_EQ(cut * kChannels * sizeof(T), scb->size());
+}
+
+}  // namespace
+
+TEST(SkipCutBufferTest, Pcm16) {
+    ExpectSkipAndCut<int16_t>(10, 5);
+}
+
+TEST(SkipCutBufferTest, PcmFloat) {
+    ExpectSkipAndCut<float>(10, 5);
+}
+
+TEST(SkipCutBufferTest, DefaultsTo16BitSamples) {
+    sp<SkipCutBuffer> scb = new SkipCutBuffer(10, 5, kChannels);
+    sp<ABuffer> buffer = CreateFrames<int16_t>();
+    scb->submit(buffer);
+    EXPECT_EQ((kFrames - 15) * kChannels * sizeof(int16_t), buffer->size());
+}
+
+TEST(SkipCutBufferTest, PassthroughOnInvalidSampleSize) {
+    sp<SkipCutBuffer> scb = new SkipCutBuffer(10, 5, kChannels, 0);
+    sp<ABuffer> buffer = CreateFrames<float>();
+    size_t size = buffer->size();
+    scb->submit(buffer);
+    EXPECT_EQ(size, buffer->size());
+}
+
+} // namespace android
@@ -35,24 +35,140 @@ namespace android {
 namespace {
 
 /**
- * A flippable, optimizable memcpy. Constructs such as (from ? src : dst) do not work as the results are
- * always const.
+ * A plane to copy from |src| to |dst|. Increments are in bytes.
  */
-template<bool ToA, size_t S>
-struct MemCopier {
-    template<typename A, typename B>
-    inline static void copy(A *a, const B *b, size_t size) {
-        __builtin_memcpy(a, b, size);
-    }
+struct PlaneCopy {
+    uint8_t *dst;
+    const uint8_t *src;
+    int32_t dstColInc;
+    int32_t dstRowInc;
+    int32_t srcColInc;
+    int32_t srcRowInc;
 };
 
-template<size_t S>
-struct MemCopier<false, S> {
-    template<typename A, typename B>
-    inline static void copy(const A *a, B *b, size_t size) {
-        MemCopier<true, S>::copy(b, a, size);
+/**
+ * Resolves the copy direction between a MediaImage plane and a view plane.
+ * Constructs such as (from ? src : dst) do not work as the results are always
+ * const.
+ */
+inline PlaneCopy MakePlaneCopy(
+        uint8_t *img, int32_t imgColInc, int32_t imgRowInc,
+        const uint8_t *view, int32_t viewColInc, int32_t viewRowInc) {
+    return { img, view, imgColInc, imgRowInc, viewColInc, viewRowInc };
+}
+
+inline PlaneCopy MakePlaneCopy(
+        const uint8_t *img, int32_t imgColInc, int32_t imgRowInc,
+        uint8_t *view, int32_t viewColInc, int32_t viewRowInc) {
+    return { view, img, viewColInc, viewRowInc, imgColInc, imgRowInc };
+}
+
+/**
+ * Copies samples of |bpp| bytes one by one between planes with arbitrary
+ * increments.
+ */
+template<size_t BPP>
+void CopyPlaneBySample(const PlaneCopy &p, uint32_t width, uint32_t height, size_t bpp) {
+    const size_t size = BPP ? BPP : bpp;
+    uint8_t *dstRow = p.dst;
+    const uint8_t *srcRow = p.src;
+    for (uint32_t row = 0; row < height; ++row) {
+        uint8_t *dst = dstRow;
+        const uint8_t *src = srcRow;
+        for (uint32_t col = 0; col < width; ++col) {
+            __builtin_memcpy(dst, src, size);
+            dst += p.dstColInc;
+            src += p.srcColInc;
+        }
+        dstRow += p.dstRowInc;
+        srcRow += p.srcRowInc;
+    }
+}
+
+/**
+ * Copies a plane of |width| x |height| samples of |bpp| bytes each.
+ */
+void CopyPlane(const PlaneCopy &p, uint32_t width, uint32_t height, size_t bpp) {
+    if (height == 0) {
+        return;
     }
-};
+    if (p.dstColInc == (int32_t)bpp && p.srcColInc == (int32_t)bpp) {
+        const size_t rowSize = width * bpp;
+        if (p.dstRowInc == p.srcRowInc && p.dstRowInc >= (int32_t)rowSize) {
+            // copy the whole plane including row padding, but not past the last row
+            __builtin_memcpy(p.dst, p.src, size_t(p.dstRowInc) * (height - 1) + rowSize);
+            return;
+        }
+        uint8_t *dst = p.dst;
+        const uint8_t *src = p.src;
+        for (uint32_t row = 0; row < height; ++row) {
+            __builtin_memcpy(dst, src, rowSize);
+            dst += p.dstRowInc;
+            src += p.srcRowInc;
+        }
+        return;
+    }
+    switch (bpp) {
+        case 1: CopyPlaneBySample<1>(p, width, height, bpp); break;
+        case 2: CopyPlaneBySample<2>(p, width, height, bpp); break;
+        default: CopyPlaneBySample<0>(p, width, height, bpp); break;
+    }
+}
+
+/**
+ * Copies the two chroma planes together if they can be handled as a pair:
+ * - interleaved on both sides in the same order (e.g. NV12, NV21 or P010),
+ *   which is copied as a single plane of twice the width, or
+ * - 8-bit interleaved on one side and planar on the other, which is split or
+ *   merged using vectorized functions.
+ *
+ * \return true if the planes were copied; false if they need to be copied
+ *         separately.
+ */
+bool CopyChromaPair(
+        const PlaneCopy &u, const PlaneCopy &v, uint32_t width, uint32_t height, size_t bpp) {
+    if (u.dstRowInc != v.dstRowInc || u.srcRowInc != v.srcRowInc) {
+        return false;
+    }
+    const int32_t pixelSize = bpp;
+    const ptrdiff_t dstDelta = v.dst - u.dst;
+    const ptrdiff_t srcDelta = v.src - u.src;
+    const bool dstInterleaved = u.dstColInc == 2 * pixelSize && v.dstColInc == 2 * pixelSize
+            && (dstDelta == pixelSize || dstDelta == -pixelSize);
+    const bool srcInterleaved = u.srcColInc == 2 * pixelSize && v.srcColInc == 2 * pixelSize
+            && (srcDelta == pixelSize || srcDelta == -pixelSize);
+    const bool dstPlanar = u.dstColInc == pixelSize && v.dstColInc == pixelSize;
+    const bool srcPlanar = u.srcColInc == pixelSize && v.srcColInc == pixelSize;
+
+    if (dstInterleaved && srcInterleaved && dstDelta == srcDelta) {
+        const PlaneCopy &first = dstDelta > 0 ? u : v;
+        CopyPlane({ first.dst, first.src, pixelSize, first.dstRowInc, pixelSize, first.srcRowInc },
+                  width * 2, height, bpp);
+        return true;
+    }
+    if (bpp != 1) {
+        return false;
+    }
+    if (srcInterleaved && dstPlanar) {
+        const PlaneCopy &first = srcDelta > 0 ? u : v;
+        const PlaneCopy &second = srcDelta > 0 ? v : u;
+        libyuv::SplitUVPlane(
+                first.src, first.srcRowInc,
+                first.dst, first.dstRowInc, second.dst, second.dstRowInc,
+                width, height);
+        return true;
+    }
+    if (srcPlanar && dstInterleaved) {
+        const PlaneCopy &first = dstDelta > 0 ? u : v;
+        const PlaneCopy &second = dstDelta > 0 ? v : u;
+        libyuv::MergeUVPlane(
+                first.src, first.srcRowInc, second.src, second.srcRowInc,
+                first.dst, first.dstRowInc,
+                width, height);
+        return true;
+    }
+    return false;
+}
 
 /**
  * Copies between a MediaImage and a graphic view.
@@ -64,15 +180,14 @@ struct MemCopier<false, S> {
  */
 template<bool ToMediaImage, typename View, typename ImagePixel>
 static status_t _ImageCopy(View &view, const MediaImage2 *img, ImagePixel *imgBase) {
-    // TODO: more efficient copying --- e.g. copy interleaved planes together, etc.
     const C2PlanarLayout &layout = view.layout();
     const size_t bpp = divUp(img->mBitDepthAllocated, 8u);
 
+    if (layout.numPlanes > MediaImage2::MAX_NUM_PLANES) {
+        return BAD_VALUE;
+    }
+    PlaneCopy planes[MediaImage2::MAX_NUM_PLANES];
     for (uint32_t i = 0; i < layout.numPlanes; ++i) {
-        typename std::conditional<ToMediaImage, uint8_t, const uint8_t>::type *imgRow =
-            imgBase + img->mPlane[i].mOffset;
-        typename std::conditional<ToMediaImage, const uint8_t, uint8_t>::type *viewRow =
-            viewRow = view.data()[i];
         const C2PlaneInfo &plane = layout.planes[i];
         if (plane.colSampling != img->mPlane[i].mHorizSubsampling
                 || plane.rowSampling != img->mPlane[i].mVertSubsampling
@@ -83,34 +198,27 @@ static status_t _ImageCopy(View &view, const MediaImage2 *img, ImagePixel *imgBa
                 || (bpp > 1 && plane.endianness != plane.NATIVE)) {
             return BAD_VALUE;
         }
+        planes[i] = MakePlaneCopy(
+                imgBase + img->mPlane[i].mOffset,
+                img->mPlane[i].mColInc, img->mPlane[i].mRowInc,
+                view.data()[i], plane.colInc, plane.rowInc);
+    }
 
+    for (uint32_t i = 0; i < layout.numPlanes; ++i) {
+        const C2PlaneInfo &plane = layout.planes[i];
         uint32_t planeW = img->mWidth / plane.colSampling;
         uint32_t planeH = img->mHeight / plane.rowSampling;
 
-        bool canCopyByRow = (plane.colInc == 1) && (img->mPlane[i].mColInc == 1);
-        bool canCopyByPlane = canCopyByRow && (plane.rowInc == img->mPlane[i].mRowInc);
-        if (canCopyByPlane) {
-            MemCopier<ToMediaImage, 0>::copy(imgRow, viewRow, plane.rowInc * planeH);
-        } else if (canCopyByRow) {
-            for (uint32_t row = 0; row < planeH; ++row) {
-                MemCopier<ToMediaImage, 0>::copy(
-                        imgRow, viewRow, std::min(plane.rowInc, img->mPlane[i].mRowInc));
-                imgRow += img->mPlane[i].mRowInc;
-                viewRow += plane.rowInc;
-            }
-        } else {
-            for (uint32_t row = 0; row < planeH; ++row) {
-                decltype(imgRow) imgPtr = imgRow;
-                decltype(viewRow) viewPtr = viewRow;
-                for (uint32_t col = 0; col < planeW; ++col) {
-                    MemCopier<ToMediaImage, 0>::copy(imgPtr, viewPtr, bpp);
-                    imgPtr += img->mPlane[i].mColInc;
-                    viewPtr += plane.colInc;
-                }
-                imgRow += img->mPlane[i].mRowInc;
-                viewRow += plane.rowInc;
-            }
+        if (layout.type == C2PlanarLayout::TYPE_YUV && layout.numPlanes == 3
+                && i == C2PlanarLayout::PLANE_U
+                && layout.planes[C2PlanarLayout::PLANE_V].colSampling == plane.colSampling
+                && layout.planes[C2PlanarLayout::PLANE_V].rowSampling == plane.rowSampling
+                && CopyChromaPair(planes[C2PlanarLayout::PLANE_U],
+                                  planes[C2PlanarLayout::PLANE_V],
+                                  planeW, planeH, bpp)) {
+            break;
         }
+        CopyPlane(planes[i], planeW, planeH, bpp);
     }
     return OK;
 }
@@ -340,9 +448,95 @@ MediaImage2 CreateYUV420SemiPlanarMediaImage2(
     };
 }
 
+namespace {
+
+/**
+ * Fixed-point (Q8) RGB to YUV conversion coefficients.
+ */
+struct RGBToYUVCoeffs {
+    int32_t yR, yG, yB;
+    int32_t uR, uG, uB;
+    int32_t vR, vG, vB;
+    int32_t yOffset;
+};
+
+constexpr RGBToYUVCoeffs kRGBToYUVBt601Limited = {
+    66, 129, 25,
+    -38, -74, 112,
+    112, -94, -18,
+    16,
+};
+
+constexpr RGBToYUVCoeffs kRGBToYUVBt601Full = {
+    77, 150, 29,
+    -43, -85, 128,
+    128, -107, -21,
+    0,
+};
+
+constexpr RGBToYUVCoeffs kRGBToYUVBt709Limited = {
+    47, 157, 16,
+    -26, -86, 112,
+    112, -102, -10,
+    16,
+};
+
+constexpr RGBToYUVCoeffs kRGBToYUVBt709Full = {
+    54, 183, 19,
+    -29, -99, 128,
+    128, -116, -12,
+    0,
+};
+
+inline uint8_t ClipToU8(int32_t v) {
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+/**
+ * A single color channel of an RGB image.
+ */
+struct RGBChannel {
+    const uint8_t *data;
+    ptrdiff_t colInc;
+    ptrdiff_t rowInc;
+
+    inline int32_t at(size_t x, size_t y) const {
+        return data[(ptrdiff_t)x * colInc + (ptrdiff_t)y * rowInc];
+    }
+};
+
+/**
+ * Converts two rows of RGB pixels starting at |y| to two rows of Y and one row
+ * of U and V.
+ */
+void ConvertRGBRowPairToPlanarYUV(
+        const RGBChannel &red, const RGBChannel &green, const RGBChannel &blue,
+        size_t y, size_t width, const RGBToYUVCoeffs &c,
+        uint8_t *dstY0, uint8_t *dstY1, uint8_t *dstU, uint8_t *dstV) {
+    for (size_t x = 0; x < width; x += 2) {
+        int32_t r00 = red.at(x, y),         g00 = green.at(x, y),         b00 = blue.at(x, y);
+        int32_t r01 = red.at(x + 1, y),     g01 = green.at(x + 1, y),     b01 = blue.at(x + 1, y);
+        int32_t r10 = red.at(x, y + 1),     g10 = green.at(x, y + 1),     b10 = blue.at(x, y + 1);
+        int32_t r11 = red.at(x + 1, y + 1), g11 = green.at(x + 1, y + 1), b11 = blue.at(x + 1, y + 1);
+
+        dstY0[x]     = ClipToU8(((c.yR * r00 + c.yG * g00 + c.yB * b00 + 128) >> 8) + c.yOffset);
+        dstY0[x + 1] = ClipToU8(((c.yR * r01 + c.yG * g01 + c.yB * b01 + 128) >> 8) + c.yOffset);
+        dstY1[x]     = ClipToU8(((c.yR * r10 + c.yG * g10 + c.yB * b10 + 128) >> 8) + c.yOffset);
+        dstY1[x + 1] = ClipToU8(((c.yR * r11 + c.yG * g11 + c.yB * b11 + 128) >> 8) + c.yOffset);
+
+        int32_t r = (r00 + r01 + r10 + r11 + 2) >> 2;
+        int32_t g = (g00 + g01 + g10 + g11 + 2) >> 2;
+        int32_t b = (b00 + b01 + b10 + b11 + 2) >> 2;
+        dstU[x >> 1] = ClipToU8(((c.uR * r + c.uG * g + c.uB * b + 128) >> 8) + 128);
+        dstV[x >> 1] = ClipToU8(((c.vR * r + c.vG * g + c.vB * b + 128) >> 8) + 128);
+    }
+}
+
+}  // namespace
+
 status_t ConvertRGBToPlanarYUV(
         uint8_t *dstY, size_t dstStride, size_t dstVStride, size_t bufferSize,
-        const C2GraphicView &src) {
+        const C2GraphicView &src, C2Color::matrix_t colorMatrix, C2Color::range_t colorRange) {
     CHECK(dstY != nullptr);
     CHECK((src.width() & 1) == 0);
     CHECK((src.height() & 1) == 0);
@@ -356,51 +550,58 @@ status_t ConvertRGBToPlanarYUV(
     uint8_t *dstV = dstU + (dstStride >> 1) * (dstVStride >> 1);
 
     const C2PlanarLayout &layout = src.layout();
+    const C2PlaneInfo &planeR = layout.planes[C2PlanarLayout::PLANE_R];
+    const C2PlaneInfo &planeG = layout.planes[C2PlanarLayout::PLANE_G];
+    const C2PlaneInfo &planeB = layout.planes[C2PlanarLayout::PLANE_B];
     const uint8_t *pRed   = src.data()[C2PlanarLayout::PLANE_R];
     const uint8_t *pGreen = src.data()[C2PlanarLayout::PLANE_G];
     const uint8_t *pBlue  = src.data()[C2PlanarLayout::PLANE_B];
 
-#define CLIP3(x,y,z) (((z) < (x)) ? (x) : (((z) > (y)) ? (y) : (z)))
-    for (size_t y = 0; y < src.height(); ++y) {
-        for (size_t x = 0; x < src.width(); ++x) {
-            uint8_t red = *pRed;
-            uint8_t green = *pGreen;
-            uint8_t blue = *pBlue;
-
-            // using ITU-R BT.601 conversion matrix
-            unsigned luma =
-                CLIP3(0, (((red * 66 + green * 129 + blue * 25) >> 8) + 16), 255);
-
-            dstY[x] = luma;
-
-            if ((x & 1) == 0 && (y & 1) == 0) {
-                unsigned U =
-                    CLIP3(0, (((-red * 38 - green * 74 + blue * 112) >> 8) + 128), 255);
-
-                unsigned V =
-                    CLIP3(0, (((red * 112 - green * 94 - blue * 18) >> 8) + 128), 255);
-
-                dstU[x >> 1] = U;
-                dstV[x >> 1] = V;
-            }
-            pRed   += layout.planes[C2PlanarLayout::PLANE_R].colInc;
-            pGreen += layout.planes[C2PlanarLayout::PLANE_G].colInc;
-            pBlue  += layout.planes[C2PlanarLayout::PLANE_B].colInc;
+    const bool bt709 = colorMatrix == C2Color::MATRIX_BT709;
+    const bool fullRange = colorRange == C2Color::RANGE_FULL;
+
+    // Packed 8-bit 4-byte pixels in R,G,B,X or B,G,R,X order can use libyuv,
+    // which has vectorized row functions for BT.601.
+    bool isPacked32 = planeR.colInc == 4 && planeG.colInc == 4 && planeB.colInc == 4
+            && planeR.rowInc == planeG.rowInc && planeR.rowInc == planeB.rowInc
+            && planeR.allocatedDepth == 8 && planeG.allocatedDepth == 8
+            && planeB.allocatedDepth == 8
+            && pGreen - pRed == pBlue - pGreen
+            && (pGreen - pRed == 1 || pGreen - pRed == -1);
+    if (isPacked32 && !bt709) {
+        const int32_t srcStride = planeR.rowInc;
+        const int32_t dstStrideUV = dstStride >> 1;
+        int res = -1;
+        if (pGreen - pRed == 1 && !fullRange) {
+            // R,G,B,X in memory order is ABGR in libyuv terms
+            res = libyuv::ABGRToI420(
+                    pRed, srcStride, dstY, dstStride, dstU, dstStrideUV, dstV, dstStrideUV,
+                    src.width(), src.height());
+        } else if (pGreen - pBlue == 1) {
+            // B,G,R,X in memory order is ARGB in libyuv terms
+            res = (fullRange ? libyuv::ARGBToJ420 : libyuv::ARGBToI420)(
+                    pBlue, srcStride, dstY, dstStride, dstU, dstStrideUV, dstV, dstStrideUV,
+                    src.width(), src.height());
         }
-
-        if ((y & 1) == 0) {
-            dstU += dstStride >> 1;
-            dstV += dstStride >> 1;
+        if (res == 0) {
+            return OK;
         }
+    }
 
-        pRed   -= layout.planes[C2PlanarLayout::PLANE_R].colInc * src.width();
-        pGreen -= layout.planes[C2PlanarLayout::PLANE_G].colInc * src.width();
-        pBlue  -= layout.planes[C2PlanarLayout::PLANE_B].colInc * src.width();
-        pRed   += layout.planes[C2PlanarLayout::PLANE_R].rowInc;
-        pGreen += layout.planes[C2PlanarLayout::PLANE_G].rowInc;
-        pBlue  += layout.planes[C2PlanarLayout::PLANE_B].rowInc;
-
-        dstY += dstStride;
+    const RGBToYUVCoeffs &coeffs =
+        bt709 ? (fullRange ? kRGBToYUVBt709Full : kRGBToYUVBt709Limited)
+              : (fullRange ? kRGBToYUVBt601Full : kRGBToYUVBt601Limited);
+
+    const RGBChannel red   = { pRed,   planeR.colInc, planeR.rowInc };
+    const RGBChannel green = { pGreen, planeG.colInc, planeG.rowInc };
+    const RGBChannel blue  = { pBlue,  planeB.colInc, planeB.rowInc };
+    for (size_t y = 0; y < src.height(); y += 2) {
+        ConvertRGBRowPairToPlanarYUV(
+                red, green, blue, y, src.width(), coeffs,
+                dstY, dstY + dstStride, dstU, dstV);
+        dstY += dstStride * 2;
+        dstU += dstStride >> 1;
+        dstV += dstStride >> 1;
     }
     return OK;
 }
@@ -18,6 +18,7 @@
 #define CODEC2_BUFFER_UTILS_H_
 
 #include <C2Buffer.h>
+#include <C2Config.h>
 #include <C2ParamDef.h>
 
 #include <media/hardware/VideoAPI.h>
@@ -28,18 +29,27 @@ namespace android {
 /**
  * Converts an RGB view to planar YUV 420 media image.
  *
+ * Chroma is computed from the average of each 2x2 block of pixels. Packed 8-bit
+ * RGBA/RGBX/BGRA sources use vectorized conversion where available.
+ *
  * \param dstY       pointer to media image buffer
  * \param dstStride  stride in bytes
  * \param dstVStride vertical stride in pixels
  * \param bufferSize media image buffer size
  * \param src source image
+ * \param colorMatrix color matrix of the YUV image. MATRIX_BT709 selects
+ *                   BT.709 coefficients; all other values select BT.601.
+ * \param colorRange color range of the YUV image. RANGE_FULL selects full
+ *                   range; all other values select limited range.
  *
  * \retval NO_MEMORY media image is too small
  * \retval OK on success
  */
 status_t ConvertRGBToPlanarYUV(
         uint8_t *dstY, size_t dstStride, size_t dstVStride, size_t bufferSize,
-        const C2GraphicView &src);
+        const C2GraphicView &src,
+        C2Color::matrix_t colorMatrix = C2Color::MATRIX_BT601,
+        C2Color::range_t colorRange = C2Color::RANGE_LIMITED);
 
 /**
  * Returns a planar YUV 420 8-bit media image descriptor.